@@ -24,6 +24,9 @@ set -o errexit  # Exit the script with error if any of the commands fail
 #       SASL                    Build against SASL or not
 #       SRV                     Whether to enable SRV: ON or OFF
 #       ENABLE_SHM_COUNTERS     Build with SHM counters
+#       ENABLE_EPOLL            Scan the topology with epoll instead of poll
+#       ENABLE_IO_URING         Use io_uring for blocking socket I/O
+#       ENABLE_ZEROCOPY         Send large messages with MSG_ZEROCOPY
 #       ZSTD                    Build against system zstd.
 
 # Options for this script.
@@ -36,6 +39,9 @@ COVERAGE=${COVERAGE:-OFF}
 RDTSCP=${RDTSCP:-OFF}
 SKIP_MOCK_TESTS=${SKIP_MOCK_TESTS:-OFF}
 ENABLE_SHM_COUNTERS=${ENABLE_SHM_COUNTERS:-AUTO}
+ENABLE_EPOLL=${ENABLE_EPOLL:-AUTO}
+ENABLE_IO_URING=${ENABLE_IO_URING:-OFF}
+ENABLE_ZEROCOPY=${ENABLE_ZEROCOPY:-OFF}
 
 # CMake options.
 SASL=${SASL:-OFF}
@@ -90,6 +96,9 @@ DEBUG_AND_RELEASE_FLAGS="\
    -DCMAKE_PREFIX_PATH=$CMAKE_PREFIX_PATH \
    -DCMAKE_INSTALL_PREFIX=$INSTALL_DIR \
    -DENABLE_SHM_COUNTERS=$ENABLE_SHM_COUNTERS \
+   -DENABLE_EPOLL=$ENABLE_EPOLL \
+   -DENABLE_IO_URING=$ENABLE_IO_URING \
+   -DENABLE_ZEROCOPY=$ENABLE_ZEROCOPY \
 "
 
 if [ ! -z "$ZLIB" ]; then
@@ -316,6 +316,8 @@ all_tasks = [
     CompileTask('debug-compile-nosrv',
                 tags=['debug-compile'],
                 SRV='OFF'),
+    CompileTask('debug-compile-io-uring',
+                ENABLE_IO_URING='ON'),
     LinkTask('link-with-cmake',
              suffix_commands=[
                  func('link sample program', BUILD_SAMPLE_WITH_CMAKE=1)]),
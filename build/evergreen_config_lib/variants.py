@@ -308,6 +308,8 @@ all_variants = [
              'debug-compile-asan-gcc',
              'debug-compile-coverage',
              'debug-compile-nosrv',
+             OD([('name', 'debug-compile-io-uring'),
+                 ('distros', ['ubuntu2204-small'])]),
              'release-compile',
              'debug-compile-nosasl-nossl',
              'debug-compile-no-align',
@@ -157,6 +157,16 @@ future_functions = [
                      param("bson_ptr", "reply"),
                      param("bson_error_ptr", "error")]),
 
+    future_function("bool",
+                    "mongoc_client_command_simple_pipelined",
+                    [param("mongoc_client_ptr", "client"),
+                     param("const_char_ptr", "db_name"),
+                     param("const_bson_ptr_ptr", "commands"),
+                     param("size_t", "n_commands"),
+                     param("const_mongoc_read_prefs_ptr", "read_prefs"),
+                     param("bson_ptr", "replies"),
+                     param("bson_error_ptr", "error")]),
+
     future_function("bool",
                     "mongoc_client_command_with_opts",
                     [param("mongoc_client_ptr", "client"),
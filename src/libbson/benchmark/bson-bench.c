@@ -0,0 +1,511 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <bson/bson.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Micro-benchmarks for libbson, modeled on the BSON benchmarks of the
+ * driver benchmarking specification: encoding and decoding of flat, deep,
+ * and full documents, plus JSON conversion and validation.
+ *
+ * The documents are generated in memory so no data files are needed.
+ * Each benchmark is calibrated and warmed up, then run REPS times; the
+ * median is reported as nanoseconds per operation and as megabytes of BSON
+ * processed per second.
+ *
+ * usage: bson-bench [-r REPS] [FILTER]
+ *
+ * Only benchmarks whose names contain FILTER are run.
+ */
+
+
+/* how long one repetition should take, in microseconds */
+#define BENCH_REP_USEC 50000
+#define BENCH_DEFAULT_REPS 10
+#define BENCH_MAX_REPS 100
+
+
+typedef struct {
+   const char *name;
+   bson_t *bson;
+   char *json;
+} bench_doc_t;
+
+
+typedef struct {
+   const char *name;
+   void (*fn) (const bench_doc_t *doc);
+} bench_op_t;
+
+
+/* results are accumulated here so the compiler cannot discard the work */
+static volatile uint64_t gSink;
+
+
+static void
+_append_flat (bson_t *doc, int n_fields)
+{
+   char key[32];
+   int i;
+
+   for (i = 0; i < n_fields; i++) {
+      switch (i % 5) {
+      case 0:
+         bson_snprintf (key, sizeof key, "int32_field_%d", i);
+         BSON_ASSERT (bson_append_int32 (doc, key, -1, i * 1000));
+         break;
+      case 1:
+         bson_snprintf (key, sizeof key, "int64_field_%d", i);
+         BSON_ASSERT (
+            bson_append_int64 (doc, key, -1, (int64_t) i * 1000000007));
+         break;
+      case 2:
+         bson_snprintf (key, sizeof key, "double_field_%d", i);
+         BSON_ASSERT (bson_append_double (doc, key, -1, i * 3.14159));
+         break;
+      case 3:
+         bson_snprintf (key, sizeof key, "string_field_%d", i);
+         BSON_ASSERT (bson_append_utf8 (
+            doc, key, -1, "The quick brown fox jumps over the lazy dog", -1));
+         break;
+      default:
+         bson_snprintf (key, sizeof key, "bool_field_%d", i);
+         BSON_ASSERT (bson_append_bool (doc, key, -1, i % 2 == 0));
+         break;
+      }
+   }
+}
+
+
+static bson_t *
+_make_flat (void)
+{
+   bson_t *doc = bson_new ();
+
+   _append_flat (doc, 150);
+
+   return doc;
+}
+
+
+static void
+_append_deep (bson_t *doc, int depth)
+{
+   bson_t child;
+
+   BSON_ASSERT (bson_append_utf8 (doc, "name", -1, "level", -1));
+   BSON_ASSERT (bson_append_int32 (doc, "depth", -1, depth));
+
+   if (depth > 0) {
+      BSON_ASSERT (bson_append_document_begin (doc, "child", -1, &child));
+      _append_deep (&child, depth - 1);
+      BSON_ASSERT (bson_append_document_end (doc, &child));
+   }
+
+   BSON_ASSERT (bson_append_utf8 (doc, "tail", -1, "end of level", -1));
+}
+
+
+static bson_t *
+_make_deep (void)
+{
+   bson_t *doc = bson_new ();
+   bson_t child;
+   char key[16];
+   int i;
+
+   /* several deep subtrees rather than one, to stay within the JSON
+    * parser's nesting limit while making the document reasonably large */
+   for (i = 0; i < 8; i++) {
+      bson_snprintf (key, sizeof key, "tree_%d", i);
+      BSON_ASSERT (bson_append_document_begin (doc, key, -1, &child));
+      _append_deep (&child, 20);
+      BSON_ASSERT (bson_append_document_end (doc, &child));
+   }
+
+   return doc;
+}
+
+
+static bson_t *
+_make_full (void)
+{
+   bson_t *doc = bson_new ();
+   bson_t child;
+   bson_t *scope;
+   bson_t *array;
+   bson_oid_t oid;
+   bson_decimal128_t dec;
+   const uint8_t bin[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+   char key[16];
+   int i;
+
+   scope = BCON_NEW ("x", BCON_INT32 (1));
+   array = BCON_NEW (
+      "0", BCON_INT32 (1), "1", BCON_UTF8 ("two"), "2", BCON_DOUBLE (3.0));
+   bson_oid_init_from_string (&oid, "5a1b2c3d4e5f60718293a4b5");
+   BSON_ASSERT (bson_decimal128_from_string ("1234.5678E-9", &dec));
+
+   for (i = 0; i < 10; i++) {
+      bson_snprintf (key, sizeof key, "sub_%d", i);
+      BSON_ASSERT (bson_append_document_begin (doc, key, -1, &child));
+
+      BSON_ASSERT (bson_append_oid (&child, "_id", -1, &oid));
+      BSON_ASSERT (bson_append_utf8 (
+         &child, "string", -1, "h\xc3\xa9llo w\xc3\xb6rld", -1));
+      BSON_ASSERT (bson_append_int32 (&child, "int32", -1, -i));
+      BSON_ASSERT (bson_append_int64 (&child, "int64", -1, INT64_MAX - i));
+      BSON_ASSERT (bson_append_double (&child, "double", -1, 1.0 / (i + 3)));
+      BSON_ASSERT (bson_append_decimal128 (&child, "decimal", -1, &dec));
+      BSON_ASSERT (bson_append_bool (&child, "bool", -1, true));
+      BSON_ASSERT (bson_append_null (&child, "null", -1));
+      BSON_ASSERT (
+         bson_append_date_time (&child, "date", -1, 1500000000000 + i));
+      BSON_ASSERT (bson_append_timestamp (&child, "timestamp", -1, 100, i));
+      BSON_ASSERT (bson_append_regex (&child, "regex", -1, "^a.*z$", "im"));
+      BSON_ASSERT (bson_append_binary (
+         &child, "binary", -1, BSON_SUBTYPE_BINARY, bin, sizeof bin));
+      BSON_ASSERT (bson_append_code (&child, "code", -1, "function () {}"));
+      BSON_ASSERT (bson_append_code_with_scope (
+         &child, "code_w_scope", -1, "function () { return x; }", scope));
+      BSON_ASSERT (bson_append_minkey (&child, "minkey", -1));
+      BSON_ASSERT (bson_append_maxkey (&child, "maxkey", -1));
+      BSON_ASSERT (bson_append_document (&child, "document", -1, scope));
+      BSON_ASSERT (bson_append_array (&child, "array", -1, array));
+
+      BSON_ASSERT (bson_append_document_end (doc, &child));
+   }
+
+   bson_destroy (scope);
+   bson_destroy (array);
+
+   return doc;
+}
+
+
+/* walk every field, reading its value */
+static void
+_decode (bson_iter_t *iter)
+{
+   bson_iter_t child;
+   uint32_t len;
+   uint64_t sum = 0;
+
+   while (bson_iter_next (iter)) {
+      sum += bson_iter_key_len (iter);
+
+      switch ((int) bson_iter_type (iter)) {
+      case BSON_TYPE_UTF8:
+         bson_iter_utf8 (iter, &len);
+         sum += len;
+         break;
+      case BSON_TYPE_INT32:
+         sum += (uint64_t) bson_iter_int32 (iter);
+         break;
+      case BSON_TYPE_INT64:
+         sum += (uint64_t) bson_iter_int64 (iter);
+         break;
+      case BSON_TYPE_DOUBLE:
+         sum += (uint64_t) bson_iter_double (iter);
+         break;
+      case BSON_TYPE_BOOL:
+         sum += bson_iter_bool (iter);
+         break;
+      case BSON_TYPE_DOCUMENT:
+      case BSON_TYPE_ARRAY:
+         BSON_ASSERT (bson_iter_recurse (iter, &child));
+         _decode (&child);
+         break;
+      default:
+         sum += bson_iter_type (iter);
+         break;
+      }
+   }
+
+   gSink += sum;
+}
+
+
+/* rebuild the document at @iter field by field */
+static void
+_encode (bson_iter_t *iter, bson_t *dst)
+{
+   bson_iter_t child;
+   bson_t dst_child;
+   const char *key;
+   const char *str;
+   uint32_t key_len;
+   uint32_t len;
+
+   while (bson_iter_next (iter)) {
+      key = bson_iter_key (iter);
+      key_len = bson_iter_key_len (iter);
+
+      switch ((int) bson_iter_type (iter)) {
+      case BSON_TYPE_UTF8:
+         str = bson_iter_utf8 (iter, &len);
+         BSON_ASSERT (bson_append_utf8 (dst, key, key_len, str, len));
+         break;
+      case BSON_TYPE_INT32:
+         BSON_ASSERT (
+            bson_append_int32 (dst, key, key_len, bson_iter_int32 (iter)));
+         break;
+      case BSON_TYPE_INT64:
+         BSON_ASSERT (
+            bson_append_int64 (dst, key, key_len, bson_iter_int64 (iter)));
+         break;
+      case BSON_TYPE_DOUBLE:
+         BSON_ASSERT (
+            bson_append_double (dst, key, key_len, bson_iter_double (iter)));
+         break;
+      case BSON_TYPE_BOOL:
+         BSON_ASSERT (
+            bson_append_bool (dst, key, key_len, bson_iter_bool (iter)));
+         break;
+      case BSON_TYPE_DOCUMENT:
+         BSON_ASSERT (bson_iter_recurse (iter, &child));
+         BSON_ASSERT (
+            bson_append_document_begin (dst, key, key_len, &dst_child));
+         _encode (&child, &dst_child);
+         BSON_ASSERT (bson_append_document_end (dst, &dst_child));
+         break;
+      case BSON_TYPE_ARRAY:
+         BSON_ASSERT (bson_iter_recurse (iter, &child));
+         BSON_ASSERT (bson_append_array_begin (dst, key, key_len, &dst_child));
+         _encode (&child, &dst_child);
+         BSON_ASSERT (bson_append_array_end (dst, &dst_child));
+         break;
+      default:
+         BSON_ASSERT (bson_append_iter (dst, key, key_len, iter));
+         break;
+      }
+   }
+}
+
+
+static void
+_op_encode (const bench_doc_t *doc)
+{
+   bson_iter_t iter;
+   bson_t dst;
+
+   bson_init (&dst);
+   BSON_ASSERT (bson_iter_init (&iter, doc->bson));
+   _encode (&iter, &dst);
+   gSink += dst.len;
+   bson_destroy (&dst);
+}
+
+
+static void
+_op_decode (const bench_doc_t *doc)
+{
+   bson_iter_t iter;
+
+   BSON_ASSERT (bson_iter_init (&iter, doc->bson));
+   _decode (&iter);
+}
+
+
+static void
+_op_validate (const bench_doc_t *doc)
+{
+   size_t offset;
+
+   BSON_ASSERT (bson_validate (doc->bson, BSON_VALIDATE_UTF8, &offset));
+   gSink += offset;
+}
+
+
+static void
+_op_to_json (const bench_doc_t *doc)
+{
+   size_t len;
+   char *json;
+
+   json = bson_as_canonical_extended_json (doc->bson, &len);
+   BSON_ASSERT (json);
+   gSink += len;
+   bson_free (json);
+}
+
+
+static void
+_op_from_json (const bench_doc_t *doc)
+{
+   bson_error_t error;
+   bson_t dst;
+
+   if (!bson_init_from_json (&dst, doc->json, -1, &error)) {
+      fprintf (stderr, "%s: %s\n", doc->name, error.message);
+      abort ();
+   }
+
+   gSink += dst.len;
+   bson_destroy (&dst);
+}
+
+
+static const bench_op_t gOps[] = {
+   {"encode", _op_encode},
+   {"decode", _op_decode},
+   {"validate", _op_validate},
+   {"to_json", _op_to_json},
+   {"from_json", _op_from_json},
+};
+
+
+static int64_t
+_time_iters (const bench_op_t *op, const bench_doc_t *doc, int64_t iters)
+{
+   int64_t start;
+   int64_t i;
+
+   start = bson_get_monotonic_time ();
+
+   for (i = 0; i < iters; i++) {
+      op->fn (doc);
+   }
+
+   return bson_get_monotonic_time () - start;
+}
+
+
+static int
+_cmp_double (const void *a, const void *b)
+{
+   double x = *(const double *) a;
+   double y = *(const double *) b;
+
+   return x < y ? -1 : x > y ? 1 : 0;
+}
+
+
+static void
+_run (const bench_op_t *op, const bench_doc_t *doc, int reps)
+{
+   double ns_per_op[BENCH_MAX_REPS];
+   char name[64];
+   int64_t iters = 1;
+   int64_t elapsed;
+   double median;
+   int i;
+
+   /* find an iteration count that takes long enough to time accurately;
+    * this also serves as the warmup */
+   while ((elapsed = _time_iters (op, doc, iters)) < BENCH_REP_USEC / 10) {
+      iters *= 2;
+   }
+
+   iters = BSON_MAX (1, iters * BENCH_REP_USEC / BSON_MAX (elapsed, 1));
+   (void) _time_iters (op, doc, iters);
+
+   for (i = 0; i < reps; i++) {
+      elapsed = _time_iters (op, doc, iters);
+      ns_per_op[i] = (double) elapsed * 1000.0 / (double) iters;
+   }
+
+   qsort (ns_per_op, (size_t) reps, sizeof (double), _cmp_double);
+   median = reps % 2 ? ns_per_op[reps / 2]
+                     : (ns_per_op[reps / 2 - 1] + ns_per_op[reps / 2]) / 2;
+
+   bson_snprintf (name, sizeof name, "%s/%s", doc->name, op->name);
+
+   /* bytes per nanosecond * 1000 == megabytes per second */
+   printf ("%-24s %10u %14.1f %12.2f\n",
+           name,
+           doc->bson->len,
+           median,
+           (double) doc->bson->len * 1000.0 / median);
+   fflush (stdout);
+}
+
+
+static void
+_usage (void)
+{
+   fprintf (stderr,
+            "usage: bson-bench [-r REPS] [FILTER]\n"
+            "\n"
+            "  -r REPS  number of timed repetitions, 1 to %d (default %d)\n"
+            "  FILTER   run only benchmarks whose names contain FILTER\n",
+            BENCH_MAX_REPS,
+            BENCH_DEFAULT_REPS);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+   bench_doc_t docs[3];
+   const char *filter = NULL;
+   int reps = BENCH_DEFAULT_REPS;
+   char name[64];
+   size_t i;
+   size_t j;
+   int arg;
+
+   for (arg = 1; arg < argc; arg++) {
+      if (!strcmp (argv[arg], "-r") && arg + 1 < argc) {
+         reps = atoi (argv[++arg]);
+         if (reps < 1 || reps > BENCH_MAX_REPS) {
+            _usage ();
+            return EXIT_FAILURE;
+         }
+      } else if (argv[arg][0] == '-' || filter) {
+         _usage ();
+         return EXIT_FAILURE;
+      } else {
+         filter = argv[arg];
+      }
+   }
+
+   docs[0].name = "flat";
+   docs[0].bson = _make_flat ();
+   docs[1].name = "deep";
+   docs[1].bson = _make_deep ();
+   docs[2].name = "full";
+   docs[2].bson = _make_full ();
+
+   for (i = 0; i < sizeof docs / sizeof docs[0]; i++) {
+      docs[i].json = bson_as_canonical_extended_json (docs[i].bson, NULL);
+      BSON_ASSERT (docs[i].json);
+   }
+
+   printf ("%-24s %10s %14s %12s\n", "benchmark", "bytes", "ns/op", "MB/s");
+
+   for (i = 0; i < sizeof docs / sizeof docs[0]; i++) {
+      for (j = 0; j < sizeof gOps / sizeof gOps[0]; j++) {
+         bson_snprintf (name, sizeof name, "%s/%s", docs[i].name, gOps[j].name);
+         if (filter && !strstr (name, filter)) {
+            continue;
+         }
+
+         _run (&gOps[j], &docs[i], reps);
+      }
+   }
+
+   for (i = 0; i < sizeof docs / sizeof docs[0]; i++) {
+      bson_destroy (docs[i].bson);
+      bson_free (docs[i].json);
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -20,6 +20,7 @@
 
 
 #include <stdio.h>
+#include <string.h>
 
 #include "bcon.h"
 #include "bson-config.h"
@@ -128,6 +129,7 @@ typedef union bcon_append {
    int64_t INT64;
    bson_decimal128_t *DECIMAL128;
    const bson_iter_t *ITER;
+   bson_type_t SLOT;
 } bcon_append_t;
 
 /* same as bcon_append_t.  Some extra symbols and varying types that handle the
@@ -181,6 +183,28 @@ typedef union bcon_extract {
    bson_decimal128_t *DECIMAL128;
 } bcon_extract_t;
 
+/* a value to be filled in when a template is instantiated */
+typedef struct {
+   bson_type_t type;
+   uint32_t offset; /* start of the placeholder value in the image */
+   uint32_t len;    /* length of the placeholder value */
+} bcon_template_slot_t;
+
+/* a document or array whose length must be patched when a slot within it
+ * changes size */
+typedef struct {
+   uint32_t offset;
+   uint32_t len;
+} bcon_template_doc_t;
+
+struct _bcon_template_t {
+   bson_t image;
+   bcon_template_slot_t *slots;
+   uint32_t n_slots;
+   bcon_template_doc_t *docs;
+   uint32_t n_docs;
+};
+
 static const char *gBconMagic = "BCON_MAGIC";
 static const char *gBconeMagic = "BCONE_MAGIC";
 
@@ -541,6 +565,9 @@ _bcon_append_tokenize (va_list *ap, bcon_append_t *u)
       case BCON_TYPE_ITER:
          u->ITER = va_arg (*ap, const bson_iter_t *);
          break;
+      case BCON_TYPE_SLOT:
+         u->SLOT = va_arg (*ap, bson_type_t);
+         break;
       default:
          BSON_ASSERT (0);
          break;
@@ -733,6 +760,122 @@ _bson_concat_array (bson_t *dest, const bson_t *src, bcon_append_ctx_t *ctx)
 }
 
 
+/* appends a placeholder for a template slot and records where it is, along
+ * with the documents enclosing it if the value's length can vary */
+static void
+_bcon_template_add_slot (bcon_template_t *tmpl,
+                         bson_t *root,
+                         bcon_append_ctx_t *ctx,
+                         bson_t *bson,
+                         const char *key,
+                         bson_type_t type)
+{
+   static const bson_oid_t zero_oid = {{0}};
+   bcon_template_slot_t *slot;
+   bson_decimal128_t zero_dec = {0};
+   bson_t empty = BSON_INITIALIZER;
+   const uint8_t *root_data;
+   const bson_t *doc;
+   uint32_t len_before;
+   uint32_t doc_offset;
+   bool variable = false;
+   int i;
+   uint32_t j;
+
+   len_before = bson->len;
+
+   switch ((int) type) {
+   case BSON_TYPE_UTF8:
+      BSON_ASSERT (bson_append_utf8 (bson, key, -1, "", 0));
+      variable = true;
+      break;
+   case BSON_TYPE_DOCUMENT:
+      BSON_ASSERT (bson_append_document (bson, key, -1, &empty));
+      variable = true;
+      break;
+   case BSON_TYPE_ARRAY:
+      BSON_ASSERT (bson_append_array (bson, key, -1, &empty));
+      variable = true;
+      break;
+   case BSON_TYPE_BINARY:
+      BSON_ASSERT (bson_append_binary (
+         bson, key, -1, BSON_SUBTYPE_BINARY, (const uint8_t *) "", 0));
+      variable = true;
+      break;
+   case BSON_TYPE_OID:
+      BSON_ASSERT (bson_append_oid (bson, key, -1, &zero_oid));
+      break;
+   case BSON_TYPE_BOOL:
+      BSON_ASSERT (bson_append_bool (bson, key, -1, false));
+      break;
+   case BSON_TYPE_DATE_TIME:
+      BSON_ASSERT (bson_append_date_time (bson, key, -1, 0));
+      break;
+   case BSON_TYPE_TIMESTAMP:
+      BSON_ASSERT (bson_append_timestamp (bson, key, -1, 0, 0));
+      break;
+   case BSON_TYPE_DOUBLE:
+      BSON_ASSERT (bson_append_double (bson, key, -1, 0.0));
+      break;
+   case BSON_TYPE_INT32:
+      BSON_ASSERT (bson_append_int32 (bson, key, -1, 0));
+      break;
+   case BSON_TYPE_INT64:
+      BSON_ASSERT (bson_append_int64 (bson, key, -1, 0));
+      break;
+   case BSON_TYPE_DECIMAL128:
+      BSON_ASSERT (bson_append_decimal128 (bson, key, -1, &zero_dec));
+      break;
+   default:
+      /* not a type a slot can hold */
+      BSON_ASSERT (0);
+      break;
+   }
+
+   if (tmpl->n_slots % 8 == 0) {
+      tmpl->slots = bson_realloc (
+         tmpl->slots, (tmpl->n_slots + 8) * sizeof (bcon_template_slot_t));
+   }
+
+   /* child documents share the root's buffer, so offsets within it are
+    * offsets within the final image */
+   root_data = bson_get_data (root);
+
+   slot = &tmpl->slots[tmpl->n_slots++];
+   slot->type = type;
+   slot->len = bson->len - len_before - (uint32_t) strlen (key) - 2;
+   slot->offset =
+      (uint32_t) (bson_get_data (bson) - root_data) + bson->len - 1 - slot->len;
+
+   if (!variable) {
+      return;
+   }
+
+   for (i = 0; i <= ctx->n; i++) {
+      doc = i == 0 ? root : &ctx->stack[i].bson;
+      doc_offset = (uint32_t) (bson_get_data (doc) - root_data);
+
+      for (j = 0; j < tmpl->n_docs; j++) {
+         if (tmpl->docs[j].offset == doc_offset) {
+            break;
+         }
+      }
+
+      if (j == tmpl->n_docs) {
+         if (tmpl->n_docs % 8 == 0) {
+            tmpl->docs = bson_realloc (
+               tmpl->docs, (tmpl->n_docs + 8) * sizeof (bcon_template_doc_t));
+         }
+
+         /* the length is read once the image is complete */
+         tmpl->docs[tmpl->n_docs].offset = doc_offset;
+         tmpl->docs[tmpl->n_docs].len = 0;
+         tmpl->n_docs++;
+      }
+   }
+}
+
+
 /* Append_ctx_va consumes the va_list until NULL is found, appending into bson
  * as tokens are found.  It can receive or return an in-progress bson object
  * via the ctx param.  It can also operate on the middle of a va_list, and so
@@ -751,8 +894,11 @@ _bson_concat_array (bson_t *dest, const bson_t *src, bcon_append_ctx_t *ctx)
  * There are also a few STACK_* macros in here which manipulate ctx that are
  * defined up top.
  * */
-void
-bcon_append_ctx_va (bson_t *bson, bcon_append_ctx_t *ctx, va_list *ap)
+static void
+_bcon_append_ctx_va (bson_t *bson,
+                     bcon_append_ctx_t *ctx,
+                     va_list *ap,
+                     bcon_template_t *tmpl)
 {
    bcon_type_t type;
    const char *key;
@@ -812,6 +958,18 @@ bcon_append_ctx_va (bson_t *bson, bcon_append_ctx_t *ctx, va_list *ap)
          STACK_POP_ARRAY (
             bson_append_array_end (STACK_BSON_PARENT, STACK_BSON_CHILD));
          break;
+      case BCON_TYPE_SLOT:
+         if (!tmpl) {
+            /* a slot has no value outside of bcon_template_new, so its
+             * element is left out, as documented in bcon.h */
+            if (STACK_IS_ARRAY) {
+               STACK_I--;
+            }
+            break;
+         }
+         _bcon_template_add_slot (
+            tmpl, bson, ctx, STACK_BSON_CHILD, key, u.SLOT);
+         break;
       default:
          _bcon_append_single (STACK_BSON_CHILD, type, key, &u);
 
@@ -821,6 +979,13 @@ bcon_append_ctx_va (bson_t *bson, bcon_append_ctx_t *ctx, va_list *ap)
 }
 
 
+void
+bcon_append_ctx_va (bson_t *bson, bcon_append_ctx_t *ctx, va_list *ap)
+{
+   _bcon_append_ctx_va (bson, ctx, ap, NULL);
+}
+
+
 /* extract_ctx_va consumes the va_list until NULL is found, extracting values
  * as tokens are found.  It can receive or return an in-progress bson object
  * via the ctx param.  It can also operate on the middle of a va_list, and so
@@ -1015,3 +1180,570 @@ bcon_new (void *unused, ...)
 
    return bson;
 }
+
+
+bcon_template_t *
+bcon_template_new (void *unused, ...)
+{
+   va_list ap;
+   bcon_append_ctx_t ctx;
+   bcon_template_t *tmpl;
+   const uint8_t *data;
+   uint32_t len;
+   uint32_t i;
+
+   bcon_append_ctx_init (&ctx);
+
+   tmpl = bson_malloc0 (sizeof *tmpl);
+   bson_init (&tmpl->image);
+
+   va_start (ap, unused);
+
+   _bcon_append_ctx_va (&tmpl->image, &ctx, &ap, tmpl);
+
+   va_end (ap);
+
+   data = bson_get_data (&tmpl->image);
+
+   for (i = 0; i < tmpl->n_docs; i++) {
+      memcpy (&len, data + tmpl->docs[i].offset, sizeof len);
+      tmpl->docs[i].len = BSON_UINT32_FROM_LE (len);
+   }
+
+   return tmpl;
+}
+
+
+uint32_t
+bcon_template_n_slots (const bcon_template_t *tmpl)
+{
+   BSON_ASSERT (tmpl);
+
+   return tmpl->n_slots;
+}
+
+
+/* the encoded length of a value, which must be of a type a slot can hold */
+static uint32_t
+_bcon_template_value_len (const bson_value_t *value)
+{
+   switch ((int) value->value_type) {
+   case BSON_TYPE_UTF8:
+      return 4 + value->value.v_utf8.len + 1;
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+      return value->value.v_doc.data_len;
+   case BSON_TYPE_BINARY:
+      if (value->value.v_binary.subtype == BSON_SUBTYPE_BINARY_DEPRECATED) {
+         return 4 + 1 + 4 + value->value.v_binary.data_len;
+      }
+      return 4 + 1 + value->value.v_binary.data_len;
+   case BSON_TYPE_BOOL:
+      return 1;
+   case BSON_TYPE_INT32:
+      return 4;
+   case BSON_TYPE_OID:
+      return 12;
+   case BSON_TYPE_DECIMAL128:
+      return 16;
+   default:
+      /* double, datetime, timestamp, int64 */
+      return 8;
+   }
+}
+
+
+static void
+_bcon_template_write_value (uint8_t *out, const bson_value_t *value)
+{
+   uint32_t u32;
+   uint64_t u64;
+   double dbl;
+
+   switch ((int) value->value_type) {
+   case BSON_TYPE_UTF8:
+      u32 = BSON_UINT32_TO_LE (value->value.v_utf8.len + 1);
+      memcpy (out, &u32, 4);
+      memcpy (out + 4, value->value.v_utf8.str, value->value.v_utf8.len);
+      out[4 + value->value.v_utf8.len] = '\0';
+      break;
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+      memcpy (out, value->value.v_doc.data, value->value.v_doc.data_len);
+      break;
+   case BSON_TYPE_BINARY:
+      if (value->value.v_binary.subtype == BSON_SUBTYPE_BINARY_DEPRECATED) {
+         u32 = BSON_UINT32_TO_LE (value->value.v_binary.data_len + 4);
+         memcpy (out, &u32, 4);
+         out[4] = (uint8_t) value->value.v_binary.subtype;
+         u32 = BSON_UINT32_TO_LE (value->value.v_binary.data_len);
+         memcpy (out + 5, &u32, 4);
+         out += 9;
+      } else {
+         u32 = BSON_UINT32_TO_LE (value->value.v_binary.data_len);
+         memcpy (out, &u32, 4);
+         out[4] = (uint8_t) value->value.v_binary.subtype;
+         out += 5;
+      }
+      memcpy (out, value->value.v_binary.data, value->value.v_binary.data_len);
+      break;
+   case BSON_TYPE_OID:
+      memcpy (out, &value->value.v_oid, 12);
+      break;
+   case BSON_TYPE_BOOL:
+      out[0] = value->value.v_bool ? 1 : 0;
+      break;
+   case BSON_TYPE_DATE_TIME:
+      u64 = BSON_UINT64_TO_LE ((uint64_t) value->value.v_datetime);
+      memcpy (out, &u64, 8);
+      break;
+   case BSON_TYPE_TIMESTAMP:
+      u64 = (((uint64_t) value->value.v_timestamp.timestamp) << 32) |
+            ((uint64_t) value->value.v_timestamp.increment);
+      u64 = BSON_UINT64_TO_LE (u64);
+      memcpy (out, &u64, 8);
+      break;
+   case BSON_TYPE_DOUBLE:
+      dbl = BSON_DOUBLE_TO_LE (value->value.v_double);
+      memcpy (out, &dbl, 8);
+      break;
+   case BSON_TYPE_INT32:
+      u32 = BSON_UINT32_TO_LE ((uint32_t) value->value.v_int32);
+      memcpy (out, &u32, 4);
+      break;
+   case BSON_TYPE_INT64:
+      u64 = BSON_UINT64_TO_LE ((uint64_t) value->value.v_int64);
+      memcpy (out, &u64, 8);
+      break;
+   case BSON_TYPE_DECIMAL128:
+      u64 = BSON_UINT64_TO_LE (value->value.v_decimal128.low);
+      memcpy (out, &u64, 8);
+      u64 = BSON_UINT64_TO_LE (value->value.v_decimal128.high);
+      memcpy (out + 8, &u64, 8);
+      break;
+   default:
+      BSON_ASSERT (0);
+      break;
+   }
+}
+
+
+bool
+bcon_template_instantiate (const bcon_template_t *tmpl,
+                           const bson_value_t *values,
+                           bson_t *dst)
+{
+   const bcon_template_slot_t *slot;
+   const bcon_template_doc_t *doc;
+   const uint8_t *image;
+   uint8_t *buf;
+   uint8_t *out;
+   int64_t len;
+   int64_t shift;
+   int64_t grow;
+   int64_t delta;
+   uint32_t doc_len;
+   uint32_t src_off;
+   uint32_t i;
+   uint32_t j;
+
+   BSON_ASSERT (tmpl);
+   BSON_ASSERT (values || !tmpl->n_slots);
+   BSON_ASSERT (dst);
+
+   bson_init (dst);
+
+   len = tmpl->image.len;
+
+   for (i = 0; i < tmpl->n_slots; i++) {
+      if (values[i].value_type != tmpl->slots[i].type) {
+         return false;
+      }
+
+      len += (int64_t) _bcon_template_value_len (&values[i]) -
+             tmpl->slots[i].len;
+   }
+
+   if (len > BSON_MAX_SIZE || !(buf = bson_reserve_buffer (dst, len))) {
+      return false;
+   }
+
+   image = bson_get_data (&tmpl->image);
+   out = buf;
+   src_off = 0;
+
+   for (i = 0; i < tmpl->n_slots; i++) {
+      slot = &tmpl->slots[i];
+      memcpy (out, image + src_off, slot->offset - src_off);
+      out += slot->offset - src_off;
+      _bcon_template_write_value (out, &values[i]);
+      out += _bcon_template_value_len (&values[i]);
+      src_off = slot->offset + slot->len;
+   }
+
+   memcpy (out, image + src_off, tmpl->image.len - src_off);
+
+   /* each enclosing document grows by the change in length of the slots
+    * within it, and moves by the change in length of the slots before it */
+   for (i = 0; i < tmpl->n_docs; i++) {
+      doc = &tmpl->docs[i];
+      shift = 0;
+      grow = 0;
+
+      for (j = 0; j < tmpl->n_slots; j++) {
+         slot = &tmpl->slots[j];
+         delta = (int64_t) _bcon_template_value_len (&values[j]) - slot->len;
+
+         if (slot->offset < doc->offset) {
+            shift += delta;
+         } else if (slot->offset < doc->offset + doc->len) {
+            grow += delta;
+         } else {
+            break;
+         }
+      }
+
+      doc_len = BSON_UINT32_TO_LE ((uint32_t) (doc->len + grow));
+      memcpy (buf + doc->offset + shift, &doc_len, sizeof doc_len);
+   }
+
+   return true;
+}
+
+
+void
+bcon_template_destroy (bcon_template_t *tmpl)
+{
+   if (tmpl) {
+      bson_destroy (&tmpl->image);
+      bson_free (tmpl->slots);
+      bson_free (tmpl->docs);
+      bson_free (tmpl);
+   }
+}
+
+
+/* a field at one level of a column spec; it may hold a column, embedded
+ * fields that hold columns, or both */
+typedef struct _bcon_column_node_t bcon_column_node_t;
+
+struct _bcon_column_node_t {
+   char *key;
+   uint32_t key_len;
+   bool has_column;
+   uint32_t column;
+   bson_type_t type;
+   bcon_column_node_t *children;
+   uint32_t n_children;
+};
+
+struct _bcon_column_spec_t {
+   bcon_column_node_t root;
+   bson_type_t *types;
+   uint32_t n_columns;
+};
+
+
+static void
+_bcon_column_node_destroy (bcon_column_node_t *node)
+{
+   uint32_t i;
+
+   for (i = 0; i < node->n_children; i++) {
+      _bcon_column_node_destroy (&node->children[i]);
+   }
+
+   bson_free (node->children);
+   bson_free (node->key);
+}
+
+
+static bcon_column_node_t *
+_bcon_column_node_child (bcon_column_node_t *node,
+                         const char *key,
+                         uint32_t key_len)
+{
+   bcon_column_node_t *child;
+   uint32_t i;
+
+   for (i = 0; i < node->n_children; i++) {
+      child = &node->children[i];
+      if (child->key_len == key_len && 0 == memcmp (child->key, key, key_len)) {
+         return child;
+      }
+   }
+
+   node->children = bson_realloc (
+      node->children, (node->n_children + 1) * sizeof (bcon_column_node_t));
+   child = &node->children[node->n_children++];
+   memset (child, 0, sizeof *child);
+   child->key = bson_strndup (key, key_len);
+   child->key_len = key_len;
+
+   return child;
+}
+
+
+static size_t
+_bcon_column_width (bson_type_t type)
+{
+   switch ((int) type) {
+   case BSON_TYPE_INT64:
+   case BSON_TYPE_DATE_TIME:
+      return sizeof (int64_t);
+   case BSON_TYPE_INT32:
+      return sizeof (int32_t);
+   case BSON_TYPE_DOUBLE:
+      return sizeof (double);
+   case BSON_TYPE_BOOL:
+      return sizeof (bool);
+   case BSON_TYPE_UTF8:
+      return sizeof (bcon_string_view_t);
+   default:
+      /* not a type a column can hold */
+      BSON_ASSERT (0);
+      return 0;
+   }
+}
+
+
+bcon_column_spec_t *
+bcon_column_spec_new (void)
+{
+   return bson_malloc0 (sizeof (bcon_column_spec_t));
+}
+
+
+uint32_t
+bcon_column_spec_add (bcon_column_spec_t *spec,
+                      const char *path,
+                      bson_type_t type)
+{
+   bcon_column_node_t *node;
+   const char *dot;
+
+   BSON_ASSERT (spec);
+   BSON_ASSERT (path);
+
+   /* asserts if the type is not supported */
+   (void) _bcon_column_width (type);
+
+   node = &spec->root;
+
+   while ((dot = strchr (path, '.'))) {
+      node = _bcon_column_node_child (node, path, (uint32_t) (dot - path));
+      path = dot + 1;
+   }
+
+   node = _bcon_column_node_child (node, path, (uint32_t) strlen (path));
+   BSON_ASSERT (!node->has_column);
+
+   node->has_column = true;
+   node->column = spec->n_columns;
+   node->type = type;
+
+   spec->types = bson_realloc (
+      spec->types, (spec->n_columns + 1) * sizeof (bson_type_t));
+   spec->types[spec->n_columns] = type;
+
+   return spec->n_columns++;
+}
+
+
+static void
+_bcon_column_store (const bcon_column_node_t *node,
+                    const bson_iter_t *iter,
+                    bcon_column_t *column,
+                    uint32_t row)
+{
+   bcon_string_view_t *view;
+   bson_type_t type = bson_iter_type (iter);
+   size_t len;
+
+   switch ((int) node->type) {
+   case BSON_TYPE_INT64:
+      if (type == BSON_TYPE_INT64) {
+         ((int64_t *) column->values)[row] = bson_iter_int64_unsafe (iter);
+      } else if (type == BSON_TYPE_INT32) {
+         ((int64_t *) column->values)[row] = bson_iter_int32_unsafe (iter);
+      } else {
+         return;
+      }
+      break;
+   case BSON_TYPE_INT32:
+      if (type != BSON_TYPE_INT32) {
+         return;
+      }
+      ((int32_t *) column->values)[row] = bson_iter_int32_unsafe (iter);
+      break;
+   case BSON_TYPE_DOUBLE:
+      if (type != BSON_TYPE_DOUBLE) {
+         return;
+      }
+      ((double *) column->values)[row] = bson_iter_double_unsafe (iter);
+      break;
+   case BSON_TYPE_BOOL:
+      if (type != BSON_TYPE_BOOL) {
+         return;
+      }
+      ((bool *) column->values)[row] = bson_iter_bool_unsafe (iter);
+      break;
+   case BSON_TYPE_DATE_TIME:
+      if (type != BSON_TYPE_DATE_TIME) {
+         return;
+      }
+      ((int64_t *) column->values)[row] = bson_iter_date_time (iter);
+      break;
+   case BSON_TYPE_UTF8:
+      if (type != BSON_TYPE_UTF8) {
+         return;
+      }
+      view = &((bcon_string_view_t *) column->values)[row];
+      view->str = bson_iter_utf8_unsafe (iter, &len);
+      view->len = (uint32_t) len;
+      break;
+   default:
+      BSON_ASSERT (0);
+      return;
+   }
+
+   column->nulls[row / 8] &= (uint8_t) ~(1u << (row % 8));
+}
+
+
+/* extracts the columns beneath @node from the document at @iter in one pass,
+ * checking first for the field after the one last matched since documents in
+ * a batch usually share their field order */
+static bool
+_bcon_column_extract_doc (const bcon_column_node_t *node,
+                          bson_iter_t *iter,
+                          bcon_column_t *columns,
+                          uint32_t row)
+{
+   const bcon_column_node_t *child;
+   bson_iter_t child_iter;
+   const char *key;
+   uint32_t key_len;
+   uint8_t seen_buf[32] = {0};
+   uint8_t *seen = seen_buf;
+   uint32_t found = 0;
+   uint32_t next = 0;
+   uint32_t i;
+   uint32_t j;
+   bool ret = true;
+
+   if (node->n_children > 8 * sizeof seen_buf) {
+      seen = bson_malloc0 ((node->n_children + 7) / 8);
+   }
+
+   while (found < node->n_children && bson_iter_next (iter)) {
+      key = bson_iter_key_unsafe (iter);
+      key_len = bson_iter_key_len (iter);
+
+      for (i = 0; i < node->n_children; i++) {
+         j = (next + i) % node->n_children;
+         child = &node->children[j];
+
+         if (child->key_len == key_len &&
+             0 == memcmp (child->key, key, key_len)) {
+            break;
+         }
+      }
+
+      /* a duplicate key counts once; its first value wins */
+      if (i == node->n_children || (seen[j / 8] & (1u << (j % 8)))) {
+         continue;
+      }
+
+      seen[j / 8] |= (uint8_t) (1u << (j % 8));
+      next = j + 1;
+      found++;
+
+      if (child->has_column) {
+         _bcon_column_store (child, iter, &columns[child->column], row);
+      }
+
+      if (child->n_children && BSON_ITER_HOLDS_DOCUMENT (iter)) {
+         if (!bson_iter_recurse (iter, &child_iter) ||
+             !_bcon_column_extract_doc (child, &child_iter, columns, row)) {
+            ret = false;
+            break;
+         }
+      }
+   }
+
+   if (seen != seen_buf) {
+      bson_free (seen);
+   }
+
+   return ret && iter->err_off == 0;
+}
+
+
+bool
+bcon_column_spec_extract (const bcon_column_spec_t *spec,
+                          const bson_t *batch,
+                          bcon_column_t *columns,
+                          uint32_t max_rows,
+                          uint32_t *n_rows)
+{
+   bson_iter_t iter;
+   bson_iter_t doc_iter;
+   uint32_t row = 0;
+   size_t width;
+   uint32_t i;
+   bool ret = true;
+
+   BSON_ASSERT (spec);
+   BSON_ASSERT (batch);
+   BSON_ASSERT (columns || !spec->n_columns);
+   BSON_ASSERT (n_rows);
+
+   if (!bson_iter_init (&iter, batch)) {
+      *n_rows = 0;
+      return false;
+   }
+
+   while (bson_iter_next (&iter)) {
+      if (row == max_rows) {
+         ret = false;
+         break;
+      }
+
+      /* every value starts out null */
+      for (i = 0; i < spec->n_columns; i++) {
+         width = _bcon_column_width (spec->types[i]);
+         memset ((uint8_t *) columns[i].values + row * width, 0, width);
+         columns[i].nulls[row / 8] |= (uint8_t) (1u << (row % 8));
+      }
+
+      if (BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+         if (!bson_iter_recurse (&iter, &doc_iter) ||
+             !_bcon_column_extract_doc (&spec->root, &doc_iter, columns, row)) {
+            ret = false;
+            break;
+         }
+      }
+
+      row++;
+   }
+
+   if (iter.err_off) {
+      ret = false;
+   }
+
+   *n_rows = row;
+
+   return ret;
+}
+
+
+void
+bcon_column_spec_destroy (bcon_column_spec_t *spec)
+{
+   if (spec) {
+      _bcon_column_node_destroy (&spec->root);
+      bson_free (spec->types);
+      bson_free (spec);
+   }
+}
@@ -114,6 +114,8 @@ BCON_ENSURE_DECLARE (const_bson_iter_ptr, const bson_iter_t *)
    BCON_MAGIC, BCON_TYPE_BCON, BCON_ENSURE (const_bson_ptr, (_val))
 #define BCON_ITER(_val) \
    BCON_MAGIC, BCON_TYPE_ITER, BCON_ENSURE (const_bson_iter_ptr, (_val))
+#define BCON_SLOT(_type) \
+   BCON_MAGIC, BCON_TYPE_SLOT, BCON_ENSURE (bson_type, (_type))
 
 #define BCONE_UTF8(_val) \
    BCONE_MAGIC, BCON_TYPE_UTF8, BCON_ENSURE_STORAGE (const_char_ptr_ptr, (_val))
@@ -205,6 +207,7 @@ typedef enum {
    BCON_TYPE_SKIP,
    BCON_TYPE_ITER,
    BCON_TYPE_ERROR,
+   BCON_TYPE_SLOT,
 } bcon_type_t;
 
 typedef struct bcon_append_ctx_frame {
@@ -229,6 +232,32 @@ typedef struct _bcon_extract_ctx_t {
    int n;
 } bcon_extract_ctx_t;
 
+typedef struct _bcon_template_t bcon_template_t;
+
+typedef struct _bcon_column_spec_t bcon_column_spec_t;
+
+/* a UTF-8 string within a batch extracted by bcon_column_spec_extract() */
+typedef struct {
+   const char *str;
+   uint32_t len;
+} bcon_string_view_t;
+
+/**
+ * bcon_column_t:
+ *
+ * Caller-provided storage for one column of a bcon_column_spec_t.
+ *
+ * @values: An array with room for one value per row, of int64_t, int32_t,
+ *    double, bool, or bcon_string_view_t according to the column's type.
+ * @nulls: A bitmap with room for one bit per row. Bit (row % 8) of byte
+ *    (row / 8) is set if the field is missing or holds another type, in which
+ *    case the row's value is zeroed.
+ */
+typedef struct {
+   void *values;
+   uint8_t *nulls;
+} bcon_column_t;
+
 BSON_EXPORT (void)
 bcon_append (bson_t *bson, ...) BSON_GNUC_NULL_TERMINATED;
 BSON_EXPORT (void)
@@ -262,6 +291,90 @@ bcon_extract_va (bson_t *bson,
 BSON_EXPORT (bson_t *)
 bcon_new (void *unused, ...) BSON_GNUC_NULL_TERMINATED;
 
+/**
+ * bcon_template_new:
+ *
+ * Encodes a BCON document once, with each BCON_SLOT (type) standing in for a
+ * value of that type to be supplied later by bcon_template_instantiate().
+ * Slots may hold UTF-8 strings, documents, arrays, binary data, ObjectIds,
+ * booleans, datetimes, timestamps, and numbers. Other BCON functions silently
+ * leave out the element of a BCON_SLOT.
+ */
+BSON_EXPORT (bcon_template_t *)
+bcon_template_new (void *unused, ...) BSON_GNUC_NULL_TERMINATED;
+
+BSON_EXPORT (uint32_t)
+bcon_template_n_slots (const bcon_template_t *tmpl);
+
+/**
+ * bcon_template_instantiate:
+ * @tmpl: A bcon_template_t.
+ * @values: An array with one value for each slot, in the order the slots
+ *    appear in the template.
+ * @dst: An uninitialized bson_t.
+ *
+ * Initializes @dst with a copy of the template, with its slots filled in from
+ * @values.
+ *
+ * Returns: true if successful; false if a value's type does not match its
+ * slot's type or the document would overflow. @dst is initialized either way.
+ */
+BSON_EXPORT (bool)
+bcon_template_instantiate (const bcon_template_t *tmpl,
+                           const bson_value_t *values,
+                           bson_t *dst);
+
+BSON_EXPORT (void)
+bcon_template_destroy (bcon_template_t *tmpl);
+
+BSON_EXPORT (bcon_column_spec_t *)
+bcon_column_spec_new (void);
+
+/**
+ * bcon_column_spec_add:
+ * @spec: A bcon_column_spec_t.
+ * @path: A field name, or a dotted path to a field in an embedded document.
+ * @type: BSON_TYPE_INT64, BSON_TYPE_INT32, BSON_TYPE_DOUBLE, BSON_TYPE_BOOL,
+ *    BSON_TYPE_DATE_TIME, or BSON_TYPE_UTF8.
+ *
+ * Adds a column holding the value at @path. An INT64 column also accepts
+ * int32 values, and a DATE_TIME column is stored as int64_t milliseconds.
+ * Each path may be added once.
+ *
+ * Returns: The index of the new column.
+ */
+BSON_EXPORT (uint32_t)
+bcon_column_spec_add (bcon_column_spec_t *spec,
+                      const char *path,
+                      bson_type_t type);
+
+/**
+ * bcon_column_spec_extract:
+ * @spec: A bcon_column_spec_t.
+ * @batch: A document or array whose values are the documents to extract
+ *    from, such as the "firstBatch" array of a cursor reply.
+ * @columns: One bcon_column_t for each column added to @spec.
+ * @max_rows: The number of rows each column has room for.
+ * @n_rows: Location for the number of rows extracted.
+ *
+ * Extracts every column from each document in @batch, in one pass over each
+ * document. Values that are not documents become rows of nulls. If a
+ * document repeats a key, the first value is used. UTF-8 values point into
+ * @batch and are valid as long as it is.
+ *
+ * Returns: true if successful; false if @batch is corrupt or has more than
+ * @max_rows values.
+ */
+BSON_EXPORT (bool)
+bcon_column_spec_extract (const bcon_column_spec_t *spec,
+                          const bson_t *batch,
+                          bcon_column_t *columns,
+                          uint32_t max_rows,
+                          uint32_t *n_rows);
+
+BSON_EXPORT (void)
+bcon_column_spec_destroy (bcon_column_spec_t *spec);
+
 /**
  * The bcon_..() functions are all declared with __attribute__((sentinel)).
  *
@@ -283,6 +396,9 @@ bcon_new (void *unused, ...) BSON_GNUC_NULL_TERMINATED;
 
 #define BCON_NEW(...) bcon_new (NULL, __VA_ARGS__, (void *) NULL)
 
+#define BCON_TEMPLATE_NEW(...) \
+   bcon_template_new (NULL, __VA_ARGS__, (void *) NULL)
+
 BSON_EXPORT (const char *)
 bson_bcon_magic (void) BSON_GNUC_PURE;
 BSON_EXPORT (const char *)
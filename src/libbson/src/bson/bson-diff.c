@@ -0,0 +1,432 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "bson.h"
+#include "bson-diff.h"
+#include "bson-string.h"
+
+
+typedef struct {
+   bson_diff_flags_t flags;
+   bson_string_t *path;
+   bson_t set;
+   bson_t unset;
+   bson_error_t *error;
+} bson_diff_ctx_t;
+
+
+static bool
+_bson_diff_document (bson_diff_ctx_t *ctx,
+                     const bson_t *from,
+                     const bson_t *to,
+                     bool is_root);
+
+static bool
+_bson_diff_field (bson_diff_ctx_t *ctx,
+                  const bson_iter_t *from_iter,
+                  const bson_iter_t *to_iter);
+
+
+/*
+ * Compare the encoded values of two fields. Values of different types are
+ * never equal, so an int32 1 and an int64 1 differ, as do 0.0 and -0.0.
+ */
+static bool
+_bson_diff_value_equal (const bson_iter_t *a, const bson_iter_t *b)
+{
+   uint32_t a_len;
+   uint32_t b_len;
+
+   if (bson_iter_type (a) != bson_iter_type (b)) {
+      return false;
+   }
+
+   a_len = a->next_off - a->d1;
+   b_len = b->next_off - b->d1;
+
+   return a_len == b_len && 0 == memcmp (a->raw + a->d1, b->raw + b->d1, a_len);
+}
+
+
+/*
+ * Find @key in @doc. Documents being compared usually share their field
+ * order, so the field following @cursor is checked before falling back to
+ * a full scan. On success @cursor is moved to the field found.
+ */
+static bool
+_bson_diff_find (const bson_t *doc,
+                 bson_iter_t *cursor,
+                 const char *key,
+                 uint32_t key_len,
+                 bson_iter_t *found)
+{
+   bson_iter_t next;
+
+   memcpy (&next, cursor, sizeof next);
+
+   if (bson_iter_next (&next) && bson_iter_key_len (&next) == key_len &&
+       0 == memcmp (bson_iter_key (&next), key, key_len)) {
+      memcpy (cursor, &next, sizeof next);
+      memcpy (found, &next, sizeof next);
+      return true;
+   }
+
+   if (bson_iter_init_find_w_len (found, doc, key, (int) key_len)) {
+      memcpy (cursor, found, sizeof *found);
+      return true;
+   }
+
+   return false;
+}
+
+
+/*
+ * Returns the bson_validate_flags_t describing why @key cannot be used as a
+ * component of an update path, or BSON_VALIDATE_NONE if it can.
+ */
+static bson_validate_flags_t
+_bson_diff_key_check (const char *key, uint32_t key_len)
+{
+   if (key_len == 0) {
+      return BSON_VALIDATE_EMPTY_KEYS;
+   }
+
+   if (key[0] == '$') {
+      return BSON_VALIDATE_DOLLAR_KEYS;
+   }
+
+   if (memchr (key, '.', key_len)) {
+      return BSON_VALIDATE_DOT_KEYS;
+   }
+
+   return BSON_VALIDATE_NONE;
+}
+
+
+static bool
+_bson_diff_keys_addressable (const bson_t *doc)
+{
+   bson_iter_t iter;
+
+   if (!bson_iter_init (&iter, doc)) {
+      return false;
+   }
+
+   while (bson_iter_next (&iter)) {
+      if (_bson_diff_key_check (bson_iter_key (&iter),
+                                bson_iter_key_len (&iter)) !=
+          BSON_VALIDATE_NONE) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+static void
+_bson_diff_push (bson_diff_ctx_t *ctx, const char *key)
+{
+   if (ctx->path->len) {
+      bson_string_append_c (ctx->path, '.');
+   }
+
+   bson_string_append (ctx->path, key);
+}
+
+
+static void
+_bson_diff_set (bson_diff_ctx_t *ctx, const bson_iter_t *value)
+{
+   if (!bson_append_iter (&ctx->set, ctx->path->str, ctx->path->len, value)) {
+      /* cannot happen when copying from within a valid bson_t */
+      BSON_ASSERT (false);
+   }
+}
+
+
+static void
+_bson_diff_unset (bson_diff_ctx_t *ctx)
+{
+   bson_append_utf8 (&ctx->unset, ctx->path->str, ctx->path->len, "", 0);
+}
+
+
+static bool
+_bson_diff_array (bson_diff_ctx_t *ctx,
+                  const bson_iter_t *from_iter,
+                  const bson_iter_t *to_iter,
+                  bool *replace)
+{
+   bson_iter_t from_child;
+   bson_iter_t to_child;
+   uint32_t from_count = 0;
+   uint32_t to_count = 0;
+   uint32_t parent_len;
+   bool from_more;
+
+   *replace = true;
+
+   if (!(ctx->flags & BSON_DIFF_ARRAY_ELEMENTS)) {
+      return true;
+   }
+
+   BSON_ASSERT (bson_iter_recurse (from_iter, &from_child));
+   BSON_ASSERT (bson_iter_recurse (to_iter, &to_child));
+
+   while (bson_iter_next (&from_child)) {
+      from_count++;
+   }
+
+   while (bson_iter_next (&to_child)) {
+      to_count++;
+   }
+
+   /* $unset on an element leaves null behind, so a shrinking array must be
+    * replaced, and a previously empty array is cheapest to set whole */
+   if (from_count == 0 || to_count < from_count) {
+      return true;
+   }
+
+   *replace = false;
+
+   BSON_ASSERT (bson_iter_recurse (from_iter, &from_child));
+   BSON_ASSERT (bson_iter_recurse (to_iter, &to_child));
+
+   parent_len = ctx->path->len;
+   from_more = true;
+
+   while (bson_iter_next (&to_child)) {
+      if (from_more) {
+         from_more = bson_iter_next (&from_child);
+      }
+
+      _bson_diff_push (ctx, bson_iter_key (&to_child));
+
+      if (!from_more) {
+         _bson_diff_set (ctx, &to_child);
+      } else if (!_bson_diff_field (ctx, &from_child, &to_child)) {
+         return false;
+      }
+
+      bson_string_truncate (ctx->path, parent_len);
+   }
+
+   return true;
+}
+
+
+/*
+ * Record the difference between two fields with the same key. The path of
+ * the field must already be on ctx->path.
+ */
+static bool
+_bson_diff_field (bson_diff_ctx_t *ctx,
+                  const bson_iter_t *from_iter,
+                  const bson_iter_t *to_iter)
+{
+   bool replace = true;
+
+   if (_bson_diff_value_equal (from_iter, to_iter)) {
+      return true;
+   }
+
+   if (BSON_ITER_HOLDS_DOCUMENT (from_iter) &&
+       BSON_ITER_HOLDS_DOCUMENT (to_iter)) {
+      bson_t from_doc;
+      bson_t to_doc;
+      const uint8_t *data;
+      uint32_t len;
+
+      bson_iter_document (from_iter, &len, &data);
+      BSON_ASSERT (bson_init_static (&from_doc, data, len));
+      bson_iter_document (to_iter, &len, &data);
+      BSON_ASSERT (bson_init_static (&to_doc, data, len));
+
+      /* fields we cannot address with a dotted path are replaced along
+       * with their parent */
+      if (_bson_diff_keys_addressable (&from_doc) &&
+          _bson_diff_keys_addressable (&to_doc)) {
+         replace = false;
+         if (!_bson_diff_document (ctx, &from_doc, &to_doc, false)) {
+            return false;
+         }
+      }
+   } else if (BSON_ITER_HOLDS_ARRAY (from_iter) &&
+              BSON_ITER_HOLDS_ARRAY (to_iter)) {
+      if (!_bson_diff_array (ctx, from_iter, to_iter, &replace)) {
+         return false;
+      }
+   }
+
+   if (replace) {
+      _bson_diff_set (ctx, to_iter);
+   }
+
+   return true;
+}
+
+
+static bool
+_bson_diff_document (bson_diff_ctx_t *ctx,
+                     const bson_t *from,
+                     const bson_t *to,
+                     bool is_root)
+{
+   bson_iter_t from_iter;
+   bson_iter_t to_iter;
+   bson_iter_t cursor;
+   bson_iter_t found;
+   bson_validate_flags_t invalid;
+   uint32_t parent_len;
+   const char *key;
+   uint32_t key_len;
+   bool changed;
+
+   /* bson_diff has validated both documents */
+   BSON_ASSERT (bson_iter_init (&from_iter, from));
+   BSON_ASSERT (bson_iter_init (&to_iter, to));
+
+   parent_len = ctx->path->len;
+
+   /* fields that were added or changed */
+   memcpy (&cursor, &from_iter, sizeof cursor);
+
+   while (bson_iter_next (&to_iter)) {
+      key = bson_iter_key (&to_iter);
+      key_len = bson_iter_key_len (&to_iter);
+
+      if (_bson_diff_find (from, &cursor, key, key_len, &found)) {
+         if (_bson_diff_value_equal (&found, &to_iter)) {
+            continue;
+         }
+
+         changed = true;
+      } else {
+         changed = false;
+      }
+
+      /* only top-level keys are checked here; nested documents containing
+       * unaddressable keys are replaced whole by _bson_diff_field */
+      if (is_root && (invalid = _bson_diff_key_check (key, key_len))) {
+         bson_set_error (ctx->error,
+                         BSON_ERROR_INVALID,
+                         invalid,
+                         "cannot express a change to field \"%s\" as an "
+                         "update path",
+                         key);
+         return false;
+      }
+
+      _bson_diff_push (ctx, key);
+
+      if (changed) {
+         if (!_bson_diff_field (ctx, &found, &to_iter)) {
+            return false;
+         }
+      } else {
+         _bson_diff_set (ctx, &to_iter);
+      }
+
+      bson_string_truncate (ctx->path, parent_len);
+   }
+
+   /* fields that were removed */
+   BSON_ASSERT (bson_iter_init (&cursor, to));
+
+   while (bson_iter_next (&from_iter)) {
+      key = bson_iter_key (&from_iter);
+      key_len = bson_iter_key_len (&from_iter);
+
+      if (_bson_diff_find (to, &cursor, key, key_len, &found)) {
+         continue;
+      }
+
+      if (is_root && (invalid = _bson_diff_key_check (key, key_len))) {
+         bson_set_error (ctx->error,
+                         BSON_ERROR_INVALID,
+                         invalid,
+                         "cannot express removal of field \"%s\" as an "
+                         "update path",
+                         key);
+         return false;
+      }
+
+      _bson_diff_push (ctx, key);
+      _bson_diff_unset (ctx);
+      bson_string_truncate (ctx->path, parent_len);
+   }
+
+   return true;
+}
+
+
+bool
+bson_diff (const bson_t *from,
+           const bson_t *to,
+           bson_diff_flags_t flags,
+           bson_t *update,
+           bson_error_t *error)
+{
+   bson_diff_ctx_t ctx;
+   size_t offset = 0;
+   bool ret;
+
+   BSON_ASSERT (from);
+   BSON_ASSERT (to);
+   BSON_ASSERT (update);
+
+   bson_init (update);
+
+   /* unchanged and replaced subdocuments are never walked, so check the
+    * whole of both documents before copying any of their values */
+   if (!bson_validate (from, BSON_VALIDATE_NONE, &offset) ||
+       !bson_validate (to, BSON_VALIDATE_NONE, &offset)) {
+      bson_set_error (error,
+                      BSON_ERROR_INVALID,
+                      BSON_VALIDATE_NONE,
+                      "corrupt document at offset %u",
+                      (unsigned) offset);
+      return false;
+   }
+
+   ctx.flags = flags;
+   ctx.path = bson_string_new (NULL);
+   ctx.error = error;
+   bson_init (&ctx.set);
+   bson_init (&ctx.unset);
+
+   ret = _bson_diff_document (&ctx, from, to, true);
+
+   if (ret) {
+      if (!bson_empty (&ctx.set)) {
+         BSON_APPEND_DOCUMENT (update, "$set", &ctx.set);
+      }
+
+      if (!bson_empty (&ctx.unset)) {
+         BSON_APPEND_DOCUMENT (update, "$unset", &ctx.unset);
+      }
+   }
+
+   bson_destroy (&ctx.set);
+   bson_destroy (&ctx.unset);
+   bson_string_free (ctx.path, true);
+
+   return ret;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bson-prelude.h"
+
+
+#ifndef BSON_DIFF_H
+#define BSON_DIFF_H
+
+
+#include "bson-macros.h"
+#include "bson-types.h"
+
+
+BSON_BEGIN_DECLS
+
+
+/**
+ * bson_diff_flags_t:
+ *
+ * This enumeration controls how bson_diff() describes changes.
+ *
+ * %BSON_DIFF_NONE: Any change within an array replaces the whole array.
+ * %BSON_DIFF_ARRAY_ELEMENTS: Changed or appended array elements are set
+ *    individually with a dotted index path. Arrays that shrink are still
+ *    replaced as a whole, since $unset cannot remove array elements.
+ */
+typedef enum {
+   BSON_DIFF_NONE = 0,
+   BSON_DIFF_ARRAY_ELEMENTS = (1 << 0),
+} bson_diff_flags_t;
+
+
+/**
+ * bson_diff:
+ * @from: The document as it was read.
+ * @to: The document as it should be written.
+ * @flags: A bitwise-or of bson_diff_flags_t.
+ * @update: An uninitialized bson_t for the update document.
+ * @error: An optional location for a bson_error_t.
+ *
+ * Computes an update document of the form { "$set": {...}, "$unset": {...} }
+ * that transforms @from into @to. Embedded documents are compared field by
+ * field and changes are addressed with dotted paths. If the documents are
+ * equal @update is empty.
+ *
+ * @update is always initialized and must be freed with bson_destroy().
+ *
+ * Returns: true if successful; otherwise false and @error is set.
+ */
+BSON_EXPORT (bool)
+bson_diff (const bson_t *from,
+           const bson_t *to,
+           bson_diff_flags_t flags,
+           bson_t *update,
+           bson_error_t *error);
+
+
+BSON_END_DECLS
+
+
+#endif /* BSON_DIFF_H */
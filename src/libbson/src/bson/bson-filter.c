@@ -0,0 +1,405 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "bson.h"
+#include "bson-filter.h"
+
+
+#define BSON_FILTER_INITIAL_SLOTS 8
+
+
+typedef struct _bson_filter_level_t bson_filter_level_t;
+
+
+/* one field name at one level of the filter */
+typedef struct {
+   char *key; /* NULL if the slot is unused */
+   uint32_t key_len;
+   uint32_t hash;
+   bool whole;                    /* the field is matched in its entirety */
+   bson_filter_level_t *children; /* fields matched beneath this one */
+} bson_filter_field_t;
+
+
+/* an open-addressing hash table of field names, keeping at most half of the
+ * slots used so that probe sequences stay short */
+struct _bson_filter_level_t {
+   bson_filter_field_t *slots;
+   uint32_t mask;
+   uint32_t count;
+};
+
+
+struct _bson_filter_t {
+   bson_filter_mode_t mode;
+   bson_filter_level_t root;
+};
+
+
+/* 32-bit FNV-1a */
+static uint32_t
+_bson_filter_hash (const char *key, uint32_t key_len)
+{
+   uint32_t hash = 2166136261u;
+   uint32_t i;
+
+   for (i = 0; i < key_len; i++) {
+      hash ^= (uint8_t) key[i];
+      hash *= 16777619u;
+   }
+
+   return hash;
+}
+
+
+static void
+_bson_filter_level_init (bson_filter_level_t *level)
+{
+   level->slots =
+      bson_malloc0 (BSON_FILTER_INITIAL_SLOTS * sizeof (bson_filter_field_t));
+   level->mask = BSON_FILTER_INITIAL_SLOTS - 1;
+   level->count = 0;
+}
+
+
+static void
+_bson_filter_level_destroy (bson_filter_level_t *level)
+{
+   uint32_t i;
+
+   for (i = 0; i <= level->mask; i++) {
+      if (level->slots[i].key) {
+         bson_free (level->slots[i].key);
+         if (level->slots[i].children) {
+            _bson_filter_level_destroy (level->slots[i].children);
+            bson_free (level->slots[i].children);
+         }
+      }
+   }
+
+   bson_free (level->slots);
+}
+
+
+static bson_filter_field_t *
+_bson_filter_level_slot (const bson_filter_level_t *level,
+                         const char *key,
+                         uint32_t key_len,
+                         uint32_t hash)
+{
+   uint32_t i = hash & level->mask;
+   bson_filter_field_t *slot;
+
+   for (;;) {
+      slot = &level->slots[i];
+
+      if (!slot->key || (slot->hash == hash && slot->key_len == key_len &&
+                         0 == memcmp (slot->key, key, key_len))) {
+         return slot;
+      }
+
+      i = (i + 1) & level->mask;
+   }
+}
+
+
+static const bson_filter_field_t *
+_bson_filter_level_find (const bson_filter_level_t *level,
+                         const char *key,
+                         uint32_t key_len)
+{
+   const bson_filter_field_t *slot;
+
+   if (!level->count) {
+      return NULL;
+   }
+
+   slot = _bson_filter_level_slot (
+      level, key, key_len, _bson_filter_hash (key, key_len));
+
+   return slot->key ? slot : NULL;
+}
+
+
+static void
+_bson_filter_level_grow (bson_filter_level_t *level)
+{
+   bson_filter_field_t *old_slots = level->slots;
+   uint32_t old_mask = level->mask;
+   bson_filter_field_t *slot;
+   uint32_t i;
+
+   level->mask = (old_mask + 1) * 2 - 1;
+   level->slots = bson_malloc0 ((level->mask + 1) * sizeof *level->slots);
+
+   for (i = 0; i <= old_mask; i++) {
+      if (old_slots[i].key) {
+         slot = _bson_filter_level_slot (level,
+                                         old_slots[i].key,
+                                         old_slots[i].key_len,
+                                         old_slots[i].hash);
+         memcpy (slot, &old_slots[i], sizeof *slot);
+      }
+   }
+
+   bson_free (old_slots);
+}
+
+
+static bson_filter_field_t *
+_bson_filter_level_insert (bson_filter_level_t *level,
+                           const char *key,
+                           uint32_t key_len)
+{
+   uint32_t hash = _bson_filter_hash (key, key_len);
+   bson_filter_field_t *slot;
+
+   slot = _bson_filter_level_slot (level, key, key_len, hash);
+   if (slot->key) {
+      return slot;
+   }
+
+   if (2 * (level->count + 1) > level->mask + 1) {
+      _bson_filter_level_grow (level);
+      slot = _bson_filter_level_slot (level, key, key_len, hash);
+   }
+
+   slot->key = bson_strndup (key, key_len);
+   slot->key_len = key_len;
+   slot->hash = hash;
+   slot->whole = false;
+   slot->children = NULL;
+   level->count++;
+
+   return slot;
+}
+
+
+bson_filter_t *
+bson_filter_new (bson_filter_mode_t mode)
+{
+   bson_filter_t *filter;
+
+   filter = bson_malloc0 (sizeof *filter);
+   filter->mode = mode;
+   _bson_filter_level_init (&filter->root);
+
+   return filter;
+}
+
+
+void
+bson_filter_add (bson_filter_t *filter, const char *path)
+{
+   bson_filter_level_t *level;
+   bson_filter_field_t *field;
+   const char *dot;
+
+   BSON_ASSERT (filter);
+   BSON_ASSERT (path);
+
+   level = &filter->root;
+
+   while ((dot = strchr (path, '.'))) {
+      field = _bson_filter_level_insert (level, path, (uint32_t) (dot - path));
+      if (field->whole) {
+         /* an ancestor is already matched in its entirety */
+         return;
+      }
+
+      if (!field->children) {
+         field->children = bson_malloc (sizeof *field->children);
+         _bson_filter_level_init (field->children);
+      }
+
+      level = field->children;
+      path = dot + 1;
+   }
+
+   field = _bson_filter_level_insert (level, path, (uint32_t) strlen (path));
+   field->whole = true;
+
+   if (field->children) {
+      _bson_filter_level_destroy (field->children);
+      bson_free (field->children);
+      field->children = NULL;
+   }
+}
+
+
+static bool
+_bson_filter_copy_level (bson_filter_mode_t mode,
+                         const bson_filter_level_t *level,
+                         bson_iter_t *iter,
+                         bson_t *dst);
+
+
+/*
+ * Apply @level to the documents within the array at @iter. Elements that
+ * are not documents have no fields to match, so they are kept when
+ * excluding and dropped when including.
+ */
+static bool
+_bson_filter_copy_array (bson_filter_mode_t mode,
+                         const bson_filter_level_t *level,
+                         const bson_iter_t *iter,
+                         bson_t *dst)
+{
+   bson_iter_t child;
+   bson_iter_t grandchild;
+   bson_t dst_child;
+   bson_t dst_grandchild;
+   const char *key;
+   char buf[16];
+   uint32_t i = 0;
+   size_t key_len;
+   bool ret = true;
+
+   if (!bson_iter_recurse (iter, &child) ||
+       !bson_append_array_begin (dst,
+                                 bson_iter_key (iter),
+                                 (int) bson_iter_key_len (iter),
+                                 &dst_child)) {
+      return false;
+   }
+
+   while (ret && bson_iter_next (&child)) {
+      key_len = bson_uint32_to_string (i, &key, buf, sizeof buf);
+
+      if (BSON_ITER_HOLDS_DOCUMENT (&child)) {
+         if (!bson_iter_recurse (&child, &grandchild) ||
+             !bson_append_document_begin (
+                &dst_child, key, (int) key_len, &dst_grandchild)) {
+            ret = false;
+            break;
+         }
+
+         /* end the document even if its copy failed, dst_child can't be
+          * ended while it is open */
+         ret = _bson_filter_copy_level (
+            mode, level, &grandchild, &dst_grandchild);
+         ret = bson_append_document_end (&dst_child, &dst_grandchild) && ret;
+      } else if (mode == BSON_FILTER_EXCLUDE) {
+         ret = bson_append_iter (&dst_child, key, (int) key_len, &child);
+      } else {
+         continue;
+      }
+
+      i++;
+   }
+
+   if (child.err_off) {
+      ret = false;
+   }
+
+   /* always ended, so that dst is left without an open child */
+   return bson_append_array_end (dst, &dst_child) && ret;
+}
+
+
+static bool
+_bson_filter_copy_level (bson_filter_mode_t mode,
+                         const bson_filter_level_t *level,
+                         bson_iter_t *iter,
+                         bson_t *dst)
+{
+   const bson_filter_field_t *field;
+   bson_iter_t child;
+   bson_t dst_child;
+   bool ok;
+
+   while (bson_iter_next (iter)) {
+      field = _bson_filter_level_find (
+         level, bson_iter_key (iter), bson_iter_key_len (iter));
+
+      if (!field) {
+         if (mode == BSON_FILTER_EXCLUDE &&
+             !bson_append_iter (dst, NULL, 0, iter)) {
+            return false;
+         }
+
+         continue;
+      }
+
+      if (field->whole) {
+         if (mode == BSON_FILTER_INCLUDE &&
+             !bson_append_iter (dst, NULL, 0, iter)) {
+            return false;
+         }
+
+         continue;
+      }
+
+      /* only part of this field is matched */
+      if (BSON_ITER_HOLDS_DOCUMENT (iter)) {
+         if (!bson_iter_recurse (iter, &child) ||
+             !bson_append_document_begin (dst,
+                                          bson_iter_key (iter),
+                                          (int) bson_iter_key_len (iter),
+                                          &dst_child)) {
+            return false;
+         }
+
+         ok = _bson_filter_copy_level (
+            mode, field->children, &child, &dst_child);
+         if (!bson_append_document_end (dst, &dst_child) || !ok) {
+            return false;
+         }
+      } else if (BSON_ITER_HOLDS_ARRAY (iter)) {
+         if (!_bson_filter_copy_array (mode, field->children, iter, dst)) {
+            return false;
+         }
+      } else if (mode == BSON_FILTER_EXCLUDE) {
+         if (!bson_append_iter (dst, NULL, 0, iter)) {
+            return false;
+         }
+      }
+   }
+
+   return iter->err_off == 0;
+}
+
+
+bool
+bson_filter_copy_to_noinit (const bson_filter_t *filter,
+                            const bson_t *src,
+                            bson_t *dst)
+{
+   bson_iter_t iter;
+
+   BSON_ASSERT (filter);
+   BSON_ASSERT (src);
+   BSON_ASSERT (dst);
+
+   if (!bson_iter_init (&iter, src)) {
+      return false;
+   }
+
+   return _bson_filter_copy_level (filter->mode, &filter->root, &iter, dst);
+}
+
+
+void
+bson_filter_destroy (bson_filter_t *filter)
+{
+   if (filter) {
+      _bson_filter_level_destroy (&filter->root);
+      bson_free (filter);
+   }
+}
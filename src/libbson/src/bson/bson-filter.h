@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bson-prelude.h"
+
+
+#ifndef BSON_FILTER_H
+#define BSON_FILTER_H
+
+
+#include "bson-macros.h"
+#include "bson-types.h"
+
+
+BSON_BEGIN_DECLS
+
+
+typedef struct _bson_filter_t bson_filter_t;
+
+
+/**
+ * bson_filter_mode_t:
+ *
+ * %BSON_FILTER_EXCLUDE: Copy every field except those added to the filter.
+ * %BSON_FILTER_INCLUDE: Copy only the fields added to the filter.
+ */
+typedef enum {
+   BSON_FILTER_EXCLUDE = 0,
+   BSON_FILTER_INCLUDE = 1,
+} bson_filter_mode_t;
+
+
+BSON_EXPORT (bson_filter_t *)
+bson_filter_new (bson_filter_mode_t mode);
+
+
+/**
+ * bson_filter_add:
+ * @filter: A bson_filter_t.
+ * @path: A field name, or a dotted path to a field in an embedded document.
+ *
+ * Adds a field to the set of fields matched by @filter. Adding a path
+ * matches the whole field at that path, including any embedded fields
+ * previously added beneath it.
+ */
+BSON_EXPORT (void)
+bson_filter_add (bson_filter_t *filter, const char *path);
+
+
+/**
+ * bson_filter_copy_to_noinit:
+ * @filter: A bson_filter_t.
+ * @src: The bson_t to filter.
+ * @dst: An initialized bson_t to append to.
+ *
+ * Appends the fields of @src selected by @filter to @dst in one pass over
+ * @src. The same filter may be used concurrently from multiple threads once
+ * all of its fields have been added.
+ *
+ * Returns: true if successful; false if @src is corrupt or @dst would
+ * overflow.
+ */
+BSON_EXPORT (bool)
+bson_filter_copy_to_noinit (const bson_filter_t *filter,
+                            const bson_t *src,
+                            bson_t *dst);
+
+
+BSON_EXPORT (void)
+bson_filter_destroy (bson_filter_t *filter);
+
+
+BSON_END_DECLS
+
+
+#endif /* BSON_FILTER_H */
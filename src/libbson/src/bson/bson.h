@@ -31,7 +31,9 @@
 #include "bson-context.h"
 #include "bson-clock.h"
 #include "bson-decimal128.h"
+#include "bson-diff.h"
 #include "bson-error.h"
+#include "bson-filter.h"
 #include "bson-iter.h"
 #include "bson-json.h"
 #include "bson-keys.h"
@@ -629,6 +629,161 @@ test_append_ctx (void)
 }
 
 
+static void
+test_template (void)
+{
+   bcon_template_t *tmpl;
+   bson_value_t values[5];
+   bson_t *expected;
+   bson_t *sub;
+   bson_t bcon;
+   const char *strs[] = {"", "short", "a much longer string value"};
+   int i;
+
+   tmpl = BCON_TEMPLATE_NEW ("find",
+                             BCON_SLOT (BSON_TYPE_UTF8),
+                             "filter",
+                             "{",
+                             "x",
+                             BCON_SLOT (BSON_TYPE_INT32),
+                             "y",
+                             "[",
+                             BCON_SLOT (BSON_TYPE_UTF8),
+                             BCON_INT32 (1),
+                             "]",
+                             "z",
+                             BCON_SLOT (BSON_TYPE_DOCUMENT),
+                             "}",
+                             "limit",
+                             BCON_SLOT (BSON_TYPE_INT64),
+                             "$db",
+                             BCON_UTF8 ("db"));
+
+   ASSERT_CMPUINT32 (bcon_template_n_slots (tmpl), ==, 5);
+
+   sub = BCON_NEW ("a", BCON_UTF8 ("b"));
+
+   /* slots that shrink, keep, and grow the length of their documents */
+   for (i = 0; i < 3; i++) {
+      values[0].value_type = BSON_TYPE_UTF8;
+      values[0].value.v_utf8.str = (char *) strs[i];
+      values[0].value.v_utf8.len = (uint32_t) strlen (strs[i]);
+      values[1].value_type = BSON_TYPE_INT32;
+      values[1].value.v_int32 = i;
+      values[2].value_type = BSON_TYPE_UTF8;
+      values[2].value.v_utf8.str = (char *) strs[2 - i];
+      values[2].value.v_utf8.len = (uint32_t) strlen (strs[2 - i]);
+      values[3].value_type = BSON_TYPE_DOCUMENT;
+      values[3].value.v_doc.data = (uint8_t *) bson_get_data (sub);
+      values[3].value.v_doc.data_len = sub->len;
+      values[4].value_type = BSON_TYPE_INT64;
+      values[4].value.v_int64 = 1000 + i;
+
+      BSON_ASSERT (bcon_template_instantiate (tmpl, values, &bcon));
+      BSON_ASSERT (bson_validate (&bcon, BSON_VALIDATE_NONE, NULL));
+
+      expected = BCON_NEW ("find",
+                           BCON_UTF8 (strs[i]),
+                           "filter",
+                           "{",
+                           "x",
+                           BCON_INT32 (i),
+                           "y",
+                           "[",
+                           BCON_UTF8 (strs[2 - i]),
+                           BCON_INT32 (1),
+                           "]",
+                           "z",
+                           BCON_DOCUMENT (sub),
+                           "}",
+                           "limit",
+                           BCON_INT64 (1000 + i),
+                           "$db",
+                           BCON_UTF8 ("db"));
+
+      bson_eq_bson (&bcon, expected);
+
+      bson_destroy (&bcon);
+      bson_destroy (expected);
+   }
+
+   /* a value of the wrong type is rejected */
+   values[1].value_type = BSON_TYPE_INT64;
+   values[1].value.v_int64 = 1;
+   BSON_ASSERT (!bcon_template_instantiate (tmpl, values, &bcon));
+   bson_destroy (&bcon);
+
+   bson_destroy (sub);
+   bcon_template_destroy (tmpl);
+}
+
+
+static void
+test_template_binary (void)
+{
+   bcon_template_t *tmpl;
+   bson_value_t values[2];
+   bson_t *expected;
+   bson_t bcon;
+   bson_oid_t oid;
+   const uint8_t data[] = {1, 2, 3, 4, 5};
+
+   tmpl = BCON_TEMPLATE_NEW ("bin",
+                             BCON_SLOT (BSON_TYPE_BINARY),
+                             "_id",
+                             BCON_SLOT (BSON_TYPE_OID));
+
+   bson_oid_init_from_string (&oid, "0123456789abcdef01234567");
+
+   values[0].value_type = BSON_TYPE_BINARY;
+   values[0].value.v_binary.subtype = BSON_SUBTYPE_BINARY_DEPRECATED;
+   values[0].value.v_binary.data = (uint8_t *) data;
+   values[0].value.v_binary.data_len = sizeof data;
+   values[1].value_type = BSON_TYPE_OID;
+   bson_oid_copy (&oid, &values[1].value.v_oid);
+
+   BSON_ASSERT (bcon_template_instantiate (tmpl, values, &bcon));
+
+   expected = BCON_NEW ("bin",
+                        BCON_BIN (BSON_SUBTYPE_BINARY_DEPRECATED,
+                                  data,
+                                  (uint32_t) sizeof data),
+                        "_id",
+                        BCON_OID (&oid));
+
+   bson_eq_bson (&bcon, expected);
+
+   bson_destroy (&bcon);
+   bson_destroy (expected);
+   bcon_template_destroy (tmpl);
+}
+
+
+/* outside of a template, a slot's element is left out */
+static void
+test_template_slot_in_bcon_new (void)
+{
+   bson_t *bcon;
+   bson_t *expected;
+
+   bcon = BCON_NEW ("a",
+                    BCON_SLOT (BSON_TYPE_INT32),
+                    "b",
+                    "[",
+                    BCON_INT32 (1),
+                    BCON_SLOT (BSON_TYPE_UTF8),
+                    BCON_INT32 (2),
+                    "]");
+
+   expected = BCON_NEW ("b", "[", BCON_INT32 (1), BCON_INT32 (2), "]");
+
+   bson_eq_bson (bcon, expected);
+
+   bson_destroy (bcon);
+   bson_destroy (expected);
+}
+
+
 void
 test_bcon_basic_install (TestSuite *suite)
 {
@@ -660,4 +815,10 @@ test_bcon_basic_install (TestSuite *suite)
    TestSuite_Add (suite, "/bson/bcon/test_iter", test_iter);
    TestSuite_Add (suite, "/bson/bcon/test_bcon_new", test_bcon_new);
    TestSuite_Add (suite, "/bson/bcon/test_append_ctx", test_append_ctx);
+   TestSuite_Add (suite, "/bson/bcon/test_template", test_template);
+   TestSuite_Add (
+      suite, "/bson/bcon/test_template_binary", test_template_binary);
+   TestSuite_Add (suite,
+                  "/bson/bcon/test_template_slot_in_bcon_new",
+                  test_template_slot_in_bcon_new);
 }
@@ -486,6 +486,157 @@ test_iter (void)
 }
 
 
+#define IS_NULL(_column, _row) \
+   (((_column).nulls[(_row) / 8] >> ((_row) % 8)) & 1)
+
+static void
+test_columns (void)
+{
+   bcon_column_spec_t *spec;
+   bcon_column_t columns[4];
+   int64_t ints[4];
+   double dbls[4];
+   bcon_string_view_t strs[4];
+   int64_t dates[4];
+   uint8_t nulls[4][1];
+   uint32_t n_rows;
+   bson_t *batch;
+   int i;
+
+   spec = bcon_column_spec_new ();
+   ASSERT_CMPUINT32 (bcon_column_spec_add (spec, "n", BSON_TYPE_INT64), ==, 0);
+   ASSERT_CMPUINT32 (
+      bcon_column_spec_add (spec, "a.x", BSON_TYPE_DOUBLE), ==, 1);
+   ASSERT_CMPUINT32 (bcon_column_spec_add (spec, "s", BSON_TYPE_UTF8), ==, 2);
+   ASSERT_CMPUINT32 (
+      bcon_column_spec_add (spec, "a.t", BSON_TYPE_DATE_TIME), ==, 3);
+
+   columns[0].values = ints;
+   columns[1].values = dbls;
+   columns[2].values = strs;
+   columns[3].values = dates;
+
+   for (i = 0; i < 4; i++) {
+      columns[i].nulls = nulls[i];
+   }
+
+   batch = BCON_NEW ("0",
+                     "{",
+                     "n",
+                     BCON_INT64 (1),
+                     "a",
+                     "{",
+                     "x",
+                     BCON_DOUBLE (1.5),
+                     "t",
+                     BCON_DATE_TIME (100),
+                     "}",
+                     "s",
+                     BCON_UTF8 ("one"),
+                     "}",
+                     /* fields in another order, int32 widened to int64 */
+                     "1",
+                     "{",
+                     "s",
+                     BCON_UTF8 ("two"),
+                     "n",
+                     BCON_INT32 (2),
+                     "a",
+                     "{",
+                     "x",
+                     BCON_DOUBLE (2.5),
+                     "}",
+                     "}",
+                     /* missing fields and mismatched types are null */
+                     "2",
+                     "{",
+                     "n",
+                     BCON_UTF8 ("three"),
+                     "a",
+                     BCON_INT32 (3),
+                     "}",
+                     /* not a document */
+                     "3",
+                     BCON_INT32 (4));
+
+   BSON_ASSERT (bcon_column_spec_extract (spec, batch, columns, 4, &n_rows));
+   ASSERT_CMPUINT32 (n_rows, ==, 4);
+
+   ASSERT_CMPINT64 (ints[0], ==, (int64_t) 1);
+   ASSERT_CMPINT64 (ints[1], ==, (int64_t) 2);
+   ASSERT_CMPINT64 (ints[2], ==, (int64_t) 0);
+   ASSERT_CMPINT (nulls[0][0] & 0xf, ==, 0xc);
+
+   ASSERT_CMPDOUBLE (dbls[0], ==, 1.5);
+   ASSERT_CMPDOUBLE (dbls[1], ==, 2.5);
+   ASSERT_CMPINT (nulls[1][0] & 0xf, ==, 0xc);
+
+   ASSERT_CMPUINT32 (strs[0].len, ==, 3);
+   BSON_ASSERT (!strncmp (strs[0].str, "one", 3));
+   ASSERT_CMPUINT32 (strs[1].len, ==, 3);
+   BSON_ASSERT (!strncmp (strs[1].str, "two", 3));
+   BSON_ASSERT (!strs[2].str);
+   ASSERT_CMPINT (nulls[2][0] & 0xf, ==, 0xc);
+
+   ASSERT_CMPINT64 (dates[0], ==, (int64_t) 100);
+   BSON_ASSERT (!IS_NULL (columns[3], 0));
+   for (i = 1; i < 4; i++) {
+      BSON_ASSERT (IS_NULL (columns[3], i));
+   }
+
+   /* too many rows */
+   BSON_ASSERT (!bcon_column_spec_extract (spec, batch, columns, 3, &n_rows));
+   ASSERT_CMPUINT32 (n_rows, ==, 3);
+
+   bson_destroy (batch);
+   bcon_column_spec_destroy (spec);
+}
+
+/* a duplicate key counts once, so later fields are still found */
+static void
+test_columns_duplicate_key (void)
+{
+   bcon_column_spec_t *spec;
+   bcon_column_t columns[2];
+   int32_t a;
+   int32_t b;
+   uint8_t nulls[2][1];
+   uint32_t n_rows;
+   bson_t *batch;
+
+   spec = bcon_column_spec_new ();
+   bcon_column_spec_add (spec, "a", BSON_TYPE_INT32);
+   bcon_column_spec_add (spec, "b", BSON_TYPE_INT32);
+
+   columns[0].values = &a;
+   columns[0].nulls = nulls[0];
+   columns[1].values = &b;
+   columns[1].nulls = nulls[1];
+
+   batch = BCON_NEW ("0",
+                     "{",
+                     "a",
+                     BCON_INT32 (1),
+                     "a",
+                     BCON_INT32 (2),
+                     "b",
+                     BCON_INT32 (3),
+                     "}");
+
+   BSON_ASSERT (bcon_column_spec_extract (spec, batch, columns, 1, &n_rows));
+   ASSERT_CMPUINT32 (n_rows, ==, 1);
+   ASSERT_CMPINT32 (a, ==, 1);
+   BSON_ASSERT (!IS_NULL (columns[0], 0));
+   ASSERT_CMPINT32 (b, ==, 3);
+   BSON_ASSERT (!IS_NULL (columns[1], 0));
+
+   bson_destroy (batch);
+   bcon_column_spec_destroy (spec);
+}
+
+#undef IS_NULL
+
+
 void
 test_bcon_extract_install (TestSuite *suite)
 {
@@ -519,4 +670,8 @@ test_bcon_extract_install (TestSuite *suite)
    TestSuite_Add (suite, "/bson/bcon/extract/test_nested", test_nested);
    TestSuite_Add (suite, "/bson/bcon/extract/test_skip", test_skip);
    TestSuite_Add (suite, "/bson/bcon/extract/test_iter", test_iter);
+   TestSuite_Add (suite, "/bson/bcon/extract/test_columns", test_columns);
+   TestSuite_Add (suite,
+                  "/bson/bcon/extract/test_columns_duplicate_key",
+                  test_columns_duplicate_key);
 }
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <bson/bson.h>
+
+#include "TestSuite.h"
+#include "test-conveniences.h"
+
+
+static void
+_check_diff (const char *from_json,
+             const char *to_json,
+             bson_diff_flags_t flags,
+             const char *expected_json)
+{
+   bson_t *from;
+   bson_t *to;
+   bson_t update;
+   bson_error_t error;
+   char *actual;
+   char *expected;
+
+   from = bson_new_from_json ((const uint8_t *) from_json, -1, &error);
+   ASSERT_OR_PRINT (from, error);
+   to = bson_new_from_json ((const uint8_t *) to_json, -1, &error);
+   ASSERT_OR_PRINT (to, error);
+
+   ASSERT_OR_PRINT (bson_diff (from, to, flags, &update, &error), error);
+
+   actual = bson_as_canonical_extended_json (&update, NULL);
+   expected = bson_as_canonical_extended_json (
+      tmp_bson ("%s", expected_json), NULL);
+   /* frees actual */
+   ASSERT_CMPJSON (actual, expected);
+
+   bson_free (expected);
+   bson_destroy (&update);
+   bson_destroy (from);
+   bson_destroy (to);
+}
+
+
+static void
+test_bson_diff_equal (void)
+{
+   _check_diff ("{}", "{}", BSON_DIFF_NONE, "{}");
+   _check_diff ("{\"a\": 1, \"b\": {\"c\": [1, 2]}}",
+                "{\"a\": 1, \"b\": {\"c\": [1, 2]}}",
+                BSON_DIFF_NONE,
+                "{}");
+   /* field order does not matter at any level */
+   _check_diff ("{\"a\": 1, \"b\": {\"c\": 1, \"d\": 2}}",
+                "{\"b\": {\"d\": 2, \"c\": 1}, \"a\": 1}",
+                BSON_DIFF_NONE,
+                "{}");
+}
+
+
+static void
+test_bson_diff_top_level (void)
+{
+   _check_diff ("{\"a\": 1, \"b\": 2, \"c\": 3}",
+                "{\"a\": 1, \"b\": 20, \"d\": 4}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"b\": 20, \"d\": 4}, \"$unset\": {\"c\": \"\"}}");
+   _check_diff (
+      "{\"a\": 1}", "{}", BSON_DIFF_NONE, "{\"$unset\": {\"a\": \"\"}}");
+   _check_diff ("{}", "{\"a\": 1}", BSON_DIFF_NONE, "{\"$set\": {\"a\": 1}}");
+   /* a change of type is a change, even if the values compare equal */
+   _check_diff ("{\"a\": {\"$numberInt\": \"1\"}}",
+                "{\"a\": {\"$numberLong\": \"1\"}}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a\": {\"$numberLong\": \"1\"}}}");
+}
+
+
+static void
+test_bson_diff_nested (void)
+{
+   _check_diff ("{\"a\": {\"b\": {\"c\": 1, \"d\": 2}, \"e\": 3}}",
+                "{\"a\": {\"b\": {\"c\": 10}, \"e\": 3, \"f\": 4}}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a.b.c\": 10, \"a.f\": 4},"
+                " \"$unset\": {\"a.b.d\": \"\"}}");
+   /* document replaced by a scalar and vice-versa */
+   _check_diff ("{\"a\": {\"b\": 1}, \"c\": 2}",
+                "{\"a\": 1, \"c\": {\"d\": 2}}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a\": 1, \"c\": {\"d\": 2}}}");
+   /* keys that cannot be part of a path force replacing the parent */
+   _check_diff ("{\"a\": {\"x.y\": 1, \"b\": 1}}",
+                "{\"a\": {\"x.y\": 1, \"b\": 2}}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a\": {\"x.y\": 1, \"b\": 2}}}");
+   _check_diff ("{\"a\": {\"b\": 1}}",
+                "{\"a\": {\"$b\": 1}}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a\": {\"$b\": 1}}}");
+}
+
+
+static void
+test_bson_diff_array (void)
+{
+   const char *from = "{\"a\": [1, {\"b\": 1, \"c\": 1}, 3]}";
+
+   _check_diff (from,
+                "{\"a\": [1, {\"b\": 2, \"c\": 1}, 3]}",
+                BSON_DIFF_NONE,
+                "{\"$set\": {\"a\": [1, {\"b\": 2, \"c\": 1}, 3]}}");
+   _check_diff (from,
+                "{\"a\": [1, {\"b\": 2, \"c\": 1}, 3]}",
+                BSON_DIFF_ARRAY_ELEMENTS,
+                "{\"$set\": {\"a.1.b\": 2}}");
+   /* growing arrays set the new elements */
+   _check_diff (from,
+                "{\"a\": [0, {\"b\": 1, \"c\": 1}, 3, 4, 5]}",
+                BSON_DIFF_ARRAY_ELEMENTS,
+                "{\"$set\": {\"a.0\": 0, \"a.3\": 4, \"a.4\": 5}}");
+   /* shrinking arrays are replaced */
+   _check_diff (from,
+                "{\"a\": [1, {\"b\": 1, \"c\": 1}]}",
+                BSON_DIFF_ARRAY_ELEMENTS,
+                "{\"$set\": {\"a\": [1, {\"b\": 1, \"c\": 1}]}}");
+   _check_diff ("{\"a\": []}",
+                "{\"a\": [1]}",
+                BSON_DIFF_ARRAY_ELEMENTS,
+                "{\"$set\": {\"a\": [1]}}");
+   /* nested arrays */
+   _check_diff ("{\"a\": [[1, 2], [3, 4]]}",
+                "{\"a\": [[1, 2], [3, 5]]}",
+                BSON_DIFF_ARRAY_ELEMENTS,
+                "{\"$set\": {\"a.1.1\": 5}}");
+}
+
+
+static void
+test_bson_diff_invalid_key (void)
+{
+   bson_t update;
+   bson_error_t error;
+
+   BSON_ASSERT (!bson_diff (tmp_bson ("{'a.b': 1}"),
+                            tmp_bson ("{'a.b': 2}"),
+                            BSON_DIFF_NONE,
+                            &update,
+                            &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          BSON_ERROR_INVALID,
+                          BSON_VALIDATE_DOT_KEYS,
+                          "cannot express a change to field \"a.b\"");
+   bson_destroy (&update);
+
+   BSON_ASSERT (!bson_diff (tmp_bson ("{'$a': 1}"),
+                            tmp_bson ("{}"),
+                            BSON_DIFF_NONE,
+                            &update,
+                            &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          BSON_ERROR_INVALID,
+                          BSON_VALIDATE_DOLLAR_KEYS,
+                          "cannot express removal of field \"$a\"");
+   bson_destroy (&update);
+
+   /* unchanged fields are never a problem */
+   ASSERT_OR_PRINT (bson_diff (tmp_bson ("{'a.b': 1, 'c': 1}"),
+                               tmp_bson ("{'a.b': 1, 'c': 2}"),
+                               BSON_DIFF_NONE,
+                               &update,
+                               &error),
+                    error);
+   ASSERT (match_bson (&update, tmp_bson ("{'$set': {'c': 2}}"), false));
+   bson_destroy (&update);
+}
+
+
+static void
+_corrupt_c (bson_t *doc)
+{
+   uint8_t *data = (uint8_t *) bson_get_data (doc);
+   uint32_t i;
+
+   for (i = 1; i + 1 < doc->len; i++) {
+      if (data[i] == 'c' && data[i + 1] == '\0') {
+         /* not a BSON type */
+         data[i - 1] = 0x25;
+         return;
+      }
+   }
+
+   BSON_ASSERT (false);
+}
+
+
+/* corruption is reported wherever it is, even in a subdocument that is
+ * unchanged or would be set whole */
+static void
+test_bson_diff_corrupt_nested (void)
+{
+   const char *docs[] = {"{'a': [{'b': 1, 'c': 2}]}",
+                         "{'a': {'b': 1, 'c': 2}}",
+                         "{'a': [{'b': 1, 'c': 2}], 'd': 1}"};
+   bson_diff_flags_t flags[] = {BSON_DIFF_NONE, BSON_DIFF_ARRAY_ELEMENTS};
+   bson_t *corrupt;
+   bson_t update;
+   bson_error_t error;
+   size_t i;
+   size_t j;
+
+   for (i = 0; i < sizeof docs / sizeof docs[0]; i++) {
+      for (j = 0; j < sizeof flags / sizeof flags[0]; j++) {
+         corrupt = bson_copy (tmp_bson (docs[i]));
+         _corrupt_c (corrupt);
+
+         BSON_ASSERT (!bson_diff (
+            tmp_bson ("{'a': 1}"), corrupt, flags[j], &update, &error));
+         ASSERT_ERROR_CONTAINS (
+            error, BSON_ERROR_INVALID, BSON_VALIDATE_NONE, "corrupt");
+         bson_destroy (&update);
+
+         BSON_ASSERT (!bson_diff (
+            corrupt, tmp_bson ("{'a': 1}"), flags[j], &update, &error));
+         ASSERT_ERROR_CONTAINS (
+            error, BSON_ERROR_INVALID, BSON_VALIDATE_NONE, "corrupt");
+         bson_destroy (&update);
+
+         BSON_ASSERT (
+            !bson_diff (corrupt, corrupt, flags[j], &update, &error));
+         ASSERT_ERROR_CONTAINS (
+            error, BSON_ERROR_INVALID, BSON_VALIDATE_NONE, "corrupt");
+         bson_destroy (&update);
+
+         bson_destroy (corrupt);
+      }
+   }
+}
+
+
+void
+test_diff_install (TestSuite *suite)
+{
+   TestSuite_Add (suite, "/bson/diff/equal", test_bson_diff_equal);
+   TestSuite_Add (suite, "/bson/diff/top_level", test_bson_diff_top_level);
+   TestSuite_Add (suite, "/bson/diff/nested", test_bson_diff_nested);
+   TestSuite_Add (suite, "/bson/diff/array", test_bson_diff_array);
+   TestSuite_Add (suite, "/bson/diff/invalid_key", test_bson_diff_invalid_key);
+   TestSuite_Add (
+      suite, "/bson/diff/corrupt_nested", test_bson_diff_corrupt_nested);
+}
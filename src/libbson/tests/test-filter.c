@@ -0,0 +1,243 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <bson/bson.h>
+
+#include "TestSuite.h"
+#include "test-conveniences.h"
+
+
+static void
+_check_filter (const bson_filter_t *filter,
+               const char *src_json,
+               const char *expected_json)
+{
+   bson_t dst = BSON_INITIALIZER;
+   char *actual;
+   char *expected;
+
+   BSON_ASSERT (
+      bson_filter_copy_to_noinit (filter, tmp_bson ("%s", src_json), &dst));
+
+   actual = bson_as_canonical_extended_json (&dst, NULL);
+   expected = bson_as_canonical_extended_json (
+      tmp_bson ("%s", expected_json), NULL);
+   /* frees actual */
+   ASSERT_CMPJSON (actual, expected);
+
+   bson_free (expected);
+   bson_destroy (&dst);
+}
+
+
+static void
+test_bson_filter_exclude (void)
+{
+   bson_filter_t *filter;
+
+   filter = bson_filter_new (BSON_FILTER_EXCLUDE);
+   _check_filter (filter, "{'a': 1, 'b': 2}", "{'a': 1, 'b': 2}");
+
+   bson_filter_add (filter, "b");
+   bson_filter_add (filter, "d");
+   _check_filter (
+      filter, "{'a': 1, 'b': 2, 'c': 3, 'd': 4}", "{'a': 1, 'c': 3}");
+   _check_filter (filter, "{}", "{}");
+   /* keys are matched exactly */
+   _check_filter (
+      filter, "{'bb': 1, 'B': 2, '': 3}", "{'bb': 1, 'B': 2, '': 3}");
+
+   bson_filter_destroy (filter);
+}
+
+
+static void
+test_bson_filter_include (void)
+{
+   bson_filter_t *filter;
+
+   filter = bson_filter_new (BSON_FILTER_INCLUDE);
+   _check_filter (filter, "{'a': 1, 'b': 2}", "{}");
+
+   bson_filter_add (filter, "b");
+   bson_filter_add (filter, "d");
+   /* source order is preserved */
+   _check_filter (filter,
+                  "{'d': 4, 'a': 1, 'b': {'x': 1}, 'c': 3}",
+                  "{'d': 4, 'b': {'x': 1}}");
+
+   bson_filter_destroy (filter);
+}
+
+
+static void
+test_bson_filter_many_keys (void)
+{
+   bson_filter_t *filter;
+   bson_t src = BSON_INITIALIZER;
+   bson_t dst = BSON_INITIALIZER;
+   bson_iter_t iter;
+   char key[16];
+   int i;
+
+   /* enough keys to grow the hash table several times */
+   filter = bson_filter_new (BSON_FILTER_EXCLUDE);
+   for (i = 0; i < 1000; i += 2) {
+      bson_snprintf (key, sizeof key, "key%d", i);
+      bson_filter_add (filter, key);
+   }
+
+   for (i = 0; i < 1000; i++) {
+      bson_snprintf (key, sizeof key, "key%d", i);
+      BSON_APPEND_INT32 (&src, key, i);
+   }
+
+   BSON_ASSERT (bson_filter_copy_to_noinit (filter, &src, &dst));
+   ASSERT_CMPUINT32 (bson_count_keys (&dst), ==, 500);
+
+   BSON_ASSERT (bson_iter_init (&iter, &dst));
+   while (bson_iter_next (&iter)) {
+      ASSERT_CMPINT (bson_iter_int32 (&iter) % 2, ==, 1);
+   }
+
+   bson_destroy (&src);
+   bson_destroy (&dst);
+   bson_filter_destroy (filter);
+}
+
+
+static void
+test_bson_filter_paths (void)
+{
+   bson_filter_t *filter;
+   const char *src = "{'a': {'b': 1, 'c': {'d': 2, 'e': 3}}, 'f': 4, "
+                     "'g': [{'b': 5, 'h': 6}, 7, {'h': 8}]}";
+
+   filter = bson_filter_new (BSON_FILTER_EXCLUDE);
+   bson_filter_add (filter, "a.c.d");
+   bson_filter_add (filter, "g.h");
+   bson_filter_add (filter, "f.x");
+   _check_filter (filter,
+                  src,
+                  "{'a': {'b': 1, 'c': {'e': 3}}, 'f': 4, "
+                  "'g': [{'b': 5}, 7, {}]}");
+   bson_filter_destroy (filter);
+
+   filter = bson_filter_new (BSON_FILTER_INCLUDE);
+   bson_filter_add (filter, "a.c.d");
+   bson_filter_add (filter, "g.h");
+   bson_filter_add (filter, "f.x");
+   /* array elements that are not documents are dropped and the remaining
+    * elements renumbered */
+   _check_filter (
+      filter, src, "{'a': {'c': {'d': 2}}, 'g': [{'h': 6}, {'h': 8}]}");
+   bson_filter_destroy (filter);
+
+   /* a whole field takes precedence over paths beneath it */
+   filter = bson_filter_new (BSON_FILTER_INCLUDE);
+   bson_filter_add (filter, "a.b");
+   bson_filter_add (filter, "a");
+   bson_filter_add (filter, "a.c.d");
+   _check_filter (filter, src, "{'a': {'b': 1, 'c': {'d': 2, 'e': 3}}}");
+   bson_filter_destroy (filter);
+}
+
+
+static void
+test_bson_filter_corrupt (void)
+{
+   bson_filter_t *filter;
+   bson_t dst = BSON_INITIALIZER;
+   bson_t src;
+   /* length is correct but the int32 is truncated */
+   const uint8_t data[] = {11, 0, 0, 0, 0x10, 'a', 0, 1, 0, 0, 0};
+
+   BSON_ASSERT (bson_init_static (&src, data, sizeof data));
+
+   filter = bson_filter_new (BSON_FILTER_EXCLUDE);
+   BSON_ASSERT (!bson_filter_copy_to_noinit (filter, &src, &dst));
+
+   bson_destroy (&dst);
+   bson_filter_destroy (filter);
+}
+
+
+/* corrupt @src's element "c", nested in a document at any depth */
+static void
+_corrupt_c (bson_t *src)
+{
+   uint8_t *data = (uint8_t *) bson_get_data (src);
+   uint32_t i;
+
+   for (i = 1; i + 1 < src->len; i++) {
+      if (data[i] == 'c' && data[i + 1] == '\0') {
+         /* not a BSON type */
+         data[i - 1] = 0x25;
+         return;
+      }
+   }
+
+   BSON_ASSERT (false);
+}
+
+
+/* a corrupt document nested within what the filter descends into fails the
+ * copy, and leaves dst a document with no open child */
+static void
+test_bson_filter_corrupt_nested (void)
+{
+   const char *srcs[] = {"{'a': [{'b': 1, 'c': 2}]}",
+                         "{'a': {'b': 1, 'c': 2}}"};
+   bson_filter_mode_t modes[] = {BSON_FILTER_INCLUDE, BSON_FILTER_EXCLUDE};
+   bson_filter_t *filter;
+   bson_t dst;
+   bson_t *src;
+   int i;
+   int j;
+
+   for (i = 0; i < 2; i++) {
+      for (j = 0; j < 2; j++) {
+         src = bson_copy (tmp_bson (srcs[i]));
+         _corrupt_c (src);
+
+         filter = bson_filter_new (modes[j]);
+         bson_filter_add (filter, "a.b");
+
+         bson_init (&dst);
+         BSON_ASSERT (!bson_filter_copy_to_noinit (filter, src, &dst));
+         BSON_ASSERT (BSON_APPEND_INT32 (&dst, "z", 1));
+         BSON_ASSERT (bson_validate (&dst, BSON_VALIDATE_NONE, NULL));
+
+         bson_destroy (&dst);
+         bson_filter_destroy (filter);
+         bson_destroy (src);
+      }
+   }
+}
+
+
+void
+test_filter_install (TestSuite *suite)
+{
+   TestSuite_Add (suite, "/bson/filter/exclude", test_bson_filter_exclude);
+   TestSuite_Add (suite, "/bson/filter/include", test_bson_filter_include);
+   TestSuite_Add (suite, "/bson/filter/many_keys", test_bson_filter_many_keys);
+   TestSuite_Add (suite, "/bson/filter/paths", test_bson_filter_paths);
+   TestSuite_Add (suite, "/bson/filter/corrupt", test_bson_filter_corrupt);
+   TestSuite_Add (
+      suite, "/bson/filter/corrupt_nested", test_bson_filter_corrupt_nested);
+}
@@ -37,7 +37,10 @@ MD_FLAGS = [
     "MONGOC_MD_FLAG_TRACE",
     "MONGOC_MD_FLAG_ENABLE_ICU",
     "MONGOC_MD_FLAG_ENABLE_CLIENT_SIDE_ENCRYPTION",
-    "MONGOC_MD_FLAG_ENABLE_MONGODB_AWS_AUTH"
+    "MONGOC_MD_FLAG_ENABLE_MONGODB_AWS_AUTH",
+    "MONGOC_MD_FLAG_ENABLE_EPOLL",
+    "MONGOC_MD_FLAG_ENABLE_IO_URING",
+    "MONGOC_MD_FLAG_ENABLE_ZEROCOPY"
 ]
 
 def main():
@@ -66,8 +66,16 @@ typedef struct _mongoc_async_cmd {
    mongoc_rpc_t rpc;
    bson_t reply;
    bool reply_needs_cleanup;
+   /* the compressed message that iovec points into, if compressed */
+   char *compressed;
    char *ns;
    struct addrinfo *dns_result;
+#ifdef MONGOC_ENABLE_EPOLL
+   /* the descriptor and events registered with async->epoll_fd, valid if
+    * watched_events is non-zero */
+   int watched_fd;
+   int watched_events;
+#endif
 
    struct _mongoc_async_cmd *next;
    struct _mongoc_async_cmd *prev;
@@ -88,6 +96,17 @@ mongoc_async_cmd_new (mongoc_async_t *async,
                       void *cb_data,
                       int64_t timeout_msec);
 
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_opmsg (mongoc_async_t *async,
+                            mongoc_stream_t *stream,
+                            const bson_t *cmd,
+                            int32_t compressor_id,
+                            int32_t compression_level,
+                            mongoc_async_cmd_cb_t cb,
+                            void *cb_data,
+                            int64_t timeout_msec,
+                            bson_error_t *error);
+
 void
 mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd);
 
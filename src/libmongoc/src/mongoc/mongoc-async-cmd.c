@@ -20,6 +20,7 @@
 #include "mongoc-client.h"
 #include "mongoc-async-cmd-private.h"
 #include "mongoc-async-private.h"
+#include "mongoc-compression-private.h"
 #include "mongoc-error.h"
 #include "mongoc-opcode.h"
 #include "mongoc-rpc-private.h"
@@ -122,6 +123,9 @@ mongoc_async_cmd_run (mongoc_async_cmd_t *acmd)
 
    duration_usec = bson_get_monotonic_time () - acmd->cmd_started;
 
+   /* the callback may close the stream or hand it to a node */
+   _mongoc_async_unwatch (acmd);
+
    if (result == MONGOC_ASYNC_CMD_SUCCESS) {
       acmd->cb (acmd, result, &acmd->reply, duration_usec);
    } else {
@@ -171,6 +175,33 @@ _mongoc_async_cmd_state_start (mongoc_async_cmd_t *acmd, bool is_setup_done)
    acmd->events = POLLOUT;
 }
 
+static mongoc_async_cmd_t *
+_mongoc_async_cmd_alloc (mongoc_async_t *async,
+                         mongoc_stream_t *stream,
+                         const bson_t *cmd,
+                         mongoc_async_cmd_cb_t cb,
+                         void *cb_data,
+                         int64_t timeout_msec)
+{
+   mongoc_async_cmd_t *acmd;
+
+   BSON_ASSERT (cmd);
+
+   acmd = (mongoc_async_cmd_t *) bson_malloc0 (sizeof (*acmd));
+   acmd->async = async;
+   acmd->timeout_msec = timeout_msec;
+   acmd->stream = stream;
+   acmd->cb = cb;
+   acmd->data = cb_data;
+   acmd->connect_started = bson_get_monotonic_time ();
+   bson_copy_to (cmd, &acmd->cmd);
+
+   _mongoc_array_init (&acmd->array, sizeof (mongoc_iovec_t));
+   _mongoc_buffer_init (&acmd->buffer, NULL, 0, NULL, NULL);
+
+   return acmd;
+}
+
 mongoc_async_cmd_t *
 mongoc_async_cmd_new (mongoc_async_t *async,
                       mongoc_stream_t *stream,
@@ -188,25 +219,15 @@ mongoc_async_cmd_new (mongoc_async_t *async,
 {
    mongoc_async_cmd_t *acmd;
 
-   BSON_ASSERT (cmd);
    BSON_ASSERT (dbname);
 
-   acmd = (mongoc_async_cmd_t *) bson_malloc0 (sizeof (*acmd));
-   acmd->async = async;
+   acmd =
+      _mongoc_async_cmd_alloc (async, stream, cmd, cb, cb_data, timeout_msec);
    acmd->dns_result = dns_result;
-   acmd->timeout_msec = timeout_msec;
-   acmd->stream = stream;
    acmd->initiator = initiator;
    acmd->initiate_delay_ms = initiate_delay_ms;
    acmd->setup = setup;
    acmd->setup_ctx = setup_ctx;
-   acmd->cb = cb;
-   acmd->data = cb_data;
-   acmd->connect_started = bson_get_monotonic_time ();
-   bson_copy_to (cmd, &acmd->cmd);
-
-   _mongoc_array_init (&acmd->array, sizeof (mongoc_iovec_t));
-   _mongoc_buffer_init (&acmd->buffer, NULL, 0, NULL, NULL);
 
    _mongoc_async_cmd_init_send (acmd, dbname);
 
@@ -219,11 +240,81 @@ mongoc_async_cmd_new (mongoc_async_t *async,
 }
 
 
+/* run a command that already includes "$db" as OP_MSG on a connected,
+ * handshaked stream, compressed with @compressor_id unless it is -1. returns
+ * NULL and sets @error if compression fails. */
+mongoc_async_cmd_t *
+mongoc_async_cmd_new_opmsg (mongoc_async_t *async,
+                            mongoc_stream_t *stream,
+                            const bson_t *cmd,
+                            int32_t compressor_id,
+                            int32_t compression_level,
+                            mongoc_async_cmd_cb_t cb,
+                            void *cb_data,
+                            int64_t timeout_msec,
+                            bson_error_t *error)
+{
+   mongoc_async_cmd_t *acmd;
+
+   BSON_ASSERT (stream);
+
+   acmd =
+      _mongoc_async_cmd_alloc (async, stream, cmd, cb, cb_data, timeout_msec);
+
+   acmd->rpc.header.msg_len = 0;
+   acmd->rpc.header.request_id = ++acmd->async->request_id;
+   acmd->rpc.header.response_to = 0;
+   acmd->rpc.header.opcode = MONGOC_OPCODE_MSG;
+   acmd->rpc.msg.flags = 0;
+   acmd->rpc.msg.n_sections = 1;
+   acmd->rpc.msg.sections[0].payload_type = 0;
+   acmd->rpc.msg.sections[0].payload.bson_document = bson_get_data (&acmd->cmd);
+
+   _mongoc_rpc_gather (&acmd->rpc, &acmd->array);
+   _mongoc_rpc_swab_to_le (&acmd->rpc);
+
+   if (compressor_id != -1) {
+      acmd->compressed = _mongoc_rpc_compress_iov (compressor_id,
+                                                   compression_level,
+                                                   &acmd->rpc,
+                                                   &acmd->array,
+                                                   error);
+      if (!acmd->compressed) {
+         if (!error->code) {
+            bson_set_error (error,
+                            MONGOC_ERROR_COMMAND,
+                            MONGOC_ERROR_COMMAND_INVALID_ARG,
+                            "Could not compress data with %s",
+                            mongoc_compressor_id_to_name (compressor_id));
+         }
+         _mongoc_array_destroy (&acmd->array);
+         _mongoc_buffer_destroy (&acmd->buffer);
+         bson_destroy (&acmd->cmd);
+         bson_free (acmd);
+         return NULL;
+      }
+   }
+
+   acmd->iovec = (mongoc_iovec_t *) acmd->array.data;
+   acmd->niovec = acmd->array.len;
+   acmd->bytes_written = 0;
+
+   _mongoc_async_cmd_state_start (acmd, true);
+
+   async->ncmds++;
+   DL_APPEND (async->cmds, acmd);
+
+   return acmd;
+}
+
+
 void
 mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd)
 {
    BSON_ASSERT (acmd);
 
+   _mongoc_async_unwatch (acmd);
+
    DL_DELETE (acmd->async->cmds, acmd);
    acmd->async->ncmds--;
 
@@ -236,6 +327,7 @@ mongoc_async_cmd_destroy (mongoc_async_cmd_t *acmd)
    _mongoc_array_destroy (&acmd->array);
    _mongoc_buffer_destroy (&acmd->buffer);
 
+   bson_free (acmd->compressed);
    bson_free (acmd->ns);
    bson_free (acmd);
 }
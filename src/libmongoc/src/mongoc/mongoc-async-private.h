@@ -20,8 +20,14 @@
 #define MONGOC_ASYNC_PRIVATE_H
 
 #include <bson/bson.h>
+#include "mongoc-client.h"
+#include "mongoc-config.h"
 #include "mongoc-stream.h"
 
+#ifdef MONGOC_ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 BSON_BEGIN_DECLS
 
 struct _mongoc_async_cmd;
@@ -30,6 +36,17 @@ typedef struct _mongoc_async {
    struct _mongoc_async_cmd *cmds;
    size_t ncmds;
    uint32_t request_id;
+   /* reused by each call to mongoc_async_run_once */
+   mongoc_stream_poll_t *poller;
+   struct _mongoc_async_cmd **acmds_polled;
+   size_t poll_size;
+#ifdef MONGOC_ENABLE_EPOLL
+   /* commands stay registered across calls to epoll_wait, so each iteration
+    * only hands the kernel what changed. -1 if epoll_create1 failed or a
+    * stream was not a socket. */
+   int epoll_fd;
+   struct epoll_event *ready;
+#endif
 } mongoc_async_t;
 
 typedef enum {
@@ -64,6 +81,34 @@ mongoc_async_destroy (mongoc_async_t *async);
 void
 mongoc_async_run (mongoc_async_t *async);
 
+void
+mongoc_async_run_once (mongoc_async_t *async, int64_t expire_at);
+
+size_t
+mongoc_async_get_fds (mongoc_async_t *async,
+                      mongoc_client_async_fd_t *fds,
+                      size_t n_fds,
+                      int64_t *expire_at);
+
+void
+mongoc_async_step (mongoc_async_t *async,
+                   const mongoc_client_async_fd_t *fds,
+                   size_t n_fds);
+
+size_t
+mongoc_async_get_pollers (mongoc_async_t *async,
+                          mongoc_stream_poll_t *pollers,
+                          size_t n_pollers,
+                          int64_t *expire_at);
+
+void
+mongoc_async_step_pollers (mongoc_async_t *async,
+                           const mongoc_stream_poll_t *pollers,
+                           size_t n_pollers);
+
+void
+_mongoc_async_unwatch (struct _mongoc_async_cmd *acmd);
+
 BSON_END_DECLS
 
 #endif /* MONGOC_ASYNC_PRIVATE_H */
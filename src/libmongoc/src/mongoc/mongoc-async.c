@@ -22,8 +22,13 @@
 #include "utlist.h"
 #include "mongoc.h"
 #include "mongoc-socket-private.h"
+#include "mongoc-stream-private.h"
 #include "mongoc-util-private.h"
 
+#ifdef MONGOC_ENABLE_EPOLL
+#include <unistd.h>
+#endif
+
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "async"
 
@@ -33,6 +38,10 @@ mongoc_async_new ()
 {
    mongoc_async_t *async = (mongoc_async_t *) bson_malloc0 (sizeof (*async));
 
+#ifdef MONGOC_ENABLE_EPOLL
+   async->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+#endif
+
    return async;
 }
 
@@ -46,24 +55,218 @@ mongoc_async_destroy (mongoc_async_t *async)
       mongoc_async_cmd_destroy (acmd);
    }
 
+#ifdef MONGOC_ENABLE_EPOLL
+   if (async->epoll_fd >= 0) {
+      close (async->epoll_fd);
+   }
+
+   bson_free (async->ready);
+#endif
+
+   bson_free (async->poller);
+   bson_free (async->acmds_polled);
    bson_free (async);
 }
 
+/* the socket beneath acmd's stream, or NULL if the stream is not backed by a
+ * socket, e.g. a custom stream from mongoc_client_set_stream_initiator. */
+static mongoc_socket_t *
+_mongoc_async_cmd_get_socket (mongoc_async_cmd_t *acmd)
+{
+   mongoc_stream_t *root;
+
+   root = mongoc_stream_get_root_stream (acmd->stream);
+   if (root->type != MONGOC_STREAM_SOCKET) {
+      return NULL;
+   }
+
+   return mongoc_stream_socket_get_socket ((mongoc_stream_socket_t *) root);
+}
+
+
+/* grow the arrays reused by each iteration to hold every command */
+static void
+_mongoc_async_reserve (mongoc_async_t *async)
+{
+   /* ncmds grows if we discover a replica & start calling hello on it */
+   if (async->poll_size < async->ncmds) {
+      async->poller = (mongoc_stream_poll_t *) bson_realloc (
+         async->poller, sizeof (*async->poller) * async->ncmds);
+      async->acmds_polled = (mongoc_async_cmd_t **) bson_realloc (
+         async->acmds_polled, sizeof (*async->acmds_polled) * async->ncmds);
+#ifdef MONGOC_ENABLE_EPOLL
+      async->ready = (struct epoll_event *) bson_realloc (
+         async->ready, sizeof (*async->ready) * async->ncmds);
+#endif
+      async->poll_size = async->ncmds;
+   }
+}
+
+
+#ifdef MONGOC_ENABLE_EPOLL
+/* register acmd's socket with async->epoll_fd, or update the registration
+ * if acmd->events changed since. returns false if the stream is not backed by
+ * a socket. */
+static bool
+_mongoc_async_watch (mongoc_async_t *async, mongoc_async_cmd_t *acmd)
+{
+   struct epoll_event event = {0};
+   mongoc_socket_t *sock;
+   int op;
+   int fd;
+
+   if (acmd->watched_events == acmd->events) {
+      return true;
+   }
+
+   if (acmd->watched_events) {
+      op = EPOLL_CTL_MOD;
+      fd = acmd->watched_fd;
+   } else {
+      sock = _mongoc_async_cmd_get_socket (acmd);
+      if (!sock) {
+         return false;
+      }
+
+      op = EPOLL_CTL_ADD;
+      fd = sock->sd;
+   }
+
+   event.events = ((acmd->events & POLLIN) ? EPOLLIN : 0) |
+                  ((acmd->events & POLLOUT) ? EPOLLOUT : 0);
+   event.data.ptr = acmd;
+
+   if (epoll_ctl (async->epoll_fd, op, fd, &event) != 0) {
+      return false;
+   }
+
+   acmd->watched_fd = fd;
+   acmd->watched_events = acmd->events;
+
+   return true;
+}
+
+
+static void
+_mongoc_async_unwatch_all (mongoc_async_t *async)
+{
+   mongoc_async_cmd_t *acmd;
+
+   DL_FOREACH (async->cmds, acmd)
+   {
+      _mongoc_async_unwatch (acmd);
+   }
+}
+
+
+static int
+_mongoc_async_epoll_to_poll (uint32_t events)
+{
+   return ((events & EPOLLIN) ? POLLIN : 0) |
+          ((events & EPOLLOUT) ? POLLOUT : 0) |
+          ((events & EPOLLERR) ? POLLERR : 0) |
+          ((events & EPOLLHUP) ? POLLHUP : 0);
+}
+#endif
+
+
+/* remove acmd's socket from the async's epoll set, if it is registered. must
+ * be called before the stream is closed or given away. */
 void
-mongoc_async_run (mongoc_async_t *async)
+_mongoc_async_unwatch (mongoc_async_cmd_t *acmd)
+{
+#ifdef MONGOC_ENABLE_EPOLL
+   struct epoll_event event = {0};
+
+   if (acmd->watched_events) {
+      (void) epoll_ctl (
+         acmd->async->epoll_fd, EPOLL_CTL_DEL, acmd->watched_fd, &event);
+      acmd->watched_events = 0;
+   }
+#endif
+}
+
+
+/* handle the poll events reported for a command. returns true if the command
+ * was run. */
+static bool
+_mongoc_async_cmd_handle_revents (mongoc_async_cmd_t *acmd,
+                                  int events,
+                                  int revents)
+{
+   if (revents & (POLLERR | POLLHUP)) {
+      int hup = revents & POLLHUP;
+      if (acmd->state == MONGOC_ASYNC_CMD_SEND) {
+         bson_set_error (&acmd->error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_CONNECT,
+                         hup ? "connection refused"
+                             : "unknown connection error");
+      } else {
+         bson_set_error (&acmd->error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         hup ? "connection closed" : "unknown socket error");
+      }
+
+      acmd->state = MONGOC_ASYNC_CMD_ERROR_STATE;
+   }
+
+   if ((revents & events) || acmd->state == MONGOC_ASYNC_CMD_ERROR_STATE) {
+      (void) mongoc_async_cmd_run (acmd);
+      return true;
+   }
+
+   return false;
+}
+
+/* fail the initiated commands that have passed their timeout as of @now, and
+ * remove the canceled ones. */
+static void
+_mongoc_async_expire (mongoc_async_t *async, int64_t now)
 {
    mongoc_async_cmd_t *acmd, *tmp;
-   mongoc_async_cmd_t **acmds_polled = NULL;
-   mongoc_stream_poll_t *poller = NULL;
-   int nstreams, i;
-   ssize_t nactive = 0;
+
+   DL_FOREACH_SAFE (async->cmds, acmd, tmp)
+   {
+      bool remove_cmd = false;
+      mongoc_async_cmd_result_t result;
+
+      /* check if an initiated cmd has passed the connection timeout.  */
+      if (acmd->state != MONGOC_ASYNC_CMD_INITIATE &&
+          now > acmd->connect_started + acmd->timeout_msec * 1000) {
+         bson_set_error (&acmd->error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_CONNECT,
+                         acmd->state == MONGOC_ASYNC_CMD_SEND
+                            ? "connection timeout"
+                            : "socket timeout");
+
+         remove_cmd = true;
+         result = MONGOC_ASYNC_CMD_TIMEOUT;
+      } else if (acmd->state == MONGOC_ASYNC_CMD_CANCELED_STATE) {
+         remove_cmd = true;
+         result = MONGOC_ASYNC_CMD_ERROR;
+      }
+
+      if (remove_cmd) {
+         _mongoc_async_unwatch (acmd);
+         acmd->cb (acmd, result, NULL, (now - acmd->connect_started) / 1000);
+
+         /* Remove acmd from the async->cmds doubly-linked list */
+         mongoc_async_cmd_destroy (acmd);
+      }
+   }
+}
+
+
+void
+mongoc_async_run (mongoc_async_t *async)
+{
+   mongoc_async_cmd_t *acmd;
    int64_t now;
-   int64_t expire_at;
-   int64_t poll_timeout_msec;
-   size_t poll_size;
 
    now = bson_get_monotonic_time ();
-   poll_size = 0;
 
    /* CDRIVER-1571 reset start times in case a stream initiator was slow */
    DL_FOREACH (async->cmds, acmd)
@@ -72,134 +275,292 @@ mongoc_async_run (mongoc_async_t *async)
    }
 
    while (async->ncmds) {
-      /* ncmds grows if we discover a replica & start calling hello on it */
-      if (poll_size < async->ncmds) {
-         poller = (mongoc_stream_poll_t *) bson_realloc (
-            poller, sizeof (*poller) * async->ncmds);
-         acmds_polled = (mongoc_async_cmd_t **) bson_realloc (
-            acmds_polled, sizeof (*acmds_polled) * async->ncmds);
-         poll_size = async->ncmds;
-      }
+      mongoc_async_run_once (async, INT64_MAX);
+   }
+}
 
-      expire_at = INT64_MAX;
-      nstreams = 0;
 
-      /* check if any cmds are ready to be initiated. */
-      DL_FOREACH_SAFE (async->cmds, acmd, tmp)
-      {
-         if (acmd->state == MONGOC_ASYNC_CMD_INITIATE) {
-            BSON_ASSERT (!acmd->stream);
-            if (now >= acmd->initiate_delay_ms * 1000 + acmd->connect_started) {
-               /* time to initiate. */
-               if (mongoc_async_cmd_run (acmd)) {
-                  BSON_ASSERT (acmd->stream);
-               } else {
-                  /* this command was removed. */
-                  continue;
-               }
+/* initiate commands that are due, wait for socket events until @expire_at
+ * (in microseconds) or the earliest command deadline, run the commands that
+ * are ready, and expire the commands that timed out. */
+void
+mongoc_async_run_once (mongoc_async_t *async, int64_t expire_at)
+{
+   mongoc_async_cmd_t *acmd, *tmp;
+   int nstreams, i;
+   ssize_t nactive = 0;
+   int64_t now;
+   int64_t poll_timeout_msec;
+   bool use_epoll = false;
+
+#ifdef MONGOC_ENABLE_EPOLL
+   use_epoll = async->epoll_fd >= 0;
+#endif
+
+   now = bson_get_monotonic_time ();
+
+   _mongoc_async_reserve (async);
+
+   nstreams = 0;
+
+   /* check if any cmds are ready to be initiated. */
+   DL_FOREACH_SAFE (async->cmds, acmd, tmp)
+   {
+      if (acmd->state == MONGOC_ASYNC_CMD_INITIATE) {
+         BSON_ASSERT (!acmd->stream);
+         if (now >= acmd->initiate_delay_ms * 1000 + acmd->connect_started) {
+            /* time to initiate. */
+            if (mongoc_async_cmd_run (acmd)) {
+               BSON_ASSERT (acmd->stream);
             } else {
-               /* don't poll longer than the earliest cmd ready to init. */
-               expire_at = BSON_MIN (
-                  expire_at, acmd->connect_started + acmd->initiate_delay_ms);
+               /* this command was removed. */
+               continue;
             }
+         } else {
+            /* don't poll longer than the earliest cmd ready to init. */
+            expire_at = BSON_MIN (
+               expire_at, acmd->connect_started + acmd->initiate_delay_ms);
+         }
+      }
+
+      if (acmd->stream) {
+#ifdef MONGOC_ENABLE_EPOLL
+         if (use_epoll && !_mongoc_async_watch (async, acmd)) {
+            /* poll every stream from now on */
+            _mongoc_async_unwatch_all (async);
+            close (async->epoll_fd);
+            async->epoll_fd = -1;
+            use_epoll = false;
          }
+#endif
+         expire_at = BSON_MIN (
+            expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
+         ++nstreams;
+      }
+   }
+
+   if (async->ncmds == 0) {
+      /* all cmds failed to initiate and removed themselves. */
+      return;
+   }
+
+   poll_timeout_msec = BSON_MAX (0, (expire_at - now) / 1000);
+   poll_timeout_msec = BSON_MIN (poll_timeout_msec, INT32_MAX - 1);
+
+   if (nstreams > 0 && use_epoll) {
+#ifdef MONGOC_ENABLE_EPOLL
+      /* only commands whose sockets are ready are returned */
+      nactive = epoll_wait (
+         async->epoll_fd, async->ready, nstreams, (int) poll_timeout_msec);
+
+      for (i = 0; i < nactive; i++) {
+         acmd = (mongoc_async_cmd_t *) async->ready[i].data.ptr;
 
+         (void) _mongoc_async_cmd_handle_revents (
+            acmd,
+            acmd->watched_events,
+            _mongoc_async_epoll_to_poll (async->ready[i].events));
+      }
+#endif
+   } else if (nstreams > 0) {
+      nstreams = 0;
+      DL_FOREACH (async->cmds, acmd)
+      {
          if (acmd->stream) {
-            acmds_polled[nstreams] = acmd;
-            poller[nstreams].stream = acmd->stream;
-            poller[nstreams].events = acmd->events;
-            poller[nstreams].revents = 0;
-            expire_at = BSON_MIN (
-               expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
+            async->acmds_polled[nstreams] = acmd;
+            async->poller[nstreams].stream = acmd->stream;
+            async->poller[nstreams].events = acmd->events;
+            async->poller[nstreams].revents = 0;
             ++nstreams;
          }
       }
 
-      if (async->ncmds == 0) {
-         /* all cmds failed to initiate and removed themselves. */
-         break;
+      /* we need at least one stream to poll. */
+      nactive = mongoc_stream_poll (
+         async->poller, nstreams, (int32_t) poll_timeout_msec);
+
+      for (i = 0; i < nstreams && nactive > 0; i++) {
+         if (_mongoc_async_cmd_handle_revents (async->acmds_polled[i],
+                                               async->poller[i].events,
+                                               async->poller[i].revents)) {
+            nactive--;
+         }
       }
+   } else {
+      /* currently this does not get hit. we always have at least one command
+       * initialized with a stream. */
+      _mongoc_usleep (poll_timeout_msec * 1000);
+   }
 
-      poll_timeout_msec = BSON_MAX (0, (expire_at - now) / 1000);
-      BSON_ASSERT (poll_timeout_msec < INT32_MAX);
+   /* the poll may have waited: expire against the time it returned */
+   _mongoc_async_expire (async, bson_get_monotonic_time ());
+}
 
-      if (nstreams > 0) {
-         /* we need at least one stream to poll. */
-         nactive =
-            mongoc_stream_poll (poller, nstreams, (int32_t) poll_timeout_msec);
-      } else {
-         /* currently this does not get hit. we always have at least one command
-          * initialized with a stream. */
-         _mongoc_usleep (poll_timeout_msec * 1000);
-      }
-
-      if (nactive > 0) {
-         for (i = 0; i < nstreams; i++) {
-            mongoc_async_cmd_t *iter = acmds_polled[i];
-            if (poller[i].revents & (POLLERR | POLLHUP)) {
-               int hup = poller[i].revents & POLLHUP;
-               if (iter->state == MONGOC_ASYNC_CMD_SEND) {
-                  bson_set_error (&iter->error,
-                                  MONGOC_ERROR_STREAM,
-                                  MONGOC_ERROR_STREAM_CONNECT,
-                                  hup ? "connection refused"
-                                      : "unknown connection error");
-               } else {
-                  bson_set_error (&iter->error,
-                                  MONGOC_ERROR_STREAM,
-                                  MONGOC_ERROR_STREAM_SOCKET,
-                                  hup ? "connection closed"
-                                      : "unknown socket error");
-               }
-
-               iter->state = MONGOC_ASYNC_CMD_ERROR_STATE;
-            }
 
-            if ((poller[i].revents & poller[i].events) ||
-                iter->state == MONGOC_ASYNC_CMD_ERROR_STATE) {
-               (void) mongoc_async_cmd_run (iter);
-               nactive--;
-            }
+/* fill @fds with the socket and events of each command waiting on a socket,
+ * and set @expire_at to the earliest command deadline (in microseconds) or
+ * INT64_MAX. returns the number of such commands, which may exceed @n_fds.
+ * commands not yet initiated, and those whose stream is not backed by a
+ * socket, are not reported. */
+size_t
+mongoc_async_get_fds (mongoc_async_t *async,
+                      mongoc_client_async_fd_t *fds,
+                      size_t n_fds,
+                      int64_t *expire_at)
+{
+   mongoc_async_cmd_t *acmd;
+   mongoc_socket_t *sock;
+   size_t n = 0;
 
-            if (!nactive) {
-               break;
-            }
-         }
+   *expire_at = INT64_MAX;
+
+   DL_FOREACH (async->cmds, acmd)
+   {
+      if (!acmd->stream) {
+         continue;
       }
 
-      DL_FOREACH_SAFE (async->cmds, acmd, tmp)
-      {
-         bool remove_cmd = false;
-         mongoc_async_cmd_result_t result;
-
-         /* check if an initiated cmd has passed the connection timeout.  */
-         if (acmd->state != MONGOC_ASYNC_CMD_INITIATE &&
-             now > acmd->connect_started + acmd->timeout_msec * 1000) {
-            bson_set_error (&acmd->error,
-                            MONGOC_ERROR_STREAM,
-                            MONGOC_ERROR_STREAM_CONNECT,
-                            acmd->state == MONGOC_ASYNC_CMD_SEND
-                               ? "connection timeout"
-                               : "socket timeout");
-
-            remove_cmd = true;
-            result = MONGOC_ASYNC_CMD_TIMEOUT;
-         } else if (acmd->state == MONGOC_ASYNC_CMD_CANCELED_STATE) {
-            remove_cmd = true;
-            result = MONGOC_ASYNC_CMD_ERROR;
+      *expire_at = BSON_MIN (
+         *expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
+
+      sock = _mongoc_async_cmd_get_socket (acmd);
+      if (!sock) {
+         continue;
+      }
+
+      if (n < n_fds) {
+         fds[n].fd = sock->sd;
+         fds[n].events = acmd->events;
+         fds[n].revents = 0;
+      }
+
+      n++;
+   }
+
+   return n;
+}
+
+
+/* run the commands whose sockets have readiness set in @fds, then expire the
+ * commands that timed out. like mongoc_async_run_once, but the caller waits
+ * for socket events. */
+void
+mongoc_async_step (mongoc_async_t *async,
+                   const mongoc_client_async_fd_t *fds,
+                   size_t n_fds)
+{
+   mongoc_async_cmd_t *acmd;
+   mongoc_socket_t *sock;
+   size_t nready = 0;
+   size_t i;
+
+   _mongoc_async_reserve (async);
+
+   /* find the ready commands first: running one may start another command on
+    * a new socket that reuses a descriptor reported in @fds */
+   DL_FOREACH (async->cmds, acmd)
+   {
+      if (!acmd->stream || !(sock = _mongoc_async_cmd_get_socket (acmd))) {
+         continue;
+      }
+
+      for (i = 0; i < n_fds; i++) {
+         if (fds[i].fd == sock->sd && fds[i].revents) {
+            async->acmds_polled[nready] = acmd;
+            async->poller[nready].events = acmd->events;
+            async->poller[nready].revents = fds[i].revents;
+            nready++;
+            break;
          }
+      }
+   }
+
+   for (i = 0; i < nready; i++) {
+      (void) _mongoc_async_cmd_handle_revents (async->acmds_polled[i],
+                                               async->poller[i].events,
+                                               async->poller[i].revents);
+   }
+
+   _mongoc_async_expire (async, bson_get_monotonic_time ());
+}
+
+
+/* fill @pollers with the stream and events of each command waiting on its
+ * stream, and set @expire_at to the earliest command deadline (in
+ * microseconds) or INT64_MAX. returns the number of such commands, which may
+ * exceed @n_pollers. like mongoc_async_get_fds, for callers that poll streams
+ * together with streams of their own. */
+size_t
+mongoc_async_get_pollers (mongoc_async_t *async,
+                          mongoc_stream_poll_t *pollers,
+                          size_t n_pollers,
+                          int64_t *expire_at)
+{
+   mongoc_async_cmd_t *acmd;
+   size_t n = 0;
+
+   *expire_at = INT64_MAX;
+
+   DL_FOREACH (async->cmds, acmd)
+   {
+      if (!acmd->stream) {
+         continue;
+      }
+
+      *expire_at = BSON_MIN (
+         *expire_at, acmd->connect_started + acmd->timeout_msec * 1000);
+
+      if (n < n_pollers) {
+         pollers[n].stream = acmd->stream;
+         pollers[n].events = acmd->events;
+         pollers[n].revents = 0;
+      }
+
+      n++;
+   }
 
-         if (remove_cmd) {
-            acmd->cb (acmd, result, NULL, (now - acmd->connect_started) / 1000);
+   return n;
+}
+
+
+/* run the commands whose streams have readiness set in @pollers, then expire
+ * the commands that timed out. like mongoc_async_step, for pollers filled by
+ * mongoc_async_get_pollers. */
+void
+mongoc_async_step_pollers (mongoc_async_t *async,
+                           const mongoc_stream_poll_t *pollers,
+                           size_t n_pollers)
+{
+   mongoc_async_cmd_t *acmd;
+   size_t nready = 0;
+   size_t i;
+
+   _mongoc_async_reserve (async);
 
-            /* Remove acmd from the async->cmds doubly-linked list */
-            mongoc_async_cmd_destroy (acmd);
+   /* find the ready commands first: running one may start another command on
+    * a new stream allocated where a stream reported in @pollers was */
+   DL_FOREACH (async->cmds, acmd)
+   {
+      if (!acmd->stream) {
+         continue;
+      }
+
+      for (i = 0; i < n_pollers; i++) {
+         if (pollers[i].stream == acmd->stream && pollers[i].revents) {
+            async->acmds_polled[nready] = acmd;
+            async->poller[nready].events = acmd->events;
+            async->poller[nready].revents = pollers[i].revents;
+            nready++;
+            break;
          }
       }
+   }
 
-      now = bson_get_monotonic_time ();
+   for (i = 0; i < nready; i++) {
+      (void) _mongoc_async_cmd_handle_revents (async->acmds_polled[i],
+                                               async->poller[i].events,
+                                               async->poller[i].revents);
    }
 
-   bson_free (poller);
-   bson_free (acmds_polled);
+   _mongoc_async_expire (async, bson_get_monotonic_time ());
 }
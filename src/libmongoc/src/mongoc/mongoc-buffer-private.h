@@ -64,6 +64,14 @@ _mongoc_buffer_try_append_from_stream (mongoc_buffer_t *buffer,
                                        size_t size,
                                        int32_t timeout_msec);
 
+bool
+_mongoc_buffer_append_from_read_ahead (mongoc_buffer_t *buffer,
+                                       mongoc_buffer_t *read_ahead,
+                                       mongoc_stream_t *stream,
+                                       size_t size,
+                                       int32_t timeout_msec,
+                                       bson_error_t *error);
+
 ssize_t
 _mongoc_buffer_fill (mongoc_buffer_t *buffer,
                      mongoc_stream_t *stream,
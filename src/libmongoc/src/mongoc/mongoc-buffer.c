@@ -30,6 +30,10 @@
 #define MONGOC_BUFFER_DEFAULT_SIZE 1024
 #endif
 
+#ifndef MONGOC_BUFFER_READ_AHEAD_SIZE
+#define MONGOC_BUFFER_READ_AHEAD_SIZE (16 * 1024)
+#endif
+
 
 #define SPACE_FOR(_b, _sz) \
    (((ssize_t) (_b)->datalen - (ssize_t) (_b)->len) >= (ssize_t) (_sz))
@@ -334,3 +338,89 @@ _mongoc_buffer_try_append_from_stream (mongoc_buffer_t *buffer,
 
    RETURN (ret);
 }
+
+
+/**
+ * _mongoc_buffer_append_from_read_ahead:
+ * @buffer; A mongoc_buffer_t.
+ * @read_ahead: A mongoc_buffer_t holding bytes read ahead from @stream, or
+ * NULL.
+ * @stream: The stream to read from.
+ * @size: The number of bytes to read.
+ * @timeout_msec: The number of milliseconds to wait or -1 for the default
+ * @error: A location for a bson_error_t, or NULL.
+ *
+ * Like _mongoc_buffer_append_from_stream, but takes the bytes from
+ * @read_ahead first. When it runs short, a single read fills @read_ahead with
+ * as many bytes as the stream has ready, so that a reply's header and body,
+ * or several replies in a row, are read with one system call. Bytes past
+ * @size are kept in @read_ahead for the next call. Reads of at least
+ * MONGOC_BUFFER_READ_AHEAD_SIZE go directly into @buffer.
+ *
+ * @read_ahead must be kept with its stream, and @stream must return as soon
+ * as it has read min_bytes, like socket and TLS streams do.
+ *
+ * Returns: true if successful; otherwise false and @error is set.
+ */
+bool
+_mongoc_buffer_append_from_read_ahead (mongoc_buffer_t *buffer,
+                                       mongoc_buffer_t *read_ahead,
+                                       mongoc_stream_t *stream,
+                                       size_t size,
+                                       int32_t timeout_msec,
+                                       bson_error_t *error)
+{
+   size_t n;
+   ssize_t ret;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (buffer);
+   BSON_ASSERT_PARAM (stream);
+   BSON_ASSERT (size);
+
+   if (!read_ahead) {
+      RETURN (_mongoc_buffer_append_from_stream (
+         buffer, stream, size, timeout_msec, error));
+   }
+
+   if (read_ahead->len < size) {
+      if (read_ahead->len) {
+         n = read_ahead->len;
+         _mongoc_buffer_append (buffer, read_ahead->data, n);
+         read_ahead->len = 0;
+         size -= n;
+      }
+
+      if (size >= MONGOC_BUFFER_READ_AHEAD_SIZE) {
+         RETURN (_mongoc_buffer_append_from_stream (
+            buffer, stream, size, timeout_msec, error));
+      }
+
+      if (read_ahead->datalen < MONGOC_BUFFER_READ_AHEAD_SIZE) {
+         read_ahead->datalen = MONGOC_BUFFER_READ_AHEAD_SIZE;
+         read_ahead->data = (uint8_t *) read_ahead->realloc_func (
+            read_ahead->data, read_ahead->datalen, read_ahead->realloc_data);
+      }
+
+      ret = mongoc_stream_read (
+         stream, read_ahead->data, read_ahead->datalen, size, timeout_msec);
+      if (ret < (ssize_t) size) {
+         bson_set_error (error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "Failed to read %" PRIu64
+                         " bytes: socket error or timeout",
+                         (uint64_t) size);
+         RETURN (false);
+      }
+
+      read_ahead->len = (size_t) ret;
+   }
+
+   _mongoc_buffer_append (buffer, read_ahead->data, size);
+   read_ahead->len -= size;
+   memmove (read_ahead->data, read_ahead->data + size, read_ahead->len);
+
+   RETURN (true);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_CLIENT_ASYNC_PRIVATE_H
+#define MONGOC_CLIENT_ASYNC_PRIVATE_H
+
+#include <bson/bson.h>
+
+#include "mongoc-async-private.h"
+#include "mongoc-client.h"
+#include "mongoc-cluster-private.h"
+#include "mongoc-cmd-private.h"
+#include "mongoc-server-stream-private.h"
+
+BSON_BEGIN_DECLS
+
+struct _mongoc_async_op_t;
+
+/* A connection used only by asynchronous commands. It is opened and
+ * authenticated like the cluster's own connections, and carries one command
+ * at a time. */
+typedef struct _mongoc_async_conn_t {
+   uint32_t server_id;
+   mongoc_cluster_node_t *node;
+   /* the command in flight, or NULL if the connection is idle */
+   struct _mongoc_async_op_t *op;
+   struct _mongoc_async_conn_t *next;
+   struct _mongoc_async_conn_t *prev;
+} mongoc_async_conn_t;
+
+typedef struct _mongoc_async_op_t {
+   mongoc_client_t *client;
+   char *db_name;
+   bson_t command;
+   mongoc_read_prefs_t *read_prefs;
+   uint32_t server_id;
+   mongoc_client_command_async_cb_t cb;
+   void *data;
+   /* set once the command is sent on a connection */
+   mongoc_async_conn_t *conn;
+   mongoc_server_stream_t *server_stream;
+   mongoc_cmd_parts_t parts;
+   /* for command monitoring events, set once the command is sent */
+   uint32_t request_id;
+   int64_t started;
+   bool is_redacted;
+   struct _mongoc_async_op_t *next;
+   struct _mongoc_async_op_t *prev;
+} mongoc_async_op_t;
+
+typedef struct _mongoc_client_async_t {
+   mongoc_client_t *client;
+   mongoc_async_t *async;
+   mongoc_async_conn_t *conns;
+   /* commands waiting for a connection, oldest first */
+   mongoc_async_op_t *queued;
+   /* commands queued or in flight */
+   size_t n_pending;
+   /* from maxPoolSize, the most connections opened to each server */
+   int32_t max_conns;
+} mongoc_client_async_t;
+
+
+void
+_mongoc_client_async_destroy (mongoc_client_async_t *client_async);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_CLIENT_ASYNC_PRIVATE_H */
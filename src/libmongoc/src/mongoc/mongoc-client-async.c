@@ -0,0 +1,603 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-apm-private.h"
+#include "mongoc-async-cmd-private.h"
+#include "mongoc-client-async-private.h"
+#include "mongoc-client-private.h"
+#include "mongoc-client-session-private.h"
+#include "mongoc-compression-private.h"
+#include "mongoc-error.h"
+#include "mongoc-read-prefs-private.h"
+#include "mongoc-rpc-private.h"
+#include "mongoc-server-description-private.h"
+#include "mongoc-topology-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "client-async"
+
+
+static bool
+_mongoc_client_async_send (mongoc_client_async_t *client_async,
+                           const mongoc_topology_description_t *td,
+                           mongoc_async_op_t *op,
+                           mongoc_async_conn_t *conn,
+                           bson_error_t *error);
+
+
+static mongoc_client_async_t *
+_mongoc_client_async_get (mongoc_client_t *client)
+{
+   mongoc_client_async_t *client_async;
+
+   if (client->async) {
+      return client->async;
+   }
+
+   client_async = bson_malloc0 (sizeof *client_async);
+   client_async->client = client;
+   client_async->async = mongoc_async_new ();
+   client_async->max_conns = BSON_MAX (
+      1,
+      mongoc_uri_get_option_as_int32 (
+         client->uri, MONGOC_URI_MAXPOOLSIZE, 100));
+
+   client->async = client_async;
+
+   return client_async;
+}
+
+
+static void
+_mongoc_async_conn_destroy (mongoc_client_async_t *client_async,
+                            mongoc_async_conn_t *conn)
+{
+   DL_DELETE (client_async->conns, conn);
+   _mongoc_cluster_node_destroy (conn->node);
+   bson_free (conn);
+}
+
+
+static void
+_mongoc_async_op_destroy (mongoc_async_op_t *op)
+{
+   if (op->server_stream) {
+      mongoc_cmd_parts_cleanup (&op->parts);
+      mongoc_server_stream_cleanup (op->server_stream);
+   }
+
+   bson_free (op->db_name);
+   bson_destroy (&op->command);
+   mongoc_read_prefs_destroy (op->read_prefs);
+   bson_free (op);
+}
+
+
+/* an idle connection to the op's server, or a new one if there are fewer than
+ * maxPoolSize. NULL with error unset if the op must wait for a connection. */
+static mongoc_async_conn_t *
+_mongoc_client_async_conn_for_op (mongoc_client_async_t *client_async,
+                                  const mongoc_topology_description_t *td,
+                                  mongoc_async_op_t *op,
+                                  bson_error_t *error)
+{
+   mongoc_async_conn_t *conn;
+   mongoc_async_conn_t *tmp;
+   mongoc_server_description_t *handshake_sd;
+   int32_t n_conns = 0;
+
+   DL_FOREACH_SAFE (client_async->conns, conn, tmp)
+   {
+      if (conn->server_id != op->server_id) {
+         continue;
+      }
+
+      handshake_sd = conn->node->handshake_sd;
+      if (!conn->op &&
+          handshake_sd->generation <
+             _mongoc_topology_get_connection_pool_generation (
+                td, op->server_id, &handshake_sd->service_id)) {
+         /* the pool for this server was cleared since the connection opened */
+         _mongoc_async_conn_destroy (client_async, conn);
+         continue;
+      }
+
+      if (!conn->op) {
+         return conn;
+      }
+
+      n_conns++;
+   }
+
+   if (n_conns >= client_async->max_conns) {
+      return NULL;
+   }
+
+   conn = bson_malloc0 (sizeof *conn);
+   conn->server_id = op->server_id;
+   conn->node = _mongoc_cluster_connect_node (
+      &client_async->client->cluster, td, op->server_id, error);
+
+   if (!conn->node) {
+      bson_free (conn);
+      return NULL;
+   }
+
+   DL_APPEND (client_async->conns, conn);
+
+   return conn;
+}
+
+
+static void
+_mongoc_client_async_send_queued (mongoc_client_async_t *client_async,
+                                  uint32_t server_id)
+{
+   mc_shared_tpld td = mc_tpld_take_ref (client_async->client->topology);
+   mongoc_async_conn_t *conn;
+   mongoc_async_op_t *op;
+   mongoc_async_op_t *tmp;
+   bson_error_t error;
+
+   DL_FOREACH_SAFE (client_async->queued, op, tmp)
+   {
+      if (op->server_id != server_id) {
+         continue;
+      }
+
+      memset (&error, 0, sizeof error);
+      conn =
+         _mongoc_client_async_conn_for_op (client_async, td.ptr, op, &error);
+      if (!conn && !error.code) {
+         /* every connection is busy again */
+         break;
+      }
+
+      DL_DELETE (client_async->queued, op);
+
+      if (!conn ||
+          !_mongoc_client_async_send (client_async, td.ptr, op, conn, &error)) {
+         client_async->n_pending--;
+         op->cb (op->client, NULL, &error, op->data);
+         _mongoc_async_op_destroy (op);
+      }
+   }
+
+   mc_tpld_drop_ref (&td);
+}
+
+
+/* publish a command started event for op, once it is sent */
+static void
+_mongoc_client_async_started (mongoc_async_op_t *op)
+{
+   mongoc_client_t *client = op->client;
+   mongoc_apm_command_started_t started_event;
+
+   op->started = bson_get_monotonic_time ();
+
+   if (!client->apm_callbacks.started) {
+      return;
+   }
+
+   mongoc_apm_command_started_init_with_cmd (&started_event,
+                                             &op->parts.assembled,
+                                             op->request_id,
+                                             &op->is_redacted,
+                                             client->apm_context);
+
+   client->apm_callbacks.started (&started_event);
+   mongoc_apm_command_started_cleanup (&started_event);
+}
+
+
+/* publish a command succeeded or failed event for op, as
+ * mongoc_cluster_run_command_monitored does */
+static void
+_mongoc_client_async_finished (mongoc_async_op_t *op,
+                               bool ok,
+                               const bson_t *reply,
+                               const bson_error_t *error)
+{
+   mongoc_client_t *client = op->client;
+   const mongoc_server_description_t *sd = op->server_stream->sd;
+   mongoc_apm_command_succeeded_t succeeded_event;
+   mongoc_apm_command_failed_t failed_event;
+   bson_t empty = BSON_INITIALIZER;
+   int64_t duration = bson_get_monotonic_time () - op->started;
+
+   if (ok && client->apm_callbacks.succeeded) {
+      mongoc_apm_command_succeeded_init (&succeeded_event,
+                                         duration,
+                                         reply,
+                                         op->parts.assembled.command_name,
+                                         op->request_id,
+                                         op->parts.assembled.operation_id,
+                                         &sd->host,
+                                         sd->id,
+                                         &sd->service_id,
+                                         op->is_redacted,
+                                         client->apm_context);
+
+      client->apm_callbacks.succeeded (&succeeded_event);
+      mongoc_apm_command_succeeded_cleanup (&succeeded_event);
+   }
+
+   if (!ok && client->apm_callbacks.failed) {
+      mongoc_apm_command_failed_init (&failed_event,
+                                      duration,
+                                      op->parts.assembled.command_name,
+                                      error,
+                                      reply ? reply : &empty,
+                                      op->request_id,
+                                      op->parts.assembled.operation_id,
+                                      &sd->host,
+                                      sd->id,
+                                      &sd->service_id,
+                                      op->is_redacted,
+                                      client->apm_context);
+
+      client->apm_callbacks.failed (&failed_event);
+      mongoc_apm_command_failed_cleanup (&failed_event);
+   }
+
+   bson_destroy (&empty);
+}
+
+
+static void
+_mongoc_client_async_cmd_cb (mongoc_async_cmd_t *acmd,
+                             mongoc_async_cmd_result_t result,
+                             const bson_t *reply,
+                             int64_t duration_usec)
+{
+   mongoc_async_op_t *op = (mongoc_async_op_t *) acmd->data;
+   mongoc_client_async_t *client_async = op->client->async;
+   mongoc_topology_t *topology = op->client->topology;
+   mongoc_async_conn_t *conn = op->conn;
+   const mongoc_server_description_t *sd;
+   bson_error_t error = {0};
+   uint32_t server_id;
+   bool close_conn = false;
+   bool ok = false;
+
+   if (result == MONGOC_ASYNC_CMD_CONNECTED ||
+       result == MONGOC_ASYNC_CMD_IN_PROGRESS) {
+      return;
+   }
+
+   sd = op->server_stream->sd;
+
+   if (result == MONGOC_ASYNC_CMD_SUCCESS) {
+      mongoc_server_load_record_op_time (op->server_stream->load,
+                                         duration_usec);
+      _mongoc_topology_update_cluster_time (topology, reply);
+      ok = _mongoc_cmd_check_ok (reply, op->client->error_api_version, &error);
+
+      if (op->parts.assembled.session) {
+         _mongoc_client_session_handle_reply (op->parts.assembled.session,
+                                              true,
+                                              op->parts.assembled.command_name,
+                                              reply);
+      }
+
+      close_conn =
+         _mongoc_topology_handle_app_error (topology,
+                                            sd->id,
+                                            true /* handshake complete */,
+                                            MONGOC_SDAM_APP_ERROR_COMMAND,
+                                            reply,
+                                            NULL,
+                                            sd->max_wire_version,
+                                            sd->generation,
+                                            &sd->service_id);
+   } else {
+      reply = NULL;
+      memcpy (&error, &acmd->error, sizeof error);
+      (void) _mongoc_topology_handle_app_error (
+         topology,
+         sd->id,
+         true /* handshake complete */,
+         result == MONGOC_ASYNC_CMD_TIMEOUT ? MONGOC_SDAM_APP_ERROR_TIMEOUT
+                                            : MONGOC_SDAM_APP_ERROR_NETWORK,
+         NULL,
+         &error,
+         sd->max_wire_version,
+         sd->generation,
+         &sd->service_id);
+      close_conn = true;
+   }
+
+   _mongoc_client_async_finished (op, ok, reply, &error);
+
+   conn->op = NULL;
+   op->conn = NULL;
+   if (close_conn) {
+      /* acmd is destroyed after this callback without using its stream */
+      _mongoc_async_conn_destroy (client_async, conn);
+   }
+
+   client_async->n_pending--;
+   op->cb (op->client, reply, ok ? NULL : &error, op->data);
+
+   server_id = op->server_id;
+   _mongoc_async_op_destroy (op);
+   _mongoc_client_async_send_queued (client_async, server_id);
+}
+
+
+/* assemble op's command for conn's server and start sending it */
+static bool
+_mongoc_client_async_send (mongoc_client_async_t *client_async,
+                           const mongoc_topology_description_t *td,
+                           mongoc_async_op_t *op,
+                           mongoc_async_conn_t *conn,
+                           bson_error_t *error)
+{
+   mongoc_client_t *client = client_async->client;
+   mongoc_async_cmd_t *acmd;
+   int32_t compressor_id = -1;
+   int32_t compression_level = -1;
+   int64_t timeout_msec;
+
+   if (conn->node->handshake_sd->max_wire_version < WIRE_VERSION_OP_MSG) {
+      bson_set_error (error,
+                      MONGOC_ERROR_PROTOCOL,
+                      MONGOC_ERROR_PROTOCOL_BAD_WIRE_VERSION,
+                      "Asynchronous commands require MongoDB 3.6 or later");
+      return false;
+   }
+
+   op->server_stream = _mongoc_cluster_create_server_stream (
+      td, conn->node->handshake_sd, conn->node->stream);
+   mongoc_cmd_parts_init (
+      &op->parts, client, op->db_name, MONGOC_QUERY_NONE, &op->command);
+   op->parts.read_prefs = op->read_prefs;
+
+   if (!mongoc_cmd_parts_assemble (&op->parts, op->server_stream, error)) {
+      mongoc_cmd_parts_cleanup (&op->parts);
+      mongoc_server_stream_cleanup (op->server_stream);
+      op->server_stream = NULL;
+      return false;
+   }
+
+   timeout_msec = client->cluster.sockettimeoutms;
+   if (timeout_msec == 0) {
+      timeout_msec = INT32_MAX;
+   }
+
+   if (mongoc_cmd_is_compressible (&op->parts.assembled)) {
+      compressor_id =
+         mongoc_server_description_compressor_id (conn->node->handshake_sd);
+      if (compressor_id == MONGOC_COMPRESSOR_ZLIB_ID) {
+         compression_level = mongoc_uri_get_option_as_int32 (
+            client->uri, MONGOC_URI_ZLIBCOMPRESSIONLEVEL, -1);
+      }
+   }
+
+   acmd = mongoc_async_cmd_new_opmsg (client_async->async,
+                                      conn->node->stream,
+                                      op->parts.assembled.command,
+                                      compressor_id,
+                                      compression_level,
+                                      _mongoc_client_async_cmd_cb,
+                                      op,
+                                      timeout_msec,
+                                      error);
+   if (!acmd) {
+      mongoc_cmd_parts_cleanup (&op->parts);
+      mongoc_server_stream_cleanup (op->server_stream);
+      op->server_stream = NULL;
+      return false;
+   }
+
+   conn->op = op;
+   op->conn = conn;
+   op->request_id = BSON_UINT32_FROM_LE (acmd->rpc.header.request_id);
+   _mongoc_client_async_started (op);
+
+   return true;
+}
+
+
+bool
+mongoc_client_command_simple_async (mongoc_client_t *client,
+                                    const char *db_name,
+                                    const bson_t *command,
+                                    const mongoc_read_prefs_t *read_prefs,
+                                    mongoc_client_command_async_cb_t cb,
+                                    void *data,
+                                    bson_error_t *error)
+{
+   mongoc_client_async_t *client_async;
+   mongoc_async_conn_t *conn;
+   mongoc_async_op_t *op;
+   mc_shared_tpld td;
+   bson_error_t error_local;
+   uint32_t server_id;
+   bool ret = false;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (client);
+   BSON_ASSERT_PARAM (db_name);
+   BSON_ASSERT_PARAM (command);
+   BSON_ASSERT_PARAM (cb);
+
+   if (!error) {
+      error = &error_local;
+   }
+
+   memset (error, 0, sizeof *error);
+
+   if (!_mongoc_read_prefs_validate (read_prefs, error)) {
+      RETURN (false);
+   }
+
+   server_id = mongoc_topology_select_server_id (
+      client->topology, MONGOC_SS_READ, read_prefs, error);
+   if (!server_id) {
+      RETURN (false);
+   }
+
+   client_async = _mongoc_client_async_get (client);
+
+   op = bson_malloc0 (sizeof *op);
+   op->client = client;
+   op->db_name = bson_strdup (db_name);
+   bson_copy_to (command, &op->command);
+   op->read_prefs = mongoc_read_prefs_copy (read_prefs);
+   op->server_id = server_id;
+   op->cb = cb;
+   op->data = data;
+
+   td = mc_tpld_take_ref (client->topology);
+   conn = _mongoc_client_async_conn_for_op (client_async, td.ptr, op, error);
+   if (conn) {
+      ret = _mongoc_client_async_send (client_async, td.ptr, op, conn, error);
+   } else if (!error->code) {
+      /* every connection to the server is busy */
+      DL_APPEND (client_async->queued, op);
+      ret = true;
+   }
+
+   mc_tpld_drop_ref (&td);
+
+   if (!ret) {
+      _mongoc_async_op_destroy (op);
+      RETURN (false);
+   }
+
+   client_async->n_pending++;
+
+   RETURN (true);
+}
+
+
+size_t
+mongoc_client_run_async (mongoc_client_t *client, int32_t timeout_msec)
+{
+   mongoc_client_async_t *client_async;
+   int64_t expire_at = INT64_MAX;
+
+   BSON_ASSERT_PARAM (client);
+
+   client_async = client->async;
+   if (!client_async) {
+      return 0;
+   }
+
+   if (timeout_msec >= 0) {
+      expire_at =
+         bson_get_monotonic_time () + (int64_t) timeout_msec * 1000;
+   }
+
+   /* queued commands always wait behind one in flight */
+   while (client_async->async->ncmds > 0) {
+      mongoc_async_run_once (client_async->async, expire_at);
+
+      if (bson_get_monotonic_time () >= expire_at) {
+         break;
+      }
+   }
+
+   return client_async->n_pending;
+}
+
+
+size_t
+mongoc_client_async_get_fds (mongoc_client_t *client,
+                             mongoc_client_async_fd_t *fds,
+                             size_t n_fds,
+                             int32_t *timeout_msec)
+{
+   int64_t expire_at;
+   int64_t now;
+   size_t n;
+
+   BSON_ASSERT_PARAM (client);
+   BSON_ASSERT (fds || n_fds == 0);
+   BSON_ASSERT_PARAM (timeout_msec);
+
+   *timeout_msec = -1;
+
+   if (!client->async) {
+      return 0;
+   }
+
+   n = mongoc_async_get_fds (client->async->async, fds, n_fds, &expire_at);
+
+   if (expire_at != INT64_MAX) {
+      /* round up, so the commands have expired when the timer fires */
+      now = bson_get_monotonic_time ();
+      *timeout_msec = (int32_t) BSON_MIN (
+         BSON_MAX (0, (expire_at - now) / 1000 + 1), INT32_MAX);
+   }
+
+   return n;
+}
+
+
+size_t
+mongoc_client_async_step (mongoc_client_t *client,
+                          const mongoc_client_async_fd_t *fds,
+                          size_t n_fds)
+{
+   BSON_ASSERT_PARAM (client);
+   BSON_ASSERT (fds || n_fds == 0);
+
+   if (!client->async) {
+      return 0;
+   }
+
+   mongoc_async_step (client->async->async, fds, n_fds);
+
+   return client->async->n_pending;
+}
+
+
+void
+_mongoc_client_async_destroy (mongoc_client_async_t *client_async)
+{
+   mongoc_async_conn_t *conn, *conn_tmp;
+   mongoc_async_op_t *op, *op_tmp;
+
+   if (!client_async) {
+      return;
+   }
+
+   /* abandon commands still in flight or queued, without calling back */
+   mongoc_async_destroy (client_async->async);
+
+   DL_FOREACH_SAFE (client_async->conns, conn, conn_tmp)
+   {
+      if (conn->op) {
+         _mongoc_async_op_destroy (conn->op);
+      }
+
+      _mongoc_async_conn_destroy (client_async, conn);
+   }
+
+   DL_FOREACH_SAFE (client_async->queued, op, op_tmp)
+   {
+      DL_DELETE (client_async->queued, op);
+      _mongoc_async_op_destroy (op);
+   }
+
+   bson_free (client_async);
+}
@@ -23,24 +23,103 @@
 #include "mongoc-client-private.h"
 #include "mongoc-client-side-encryption-private.h"
 #include "mongoc-queue-private.h"
+#include "mongoc-server-stream-private.h"
+#include "mongoc-stream-mux-private.h"
 #include "mongoc-thread-private.h"
 #include "mongoc-topology-private.h"
 #include "mongoc-topology-background-monitoring-private.h"
 #include "mongoc-trace-private.h"
+#include "mongoc-uri-private.h"
 
 #ifdef MONGOC_ENABLE_SSL
 #include "mongoc-ssl-private.h"
 #endif
 
+/* the most clients that can be pushed and popped without the mutex; any
+ * more are kept in the queue */
+#define MONGOC_CLIENT_POOL_MAX_NODES 1024
+#define MONGOC_CLIENT_POOL_NO_NODE 0xffffffffu
+/* the least time between prunings, however short maxIdleTimeMS or
+ * maxConnectionLifeTimeMS; connections may be closed this much late */
+#define MONGOC_CLIENT_POOL_MIN_MAINTENANCE_INTERVAL_MS 100
+
+typedef struct {
+   mongoc_client_t *client;
+   int32_t next; /* index of the next node in its list */
+} mongoc_client_pool_node_t;
+
+/* a client kept for the threads whose numbers map to this slot, padded to a
+ * cache line so that threads do not contend on each other's slots */
+typedef struct {
+   void *client;
+   char padding[64 - sizeof (void *)];
+} mongoc_client_pool_affine_slot_t;
+
+/* a topology shared by the pools for the same cluster that opted in with
+ * mongoc_client_pool_share_topology, so that servers are monitored once */
+typedef struct _mongoc_client_pool_shared_topology_t {
+   /* describes the URI and every option that configures the topology,
+    * except secrets, which are compared with the topology's own */
+   char *key;
+   mongoc_topology_t *topology;
+#ifdef MONGOC_ENABLE_SSL
+   /* the scanner's TLS options, which must outlive the pool that created
+    * the topology */
+   mongoc_ssl_opt_t ssl_opts;
+#endif
+   /* the pools sharing the topology; held while maintaining them, so that a
+    * pool leaving waits for the maintenance thread to be done with it */
+   bson_mutex_t pools_mtx;
+   mongoc_array_t pools;
+   struct _mongoc_client_pool_shared_topology_t *next;
+} mongoc_client_pool_shared_topology_t;
+
+static bson_once_t gSharedTopologiesOnce = BSON_ONCE_INIT;
+static bson_mutex_t gSharedTopologiesMutex;
+static mongoc_client_pool_shared_topology_t *gSharedTopologies;
+
+/* each thread that uses a pool with thread affinity is numbered on first use,
+ * and the number is kept in thread-local storage */
+static bson_once_t gThreadNumberOnce = BSON_ONCE_INIT;
+#if defined(BSON_OS_UNIX)
+static pthread_key_t gThreadNumberKey;
+#else
+static DWORD gThreadNumberKey;
+#endif
+static int32_t gNextThreadNumber;
+
 struct _mongoc_client_pool_t {
    bson_mutex_t mutex;
    mongoc_cond_t cond;
    mongoc_queue_t queue;
+   /* Two lock-free LIFO lists over a fixed array of nodes: one of nodes
+    * holding pushed clients, one of unused nodes. Each head packs the index
+    * of its first node with a counter bumped on every update, so a node
+    * popped and pushed back between a read and a compare-exchange cannot be
+    * mistaken for an unchanged head. */
+   mongoc_client_pool_node_t *nodes;
+   uint32_t n_nodes;
+   int64_t clients_head;
+   int64_t free_head;
+   int32_t n_fast_clients;
+   /* threads in the slow path of mongoc_client_pool_pop, which a lock-free
+    * push must wake */
+   int32_t n_waiters;
+   /* with thread affinity enabled, each thread pushes its client to a slot
+    * of its own and pops it back from there; clients left idle in slots are
+    * taken back when the pool is exhausted */
+   int32_t thread_affinity;
+   mongoc_client_pool_affine_slot_t *affine_slots;
    mongoc_topology_t *topology;
    mongoc_uri_t *uri;
    uint32_t min_pool_size;
    uint32_t max_pool_size;
    uint32_t size;
+   /* number of clients kept connected to every server in the background */
+   uint32_t warm_size;
+   /* whether maxIdleTimeMS or maxConnectionLifeTimeMS is set, so that
+    * connections of idle clients are pruned in the background */
+   bool prune;
 #ifdef MONGOC_ENABLE_SSL
    bool ssl_opts_set;
    mongoc_ssl_opt_t ssl_opts;
@@ -52,14 +131,229 @@ struct _mongoc_client_pool_t {
    bool error_api_set;
    mongoc_server_api_t *api;
    bool client_initialized;
+   /* set if the topology is shared with other pools */
+   mongoc_client_pool_shared_topology_t *shared_topology;
+   /* set if clients share connections to each server */
+   mongoc_mux_t *mux;
 };
 
 
+static uint32_t
+_node_list_first (int64_t head)
+{
+   return (uint32_t) ((uint64_t) head & 0xffffffffu);
+}
+
+
+/* a new head for a list whose head was @old, with @first as its first node */
+static int64_t
+_node_list_head (int64_t old, uint32_t first)
+{
+   return (int64_t) (((((uint64_t) old >> 32) + 1) << 32) | first);
+}
+
+
+static uint32_t
+_node_list_pop (mongoc_client_pool_t *pool, int64_t *head)
+{
+   int64_t old;
+   int64_t prev;
+   uint32_t first;
+   int32_t next;
+
+   old = bson_atomic_int64_fetch (head, bson_memory_order_acquire);
+
+   for (;;) {
+      first = _node_list_first (old);
+      if (first == MONGOC_CLIENT_POOL_NO_NODE) {
+         return first;
+      }
+
+      /* the node may be popped and reused meanwhile; the compare-exchange
+       * then fails since the head's counter has moved on */
+      next = bson_atomic_int32_fetch (&pool->nodes[first].next,
+                                      bson_memory_order_relaxed);
+      prev = bson_atomic_int64_compare_exchange_strong (
+         head,
+         old,
+         _node_list_head (old, (uint32_t) next),
+         bson_memory_order_seq_cst);
+
+      if (prev == old) {
+         return first;
+      }
+
+      old = prev;
+   }
+}
+
+
+static void
+_node_list_push (mongoc_client_pool_t *pool, int64_t *head, uint32_t node)
+{
+   int64_t old;
+   int64_t prev;
+
+   old = bson_atomic_int64_fetch (head, bson_memory_order_relaxed);
+
+   for (;;) {
+      bson_atomic_int32_exchange (&pool->nodes[node].next,
+                                  (int32_t) _node_list_first (old),
+                                  bson_memory_order_relaxed);
+      prev = bson_atomic_int64_compare_exchange_strong (
+         head, old, _node_list_head (old, node), bson_memory_order_seq_cst);
+
+      if (prev == old) {
+         return;
+      }
+
+      old = prev;
+   }
+}
+
+
+static void
+_mongoc_client_pool_nodes_init (mongoc_client_pool_t *pool)
+{
+   uint32_t i;
+
+   pool->n_nodes =
+      BSON_MIN (pool->max_pool_size, MONGOC_CLIENT_POOL_MAX_NODES);
+   pool->nodes = bson_malloc0 (pool->n_nodes * sizeof *pool->nodes);
+   pool->affine_slots =
+      bson_malloc0 (pool->n_nodes * sizeof *pool->affine_slots);
+   pool->free_head = MONGOC_CLIENT_POOL_NO_NODE;
+
+   for (i = 0; i < pool->n_nodes; i++) {
+      _node_list_push (pool, &pool->free_head, i);
+   }
+}
+
+
+/* pop the most recently pushed client without taking the mutex */
+static mongoc_client_t *
+_mongoc_client_pool_fast_pop (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+   uint32_t node;
+
+   node = _node_list_pop (pool, &pool->clients_head);
+   if (node == MONGOC_CLIENT_POOL_NO_NODE) {
+      return NULL;
+   }
+
+   client = pool->nodes[node].client;
+   _node_list_push (pool, &pool->free_head, node);
+   bson_atomic_int32_fetch_sub (
+      &pool->n_fast_clients, 1, bson_memory_order_relaxed);
+
+   return client;
+}
+
+
+/* push a client without taking the mutex, unless all nodes are in use */
+static bool
+_mongoc_client_pool_fast_push (mongoc_client_pool_t *pool,
+                               mongoc_client_t *client)
+{
+   uint32_t node;
+
+   node = _node_list_pop (pool, &pool->free_head);
+   if (node == MONGOC_CLIENT_POOL_NO_NODE) {
+      return false;
+   }
+
+   pool->nodes[node].client = client;
+   bson_atomic_int32_fetch_add (
+      &pool->n_fast_clients, 1, bson_memory_order_relaxed);
+   _node_list_push (pool, &pool->clients_head, node);
+
+   return true;
+}
+
+
+static void
+_thread_number_init (void)
+{
+#if defined(BSON_OS_UNIX)
+   BSON_ASSERT (pthread_key_create (&gThreadNumberKey, NULL) == 0);
+#else
+   gThreadNumberKey = TlsAlloc ();
+   BSON_ASSERT (gThreadNumberKey != TLS_OUT_OF_INDEXES);
+#endif
+}
+
+
+/* threads are numbered consecutively, so that up to n_nodes threads each have
+ * a slot of their own rather than one picked by hashing their ids */
+static uint32_t
+_current_thread_number (void)
+{
+   void *value;
+
+   bson_once (&gThreadNumberOnce, _thread_number_init);
+
+#if defined(BSON_OS_UNIX)
+   value = pthread_getspecific (gThreadNumberKey);
+#else
+   value = TlsGetValue (gThreadNumberKey);
+#endif
+
+   if (!value) {
+      /* store the number plus one, since NULL means unnumbered */
+      value = (void *) ((uintptr_t) (uint32_t) bson_atomic_int32_fetch_add (
+                           &gNextThreadNumber, 1, bson_memory_order_relaxed) +
+                        1u);
+#if defined(BSON_OS_UNIX)
+      pthread_setspecific (gThreadNumberKey, value);
+#else
+      TlsSetValue (gThreadNumberKey, value);
+#endif
+   }
+
+   return (uint32_t) ((uintptr_t) value - 1u);
+}
+
+
+static void *volatile *
+_mongoc_client_pool_affine_slot (mongoc_client_pool_t *pool)
+{
+   return &pool->affine_slots[_current_thread_number () % pool->n_nodes]
+              .client;
+}
+
+
+/* take any client left idle in a thread's slot */
+static mongoc_client_t *
+_mongoc_client_pool_steal_affine (mongoc_client_pool_t *pool)
+{
+   void *client;
+   uint32_t i;
+
+   for (i = 0; i < pool->n_nodes; i++) {
+      if (bson_atomic_ptr_fetch (&pool->affine_slots[i].client,
+                                 bson_memory_order_relaxed) &&
+          (client = bson_atomic_ptr_exchange (&pool->affine_slots[i].client,
+                                              NULL,
+                                              bson_memory_order_seq_cst))) {
+         return (mongoc_client_t *) client;
+      }
+   }
+
+   return NULL;
+}
+
+
 #ifdef MONGOC_ENABLE_SSL
 void
 mongoc_client_pool_set_ssl_opts (mongoc_client_pool_t *pool,
                                  const mongoc_ssl_opt_t *opts)
 {
+   if (pool->shared_topology) {
+      MONGOC_ERROR ("Cannot set TLS options of a pool sharing its topology");
+      return;
+   }
+
    bson_mutex_lock (&pool->mutex);
 
    _mongoc_ssl_opts_cleanup (&pool->ssl_opts,
@@ -96,6 +390,19 @@ _mongoc_client_pool_set_internal_tls_opts (
 #endif
 
 
+static void
+_mongoc_client_pool_maintain (void *pool_void);
+
+
+static mongoc_client_pool_shared_topology_t *
+_mongoc_client_pool_unshare_topology (mongoc_client_pool_t *pool);
+
+
+static void
+_mongoc_client_pool_shared_topology_destroy (
+   mongoc_client_pool_shared_topology_t *shared);
+
+
 mongoc_client_pool_t *
 mongoc_client_pool_new (const mongoc_uri_t *uri)
 {
@@ -104,6 +411,8 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
    const bson_t *b;
    bson_iter_t iter;
    const char *appname;
+   int32_t max_idle_time_ms;
+   int32_t max_life_time_ms;
 
 
    ENTRY;
@@ -126,6 +435,7 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
    pool->min_pool_size = 0;
    pool->max_pool_size = 100;
    pool->size = 0;
+   pool->clients_head = MONGOC_CLIENT_POOL_NO_NODE;
 
    topology = mongoc_topology_new (uri, false);
    pool->topology = topology;
@@ -150,6 +460,25 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
       }
    }
 
+   _mongoc_client_pool_nodes_init (pool);
+
+   max_idle_time_ms =
+      mongoc_uri_get_option_as_int32 (pool->uri, MONGOC_URI_MAXIDLETIMEMS, 0);
+   max_life_time_ms = mongoc_uri_get_option_as_int32 (
+      pool->uri, MONGOC_URI_MAXCONNECTIONLIFETIMEMS, 0);
+   if (max_idle_time_ms > 0 || max_life_time_ms > 0) {
+      pool->prune = true;
+      pool->topology->maintenance_cb = _mongoc_client_pool_maintain;
+      pool->topology->maintenance_ctx = pool;
+      /* check often enough that connections are closed soon after they
+       * expire, rather than up to a heartbeat later */
+      pool->topology->maintenance_interval_msec = BSON_MAX (
+         MONGOC_CLIENT_POOL_MIN_MAINTENANCE_INTERVAL_MS,
+         BSON_MIN (max_idle_time_ms > 0 ? max_idle_time_ms : INT32_MAX,
+                   max_life_time_ms > 0 ? max_life_time_ms : INT32_MAX) /
+            2);
+   }
+
    appname =
       mongoc_uri_get_option_as_utf8 (pool->uri, MONGOC_URI_APPNAME, NULL);
    if (appname) {
@@ -177,6 +506,8 @@ mongoc_client_pool_new (const mongoc_uri_t *uri)
 void
 mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
 {
+   mongoc_client_pool_shared_topology_t *shared = NULL;
+   bool owns_topology = true;
    mongoc_client_t *client;
 
    ENTRY;
@@ -185,18 +516,42 @@ mongoc_client_pool_destroy (mongoc_client_pool_t *pool)
       EXIT;
    }
 
-   if (!mongoc_server_session_pool_is_empty (pool->topology->session_pool)) {
+   if (pool->shared_topology) {
+      /* the topology is left to the other pools sharing it, if any */
+      shared = _mongoc_client_pool_unshare_topology (pool);
+      owns_topology = shared != NULL;
+   }
+
+   if (owns_topology &&
+       !mongoc_server_session_pool_is_empty (pool->topology->session_pool)) {
       client = mongoc_client_pool_pop (pool);
       _mongoc_client_end_sessions (client);
       mongoc_client_pool_push (pool, client);
    }
 
+   /* stop the warming thread before destroying the clients it may hold */
+   if (owns_topology) {
+      _mongoc_topology_background_monitoring_stop (pool->topology);
+   }
+
+   while ((client = _mongoc_client_pool_steal_affine (pool)) ||
+          (client = _mongoc_client_pool_fast_pop (pool))) {
+      mongoc_client_destroy (client);
+   }
+
    while (
       (client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
       mongoc_client_destroy (client);
    }
 
-   mongoc_topology_destroy (pool->topology);
+   /* after the clients, whose streams hold the shared connections */
+   _mongoc_mux_destroy (pool->mux);
+   bson_free (pool->nodes);
+   bson_free (pool->affine_slots);
+   if (owns_topology) {
+      mongoc_topology_destroy (pool->topology);
+   }
+   _mongoc_client_pool_shared_topology_destroy (shared);
 
    mongoc_uri_destroy (pool->uri);
    bson_mutex_destroy (&pool->mutex);
@@ -241,6 +596,7 @@ _initialize_new_client (mongoc_client_pool_t *pool, mongoc_client_t *client)
 
    pool->client_initialized = true;
    client->is_pooled = true;
+   client->mux = pool->mux;
    client->error_api_version = pool->error_api_version;
    _mongoc_client_set_apm_callbacks_private (
       client, &pool->apm_callbacks, pool->apm_context);
@@ -267,6 +623,19 @@ mongoc_client_pool_pop (mongoc_client_pool_t *pool)
 
    BSON_ASSERT (pool);
 
+   if (bson_atomic_int32_fetch (&pool->thread_affinity,
+                                bson_memory_order_relaxed) &&
+       (client = bson_atomic_ptr_exchange (
+           _mongoc_client_pool_affine_slot (pool),
+           NULL,
+           bson_memory_order_seq_cst))) {
+      RETURN (client);
+   }
+
+   if ((client = _mongoc_client_pool_fast_pop (pool))) {
+      RETURN (client);
+   }
+
    wait_queue_timeout_ms = mongoc_uri_get_option_as_int32 (
       pool->uri, MONGOC_URI_WAITQUEUETIMEOUTMS, -1);
    if (wait_queue_timeout_ms > 0) {
@@ -275,12 +644,19 @@ mongoc_client_pool_pop (mongoc_client_pool_t *pool)
    }
    bson_mutex_lock (&pool->mutex);
 
+   /* announce this thread before checking for clients again, so a push that
+    * misses the check sees the announcement and signals the condition */
+   bson_atomic_int32_fetch_add (&pool->n_waiters, 1, bson_memory_order_seq_cst);
+
 again:
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
+   if (!(client = _mongoc_client_pool_fast_pop (pool)) &&
+       !(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
       if (pool->size < pool->max_pool_size) {
          client = _mongoc_client_new_from_uri (pool->topology);
          _initialize_new_client (pool, client);
          pool->size++;
+      } else if ((client = _mongoc_client_pool_steal_affine (pool))) {
+         /* the pool is exhausted, but another thread's client was idle */
       } else {
          if (wait_queue_timeout_ms > 0) {
             now_ms = bson_get_monotonic_time () / 1000;
@@ -302,6 +678,7 @@ again:
 
    _start_scanner_if_needed (pool);
 done:
+   bson_atomic_int32_fetch_sub (&pool->n_waiters, 1, bson_memory_order_seq_cst);
    bson_mutex_unlock (&pool->mutex);
 
    RETURN (client);
@@ -317,13 +694,30 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 
    BSON_ASSERT (pool);
 
+   if (bson_atomic_int32_fetch (&pool->thread_affinity,
+                                bson_memory_order_relaxed) &&
+       (client = bson_atomic_ptr_exchange (
+           _mongoc_client_pool_affine_slot (pool),
+           NULL,
+           bson_memory_order_seq_cst))) {
+      RETURN (client);
+   }
+
+   if ((client = _mongoc_client_pool_fast_pop (pool))) {
+      RETURN (client);
+   }
+
    bson_mutex_lock (&pool->mutex);
 
-   if (!(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
+   /* pruning may have emptied the list while it held the mutex */
+   if (!(client = _mongoc_client_pool_fast_pop (pool)) &&
+       !(client = (mongoc_client_t *) _mongoc_queue_pop_head (&pool->queue))) {
       if (pool->size < pool->max_pool_size) {
          client = _mongoc_client_new_from_uri (pool->topology);
          _initialize_new_client (pool, client);
          pool->size++;
+      } else {
+         client = _mongoc_client_pool_steal_affine (pool);
       }
    }
 
@@ -336,13 +730,24 @@ mongoc_client_pool_try_pop (mongoc_client_pool_t *pool)
 }
 
 
-void
-mongoc_client_pool_push (mongoc_client_pool_t *pool, mongoc_client_t *client)
+static void
+_mongoc_client_pool_push_shared (mongoc_client_pool_t *pool,
+                                 mongoc_client_t *client)
 {
    ENTRY;
 
-   BSON_ASSERT (pool);
-   BSON_ASSERT (client);
+   /* the deprecated minPoolSize trims the queue on push, which needs the
+    * mutex */
+   if (!pool->min_pool_size && _mongoc_client_pool_fast_push (pool, client)) {
+      if (bson_atomic_int32_fetch (&pool->n_waiters,
+                                   bson_memory_order_seq_cst)) {
+         bson_mutex_lock (&pool->mutex);
+         mongoc_cond_signal (&pool->cond);
+         bson_mutex_unlock (&pool->mutex);
+      }
+
+      EXIT;
+   }
 
    bson_mutex_lock (&pool->mutex);
    _mongoc_queue_push_head (&pool->queue, client);
@@ -363,6 +768,657 @@ mongoc_client_pool_push (mongoc_client_pool_t *pool, mongoc_client_t *client)
    EXIT;
 }
 
+
+void
+mongoc_client_pool_push (mongoc_client_pool_t *pool, mongoc_client_t *client)
+{
+   ENTRY;
+
+   BSON_ASSERT (pool);
+   BSON_ASSERT (client);
+
+   /* keep the client for this thread, unless another thread is waiting */
+   if (bson_atomic_int32_fetch (&pool->thread_affinity,
+                                bson_memory_order_relaxed) &&
+       !bson_atomic_int32_fetch (&pool->n_waiters,
+                                 bson_memory_order_seq_cst) &&
+       !bson_atomic_ptr_compare_exchange_strong (
+          _mongoc_client_pool_affine_slot (pool),
+          NULL,
+          client,
+          bson_memory_order_seq_cst)) {
+      /* a waiter may have arrived after the check above, and missed the
+       * client while stealing from the slots */
+      if (bson_atomic_int32_fetch (&pool->n_waiters,
+                                   bson_memory_order_seq_cst)) {
+         bson_mutex_lock (&pool->mutex);
+         mongoc_cond_signal (&pool->cond);
+         bson_mutex_unlock (&pool->mutex);
+      }
+
+      EXIT;
+   }
+
+   _mongoc_client_pool_push_shared (pool, client);
+
+   EXIT;
+}
+
+
+/* servers worth connecting to before the application needs them */
+static bool
+_server_is_warmable (const mongoc_server_description_t *sd)
+{
+   switch (sd->type) {
+   case MONGOC_SERVER_STANDALONE:
+   case MONGOC_SERVER_MONGOS:
+   case MONGOC_SERVER_RS_PRIMARY:
+   case MONGOC_SERVER_RS_SECONDARY:
+   case MONGOC_SERVER_LOAD_BALANCER:
+      return true;
+   case MONGOC_SERVER_UNKNOWN:
+   case MONGOC_SERVER_POSSIBLE_PRIMARY:
+   case MONGOC_SERVER_RS_ARBITER:
+   case MONGOC_SERVER_RS_OTHER:
+   case MONGOC_SERVER_RS_GHOST:
+   case MONGOC_SERVER_DESCRIPTION_TYPES:
+   default:
+      return false;
+   }
+}
+
+
+/* whether pruning @client now could close one of its connections */
+static bool
+_client_is_prune_due (mongoc_client_t *client, int64_t now)
+{
+   return client->cluster.prune_at <= now;
+}
+
+
+/* Close the expired connections of idle clients. Only clients that may have
+ * an expired connection, going by their previous pruning, are taken from the
+ * pool; the rest stay available. Clients in the queue are checked in place.
+ * Clients in the lock-free list cannot be, so the list is emptied and refilled
+ * in one critical section, with no I/O, which pops wait for. Each pruned
+ * client is held only while its own connections are closed, and then goes to
+ * the tail of the queue. */
+static void
+_mongoc_client_pool_prune (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t **clients;
+   mongoc_client_t **due;
+   mongoc_client_t *client;
+   mongoc_queue_item_t *item;
+   uint32_t n_clients = 0;
+   uint32_t n_due = 0;
+   uint32_t i;
+   int64_t now;
+   void *kept;
+
+   now = bson_get_monotonic_time ();
+
+   bson_mutex_lock (&pool->mutex);
+   clients = bson_malloc ((pool->size + 1) * sizeof (mongoc_client_t *));
+   due = bson_malloc ((pool->size + 1) * sizeof (mongoc_client_t *));
+
+   while (n_clients < pool->size &&
+          (client = _mongoc_client_pool_fast_pop (pool))) {
+      if (_client_is_prune_due (client, now)) {
+         due[n_due++] = client;
+      } else {
+         clients[n_clients++] = client;
+      }
+   }
+
+   /* restore the list's order, most recently pushed on top */
+   for (i = n_clients; i > 0; i--) {
+      if (!_mongoc_client_pool_fast_push (pool, clients[i - 1])) {
+         _mongoc_queue_push_head (&pool->queue, clients[i - 1]);
+      }
+   }
+
+   for (item = pool->queue.head; item && n_due < pool->size;) {
+      client = (mongoc_client_t *) item->data;
+      item = item->next;
+      if (_client_is_prune_due (client, now)) {
+         BSON_ASSERT (_mongoc_queue_remove (&pool->queue, client));
+         due[n_due++] = client;
+      }
+   }
+   bson_mutex_unlock (&pool->mutex);
+
+   for (i = 0; i < n_due; i++) {
+      mongoc_cluster_prune_nodes (&due[i]->cluster);
+
+      bson_mutex_lock (&pool->mutex);
+      _mongoc_queue_push_tail (&pool->queue, due[i]);
+      mongoc_cond_signal (&pool->cond);
+      bson_mutex_unlock (&pool->mutex);
+   }
+
+   bson_free (due);
+   bson_free (clients);
+
+   for (i = 0; i < pool->n_nodes; i++) {
+      kept = bson_atomic_ptr_fetch (&pool->affine_slots[i].client,
+                                    bson_memory_order_seq_cst);
+      if (!kept ||
+          !_client_is_prune_due ((mongoc_client_t *) kept, now) ||
+          bson_atomic_ptr_compare_exchange_strong (
+             &pool->affine_slots[i].client,
+             kept,
+             NULL,
+             bson_memory_order_seq_cst) != kept) {
+         /* nothing to close yet, or the thread took its client back */
+         continue;
+      }
+
+      mongoc_cluster_prune_nodes (&((mongoc_client_t *) kept)->cluster);
+
+      /* give the client back to its thread, unless the thread pushed another
+       * client meanwhile or other threads are waiting */
+      if (bson_atomic_int32_fetch (&pool->n_waiters,
+                                   bson_memory_order_seq_cst) ||
+          bson_atomic_ptr_compare_exchange_strong (
+             &pool->affine_slots[i].client,
+             NULL,
+             kept,
+             bson_memory_order_seq_cst)) {
+         _mongoc_client_pool_push_shared (pool, (mongoc_client_t *) kept);
+      }
+   }
+}
+
+
+/* Connect idle clients to every available server, creating clients while
+ * the pool has fewer than warm_size. Clients are taken one at a time, so the
+ * others stay available, and each goes back to the tail of the queue, behind
+ * those not yet visited. Connections that are still current are reused;
+ * those closed by a pool clear are re-established. */
+static void
+_mongoc_client_pool_warm (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+   mongoc_server_stream_t *server_stream;
+   const mongoc_set_t *servers;
+   const mongoc_server_description_t *sd;
+   mc_shared_tpld td;
+   bson_error_t error;
+   uint32_t *server_ids;
+   int n_servers = 0;
+   uint32_t i;
+   int j;
+
+   td = mc_tpld_take_ref (pool->topology);
+   servers = mc_tpld_servers_const (td.ptr);
+   server_ids = bson_malloc ((servers->items_len + 1) * sizeof (uint32_t));
+
+   for (j = 0; j < servers->items_len; j++) {
+      sd = mongoc_set_get_item_const (servers, j);
+      if (_server_is_warmable (sd)) {
+         server_ids[n_servers++] = sd->id;
+      }
+   }
+
+   mc_tpld_drop_ref (&td);
+
+   for (i = 0; i < pool->warm_size && n_servers > 0; i++) {
+      bson_mutex_lock (&pool->mutex);
+      if (!(client = _mongoc_client_pool_fast_pop (pool)) &&
+          !(client = (mongoc_client_t *) _mongoc_queue_pop_head (
+               &pool->queue))) {
+         if (pool->size >= pool->warm_size) {
+            /* the rest are in use, and so connected already */
+            bson_mutex_unlock (&pool->mutex);
+            break;
+         }
+
+         client = _mongoc_client_new_from_uri (pool->topology);
+         _initialize_new_client (pool, client);
+         pool->size++;
+      }
+      bson_mutex_unlock (&pool->mutex);
+
+      /* don't reopen the connections pruning just closed for being idle */
+      for (j = 0; j < n_servers && !client->cluster.idle_pruned; j++) {
+         server_stream = mongoc_cluster_stream_for_server (
+            &client->cluster, server_ids[j], true, NULL, NULL, &error);
+         if (!server_stream) {
+            MONGOC_DEBUG ("could not warm connection to server %" PRIu32
+                          ": %s",
+                          server_ids[j],
+                          error.message);
+            /* the server was marked unknown; it will be warmed once a
+             * monitor finds it available again */
+            server_ids[j--] = server_ids[--n_servers];
+            continue;
+         }
+
+         mongoc_server_stream_cleanup (server_stream);
+      }
+
+      bson_mutex_lock (&pool->mutex);
+      _mongoc_queue_push_tail (&pool->queue, client);
+      mongoc_cond_signal (&pool->cond);
+      bson_mutex_unlock (&pool->mutex);
+   }
+
+   bson_free (server_ids);
+}
+
+
+/* Called by the background monitoring maintenance thread. */
+static void
+_mongoc_client_pool_maintain (void *pool_void)
+{
+   mongoc_client_pool_t *pool = (mongoc_client_pool_t *) pool_void;
+
+   if (pool->prune) {
+      _mongoc_client_pool_prune (pool);
+   }
+
+   if (pool->warm_size) {
+      _mongoc_client_pool_warm (pool);
+   }
+}
+
+
+bool
+mongoc_client_pool_set_warm_size (mongoc_client_pool_t *pool,
+                                  uint32_t warm_size)
+{
+   BSON_ASSERT_PARAM (pool);
+
+   if (pool->client_initialized) {
+      MONGOC_ERROR ("Cannot set warm size after a client has been created");
+      return false;
+   }
+
+   if (pool->shared_topology) {
+      /* the maintenance thread may already be running for other pools */
+      bson_mutex_lock (&pool->shared_topology->pools_mtx);
+      pool->warm_size = BSON_MIN (warm_size, pool->max_pool_size);
+      bson_mutex_unlock (&pool->shared_topology->pools_mtx);
+      return true;
+   }
+
+   pool->warm_size = BSON_MIN (warm_size, pool->max_pool_size);
+   pool->topology->maintenance_cb =
+      pool->warm_size || pool->prune ? _mongoc_client_pool_maintain : NULL;
+   pool->topology->maintenance_ctx = pool;
+
+   return true;
+}
+
+
+bool
+mongoc_client_pool_set_shared_connections (mongoc_client_pool_t *pool,
+                                           uint32_t n_per_server)
+{
+   BSON_ASSERT_PARAM (pool);
+
+   if (pool->client_initialized) {
+      MONGOC_ERROR (
+         "Cannot set shared connections after a client has been created");
+      return false;
+   }
+
+   _mongoc_mux_destroy (pool->mux);
+   pool->mux = n_per_server ? _mongoc_mux_new (n_per_server) : NULL;
+
+   return true;
+}
+
+
+static void
+_mongoc_client_pool_shared_topologies_init (void)
+{
+   bson_mutex_init (&gSharedTopologiesMutex);
+}
+
+
+static void
+_append_utf8_or_null (bson_t *doc, const char *key, const char *value)
+{
+   if (value) {
+      bson_append_utf8 (doc, key, -1, value, -1);
+   } else {
+      bson_append_null (doc, key, -1);
+   }
+}
+
+
+static void
+_append_optional_bool (bson_t *doc,
+                       const char *key,
+                       const mongoc_optional_t *value)
+{
+   if (mongoc_optional_is_set (value)) {
+      bson_append_bool (doc, key, -1, mongoc_optional_value (value));
+   } else {
+      bson_append_null (doc, key, -1);
+   }
+}
+
+
+/* describe the URI and every pool setting that configures the topology, so
+ * that only identically configured pools share it */
+static char *
+_mongoc_client_pool_topology_key (mongoc_client_pool_t *pool)
+{
+   bson_t key = BSON_INITIALIZER;
+   bson_t child;
+   char *str;
+
+   str = _mongoc_uri_canonical_string (pool->uri);
+   BSON_APPEND_UTF8 (&key, "uri", str);
+   bson_free (str);
+
+#ifdef MONGOC_ENABLE_SSL
+   if (pool->ssl_opts_set) {
+      _mongoc_internal_tls_opts_t *internal = pool->ssl_opts.internal;
+
+      BSON_APPEND_DOCUMENT_BEGIN (&key, "tls", &child);
+      _append_utf8_or_null (&child, "pemFile", pool->ssl_opts.pem_file);
+      _append_utf8_or_null (&child, "caFile", pool->ssl_opts.ca_file);
+      _append_utf8_or_null (&child, "caDir", pool->ssl_opts.ca_dir);
+      _append_utf8_or_null (&child, "crlFile", pool->ssl_opts.crl_file);
+      BSON_APPEND_BOOL (
+         &child, "weakCertValidation", pool->ssl_opts.weak_cert_validation);
+      BSON_APPEND_BOOL (&child,
+                        "allowInvalidHostname",
+                        pool->ssl_opts.allow_invalid_hostname);
+      if (internal) {
+         BSON_APPEND_BOOL (&child,
+                           "disableCertificateRevocationCheck",
+                           internal->tls_disable_certificate_revocation_check);
+         BSON_APPEND_BOOL (&child,
+                           "disableOCSPEndpointCheck",
+                           internal->tls_disable_ocsp_endpoint_check);
+      }
+      bson_append_document_end (&key, &child);
+   }
+#endif
+
+   _append_utf8_or_null (&key, "appname", pool->topology->scanner->appname);
+
+   if (pool->api) {
+      const mongoc_server_api_t *api = pool->api;
+
+      BSON_APPEND_DOCUMENT_BEGIN (&key, "serverApi", &child);
+      BSON_APPEND_INT32 (
+         &child, "version", (int32_t) mongoc_server_api_get_version (api));
+      _append_optional_bool (
+         &child, "strict", mongoc_server_api_get_strict (api));
+      _append_optional_bool (&child,
+                             "deprecationErrors",
+                             mongoc_server_api_get_deprecation_errors (api));
+      bson_append_document_end (&key, &child);
+   }
+
+   BSON_APPEND_BOOL (
+      &key, "monitoringEventLoop", pool->topology->use_monitor_loop);
+
+   str = bson_as_canonical_extended_json (&key, NULL);
+   bson_destroy (&key);
+
+   return str;
+}
+
+
+/* whether @pool, described by @key, is configured like the pools sharing
+ * @shared, secrets included */
+static bool
+_mongoc_client_pool_can_share (mongoc_client_pool_t *pool,
+                               mongoc_client_pool_shared_topology_t *shared,
+                               const char *key)
+{
+   if (strcmp (shared->key, key) ||
+       !_mongoc_uri_secrets_equal (pool->uri, shared->topology->uri)) {
+      return false;
+   }
+
+#ifdef MONGOC_ENABLE_SSL
+   if (pool->ssl_opts_set && pool->ssl_opts.pem_pwd) {
+      return shared->ssl_opts.pem_pwd &&
+             !strcmp (pool->ssl_opts.pem_pwd, shared->ssl_opts.pem_pwd);
+   }
+
+   return !shared->ssl_opts.pem_pwd;
+#else
+   return true;
+#endif
+}
+
+
+/* Called by the background monitoring maintenance thread of a shared
+ * topology. */
+static void
+_mongoc_client_pool_maintain_shared (void *shared_void)
+{
+   mongoc_client_pool_shared_topology_t *shared = shared_void;
+   mongoc_client_pool_t **pools;
+   mongoc_client_pool_t *pool;
+   bool started;
+   size_t i;
+
+   bson_mutex_lock (&shared->pools_mtx);
+   pools = (mongoc_client_pool_t **) shared->pools.data;
+
+   for (i = 0; i < shared->pools.len; i++) {
+      pool = pools[i];
+
+      /* like a pool with a topology of its own, wait for the application to
+       * pop the first client, so that the pool is fully configured */
+      bson_mutex_lock (&pool->mutex);
+      started = pool->client_initialized;
+      bson_mutex_unlock (&pool->mutex);
+
+      if (started) {
+         _mongoc_client_pool_maintain (pool);
+      }
+   }
+
+   bson_mutex_unlock (&shared->pools_mtx);
+}
+
+
+/* Returns the shared topology if @pool was the last pool sharing it. It is
+ * then unregistered, and the caller must destroy it after the topology. */
+static mongoc_client_pool_shared_topology_t *
+_mongoc_client_pool_unshare_topology (mongoc_client_pool_t *pool)
+{
+   mongoc_client_pool_shared_topology_t *shared = pool->shared_topology;
+   mongoc_client_pool_shared_topology_t **link;
+   mongoc_client_pool_t **pools;
+   bool last;
+   size_t i;
+
+   bson_mutex_lock (&gSharedTopologiesMutex);
+
+   /* waits for the maintenance thread to be done with the pool */
+   bson_mutex_lock (&shared->pools_mtx);
+   pools = (mongoc_client_pool_t **) shared->pools.data;
+   for (i = 0; i < shared->pools.len; i++) {
+      if (pools[i] == pool) {
+         pools[i] = pools[shared->pools.len - 1];
+         shared->pools.len--;
+         break;
+      }
+   }
+   last = shared->pools.len == 0;
+   bson_mutex_unlock (&shared->pools_mtx);
+
+   if (last) {
+      for (link = &gSharedTopologies; *link != shared; link = &(*link)->next) {
+      }
+      *link = shared->next;
+   }
+
+   bson_mutex_unlock (&gSharedTopologiesMutex);
+
+   return last ? shared : NULL;
+}
+
+
+static void
+_mongoc_client_pool_shared_topology_destroy (
+   mongoc_client_pool_shared_topology_t *shared)
+{
+   if (!shared) {
+      return;
+   }
+
+   bson_free (shared->key);
+#ifdef MONGOC_ENABLE_SSL
+   _mongoc_ssl_opts_cleanup (&shared->ssl_opts, true);
+#endif
+   bson_mutex_destroy (&shared->pools_mtx);
+   _mongoc_array_destroy (&shared->pools);
+   bson_free (shared);
+}
+
+
+bool
+mongoc_client_pool_share_topology (mongoc_client_pool_t *pool)
+{
+   mongoc_client_pool_shared_topology_t *shared;
+   mongoc_topology_t *own_topology = NULL;
+   char *key;
+
+   BSON_ASSERT_PARAM (pool);
+
+   if (pool->shared_topology) {
+      return true;
+   }
+
+   if (pool->client_initialized) {
+      MONGOC_ERROR ("Cannot share the topology after a client has been "
+                    "created");
+      return false;
+   }
+
+   if (pool->apm_callbacks_set) {
+      MONGOC_ERROR ("Cannot share the topology of a pool with APM callbacks");
+      return false;
+   }
+
+   if (pool->topology->cse_state != MONGOC_CSE_DISABLED) {
+      MONGOC_ERROR ("Cannot share the topology of a pool with automatic "
+                    "encryption");
+      return false;
+   }
+
+   if (!pool->topology->valid) {
+      MONGOC_ERROR ("Cannot share an invalid topology");
+      return false;
+   }
+
+   bson_once (&gSharedTopologiesOnce,
+              _mongoc_client_pool_shared_topologies_init);
+
+   key = _mongoc_client_pool_topology_key (pool);
+
+   bson_mutex_lock (&gSharedTopologiesMutex);
+
+   for (shared = gSharedTopologies; shared; shared = shared->next) {
+      if (_mongoc_client_pool_can_share (pool, shared, key)) {
+         break;
+      }
+   }
+
+   if (shared) {
+      bson_free (key);
+      own_topology = pool->topology;
+      pool->topology = shared->topology;
+
+      bson_mutex_lock (&shared->topology->maintenance_mtx);
+      if (own_topology->maintenance_interval_msec > 0 &&
+          (shared->topology->maintenance_interval_msec <= 0 ||
+           own_topology->maintenance_interval_msec <
+              shared->topology->maintenance_interval_msec)) {
+         shared->topology->maintenance_interval_msec =
+            own_topology->maintenance_interval_msec;
+      }
+      bson_mutex_unlock (&shared->topology->maintenance_mtx);
+   } else {
+      /* the pool's topology becomes the shared one */
+      shared = bson_malloc0 (sizeof *shared);
+      shared->key = key;
+      shared->topology = pool->topology;
+      bson_mutex_init (&shared->pools_mtx);
+      _mongoc_array_init (&shared->pools, sizeof (mongoc_client_pool_t *));
+#ifdef MONGOC_ENABLE_SSL
+      if (pool->ssl_opts_set) {
+         _mongoc_ssl_opts_copy_to (&pool->ssl_opts, &shared->ssl_opts, true);
+         mongoc_topology_scanner_set_ssl_opts (shared->topology->scanner,
+                                               &shared->ssl_opts);
+      }
+#endif
+      shared->topology->maintenance_cb = _mongoc_client_pool_maintain_shared;
+      shared->topology->maintenance_ctx = shared;
+      shared->next = gSharedTopologies;
+      gSharedTopologies = shared;
+   }
+
+   bson_mutex_lock (&shared->pools_mtx);
+   _mongoc_array_append_val (&shared->pools, pool);
+   pool->shared_topology = shared;
+   bson_mutex_unlock (&shared->pools_mtx);
+
+   bson_mutex_unlock (&gSharedTopologiesMutex);
+
+   /* the topology created for the pool was never started */
+   mongoc_topology_destroy (own_topology);
+
+   return true;
+}
+
+
+bool
+mongoc_client_pool_set_monitoring_event_loop (mongoc_client_pool_t *pool,
+                                              bool enabled)
+{
+   BSON_ASSERT_PARAM (pool);
+
+   if (pool->client_initialized) {
+      MONGOC_ERROR ("Cannot set the monitoring event loop after a client has "
+                    "been created");
+      return false;
+   }
+
+   if (pool->shared_topology) {
+      MONGOC_ERROR ("Cannot set the monitoring event loop of a pool sharing "
+                    "its topology");
+      return false;
+   }
+
+   pool->topology->use_monitor_loop = enabled;
+
+   return true;
+}
+
+
+void
+mongoc_client_pool_set_thread_affinity (mongoc_client_pool_t *pool,
+                                        bool enabled)
+{
+   mongoc_client_t *client;
+
+   BSON_ASSERT_PARAM (pool);
+
+   bson_atomic_int32_exchange (
+      &pool->thread_affinity, enabled ? 1 : 0, bson_memory_order_seq_cst);
+
+   if (!enabled) {
+      /* return clients kept by threads to the shared pool */
+      while ((client = _mongoc_client_pool_steal_affine (pool))) {
+         _mongoc_client_pool_push_shared (pool, client);
+      }
+   }
+}
+
 /* for tests */
 void
 _mongoc_client_pool_set_stream_initiator (mongoc_client_pool_t *pool,
@@ -393,11 +1449,21 @@ size_t
 mongoc_client_pool_num_pushed (mongoc_client_pool_t *pool)
 {
    size_t num_pushed = 0;
+   uint32_t i;
 
    ENTRY;
 
    bson_mutex_lock (&pool->mutex);
-   num_pushed = pool->queue.length;
+   num_pushed = pool->queue.length +
+                (size_t) bson_atomic_int32_fetch (&pool->n_fast_clients,
+                                                  bson_memory_order_relaxed);
+
+   for (i = 0; i < pool->n_nodes; i++) {
+      if (bson_atomic_ptr_fetch (&pool->affine_slots[i].client,
+                                 bson_memory_order_relaxed)) {
+         num_pushed++;
+      }
+   }
    bson_mutex_unlock (&pool->mutex);
 
    RETURN (num_pushed);
@@ -452,6 +1518,11 @@ mongoc_client_pool_set_apm_callbacks (mongoc_client_pool_t *pool,
       return false;
    }
 
+   if (pool->shared_topology) {
+      MONGOC_ERROR ("Cannot set callbacks of a pool sharing its topology");
+      return false;
+   }
+
    tdmod = mc_tpld_modify_begin (topology);
 
    if (callbacks) {
@@ -497,6 +1568,11 @@ mongoc_client_pool_set_appname (mongoc_client_pool_t *pool, const char *appname)
 {
    bool ret;
 
+   if (pool->shared_topology) {
+      MONGOC_ERROR ("Cannot set appname of a pool sharing its topology");
+      return false;
+   }
+
    bson_mutex_lock (&pool->mutex);
    ret = _mongoc_topology_set_appname (pool->topology, appname);
    bson_mutex_unlock (&pool->mutex);
@@ -509,6 +1585,15 @@ mongoc_client_pool_enable_auto_encryption (mongoc_client_pool_t *pool,
                                            mongoc_auto_encryption_opts_t *opts,
                                            bson_error_t *error)
 {
+   if (pool->shared_topology) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_INVALID_ENCRYPTION_STATE,
+                      "Cannot enable auto encryption on a pool sharing its "
+                      "topology");
+      return false;
+   }
+
    return _mongoc_cse_client_pool_enable_auto_encryption (
       pool->topology, opts, error);
 }
@@ -537,6 +1622,14 @@ mongoc_client_pool_set_server_api (mongoc_client_pool_t *pool,
       return false;
    }
 
+   if (pool->shared_topology) {
+      bson_set_error (error,
+                      MONGOC_ERROR_POOL,
+                      MONGOC_ERROR_POOL_API_TOO_LATE,
+                      "Cannot set server api of a pool sharing its topology");
+      return false;
+   }
+
    pool->api = mongoc_server_api_copy (api);
 
    _mongoc_topology_scanner_set_server_api (pool->topology->scanner, api);
@@ -77,6 +77,20 @@ MONGOC_EXPORT (bool)
 mongoc_client_pool_set_server_api (mongoc_client_pool_t *pool,
                                    const mongoc_server_api_t *api,
                                    bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_client_pool_set_warm_size (mongoc_client_pool_t *pool,
+                                  uint32_t warm_size);
+MONGOC_EXPORT (bool)
+mongoc_client_pool_set_shared_connections (mongoc_client_pool_t *pool,
+                                           uint32_t n_per_server);
+MONGOC_EXPORT (void)
+mongoc_client_pool_set_thread_affinity (mongoc_client_pool_t *pool,
+                                        bool enabled);
+MONGOC_EXPORT (bool)
+mongoc_client_pool_set_monitoring_event_loop (mongoc_client_pool_t *pool,
+                                              bool enabled);
+MONGOC_EXPORT (bool)
+mongoc_client_pool_share_topology (mongoc_client_pool_t *pool);
 
 BSON_END_DECLS
 
@@ -132,6 +132,13 @@ struct _mongoc_client_t {
    unsigned int csid_rand_seed;
 
    uint32_t generation;
+
+   /* commands submitted with mongoc_client_command_simple_async, created on
+    * first use */
+   struct _mongoc_client_async_t *async;
+
+   /* the pool's shared connections, if it shares them */
+   struct _mongoc_mux_t *mux;
 };
 
 /* Defines whether _mongoc_client_command_with_opts() is acting as a read
@@ -35,6 +35,7 @@
 #endif
 #endif
 
+#include "mongoc-client-async-private.h"
 #include "mongoc-client-private.h"
 #include "mongoc-client-side-encryption-private.h"
 #include "mongoc-collection-private.h"
@@ -1215,6 +1216,8 @@ void
 mongoc_client_destroy (mongoc_client_t *client)
 {
    if (client) {
+      _mongoc_client_async_destroy (client->async);
+
       if (client->topology->single_threaded) {
          _mongoc_client_end_sessions (client);
          mongoc_topology_destroy (client->topology);
@@ -1912,6 +1915,116 @@ mongoc_client_command_simple (mongoc_client_t *client,
 }
 
 
+bool
+mongoc_client_command_simple_pipelined (mongoc_client_t *client,
+                                        const char *db_name,
+                                        const bson_t *const *commands,
+                                        size_t n_commands,
+                                        const mongoc_read_prefs_t *read_prefs,
+                                        bson_t *replies,
+                                        bson_error_t *error)
+{
+   mongoc_cluster_t *cluster;
+   mongoc_server_stream_t *server_stream = NULL;
+   mongoc_cmd_parts_t *parts;
+   mongoc_cmd_t **cmds;
+   bson_t reply_local;
+   bson_error_t error_local;
+   bson_error_t *cmd_error;
+   bool ret = true;
+   size_t n_assembled = 0;
+   size_t i;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (client);
+   BSON_ASSERT_PARAM (db_name);
+   BSON_ASSERT (commands || n_commands == 0);
+   BSON_ASSERT (replies || n_commands == 0);
+
+   if (n_commands == 0) {
+      RETURN (true);
+   }
+
+   if (!_mongoc_read_prefs_validate (read_prefs, error)) {
+      for (i = 0; i < n_commands; i++) {
+         bson_init (&replies[i]);
+      }
+
+      RETURN (false);
+   }
+
+   cluster = &client->cluster;
+   server_stream = mongoc_cluster_stream_for_reads (
+      cluster, read_prefs, NULL, &reply_local, error);
+
+   if (!server_stream) {
+      for (i = 0; i < n_commands; i++) {
+         bson_copy_to (&reply_local, &replies[i]);
+      }
+
+      bson_destroy (&reply_local);
+      RETURN (false);
+   }
+
+   parts = bson_malloc0 (n_commands * sizeof (mongoc_cmd_parts_t));
+   cmds = bson_malloc0 (n_commands * sizeof (mongoc_cmd_t *));
+
+   for (i = 0; i < n_commands; i++) {
+      mongoc_cmd_parts_init (
+         &parts[i], client, db_name, MONGOC_QUERY_NONE, commands[i]);
+      parts[i].read_prefs = read_prefs;
+   }
+
+   /* the commands are sent one by one where pipelining is unavailable */
+   if (server_stream->sd->max_wire_version < WIRE_VERSION_OP_MSG ||
+       _mongoc_cse_is_enabled (client)) {
+      for (i = 0; i < n_commands; i++) {
+         cmd_error = ret ? error : &error_local;
+         if (!_mongoc_client_command_with_stream (client,
+                                                  &parts[i],
+                                                  read_prefs,
+                                                  server_stream,
+                                                  &replies[i],
+                                                  cmd_error)) {
+            ret = false;
+         }
+      }
+
+      GOTO (done);
+   }
+
+   for (; n_assembled < n_commands; n_assembled++) {
+      parts[n_assembled].assembled.operation_id = ++cluster->operation_id;
+      if (!mongoc_cmd_parts_assemble (
+             &parts[n_assembled], server_stream, error)) {
+         for (i = 0; i < n_commands; i++) {
+            bson_init (&replies[i]);
+         }
+
+         ret = false;
+         GOTO (done);
+      }
+
+      cmds[n_assembled] = &parts[n_assembled].assembled;
+   }
+
+   ret = mongoc_cluster_run_opmsg_pipelined (
+      cluster, cmds, n_commands, replies, error);
+
+done:
+   for (i = 0; i < n_commands; i++) {
+      mongoc_cmd_parts_cleanup (&parts[i]);
+   }
+
+   bson_free (cmds);
+   bson_free (parts);
+   mongoc_server_stream_cleanup (server_stream);
+
+   RETURN (ret);
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
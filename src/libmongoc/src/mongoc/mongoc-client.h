@@ -102,6 +102,42 @@ typedef mongoc_stream_t *(*mongoc_stream_initiator_t) (
    bson_error_t *error);
 
 
+/**
+ * mongoc_client_command_async_cb_t:
+ * @client: The client the command was submitted on.
+ * @reply: The server reply, or NULL if no reply was received. Only valid
+ *         during the callback.
+ * @error: NULL if the command succeeded, otherwise the error.
+ * @data: The data passed to mongoc_client_command_simple_async.
+ *
+ * Called from mongoc_client_run_async when an asynchronous command completes.
+ */
+typedef void (*mongoc_client_command_async_cb_t) (mongoc_client_t *client,
+                                                  const bson_t *reply,
+                                                  const bson_error_t *error,
+                                                  void *data);
+
+
+/**
+ * mongoc_client_async_fd_t:
+ * @fd: A socket an asynchronous command is waiting on.
+ * @events: The readiness the command waits for, POLLIN or POLLOUT.
+ * @revents: The readiness the application observed on @fd, set before
+ *           passing it to mongoc_client_async_step.
+ *
+ * Lets an application's own event loop drive asynchronous commands.
+ */
+typedef struct _mongoc_client_async_fd_t {
+#ifdef _WIN32
+   SOCKET fd;
+#else
+   int fd;
+#endif
+   int events;
+   int revents;
+} mongoc_client_async_fd_t;
+
+
 MONGOC_EXPORT (mongoc_client_t *)
 mongoc_client_new (const char *uri_string) BSON_GNUC_WARN_UNUSED_RESULT;
 MONGOC_EXPORT (mongoc_client_t *)
@@ -135,6 +171,33 @@ mongoc_client_command_simple (mongoc_client_t *client,
                               bson_t *reply,
                               bson_error_t *error);
 MONGOC_EXPORT (bool)
+mongoc_client_command_simple_pipelined (mongoc_client_t *client,
+                                        const char *db_name,
+                                        const bson_t *const *commands,
+                                        size_t n_commands,
+                                        const mongoc_read_prefs_t *read_prefs,
+                                        bson_t *replies,
+                                        bson_error_t *error);
+MONGOC_EXPORT (bool)
+mongoc_client_command_simple_async (mongoc_client_t *client,
+                                    const char *db_name,
+                                    const bson_t *command,
+                                    const mongoc_read_prefs_t *read_prefs,
+                                    mongoc_client_command_async_cb_t cb,
+                                    void *data,
+                                    bson_error_t *error);
+MONGOC_EXPORT (size_t)
+mongoc_client_run_async (mongoc_client_t *client, int32_t timeout_msec);
+MONGOC_EXPORT (size_t)
+mongoc_client_async_get_fds (mongoc_client_t *client,
+                             mongoc_client_async_fd_t *fds,
+                             size_t n_fds,
+                             int32_t *timeout_msec);
+MONGOC_EXPORT (size_t)
+mongoc_client_async_step (mongoc_client_t *client,
+                          const mongoc_client_async_fd_t *fds,
+                          size_t n_fds);
+MONGOC_EXPORT (bool)
 mongoc_client_read_command_with_opts (mongoc_client_t *client,
                                       const char *db_name,
                                       const bson_t *command,
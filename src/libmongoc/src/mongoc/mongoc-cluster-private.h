@@ -46,6 +46,13 @@ typedef struct _mongoc_cluster_node_t {
    char *connection_address;
    /* handshake_sd is a server description created from the handshake on the stream. */
    mongoc_server_description_t *handshake_sd;
+   /* for maxConnectionLifeTimeMS and maxIdleTimeMS. n_uses is incremented
+    * each time the stream is fetched, and last_used is only updated when
+    * pruning finds that n_uses changed, to keep fetching cheap. */
+   int64_t created;
+   int64_t last_used;
+   uint32_t n_uses;
+   uint32_t n_uses_seen;
 } mongoc_cluster_node_t;
 
 typedef struct _mongoc_cluster_t {
@@ -53,6 +60,8 @@ typedef struct _mongoc_cluster_t {
    uint32_t request_id;
    uint32_t sockettimeoutms;
    uint32_t socketcheckintervalms;
+   int32_t max_idle_time_ms;
+   int32_t max_connection_life_time_ms;
    mongoc_uri_t *uri;
    unsigned requires_auth : 1;
 
@@ -61,6 +70,12 @@ typedef struct _mongoc_cluster_t {
    mongoc_set_t *nodes;
    mongoc_array_t iov;
 
+   /* set by mongoc_cluster_prune_nodes: the earliest time a later call may
+    * close a connection, or 0 if unknown, and whether the call closed an
+    * idle connection. Reset when a connection is added. */
+   int64_t prune_at;
+   bool idle_pruned;
+
    mongoc_scram_cache_t *scram_cache;
 } mongoc_cluster_t;
 
@@ -76,6 +91,19 @@ mongoc_cluster_destroy (mongoc_cluster_t *cluster);
 void
 mongoc_cluster_disconnect_node (mongoc_cluster_t *cluster, uint32_t id);
 
+mongoc_cluster_node_t *
+_mongoc_cluster_connect_node (mongoc_cluster_t *cluster,
+                              const mongoc_topology_description_t *td,
+                              uint32_t server_id,
+                              bson_error_t *error);
+
+mongoc_cluster_node_t *
+_mongoc_cluster_node_new (mongoc_stream_t *stream,
+                          const char *connection_address);
+
+void
+_mongoc_cluster_node_destroy (mongoc_cluster_node_t *node);
+
 int32_t
 mongoc_cluster_get_max_bson_obj_size (mongoc_cluster_t *cluster);
 
@@ -91,6 +119,9 @@ _mongoc_cluster_buffer_iovec (mongoc_iovec_t *iov,
 bool
 mongoc_cluster_check_interval (mongoc_cluster_t *cluster, uint32_t server_id);
 
+void
+mongoc_cluster_prune_nodes (mongoc_cluster_t *cluster);
+
 bool
 mongoc_cluster_legacy_rpc_sendv_to_server (
    mongoc_cluster_t *cluster,
@@ -174,6 +205,13 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
                                       bson_t *reply,
                                       bson_error_t *error);
 
+bool
+mongoc_cluster_run_opmsg_pipelined (mongoc_cluster_t *cluster,
+                                    mongoc_cmd_t *const *cmds,
+                                    size_t n_cmds,
+                                    bson_t *replies,
+                                    bson_error_t *error);
+
 bool
 mongoc_cluster_run_command_parts (mongoc_cluster_t *cluster,
                                   mongoc_server_stream_t *server_stream,
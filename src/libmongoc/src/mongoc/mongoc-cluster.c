@@ -55,6 +55,7 @@
 #include "mongoc-handshake-private.h"
 #include "mongoc-cluster-aws-private.h"
 #include "mongoc-error-private.h"
+#include "mongoc-stream-mux-private.h"
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "cluster"
@@ -62,6 +63,11 @@
 
 #define CHECK_CLOSED_DURATION_MSEC 1000
 
+/* the most request bytes mongoc_cluster_run_opmsg_pipelined writes before
+ * reading replies: small enough for the socket buffers to absorb, so the
+ * server never blocks sending replies while we block writing requests */
+#define PIPELINE_MAX_BYTES_IN_FLIGHT (64 * 1024)
+
 #define IS_NOT_COMMAND(_name) (!!strcasecmp (cmd->command_name, _name))
 
 static mongoc_server_stream_t *
@@ -500,6 +506,7 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
    mongoc_apm_command_succeeded_t succeeded_event;
    mongoc_apm_command_failed_t failed_event;
    int64_t started = bson_get_monotonic_time ();
+   int64_t op_started;
    const mongoc_server_stream_t *server_stream;
    bson_t reply_local;
    bson_error_t error_local;
@@ -545,12 +552,15 @@ mongoc_cluster_run_command_monitored (mongoc_cluster_t *cluster,
       mongoc_apm_command_started_cleanup (&started_event);
    }
 
+   op_started = bson_get_monotonic_time ();
    if (server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
       retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, error);
    } else {
       retval = mongoc_cluster_run_command_opquery (
          cluster, cmd, compressor_id, reply, error);
    }
+   mongoc_server_load_record_op_time (
+      server_stream->load, bson_get_monotonic_time () - op_started);
 
    if (_mongoc_cse_is_enabled (cluster->client)) {
       bson_destroy (&decrypted);
@@ -669,6 +679,7 @@ mongoc_cluster_run_command_private (mongoc_cluster_t *cluster,
    const mongoc_server_stream_t *server_stream;
    bson_t reply_local;
    bson_error_t error_local;
+   int64_t started;
 
    if (!error) {
       error = &error_local;
@@ -678,12 +689,15 @@ mongoc_cluster_run_command_private (mongoc_cluster_t *cluster,
       reply = &reply_local;
    }
    server_stream = cmd->server_stream;
+   started = bson_get_monotonic_time ();
    if (server_stream->sd->max_wire_version >= WIRE_VERSION_OP_MSG) {
       retval = mongoc_cluster_run_opmsg (cluster, cmd, reply, error);
    } else {
       retval =
          mongoc_cluster_run_command_opquery (cluster, cmd, -1, reply, error);
    }
+   mongoc_server_load_record_op_time (server_stream->load,
+                                      bson_get_monotonic_time () - started);
    _handle_not_primary_error (cluster, server_stream, reply);
    if (reply == &reply_local) {
       bson_destroy (&reply_local);
@@ -1921,7 +1935,7 @@ mongoc_cluster_disconnect_node (mongoc_cluster_t *cluster, uint32_t server_id)
    EXIT;
 }
 
-static void
+void
 _mongoc_cluster_node_destroy (mongoc_cluster_node_t *node)
 {
    /* Failure, or Replica Set reconfigure without this node */
@@ -1940,7 +1954,7 @@ _mongoc_cluster_node_dtor (void *data_, void *ctx_)
    _mongoc_cluster_node_destroy (node);
 }
 
-static mongoc_cluster_node_t *
+mongoc_cluster_node_t *
 _mongoc_cluster_node_new (mongoc_stream_t *stream,
                           const char *connection_address)
 {
@@ -1954,6 +1968,7 @@ _mongoc_cluster_node_new (mongoc_stream_t *stream,
 
    node->stream = stream;
    node->connection_address = bson_strdup (connection_address);
+   node->created = node->last_used = bson_get_monotonic_time ();
 
    return node;
 }
@@ -2030,25 +2045,25 @@ _mongoc_cluster_finish_speculative_auth (
 /*
  *--------------------------------------------------------------------------
  *
- * mongoc_cluster_add_node --
- *
- *       Add a new node to this cluster for the given server description.
+ * _mongoc_cluster_connect_node --
  *
- *       NOTE: does NOT check if this server is already in the cluster.
+ *       Open, handshake and authenticate a new connection to the given
+ *       server. The node is not added to the cluster.
  *
  * Returns:
- *       A stream connected to the server, or NULL on failure.
+ *       A new node that must be destroyed with _mongoc_cluster_node_destroy,
+ *       or NULL on failure.
  *
  * Side effects:
- *       Adds a cluster node, or sets error on failure.
+ *       Sets error on failure.
  *
  *--------------------------------------------------------------------------
  */
-static mongoc_cluster_node_t *
-_cluster_add_node (mongoc_cluster_t *cluster,
-                   const mongoc_topology_description_t *td,
-                   uint32_t server_id,
-                   bson_error_t *error /* OUT */)
+mongoc_cluster_node_t *
+_mongoc_cluster_connect_node (mongoc_cluster_t *cluster,
+                              const mongoc_topology_description_t *td,
+                              uint32_t server_id,
+                              bson_error_t *error /* OUT */)
 {
    mongoc_host_list_t *host = NULL;
    mongoc_cluster_node_t *cluster_node = NULL;
@@ -2057,11 +2072,10 @@ _cluster_add_node (mongoc_cluster_t *cluster,
    mongoc_handshake_sasl_supported_mechs_t sasl_supported_mechs;
    mongoc_scram_t scram = {0};
    bson_t speculative_auth_response = BSON_INITIALIZER;
+   bool connecting = false;
 
    ENTRY;
 
-   BSON_ASSERT (!cluster->client->topology->single_threaded);
-
    host = _mongoc_topology_host_by_id (td, server_id, error);
 
    if (!host) {
@@ -2070,6 +2084,19 @@ _cluster_add_node (mongoc_cluster_t *cluster,
 
    TRACE ("Adding new server to cluster: %s", host->host_and_port);
 
+   /* limit connection storms, e.g. when many threads reconnect to a new
+    * primary at once; wait no longer than server selection would */
+   if (!_mongoc_topology_connecting_begin (
+          cluster->client->topology,
+          server_id,
+          bson_get_monotonic_time () +
+             cluster->client->topology->server_selection_timeout_msec * 1000,
+          error)) {
+      GOTO (error);
+   }
+
+   connecting = true;
+
    stream = _mongoc_client_create_stream (cluster->client, host, error);
 
    if (!stream) {
@@ -2129,8 +2156,9 @@ _cluster_add_node (mongoc_cluster_t *cluster,
    handshake_sd->generation = _mongoc_topology_get_connection_pool_generation (
       td, server_id, &handshake_sd->service_id);
 
+   _mongoc_topology_connecting_end (cluster->client->topology, server_id);
+
    bson_destroy (&speculative_auth_response);
-   mongoc_set_add (cluster->nodes, server_id, cluster_node);
    _mongoc_host_list_destroy_all (host);
 
 #ifdef MONGOC_ENABLE_CRYPTO
@@ -2140,6 +2168,10 @@ _cluster_add_node (mongoc_cluster_t *cluster,
    RETURN (cluster_node);
 
 error:
+   if (connecting) {
+      _mongoc_topology_connecting_end (cluster->client->topology, server_id);
+   }
+
    bson_destroy (&speculative_auth_response);
    _mongoc_host_list_destroy_all (host); /* null ok */
 
@@ -2154,6 +2186,52 @@ error:
    RETURN (NULL);
 }
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_add_node --
+ *
+ *       Add a new node to this cluster for the given server description.
+ *
+ *       NOTE: does NOT check if this server is already in the cluster.
+ *
+ * Returns:
+ *       A stream connected to the server, or NULL on failure.
+ *
+ * Side effects:
+ *       Adds a cluster node, or sets error on failure.
+ *
+ *--------------------------------------------------------------------------
+ */
+static mongoc_cluster_node_t *
+_cluster_add_node (mongoc_cluster_t *cluster,
+                   const mongoc_topology_description_t *td,
+                   uint32_t server_id,
+                   bson_error_t *error /* OUT */)
+{
+   mongoc_cluster_node_t *cluster_node;
+
+   BSON_ASSERT (!cluster->client->topology->single_threaded);
+
+   /* behind a load balancer cursors and transactions are pinned to a
+    * connection, so it can't be shared */
+   if (cluster->client->mux && td->type != MONGOC_TOPOLOGY_LOAD_BALANCED) {
+      cluster_node = _mongoc_mux_connect_node (
+         cluster->client->mux, cluster, td, server_id, error);
+   } else {
+      cluster_node =
+         _mongoc_cluster_connect_node (cluster, td, server_id, error);
+   }
+
+   if (cluster_node) {
+      mongoc_set_add (cluster->nodes, server_id, cluster_node);
+      cluster->prune_at = 0;
+      cluster->idle_pruned = false;
+   }
+
+   return cluster_node;
+}
+
 static void
 node_not_found (const mongoc_topology_description_t *td,
                 uint32_t server_id,
@@ -2589,6 +2667,7 @@ _cluster_fetch_stream_pooled (mongoc_cluster_t *cluster,
           */
          mongoc_cluster_disconnect_node (cluster, server_id);
       } else {
+         cluster_node->n_uses++;
          return _mongoc_cluster_create_server_stream (
             td, cluster_node->handshake_sd, cluster_node->stream);
       }
@@ -2653,6 +2732,12 @@ mongoc_cluster_init (mongoc_cluster_t *cluster,
                                       MONGOC_URI_SOCKETCHECKINTERVALMS,
                                       MONGOC_TOPOLOGY_SOCKET_CHECK_INTERVAL_MS);
 
+   cluster->max_idle_time_ms =
+      mongoc_uri_get_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 0);
+
+   cluster->max_connection_life_time_ms = mongoc_uri_get_option_as_int32 (
+      uri, MONGOC_URI_MAXCONNECTIONLIFETIMEMS, 0);
+
    /* TODO for single-threaded case we don't need this */
    cluster->nodes = mongoc_set_new (8, _mongoc_cluster_node_dtor, NULL);
 
@@ -3068,6 +3153,89 @@ mongoc_cluster_check_interval (mongoc_cluster_t *cluster, uint32_t server_id)
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_prune_nodes --
+ *
+ *      Only for pooled clients, by the client pool's background
+ *      maintenance while @cluster's client is not in use.
+ *
+ *      Close connections that have been open for maxConnectionLifeTimeMS,
+ *      or unused for maxIdleTimeMS. Use is detected by comparing each
+ *      node's use count with the count seen by the previous call, so idle
+ *      time is measured with the resolution of the calls to this function.
+ *
+ * Side effects:
+ *      Pruned connections are re-established the next time they are
+ *      needed. The topology description is not modified.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+void
+mongoc_cluster_prune_nodes (mongoc_cluster_t *cluster)
+{
+   mongoc_cluster_node_t *node;
+   uint32_t *ids;
+   uint32_t id;
+   int n_ids = 0;
+   int64_t now;
+   int64_t idle_at;
+   int64_t expire_at;
+   int i;
+
+   BSON_ASSERT_PARAM (cluster);
+   BSON_ASSERT (!cluster->client->topology->single_threaded);
+
+   cluster->prune_at = INT64_MAX;
+
+   if ((!cluster->max_idle_time_ms && !cluster->max_connection_life_time_ms) ||
+       !cluster->nodes->items_len) {
+      return;
+   }
+
+   now = bson_get_monotonic_time ();
+   ids = bson_malloc (cluster->nodes->items_len * sizeof (uint32_t));
+
+   for (i = 0; i < cluster->nodes->items_len; i++) {
+      node = mongoc_set_get_item_and_id (cluster->nodes, i, &id);
+
+      if (node->n_uses != node->n_uses_seen) {
+         node->n_uses_seen = node->n_uses;
+         node->last_used = now;
+      }
+
+      idle_at = cluster->max_idle_time_ms
+                   ? node->last_used +
+                        1000 * (int64_t) cluster->max_idle_time_ms
+                   : INT64_MAX;
+      expire_at = cluster->max_connection_life_time_ms
+                     ? node->created +
+                          1000 * (int64_t) cluster->max_connection_life_time_ms
+                     : INT64_MAX;
+
+      if (idle_at <= now || expire_at <= now) {
+         if (idle_at <= now) {
+            cluster->idle_pruned = true;
+         }
+
+         ids[n_ids++] = id;
+      } else {
+         cluster->prune_at = BSON_MIN (cluster->prune_at,
+                                       BSON_MIN (idle_at, expire_at));
+      }
+   }
+
+   for (i = 0; i < n_ids; i++) {
+      TRACE ("pruning connection to server %" PRIu32, ids[i]);
+      mongoc_cluster_disconnect_node (cluster, ids[i]);
+   }
+
+   bson_free (ids);
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -3166,6 +3334,50 @@ done:
 }
 
 
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_cluster_get_read_ahead --
+ *
+ *       Find the read-ahead buffer kept with the connection of
+ *       @server_stream, so that replies can be read from it with
+ *       _mongoc_buffer_append_from_read_ahead. Only a single-threaded
+ *       client's connections, which the topology scanner creates as plain
+ *       socket or TLS streams, have one. A pooled client's connections
+ *       come from the stream initiator, which wraps them in a buffered
+ *       stream that reads ahead itself.
+ *
+ * Returns:
+ *       The buffer, or NULL if the stream must be read exactly: it is
+ *       not a scanner connection, e.g. during its handshake, or it may
+ *       not return early with fewer bytes than requested.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static mongoc_buffer_t *
+_mongoc_cluster_get_read_ahead (mongoc_cluster_t *cluster,
+                                mongoc_server_stream_t *server_stream)
+{
+   mongoc_topology_t *topology = cluster->client->topology;
+   mongoc_topology_scanner_node_t *scanner_node;
+   mongoc_stream_t *stream = server_stream->stream;
+
+   if (!topology->single_threaded || (stream->type != MONGOC_STREAM_SOCKET &&
+                                      stream->type != MONGOC_STREAM_TLS)) {
+      return NULL;
+   }
+
+   scanner_node = mongoc_topology_scanner_get_node (topology->scanner,
+                                                    server_stream->sd->id);
+   if (scanner_node && scanner_node->stream == stream) {
+      return &scanner_node->read_ahead;
+   }
+
+   return NULL;
+}
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -3197,6 +3409,7 @@ mongoc_cluster_try_recv (mongoc_cluster_t *cluster,
                          bson_error_t *error)
 {
    bson_error_t err_local;
+   mongoc_buffer_t *read_ahead;
    int32_t msg_len;
    int32_t max_msg_size;
    off_t pos;
@@ -3215,12 +3428,18 @@ mongoc_cluster_try_recv (mongoc_cluster_t *cluster,
       error = &err_local;
    }
 
+   read_ahead = _mongoc_cluster_get_read_ahead (cluster, server_stream);
+
    /*
     * Buffer the message length to determine how much more to read.
     */
    pos = buffer->len;
-   if (!_mongoc_buffer_append_from_stream (
-          buffer, server_stream->stream, 4, cluster->sockettimeoutms, error)) {
+   if (!_mongoc_buffer_append_from_read_ahead (buffer,
+                                               read_ahead,
+                                               server_stream->stream,
+                                               4,
+                                               cluster->sockettimeoutms,
+                                               error)) {
       MONGOC_DEBUG (
          "Could not read 4 bytes, stream probably closed or timed out");
       mongoc_counter_protocol_ingress_error_inc ();
@@ -3249,11 +3468,12 @@ mongoc_cluster_try_recv (mongoc_cluster_t *cluster,
    /*
     * Read the rest of the message from the stream.
     */
-   if (!_mongoc_buffer_append_from_stream (buffer,
-                                           server_stream->stream,
-                                           msg_len - 4,
-                                           cluster->sockettimeoutms,
-                                           error)) {
+   if (!_mongoc_buffer_append_from_read_ahead (buffer,
+                                               read_ahead,
+                                               server_stream->stream,
+                                               msg_len - 4,
+                                               cluster->sockettimeoutms,
+                                               error)) {
       _handle_network_error (
          cluster, server_stream, true /* handshake complete */, error);
       mongoc_counter_protocol_ingress_error_inc ();
@@ -3346,6 +3566,7 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
 {
    mongoc_rpc_section_t section[2];
    mongoc_buffer_t buffer;
+   mongoc_buffer_t *read_ahead;
    bson_t reply_local; /* only statically initialized */
    char *output = NULL;
    mongoc_rpc_t rpc;
@@ -3439,8 +3660,13 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
 
    /* If acknowledged, wait for a server response. Otherwise, exit early */
    if (cmd->is_acknowledged) {
-      ok = _mongoc_buffer_append_from_stream (
-         &buffer, server_stream->stream, 4, cluster->sockettimeoutms, error);
+      read_ahead = _mongoc_cluster_get_read_ahead (cluster, server_stream);
+      ok = _mongoc_buffer_append_from_read_ahead (&buffer,
+                                                  read_ahead,
+                                                  server_stream->stream,
+                                                  4,
+                                                  cluster->sockettimeoutms,
+                                                  error);
       if (!ok) {
          RUN_CMD_ERR_DECORATE;
          _handle_network_error (
@@ -3471,11 +3697,12 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
          return false;
       }
 
-      ok = _mongoc_buffer_append_from_stream (&buffer,
-                                              server_stream->stream,
-                                              (size_t) msg_len - 4,
-                                              cluster->sockettimeoutms,
-                                              error);
+      ok = _mongoc_buffer_append_from_read_ahead (&buffer,
+                                                  read_ahead,
+                                                  server_stream->stream,
+                                                  (size_t) msg_len - 4,
+                                                  cluster->sockettimeoutms,
+                                                  error);
       if (!ok) {
          RUN_CMD_ERR_DECORATE;
          _handle_network_error (
@@ -3546,3 +3773,309 @@ mongoc_cluster_run_opmsg (mongoc_cluster_t *cluster,
 
    return ok;
 }
+
+
+/* the state of one command sent by mongoc_cluster_run_opmsg_pipelined */
+typedef struct {
+   mongoc_rpc_section_t section[2];
+   mongoc_rpc_t rpc;
+   uint32_t request_id;
+   size_t iov_offset;
+   size_t msg_len;
+   bool is_redacted;
+   bool ok;
+   int64_t duration;
+   bson_error_t error;
+} mongoc_pipelined_cmd_t;
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_cluster_run_opmsg_pipelined --
+ *
+ *       Write the OP_MSG commands @cmds back to back on their server's
+ *       stream, then read their replies in turn, so the batch costs a
+ *       single round trip. At most PIPELINE_MAX_BYTES_IN_FLIGHT of
+ *       requests are written before their replies are read, so large
+ *       batches take one round trip per window. All commands must be
+ *       acknowledged and share one server stream that supports OP_MSG.
+ *       Requests are not compressed and automatic encryption is not
+ *       performed.
+ *
+ * Returns:
+ *       true if every command succeeded; otherwise false and @error is
+ *       set to the first failure.
+ *
+ * Side effects:
+ *       If the client's APM callbacks are set, they are executed.
+ *       Each of the @n_cmds documents in @replies is set and should
+ *       ALWAYS be released with bson_destroy().
+ *       On a network error the connection is closed, and every command
+ *       still waiting for its reply fails.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+mongoc_cluster_run_opmsg_pipelined (mongoc_cluster_t *cluster,
+                                    mongoc_cmd_t *const *cmds,
+                                    size_t n_cmds,
+                                    bson_t *replies,
+                                    bson_error_t *error)
+{
+   mongoc_server_stream_t *server_stream;
+   mongoc_apm_callbacks_t *callbacks;
+   mongoc_apm_command_started_t started_event;
+   mongoc_apm_command_succeeded_t succeeded_event;
+   mongoc_apm_command_failed_t failed_event;
+   mongoc_pipelined_cmd_t *pcmds;
+   mongoc_pipelined_cmd_t *pcmd;
+   const mongoc_cmd_t *cmd;
+   mongoc_buffer_t buffer;
+   mongoc_rpc_t rpc;
+   bson_t reply_local; /* only statically initialized */
+   bson_error_t *first_error = NULL;
+   int64_t started;
+   size_t n_replied = 0;
+   size_t n_sent;
+   size_t n_bytes;
+   size_t iov_begin;
+   size_t iov_end;
+   size_t i;
+
+   ENTRY;
+
+   BSON_ASSERT_PARAM (cluster);
+   BSON_ASSERT_PARAM (cmds);
+   BSON_ASSERT_PARAM (replies);
+   BSON_ASSERT (n_cmds > 0);
+
+   server_stream = cmds[0]->server_stream;
+   callbacks = &cluster->client->apm_callbacks;
+   pcmds = bson_malloc0 (n_cmds * sizeof (mongoc_pipelined_cmd_t));
+
+   for (i = 0; i < n_cmds; i++) {
+      bson_init (&replies[i]);
+   }
+
+   if (cluster->client->in_exhaust) {
+      bson_set_error (error,
+                      MONGOC_ERROR_CLIENT,
+                      MONGOC_ERROR_CLIENT_IN_EXHAUST,
+                      "A cursor derived from this client is in exhaust.");
+      bson_free (pcmds);
+      RETURN (false);
+   }
+
+   _mongoc_array_clear (&cluster->iov);
+
+   for (i = 0; i < n_cmds; i++) {
+      cmd = cmds[i];
+      pcmd = &pcmds[i];
+
+      BSON_ASSERT (cmd->server_stream == server_stream);
+      BSON_ASSERT (cmd->is_acknowledged);
+      BSON_ASSERT (cmd->command_name);
+
+      pcmd->request_id = ++cluster->request_id;
+      pcmd->rpc.header.msg_len = 0;
+      pcmd->rpc.header.request_id = pcmd->request_id;
+      pcmd->rpc.header.response_to = 0;
+      pcmd->rpc.header.opcode = MONGOC_OPCODE_MSG;
+      pcmd->rpc.msg.flags = 0;
+      pcmd->rpc.msg.n_sections = 1;
+
+      pcmd->section[0].payload_type = 0;
+      pcmd->section[0].payload.bson_document = bson_get_data (cmd->command);
+      pcmd->rpc.msg.sections[0] = pcmd->section[0];
+
+      if (cmd->payload) {
+         pcmd->section[1].payload_type = 1;
+         pcmd->section[1].payload.sequence.size =
+            cmd->payload_size + strlen (cmd->payload_identifier) + 1 +
+            sizeof (int32_t);
+         pcmd->section[1].payload.sequence.identifier =
+            cmd->payload_identifier;
+         pcmd->section[1].payload.sequence.bson_documents = cmd->payload;
+         pcmd->rpc.msg.sections[1] = pcmd->section[1];
+         pcmd->rpc.msg.n_sections++;
+      }
+
+      /* each rpc stays alive until written, the iovecs point into it */
+      pcmd->iov_offset = cluster->iov.len;
+      _mongoc_rpc_gather (&pcmd->rpc, &cluster->iov);
+      pcmd->msg_len = (size_t) pcmd->rpc.header.msg_len;
+      _mongoc_rpc_swab_to_le (&pcmd->rpc);
+
+      if (callbacks->started) {
+         mongoc_apm_command_started_init_with_cmd (
+            &started_event,
+            (mongoc_cmd_t *) cmd,
+            pcmd->request_id,
+            &pcmd->is_redacted,
+            cluster->client->apm_context);
+
+         callbacks->started (&started_event);
+         mongoc_apm_command_started_cleanup (&started_event);
+      }
+   }
+
+   while (n_replied < n_cmds) {
+      /* write a window of requests, always at least one */
+      n_bytes = 0;
+      for (n_sent = n_replied; n_sent < n_cmds; n_sent++) {
+         if (n_sent > n_replied &&
+             n_bytes + pcmds[n_sent].msg_len > PIPELINE_MAX_BYTES_IN_FLIGHT) {
+            break;
+         }
+
+         n_bytes += pcmds[n_sent].msg_len;
+      }
+
+      iov_begin = pcmds[n_replied].iov_offset;
+      iov_end = n_sent < n_cmds ? pcmds[n_sent].iov_offset : cluster->iov.len;
+      started = bson_get_monotonic_time ();
+
+      if (!_mongoc_stream_writev_full (
+             server_stream->stream,
+             &_mongoc_array_index (&cluster->iov, mongoc_iovec_t, iov_begin),
+             iov_end - iov_begin,
+             cluster->sockettimeoutms,
+             &pcmds[n_replied].error)) {
+         _handle_network_error (cluster,
+                                server_stream,
+                                true /* handshake complete */,
+                                &pcmds[n_replied].error);
+         server_stream->stream = NULL;
+         break;
+      }
+
+      /* the server answers the requests in order */
+      for (; n_replied < n_sent; n_replied++) {
+         pcmd = &pcmds[n_replied];
+
+         _mongoc_buffer_init (&buffer, NULL, 0, NULL, NULL);
+         if (!mongoc_cluster_try_recv (
+                cluster, &rpc, &buffer, server_stream, &pcmd->error)) {
+            /* try_recv closed the connection */
+            server_stream->stream = NULL;
+            _mongoc_buffer_destroy (&buffer);
+            break;
+         }
+
+         if (rpc.header.opcode != MONGOC_OPCODE_MSG ||
+             rpc.header.response_to != pcmd->request_id ||
+             !_mongoc_rpc_get_first_document (&rpc, &reply_local)) {
+            bson_set_error (&pcmd->error,
+                            MONGOC_ERROR_PROTOCOL,
+                            MONGOC_ERROR_PROTOCOL_INVALID_REPLY,
+                            "Malformed message from server");
+            _handle_network_error (cluster,
+                                   server_stream,
+                                   true /* handshake complete */,
+                                   &pcmd->error);
+            server_stream->stream = NULL;
+            _mongoc_buffer_destroy (&buffer);
+            break;
+         }
+
+         pcmd->duration = bson_get_monotonic_time () - started;
+         _mongoc_topology_update_cluster_time (cluster->client->topology,
+                                               &reply_local);
+         pcmd->ok = _mongoc_cmd_check_ok (
+            &reply_local, cluster->client->error_api_version, &pcmd->error);
+
+         cmd = cmds[n_replied];
+         if (cmd->session) {
+            _mongoc_client_session_handle_reply (
+               cmd->session, true, cmd->command_name, &reply_local);
+         }
+
+         bson_destroy (&replies[n_replied]);
+         bson_copy_to (&reply_local, &replies[n_replied]);
+         _mongoc_buffer_destroy (&buffer);
+
+         mongoc_server_load_record_op_time (server_stream->load,
+                                            pcmd->duration);
+      }
+
+      if (n_replied < n_sent) {
+         /* a reply failed, the connection is closed */
+         break;
+      }
+   }
+
+   /* the commands without a reply all fail with the network error */
+   for (i = n_replied; i < n_cmds; i++) {
+      pcmds[i].duration = bson_get_monotonic_time () - started;
+      if (i > n_replied) {
+         memcpy (
+            &pcmds[i].error, &pcmds[n_replied].error, sizeof (bson_error_t));
+      }
+
+      bson_destroy (&replies[i]);
+      network_error_reply (&replies[i], cmds[i]);
+   }
+
+   /* publish the results only once the stream is no longer needed, since
+    * handling a "not primary" reply may close it */
+   for (i = 0; i < n_cmds; i++) {
+      cmd = cmds[i];
+      pcmd = &pcmds[i];
+
+      if (pcmd->ok && callbacks->succeeded) {
+         mongoc_apm_command_succeeded_init (&succeeded_event,
+                                            pcmd->duration,
+                                            &replies[i],
+                                            cmd->command_name,
+                                            pcmd->request_id,
+                                            cmd->operation_id,
+                                            &server_stream->sd->host,
+                                            server_stream->sd->id,
+                                            &server_stream->sd->service_id,
+                                            pcmd->is_redacted,
+                                            cluster->client->apm_context);
+
+         callbacks->succeeded (&succeeded_event);
+         mongoc_apm_command_succeeded_cleanup (&succeeded_event);
+      }
+
+      if (!pcmd->ok && callbacks->failed) {
+         mongoc_apm_command_failed_init (&failed_event,
+                                         pcmd->duration,
+                                         cmd->command_name,
+                                         &pcmd->error,
+                                         &replies[i],
+                                         pcmd->request_id,
+                                         cmd->operation_id,
+                                         &server_stream->sd->host,
+                                         server_stream->sd->id,
+                                         &server_stream->sd->service_id,
+                                         pcmd->is_redacted,
+                                         cluster->client->apm_context);
+
+         callbacks->failed (&failed_event);
+         mongoc_apm_command_failed_cleanup (&failed_event);
+      }
+
+      if (i < n_replied) {
+         _handle_not_primary_error (cluster, server_stream, &replies[i]);
+      }
+
+      if (!pcmd->ok && !first_error) {
+         first_error = &pcmd->error;
+      }
+   }
+
+   if (first_error && error) {
+      memcpy (error, first_error, sizeof (bson_error_t));
+   }
+
+   _mongoc_topology_update_last_used (cluster->client->topology,
+                                      server_stream->sd->id);
+
+   bson_free (pcmds);
+
+   RETURN (!first_error);
+}
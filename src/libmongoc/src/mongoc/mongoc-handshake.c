@@ -198,6 +198,18 @@ _mongoc_handshake_get_config_hex_string (void)
    _set_bit (bf, byte_count, MONGOC_MD_FLAG_ENABLE_MONGODB_AWS_AUTH);
 #endif
 
+#ifdef MONGOC_ENABLE_EPOLL
+   _set_bit (bf, byte_count, MONGOC_MD_FLAG_ENABLE_EPOLL);
+#endif
+
+#ifdef MONGOC_ENABLE_IO_URING
+   _set_bit (bf, byte_count, MONGOC_MD_FLAG_ENABLE_IO_URING);
+#endif
+
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   _set_bit (bf, byte_count, MONGOC_MD_FLAG_ENABLE_ZEROCOPY);
+#endif
+
    str = bson_string_new ("0x");
    for (i = 0; i < byte_count; i++) {
       bson_string_append_printf (str, "%02x", bf[i]);
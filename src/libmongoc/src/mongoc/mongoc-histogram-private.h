@@ -0,0 +1,53 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#include "bson/bson.h"
+
+#ifndef MONGOC_HISTOGRAM_PRIVATE_H
+#define MONGOC_HISTOGRAM_PRIVATE_H
+
+/* Each power of two is split into this many buckets, so a value is known to
+ * within 1/8 of itself. Values below this are counted exactly. */
+#define MONGOC_HISTOGRAM_SUB_BUCKETS 8
+/* Values of 2^40 microseconds (about 12 days) or more share the last bucket */
+#define MONGOC_HISTOGRAM_MAX_BITS 40
+#define MONGOC_HISTOGRAM_N_BUCKETS \
+   (MONGOC_HISTOGRAM_SUB_BUCKETS * (MONGOC_HISTOGRAM_MAX_BITS - 2))
+/* Once this many samples are counted, all counts are halved, so the histogram
+ * follows recent samples rather than the whole history. */
+#define MONGOC_HISTOGRAM_DECAY_SAMPLES 1024
+
+/* mongoc_histogram_t is a streaming histogram of durations in microseconds,
+ * in the manner of HdrHistogram: buckets grow wider with the magnitude of the
+ * value. It may be updated and read from several threads at once. */
+typedef struct _mongoc_histogram_t {
+   int32_t total;
+   int32_t decaying;
+   int32_t counts[MONGOC_HISTOGRAM_N_BUCKETS];
+} mongoc_histogram_t;
+
+void
+mongoc_histogram_record (mongoc_histogram_t *histogram, int64_t usec);
+
+/* Returns an estimate of the given percentile (0 to 100) of the recorded
+ * values in microseconds, or -1 if there are none. */
+int64_t
+mongoc_histogram_percentile (const mongoc_histogram_t *histogram,
+                             double percentile);
+
+#endif /* MONGOC_HISTOGRAM_PRIVATE_H */
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-histogram-private.h"
+
+
+static int
+_bucket_for_value (int64_t usec)
+{
+   int msb = 0;
+
+   if (usec < MONGOC_HISTOGRAM_SUB_BUCKETS) {
+      return (int) BSON_MAX (usec, 0);
+   }
+
+   usec = BSON_MIN (usec, ((int64_t) 1 << MONGOC_HISTOGRAM_MAX_BITS) - 1);
+   while (usec >> (msb + 1)) {
+      msb++;
+   }
+
+   /* msb is at least 3. the three bits below the most significant one choose
+    * the bucket within its power of two */
+   return MONGOC_HISTOGRAM_SUB_BUCKETS * (msb - 2) +
+          (int) ((usec >> (msb - 3)) & (MONGOC_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+
+/* the middle of the range of values counted in the bucket */
+static int64_t
+_value_for_bucket (int bucket)
+{
+   int msb;
+   int64_t sub;
+
+   if (bucket < MONGOC_HISTOGRAM_SUB_BUCKETS) {
+      return bucket;
+   }
+
+   msb = bucket / MONGOC_HISTOGRAM_SUB_BUCKETS + 2;
+   sub = bucket % MONGOC_HISTOGRAM_SUB_BUCKETS;
+
+   return ((MONGOC_HISTOGRAM_SUB_BUCKETS + sub) << (msb - 3)) +
+          (((int64_t) 1 << (msb - 3)) >> 1);
+}
+
+
+static void
+_mongoc_histogram_decay (mongoc_histogram_t *histogram)
+{
+   int32_t removed = 0;
+   int32_t count;
+   int i;
+
+   for (i = 0; i < MONGOC_HISTOGRAM_N_BUCKETS; i++) {
+      count = bson_atomic_int32_fetch (&histogram->counts[i],
+                                       bson_memory_order_relaxed);
+      if (count) {
+         /* round up, so single samples are eventually forgotten */
+         count -= count / 2;
+         bson_atomic_int32_fetch_add (
+            &histogram->counts[i], -count, bson_memory_order_relaxed);
+         removed += count;
+      }
+   }
+
+   bson_atomic_int32_fetch_add (
+      &histogram->total, -removed, bson_memory_order_relaxed);
+}
+
+
+void
+mongoc_histogram_record (mongoc_histogram_t *histogram, int64_t usec)
+{
+   int32_t total;
+
+   BSON_ASSERT_PARAM (histogram);
+
+   bson_atomic_int32_fetch_add (&histogram->counts[_bucket_for_value (usec)],
+                                1,
+                                bson_memory_order_relaxed);
+   total = bson_atomic_int32_fetch_add (
+              &histogram->total, 1, bson_memory_order_relaxed) +
+           1;
+
+   /* a thread recording at the same time may see slightly inconsistent
+    * counts, which does not matter for an estimate */
+   if (total >= MONGOC_HISTOGRAM_DECAY_SAMPLES &&
+       bson_atomic_int32_compare_exchange_strong (
+          &histogram->decaying, 0, 1, bson_memory_order_acquire) == 0) {
+      _mongoc_histogram_decay (histogram);
+      bson_atomic_int32_exchange (
+         &histogram->decaying, 0, bson_memory_order_release);
+   }
+}
+
+
+int64_t
+mongoc_histogram_percentile (const mongoc_histogram_t *histogram,
+                             double percentile)
+{
+   int32_t counts[MONGOC_HISTOGRAM_N_BUCKETS];
+   int64_t total = 0;
+   double exact_rank;
+   int64_t rank;
+   int64_t seen = 0;
+   int i;
+
+   BSON_ASSERT_PARAM (histogram);
+
+   for (i = 0; i < MONGOC_HISTOGRAM_N_BUCKETS; i++) {
+      counts[i] = BSON_MAX (bson_atomic_int32_fetch (&histogram->counts[i],
+                                                     bson_memory_order_relaxed),
+                            0);
+      total += counts[i];
+   }
+
+   if (total == 0) {
+      return -1;
+   }
+
+   /* the smallest value with at least percentile% of the values at or below
+    * it: find the value of rank ceil (percentile% * total) */
+   exact_rank = BSON_MIN (BSON_MAX (percentile, 0.0), 100.0) / 100.0 *
+                (double) total;
+   rank = (int64_t) exact_rank;
+   if ((double) rank < exact_rank || rank == 0) {
+      rank++;
+   }
+
+   for (i = 0; i < MONGOC_HISTOGRAM_N_BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+         return _value_for_bucket (i);
+      }
+   }
+
+   return _value_for_bucket (MONGOC_HISTOGRAM_N_BUCKETS - 1);
+}
@@ -60,6 +60,8 @@ void
 _mongoc_queue_push_head (mongoc_queue_t *queue, void *data);
 void
 _mongoc_queue_push_tail (mongoc_queue_t *queue, void *data);
+bool
+_mongoc_queue_remove (mongoc_queue_t *queue, const void *data);
 uint32_t
 _mongoc_queue_get_length (const mongoc_queue_t *queue);
 
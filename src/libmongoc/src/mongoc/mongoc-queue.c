@@ -130,6 +130,39 @@ _mongoc_queue_pop_tail (mongoc_queue_t *queue)
 }
 
 
+/* Remove the first item holding @data. Returns false if there is none. */
+bool
+_mongoc_queue_remove (mongoc_queue_t *queue, const void *data)
+{
+   mongoc_queue_item_t *prev = NULL;
+   mongoc_queue_item_t *item;
+
+   BSON_ASSERT (queue);
+
+   for (item = queue->head; item; prev = item, item = item->next) {
+      if (item->data != data) {
+         continue;
+      }
+
+      if (prev) {
+         prev->next = item->next;
+      } else {
+         queue->head = item->next;
+      }
+
+      if (queue->tail == item) {
+         queue->tail = prev;
+      }
+
+      bson_free (item);
+      queue->length--;
+      return true;
+   }
+
+   return false;
+}
+
+
 uint32_t
 _mongoc_queue_get_length (const mongoc_queue_t *queue)
 {
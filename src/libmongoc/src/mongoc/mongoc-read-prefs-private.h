@@ -30,6 +30,9 @@ BSON_BEGIN_DECLS
 struct _mongoc_read_prefs_t {
    mongoc_read_mode_t mode;
    bson_t tags;
+   /* hash of the tags document, kept up to date by the setters so server
+    * selection can compare tag sets cheaply. zero if there are no tags. */
+   uint32_t tags_hash;
    int64_t max_staleness_seconds;
    bson_t hedge;
 };
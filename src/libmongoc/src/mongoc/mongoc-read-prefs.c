@@ -20,6 +20,27 @@
 #include "mongoc-trace-private.h"
 
 
+/* FNV-1a over the raw tags document */
+static uint32_t
+_mongoc_read_prefs_hash_tags (const bson_t *tags)
+{
+   const uint8_t *data;
+   uint32_t hash = 2166136261u;
+   uint32_t i;
+
+   if (bson_empty (tags)) {
+      return 0;
+   }
+
+   data = bson_get_data (tags);
+   for (i = 0; i < tags->len; i++) {
+      hash = (hash ^ data[i]) * 16777619u;
+   }
+
+   return hash;
+}
+
+
 mongoc_read_prefs_t *
 mongoc_read_prefs_new (mongoc_read_mode_t mode)
 {
@@ -73,6 +94,8 @@ mongoc_read_prefs_set_tags (mongoc_read_prefs_t *read_prefs, const bson_t *tags)
    } else {
       bson_init (&read_prefs->tags);
    }
+
+   read_prefs->tags_hash = _mongoc_read_prefs_hash_tags (&read_prefs->tags);
 }
 
 
@@ -94,6 +117,7 @@ mongoc_read_prefs_add_tag (mongoc_read_prefs_t *read_prefs, const bson_t *tag)
       bson_append_document (&read_prefs->tags, str, -1, &empty);
    }
 
+   read_prefs->tags_hash = _mongoc_read_prefs_hash_tags (&read_prefs->tags);
    bson_destroy (&empty);
 }
 
@@ -188,6 +212,7 @@ mongoc_read_prefs_copy (const mongoc_read_prefs_t *read_prefs)
       ret = mongoc_read_prefs_new (read_prefs->mode);
       bson_destroy (&ret->tags);
       bson_copy_to (&read_prefs->tags, &ret->tags);
+      ret->tags_hash = read_prefs->tags_hash;
       ret->max_staleness_seconds = read_prefs->max_staleness_seconds;
       bson_destroy (&ret->hedge);
       bson_copy_to (&read_prefs->hedge, &ret->hedge);
@@ -176,6 +176,13 @@ _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
                       mongoc_rpc_t *rpc_le,
                       bson_error_t *error);
 
+char *
+_mongoc_rpc_compress_iov (int32_t compressor_id,
+                          int32_t compression_level,
+                          mongoc_rpc_t *rpc_le,
+                          mongoc_array_t *iov,
+                          bson_error_t *error);
+
 bool
 _mongoc_rpc_decompress_if_necessary (mongoc_rpc_t *rpc,
                                      mongoc_buffer_t *buffer,
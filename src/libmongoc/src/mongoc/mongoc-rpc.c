@@ -832,11 +832,6 @@ _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
                       mongoc_rpc_t *rpc_le,
                       bson_error_t *error)
 {
-   char *output;
-   size_t output_length = 0;
-   size_t allocate = BSON_UINT32_FROM_LE (rpc_le->header.msg_len) - 16;
-   char *data;
-   int size;
    int32_t compression_level = -1;
 
    if (compressor_id == MONGOC_COMPRESSOR_ZLIB_ID) {
@@ -844,10 +839,45 @@ _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
          cluster->uri, MONGOC_URI_ZLIBCOMPRESSIONLEVEL, -1);
    }
 
+   return _mongoc_rpc_compress_iov (
+      compressor_id, compression_level, rpc_le, &cluster->iov, error);
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_rpc_compress_iov --
+ *
+ *       Like _mongoc_rpc_compress, for an rpc gathered into @iov rather
+ *       than into the cluster buffer.
+ *
+ * Returns:
+ *       The compressed message, which @iov points into and the caller
+ *       must free, or NULL on failure.
+ *
+ * Side effects:
+ *       Overwrites the RPC, and clears and overwrites @iov with the
+ *       compressed results.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+char *
+_mongoc_rpc_compress_iov (int32_t compressor_id,
+                          int32_t compression_level,
+                          mongoc_rpc_t *rpc_le,
+                          mongoc_array_t *iov,
+                          bson_error_t *error)
+{
+   char *output;
+   size_t output_length = 0;
+   size_t allocate = BSON_UINT32_FROM_LE (rpc_le->header.msg_len) - 16;
+   char *data;
+   int size;
+
    BSON_ASSERT (allocate > 0);
    data = bson_malloc0 (allocate);
-   size = _mongoc_cluster_buffer_iovec (
-      cluster->iov.data, cluster->iov.len, 16, data);
+   size = _mongoc_cluster_buffer_iovec (iov->data, iov->len, 16, data);
    BSON_ASSERT (size);
 
    output_length =
@@ -885,9 +915,9 @@ _mongoc_rpc_compress (struct _mongoc_cluster_t *cluster,
       bson_free (data);
 
 
-      _mongoc_array_destroy (&cluster->iov);
-      _mongoc_array_init (&cluster->iov, sizeof (mongoc_iovec_t));
-      _mongoc_rpc_gather (rpc_le, &cluster->iov);
+      _mongoc_array_destroy (iov);
+      _mongoc_array_init (iov, sizeof (mongoc_iovec_t));
+      _mongoc_rpc_gather (rpc_le, iov);
       _mongoc_rpc_swab_to_le (rpc_le);
       return output;
    } else {
@@ -985,11 +1015,22 @@ _mongoc_rpc_scatter_reply_header_only (mongoc_rpc_t *rpc,
 bool
 _mongoc_rpc_get_first_document (mongoc_rpc_t *rpc, bson_t *reply)
 {
+   int32_t len;
+
    if (rpc->header.opcode == MONGOC_OPCODE_REPLY &&
        _mongoc_rpc_reply_get_first (&rpc->reply, reply)) {
       return true;
    }
 
+   /* the body of an OP_MSG reply is its first, kind 0 section */
+   if (rpc->header.opcode == MONGOC_OPCODE_MSG && rpc->msg.n_sections > 0 &&
+       rpc->msg.sections[0].payload_type == 0) {
+      memcpy (&len, rpc->msg.sections[0].payload.bson_document, 4);
+      len = BSON_UINT32_FROM_LE (len);
+      return bson_init_static (
+         reply, rpc->msg.sections[0].payload.bson_document, len);
+   }
+
    return false;
 }
 
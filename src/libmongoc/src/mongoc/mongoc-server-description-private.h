@@ -21,6 +21,7 @@
 
 #include "mongoc-server-description.h"
 #include "mongoc-generation-map-private.h"
+#include "mongoc-histogram-private.h"
 
 
 #define MONGOC_DEFAULT_WIRE_VERSION 0
@@ -59,6 +60,19 @@ typedef enum {
    MONGOC_SERVER_DESCRIPTION_TYPES,
 } mongoc_server_description_type_t;
 
+/* The number of operations in progress on a server and its recent latencies.
+ * It is allocated for server descriptions added to a topology description,
+ * and shared by all copies made from them, so it follows the server across
+ * topology description updates. */
+typedef struct _mongoc_server_load_t {
+   int32_t refs;
+   int32_t in_flight;
+   /* heartbeat round trip times */
+   mongoc_histogram_t rtt;
+   /* durations of commands run on the server */
+   mongoc_histogram_t op_time;
+} mongoc_server_load_t;
+
 struct _mongoc_server_description_t {
    uint32_t id;
    mongoc_host_list_t host;
@@ -123,6 +137,19 @@ struct _mongoc_server_description_t {
     * service IDs. The only server generation is mapped from kZeroServiceID */
    mongoc_generation_map_t *_generation_map_;
    bson_oid_t service_id;
+
+   /* The number of topology descriptions sharing this server description,
+    * less one. A topology description must not modify a server description
+    * that is shared; see mongoc_topology_description_server_by_id. */
+   int32_t _shared_;
+
+   /* operations in progress, counted by mongoc_server_stream_t */
+   mongoc_server_load_t *_load_;
+
+   /* A heartbeat round trip time in microseconds measured while this
+    * description was modified, or -1. It is recorded in _load_ when the
+    * topology description is published. */
+   int64_t rtt_sample_usec;
 };
 
 /** Get a mutable pointer to the server's generation map */
@@ -198,12 +225,47 @@ void
 mongoc_server_description_update_rtt (mongoc_server_description_t *server,
                                       int64_t rtt_msec);
 
+void
+mongoc_server_description_set_rtt_sample (mongoc_server_description_t *sd,
+                                          int64_t rtt_usec);
+
+void
+mongoc_server_description_init_load (mongoc_server_description_t *sd);
+
+void
+mongoc_server_description_publish (mongoc_server_description_t *sd);
+
 void
 mongoc_server_description_handle_hello (mongoc_server_description_t *sd,
                                         const bson_t *hello_response,
                                         int64_t rtt_msec,
                                         const bson_error_t *error /* IN */);
 
+bool
+_mongoc_server_description_hello_unchanged (
+   const mongoc_server_description_t *sd,
+   const bson_t *hello_response,
+   int64_t *last_write_date_ms);
+
+void
+mongoc_server_description_handle_unchanged_hello (
+   mongoc_server_description_t *sd,
+   int64_t rtt_msec,
+   int64_t last_write_date_ms);
+
+mongoc_server_load_t *
+mongoc_server_description_begin_op (const mongoc_server_description_t *sd);
+
+void
+mongoc_server_load_end_op (mongoc_server_load_t *load);
+
+void
+mongoc_server_load_record_op_time (mongoc_server_load_t *load, int64_t usec);
+
+int32_t
+mongoc_server_description_ops_in_flight (
+   const mongoc_server_description_t *sd);
+
 void
 mongoc_server_description_filter_stale (
    const mongoc_server_description_t **sds,
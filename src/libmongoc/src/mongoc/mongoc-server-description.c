@@ -24,6 +24,7 @@
 #include "mongoc-uri.h"
 #include "mongoc-util-private.h"
 #include "mongoc-compression-private.h"
+#include "mongoc-counters-private.h"
 
 #include <stdio.h>
 
@@ -39,6 +40,27 @@ static bool
 _match_tag_set (const mongoc_server_description_t *sd,
                 bson_iter_t *tag_set_iter);
 
+
+static mongoc_server_load_t *
+_mongoc_server_load_ref (mongoc_server_load_t *load)
+{
+   if (load) {
+      bson_atomic_int32_fetch_add (&load->refs, 1, bson_memory_order_relaxed);
+   }
+
+   return load;
+}
+
+
+static void
+_mongoc_server_load_unref (mongoc_server_load_t *load)
+{
+   if (load && bson_atomic_int32_fetch_add (
+                  &load->refs, -1, bson_memory_order_acq_rel) == 1) {
+      bson_free (load);
+   }
+}
+
 /* Destroy allocated resources within @description, but don't free it */
 void
 mongoc_server_description_cleanup (mongoc_server_description_t *sd)
@@ -53,6 +75,7 @@ mongoc_server_description_cleanup (mongoc_server_description_t *sd)
    bson_destroy (&sd->compressors);
    bson_destroy (&sd->topology_version);
    mongoc_generation_map_destroy (sd->_generation_map_);
+   _mongoc_server_load_unref (sd->_load_);
 }
 
 /* Reset fields inside this sd, but keep same id, host information, RTT,
@@ -131,6 +154,8 @@ mongoc_server_description_init (mongoc_server_description_t *sd,
    sd->generation = 0;
    sd->opened = 0;
    sd->_generation_map_ = mongoc_generation_map_new ();
+   sd->_load_ = NULL;
+   sd->rtt_sample_usec = -1;
 
    if (!_mongoc_host_list_from_string (&sd->host, address)) {
       MONGOC_WARNING ("Failed to parse uri for %s", address);
@@ -334,6 +359,69 @@ mongoc_server_description_round_trip_time (
    return description->round_trip_time_msec;
 }
 
+
+static double
+_histogram_percentile_ms (const mongoc_histogram_t *histogram,
+                          double percentile)
+{
+   int64_t usec;
+
+   if (!histogram) {
+      return -1;
+   }
+
+   usec = mongoc_histogram_percentile (histogram, percentile);
+   return usec < 0 ? -1 : (double) usec / 1000.0;
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_server_description_round_trip_time_percentile --
+ *
+ *      Estimate a percentile of the server's recent round trip times, in
+ *      milliseconds.
+ *
+ * Returns:
+ *      The estimate, or -1 if no round trip time has been measured.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+double
+mongoc_server_description_round_trip_time_percentile (
+   const mongoc_server_description_t *description, double percentile)
+{
+   BSON_ASSERT_PARAM (description);
+
+   return _histogram_percentile_ms (
+      description->_load_ ? &description->_load_->rtt : NULL, percentile);
+}
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * mongoc_server_description_operation_time_percentile --
+ *
+ *      Estimate a percentile of the durations of recent commands run on
+ *      the server, in milliseconds.
+ *
+ * Returns:
+ *      The estimate, or -1 if no command has completed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+double
+mongoc_server_description_operation_time_percentile (
+   const mongoc_server_description_t *description, double percentile)
+{
+   BSON_ASSERT_PARAM (description);
+
+   return _histogram_percentile_ms (
+      description->_load_ ? &description->_load_->op_time : NULL, percentile);
+}
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -513,6 +601,79 @@ mongoc_server_description_update_rtt (mongoc_server_description_t *server,
 }
 
 
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_server_description_set_rtt_sample --
+ *
+ *       Keep a heartbeat round trip time in microseconds, to be recorded
+ *       in the server's round trip time histogram by
+ *       mongoc_server_description_publish. Replaces any earlier sample.
+ *
+ *-------------------------------------------------------------------------
+ */
+void
+mongoc_server_description_set_rtt_sample (mongoc_server_description_t *sd,
+                                          int64_t rtt_usec)
+{
+   BSON_ASSERT_PARAM (sd);
+
+   sd->rtt_sample_usec = rtt_usec;
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_server_description_init_load --
+ *
+ *       Start counting operations and latencies for a server description
+ *       added to a topology description. Other server descriptions, such as
+ *       those built from a handshake or kept by a monitor, have no load.
+ *
+ *-------------------------------------------------------------------------
+ */
+void
+mongoc_server_description_init_load (mongoc_server_description_t *sd)
+{
+   BSON_ASSERT_PARAM (sd);
+
+   if (!sd->_load_) {
+      sd->_load_ = bson_malloc0 (sizeof (mongoc_server_load_t));
+      sd->_load_->refs = 1;
+   }
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_server_description_publish --
+ *
+ *       Called as the topology description holding @sd is published.
+ *       Records the round trip time sample, if any, in the load shared with
+ *       earlier copies of @sd, so that a modification that is dropped
+ *       records nothing.
+ *
+ *-------------------------------------------------------------------------
+ */
+void
+mongoc_server_description_publish (mongoc_server_description_t *sd)
+{
+   BSON_ASSERT_PARAM (sd);
+
+   if (sd->rtt_sample_usec < 0) {
+      return;
+   }
+
+   if (sd->_load_) {
+      mongoc_histogram_record (&sd->_load_->rtt, sd->rtt_sample_usec);
+   }
+
+   sd->rtt_sample_usec = -1;
+}
+
+
 static void
 _mongoc_server_description_set_error (mongoc_server_description_t *sd,
                                       const bson_error_t *error)
@@ -789,6 +950,133 @@ failure:
    EXIT;
 }
 
+
+/* Fields of a hello reply that differ from one reply to the next without the
+ * server's state having changed. */
+static bool
+_is_volatile_hello_field (const char *key)
+{
+   return !strcmp (key, "localTime") || !strcmp (key, "$clusterTime") ||
+          !strcmp (key, "operationTime") || !strcmp (key, "lastWrite");
+}
+
+
+static bool
+_next_stable_hello_field (bson_iter_t *iter)
+{
+   while (bson_iter_next (iter)) {
+      if (!_is_volatile_hello_field (bson_iter_key (iter))) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * _mongoc_server_description_hello_unchanged --
+ *
+ *       Whether @hello_response describes the same server state as the
+ *       reply @sd was built from, differing only in fields that change
+ *       with every reply. If so, @sd is brought up to date by
+ *       mongoc_server_description_handle_unchanged_hello instead of being
+ *       rebuilt, and @last_write_date_ms is set to the reply's
+ *       lastWrite.lastWriteDate, or -1 if it has none.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_server_description_hello_unchanged (
+   const mongoc_server_description_t *sd,
+   const bson_t *hello_response,
+   int64_t *last_write_date_ms)
+{
+   bson_iter_t prev_iter;
+   bson_iter_t iter;
+   bson_iter_t child;
+   bool has_prev;
+   bool has_next;
+
+   BSON_ASSERT_PARAM (sd);
+   BSON_ASSERT_PARAM (hello_response);
+   BSON_ASSERT_PARAM (last_write_date_ms);
+
+   if (!sd->has_hello_response || sd->error.code ||
+       sd->type == MONGOC_SERVER_UNKNOWN) {
+      return false;
+   }
+
+   *last_write_date_ms = -1;
+   if (bson_iter_init_find (&iter, hello_response, "lastWrite")) {
+      if (!BSON_ITER_HOLDS_DOCUMENT (&iter) ||
+          !bson_iter_recurse (&iter, &child) ||
+          !bson_iter_find (&child, "lastWriteDate") ||
+          !BSON_ITER_HOLDS_DATE_TIME (&child)) {
+         return false;
+      }
+
+      *last_write_date_ms = bson_iter_date_time (&child);
+   }
+
+   if ((*last_write_date_ms == -1) != (sd->last_write_date_ms == -1)) {
+      return false;
+   }
+
+   if (!bson_iter_init (&prev_iter, &sd->last_hello_response) ||
+       !bson_iter_init (&iter, hello_response)) {
+      return false;
+   }
+
+   while (true) {
+      has_prev = _next_stable_hello_field (&prev_iter);
+      has_next = _next_stable_hello_field (&iter);
+      if (!has_prev || !has_next) {
+         return has_prev == has_next;
+      }
+
+      /* compare whole elements: type, key, and value */
+      if (prev_iter.next_off - prev_iter.off != iter.next_off - iter.off ||
+          memcmp (prev_iter.raw + prev_iter.off,
+                  iter.raw + iter.off,
+                  iter.next_off - iter.off) != 0) {
+         return false;
+      }
+   }
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_server_description_handle_unchanged_hello --
+ *
+ *       Update @sd with a reply for which
+ *       _mongoc_server_description_hello_unchanged returned true. Only the
+ *       round trip time, last write date, and last update time change. The
+ *       reply @sd was built from is kept. @sd must not be visible to other
+ *       threads, e.g. it belongs to a topology description that is being
+ *       modified.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+void
+mongoc_server_description_handle_unchanged_hello (
+   mongoc_server_description_t *sd,
+   int64_t rtt_msec,
+   int64_t last_write_date_ms)
+{
+   BSON_ASSERT_PARAM (sd);
+
+   mongoc_server_description_update_rtt (sd, rtt_msec);
+   sd->last_write_date_ms = last_write_date_ms;
+   sd->last_update_time_usec = bson_get_monotonic_time ();
+}
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -814,6 +1102,7 @@ mongoc_server_description_new_copy (
    copy->opened = description->opened;
    memcpy (&copy->host, &description->host, sizeof (copy->host));
    copy->round_trip_time_msec = MONGOC_RTT_UNSET;
+   copy->rtt_sample_usec = -1;
 
    copy->connection_address = copy->host.host_and_port;
    bson_init (&copy->last_hello_response);
@@ -833,6 +1122,10 @@ mongoc_server_description_new_copy (
                                               &description->last_hello_response,
                                               last_rtt_ms,
                                               &description->error);
+      /* keep the fields that unchanged replies update without replacing
+       * last_hello_response */
+      copy->last_write_date_ms = description->last_write_date_ms;
+      copy->last_update_time_usec = description->last_update_time_usec;
    } else {
       mongoc_server_description_reset (copy);
       /* preserve the original server description type, which is manually set
@@ -846,10 +1139,78 @@ mongoc_server_description_new_copy (
    copy->generation = description->generation;
    copy->_generation_map_ =
       mongoc_generation_map_copy (mc_tpl_sd_generation_map_const (description));
+   copy->_load_ = _mongoc_server_load_ref (description->_load_);
    return copy;
 }
 
 
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_server_description_begin_op --
+ *
+ *       Count an operation in progress on the server. Returns the
+ *       server's load, which must be passed to mongoc_server_load_end_op
+ *       once the operation completes, or NULL.
+ *
+ *-------------------------------------------------------------------------
+ */
+mongoc_server_load_t *
+mongoc_server_description_begin_op (const mongoc_server_description_t *sd)
+{
+   mongoc_server_load_t *load;
+
+   BSON_ASSERT_PARAM (sd);
+
+   load = _mongoc_server_load_ref (sd->_load_);
+   if (load) {
+      bson_atomic_int32_fetch_add (
+         &load->in_flight, 1, bson_memory_order_relaxed);
+      mongoc_counter_server_ops_in_flight_inc ();
+   }
+
+   return load;
+}
+
+
+void
+mongoc_server_load_end_op (mongoc_server_load_t *load)
+{
+   if (!load) {
+      return;
+   }
+
+   bson_atomic_int32_fetch_add (
+      &load->in_flight, -1, bson_memory_order_relaxed);
+   mongoc_counter_server_ops_in_flight_dec ();
+   _mongoc_server_load_unref (load);
+}
+
+
+void
+mongoc_server_load_record_op_time (mongoc_server_load_t *load, int64_t usec)
+{
+   if (load) {
+      mongoc_histogram_record (&load->op_time, usec);
+   }
+}
+
+
+int32_t
+mongoc_server_description_ops_in_flight (
+   const mongoc_server_description_t *sd)
+{
+   BSON_ASSERT_PARAM (sd);
+
+   if (!sd->_load_) {
+      return 0;
+   }
+
+   return bson_atomic_int32_fetch (&sd->_load_->in_flight,
+                                   bson_memory_order_relaxed);
+}
+
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -50,6 +50,14 @@ MONGOC_EXPORT (int64_t)
 mongoc_server_description_round_trip_time (
    const mongoc_server_description_t *description);
 
+MONGOC_EXPORT (double)
+mongoc_server_description_round_trip_time_percentile (
+   const mongoc_server_description_t *description, double percentile);
+
+MONGOC_EXPORT (double)
+mongoc_server_description_operation_time_percentile (
+   const mongoc_server_description_t *description, double percentile);
+
 MONGOC_EXPORT (const char *)
 mongoc_server_description_type (const mongoc_server_description_t *description);
 
@@ -27,6 +27,16 @@
 
 typedef struct _mongoc_server_monitor_t mongoc_server_monitor_t;
 
+/* For servicing many server monitors from one thread. */
+
+typedef struct _mongoc_server_monitor_loop_t mongoc_server_monitor_loop_t;
+
+mongoc_server_monitor_loop_t *
+mongoc_server_monitor_loop_new (void);
+
+void
+mongoc_server_monitor_loop_destroy (mongoc_server_monitor_loop_t *loop);
+
 mongoc_server_monitor_t *
 mongoc_server_monitor_new (mongoc_topology_t *topology,
                            mongoc_topology_description_t *td,
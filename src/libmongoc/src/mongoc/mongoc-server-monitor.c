@@ -17,11 +17,18 @@
 #include "common-thread-private.h"
 #include "mongoc-server-monitor-private.h"
 
+#include "mongoc/mongoc-async-cmd-private.h"
+#include "mongoc/mongoc-async-private.h"
 #include "mongoc/mongoc-client-private.h"
+#include "mongoc/mongoc-counters-private.h"
 #include "mongoc/mongoc-error-private.h"
 #include "mongoc/mongoc-flags-private.h"
 #include "mongoc/mongoc-ssl-private.h"
 #include "mongoc/mongoc-stream-private.h"
+#include "mongoc/mongoc-stream-socket.h"
+#ifdef MONGOC_ENABLE_SSL
+#include "mongoc/mongoc-stream-tls.h"
+#endif
 #include "mongoc/mongoc-topology-background-monitoring-private.h"
 #include "mongoc/mongoc-topology-private.h"
 #include "mongoc/mongoc-trace-private.h"
@@ -87,6 +94,48 @@ struct _mongoc_server_monitor_t {
    mongoc_server_description_t *description;
    uint32_t server_id;
    bool is_rtt;
+
+   /* If set, the monitor is serviced by an event loop thread shared with other
+    * monitors instead of by a thread of its own. */
+   mongoc_server_monitor_loop_t *loop;
+
+   /* State accessed only by the event loop thread. */
+   struct {
+      /* An awaitable hello was sent, or moreToCome was set, and the reply is
+       * awaited until expire_at_ms. */
+      bool awaiting;
+      int64_t start_us;
+      int64_t expire_at_ms;
+      /* When the monitor began waiting, and when the next check is due. */
+      int64_t wait_start_ms;
+      int64_t due_ms;
+      mongoc_server_description_t *description;
+      mongoc_server_description_t *previous_description;
+      /* A handshake or polling hello in flight on the event loop's async
+       * commands, and whether it sets up a new connection. */
+      mongoc_async_cmd_t *acmd;
+      bool connecting;
+      /* Resolved addresses of the server, and the next one to connect to if
+       * connecting to the current one fails. */
+      struct addrinfo *dns_results;
+      struct addrinfo *dns_next;
+   } looped;
+};
+
+/* Services many server monitors from one thread. While a check is awaiting a
+ * streaming hello reply, the monitor's stream is polled together with the
+ * others instead of blocking a thread. Connection setup, polling hello, and
+ * RTT pings run as async commands polled along with them. */
+struct _mongoc_server_monitor_loop_t {
+   bson_thread_t thread;
+   bson_mutex_t mutex;
+   mongoc_cond_t cond;
+   /* Accessed only by the event loop thread. */
+   mongoc_async_t *async;
+   /* Protected by mutex. */
+   bool running;
+   bool wakeup;
+   mongoc_array_t monitors;
 };
 
 static BSON_GNUC_PRINTF (3, 4) void _server_monitor_log (
@@ -387,6 +436,13 @@ _server_monitor_poll_with_interrupt (mongoc_server_monitor_t *server_monitor,
    const int32_t monitor_tick_ms = MONGOC_TOPOLOGY_MIN_HEARTBEAT_FREQUENCY_MS;
    int64_t timeleft_ms;
 
+   /* Polling the socket misses a reply already read into a TLS or buffered
+    * stream. */
+   if (_mongoc_stream_has_pending_data (server_monitor->stream)) {
+      MONITOR_LOG (server_monitor, "reply already buffered");
+      return true;
+   }
+
    while ((timeleft_ms = expire_at_ms - _now_ms ()) > 0) {
       ssize_t ret;
       mongoc_stream_poll_t poller[1];
@@ -406,6 +462,10 @@ _server_monitor_poll_with_interrupt (mongoc_server_monitor_t *server_monitor,
          timeleft_ms);
       ret = mongoc_stream_poll (
          poller, 1, (int32_t) BSON_MIN (timeleft_ms, monitor_tick_ms));
+      if (ret == -1 && errno == EINTR) {
+         continue;
+      }
+
       if (ret == -1) {
          MONITOR_LOG (server_monitor, "mongoc_stream_poll error");
          bson_set_error (error,
@@ -577,22 +637,19 @@ fail:
    return ret;
 }
 
-/* Send and receive an awaitable hello.
+/* Send an awaitable hello.
  *
- * Called only from server monitor thread.
- * May lock server monitor mutex in functions that are called.
- * May block for up to heartbeatFrequencyMS waiting for reply.
+ * Called only from server monitor thread or event loop thread.
  */
 static bool
-_server_monitor_awaitable_hello (mongoc_server_monitor_t *server_monitor,
-                                 const mongoc_server_description_t *description,
-                                 bson_t *hello_response,
-                                 bool *cancelled,
-                                 bson_error_t *error)
+_server_monitor_awaitable_hello_begin (
+   mongoc_server_monitor_t *server_monitor,
+   const mongoc_server_description_t *description,
+   bson_error_t *error)
 {
    bson_t cmd;
    const bson_t *hello;
-   bool ret = false;
+   bool ret;
 
    hello = _mongoc_topology_scanner_get_monitoring_cmd (
       server_monitor->topology->scanner, description->hello_ok);
@@ -605,7 +662,28 @@ _server_monitor_awaitable_hello (mongoc_server_monitor_t *server_monitor,
       &cmd, "maxAwaitTimeMS", 14, server_monitor->heartbeat_frequency_ms);
    bson_append_utf8 (&cmd, "$db", 3, "admin", 5);
 
-   if (!_server_monitor_awaitable_hello_send (server_monitor, &cmd, error)) {
+   ret = _server_monitor_awaitable_hello_send (server_monitor, &cmd, error);
+   bson_destroy (&cmd);
+   return ret;
+}
+
+/* Send and receive an awaitable hello.
+ *
+ * Called only from server monitor thread.
+ * May lock server monitor mutex in functions that are called.
+ * May block for up to heartbeatFrequencyMS waiting for reply.
+ */
+static bool
+_server_monitor_awaitable_hello (mongoc_server_monitor_t *server_monitor,
+                                 const mongoc_server_description_t *description,
+                                 bson_t *hello_response,
+                                 bool *cancelled,
+                                 bson_error_t *error)
+{
+   bool ret = false;
+
+   if (!_server_monitor_awaitable_hello_begin (
+          server_monitor, description, error)) {
       GOTO (fail);
    }
 
@@ -620,7 +698,6 @@ fail:
    if (!ret) {
       bson_init (hello_response);
    }
-   bson_destroy (&cmd);
    return ret;
 }
 
@@ -635,6 +712,7 @@ _update_topology_description (mongoc_server_monitor_t *server_monitor,
                               mongoc_server_description_t *description)
 {
    mongoc_topology_t *topology;
+   mongoc_server_description_t *sd;
    bson_t *hello_response = NULL;
    mc_tpld_modification tdmod;
 
@@ -662,6 +740,14 @@ _update_topology_description (mongoc_server_monitor_t *server_monitor,
                                              hello_response,
                                              description->round_trip_time_msec,
                                              &description->error);
+   if (description->rtt_sample_usec >= 0) {
+      sd = mongoc_topology_description_server_by_id (
+         tdmod.new_td, server_monitor->server_id, NULL);
+      if (sd) {
+         mongoc_server_description_set_rtt_sample (
+            sd, description->rtt_sample_usec);
+      }
+   }
    /* Reconcile server monitors. */
    _mongoc_topology_background_monitoring_reconcile (topology, tdmod.new_td);
    /* Wake threads performing server selection. */
@@ -669,6 +755,76 @@ _update_topology_description (mongoc_server_monitor_t *server_monitor,
    mc_tpld_modify_commit (tdmod);
 }
 
+/* Update the topology description with a reply that describes the same server
+ * state as the previous one. The server description in the new topology
+ * description is brought up to date rather than rebuilt from the reply, and
+ * servers are not reconciled. If the topology description no longer reflects
+ * the previous reply, e.g. because an application thread marked the server
+ * Unknown, the reply is handled as usual.
+ *
+ * Called only from server monitor thread or event loop thread.
+ * Caller must hold no locks.
+ * Locks server monitor mutex and topology description mutex.
+ */
+static void
+_update_topology_description_unchanged (
+   mongoc_server_monitor_t *server_monitor,
+   const bson_t *hello_response,
+   int64_t rtt_us)
+{
+   mongoc_topology_t *topology;
+   mongoc_server_description_t *sd;
+   mongoc_server_description_t *description;
+   mc_tpld_modification tdmod;
+   int64_t rtt_ms = rtt_us < 0 ? MONGOC_RTT_UNSET : rtt_us / 1000;
+   int64_t last_write_date_ms;
+   bool updated = false;
+
+   topology = server_monitor->topology;
+   _mongoc_topology_update_cluster_time (topology, hello_response);
+
+   if (bson_atomic_int_fetch (&topology->scanner_state,
+                              bson_memory_order_relaxed) ==
+       MONGOC_TOPOLOGY_SCANNER_SHUTTING_DOWN) {
+      return;
+   }
+
+   /* The round trip time, last write date, and last update time are set
+    * together in an unpublished copy, so server selection never sees a last
+    * write date from one reply with the update time of another. */
+   tdmod = mc_tpld_modify_begin (topology);
+   bson_mutex_lock (&server_monitor->shared.mutex);
+   server_monitor->shared.scan_requested = false;
+   bson_mutex_unlock (&server_monitor->shared.mutex);
+   sd = mongoc_topology_description_server_by_id (
+      tdmod.new_td, server_monitor->server_id, NULL);
+   if (sd && _mongoc_server_description_hello_unchanged (
+                sd, hello_response, &last_write_date_ms)) {
+      mongoc_server_description_handle_unchanged_hello (
+         sd, rtt_ms, last_write_date_ms);
+      mongoc_server_description_set_rtt_sample (sd, rtt_us);
+      /* Wake threads performing server selection. */
+      mongoc_cond_broadcast (&topology->cond_client);
+      mc_tpld_modify_commit (tdmod);
+      updated = true;
+   } else {
+      mc_tpld_modify_drop (tdmod);
+   }
+
+   if (!updated) {
+      description = bson_malloc0 (sizeof (mongoc_server_description_t));
+      mongoc_server_description_init (
+         description,
+         server_monitor->description->connection_address,
+         server_monitor->description->id);
+      mongoc_server_description_handle_hello (
+         description, hello_response, rtt_ms, NULL);
+      mongoc_server_description_set_rtt_sample (description, rtt_us);
+      _update_topology_description (server_monitor, description);
+      mongoc_server_description_destroy (description);
+   }
+}
+
 /* Create a new server monitor.
  *
  * Called during reconcile.
@@ -706,11 +862,42 @@ mongoc_server_monitor_new (mongoc_topology_t *topology,
    server_monitor->apm_context = td->apm_context;
    server_monitor->initiator = topology->scanner->initiator;
    server_monitor->initiator_context = topology->scanner->initiator_context;
+   server_monitor->loop = topology->monitor_loop;
    mongoc_cond_init (&server_monitor->shared.cond);
    bson_mutex_init (&server_monitor->shared.mutex);
    return server_monitor;
 }
 
+/* Creates a connected stream, blocking until it is set up.
+ *
+ * Returns NULL and sets error on failure.
+ */
+static mongoc_stream_t *
+_server_monitor_connect (mongoc_server_monitor_t *server_monitor,
+                         bson_error_t *error)
+{
+   void *ssl_opts_void = NULL;
+
+   /* Using an initiator isn't really necessary. Users can't set them on
+    * pools. But it is used for tests. */
+   if (server_monitor->initiator) {
+      return server_monitor->initiator (server_monitor->uri,
+                                        &server_monitor->description->host,
+                                        server_monitor->initiator_context,
+                                        error);
+   }
+
+#ifdef MONGOC_ENABLE_SSL
+   ssl_opts_void = server_monitor->ssl_opts;
+#endif
+   return mongoc_client_connect (false,
+                                 ssl_opts_void != NULL,
+                                 ssl_opts_void,
+                                 server_monitor->uri,
+                                 &server_monitor->description->host,
+                                 error);
+}
+
 /* Creates a stream and performs the initial hello handshake.
  *
  * Called only by server monitor thread.
@@ -733,29 +920,7 @@ _server_monitor_setup_connection (mongoc_server_monitor_t *server_monitor,
    bson_init (hello_response);
 
    server_monitor->more_to_come = false;
-
-   /* Using an initiator isn't really necessary. Users can't set them on
-    * pools. But it is used for tests. */
-   if (server_monitor->initiator) {
-      server_monitor->stream =
-         server_monitor->initiator (server_monitor->uri,
-                                    &server_monitor->description->host,
-                                    server_monitor->initiator_context,
-                                    error);
-   } else {
-      void *ssl_opts_void = NULL;
-
-#ifdef MONGOC_ENABLE_SSL
-      ssl_opts_void = server_monitor->ssl_opts;
-#endif
-      server_monitor->stream =
-         mongoc_client_connect (false,
-                                ssl_opts_void != NULL,
-                                ssl_opts_void,
-                                server_monitor->uri,
-                                &server_monitor->description->host,
-                                error);
-   }
+   server_monitor->stream = _server_monitor_connect (server_monitor, error);
 
    if (!server_monitor->stream) {
       GOTO (fail);
@@ -779,6 +944,129 @@ fail:
    RETURN (ret);
 }
 
+/* Handle the outcome of a hello check.
+ *
+ * Publishes the heartbeat result, closes the connection on errors, and clears
+ * the connection pool on command or network errors. Destroys hello_response.
+ * Returns a new server description with the reply, or with the error
+ * information but no hello reply.
+ *
+ * Most replies to a streaming hello only differ from the previous one in their
+ * timestamps. Rather than parsing such a reply and replacing the topology
+ * description, previous_description and the topology description are updated
+ * in place, and NULL is returned.
+ */
+static mongoc_server_description_t *
+_server_monitor_check_finish (
+   mongoc_server_monitor_t *server_monitor,
+   mongoc_server_description_t *previous_description,
+   bool ret,
+   bson_t *hello_response,
+   int64_t start_us,
+   bool awaited,
+   bool cancelled,
+   bson_error_t *error)
+{
+   int64_t duration_us;
+   int64_t rtt_us = -1;
+   int64_t rtt_ms = MONGOC_RTT_UNSET;
+   int64_t last_write_date_ms;
+   bool ok;
+   bool command_or_network_error = false;
+   mongoc_server_description_t *description;
+   mc_tpld_modification tdmod;
+
+   duration_us = _now_us () - start_us;
+   MONITOR_LOG (
+      server_monitor, "server check duration (us): %" PRId64, duration_us);
+
+   /* rtt remains MONGOC_RTT_UNSET if awaited. */
+   if (!awaited) {
+      rtt_us = duration_us;
+      rtt_ms = duration_us / 1000;
+   }
+
+   /* If ret is true, we have a reply. Check if "ok": 1. */
+   ok = ret && _mongoc_cmd_check_ok (
+                  hello_response, MONGOC_ERROR_API_VERSION_2, error);
+
+   if (ok && _mongoc_server_description_hello_unchanged (
+                previous_description, hello_response, &last_write_date_ms)) {
+      MONITOR_LOG (server_monitor, "server state unchanged");
+      mongoc_server_description_handle_unchanged_hello (
+         previous_description, rtt_ms, last_write_date_ms);
+      _server_monitor_heartbeat_succeeded (
+         server_monitor, hello_response, duration_us, awaited);
+      _update_topology_description_unchanged (
+         server_monitor, hello_response, rtt_us);
+      bson_destroy (hello_response);
+      return NULL;
+   }
+
+   description = bson_malloc0 (sizeof (mongoc_server_description_t));
+   mongoc_server_description_init (
+      description,
+      server_monitor->description->connection_address,
+      server_monitor->description->id);
+
+   if (ok) {
+      mongoc_server_description_handle_hello (
+         description, hello_response, rtt_ms, NULL);
+      /* If the hello reply could not be parsed, consider this a command
+       * error. */
+      if (description->error.code) {
+         MONITOR_LOG_ERROR (server_monitor,
+                            "error parsing server reply: %s",
+                            description->error.message);
+         command_or_network_error = true;
+         _server_monitor_heartbeat_failed (
+            server_monitor, &description->error, duration_us, awaited);
+      } else {
+         mongoc_server_description_set_rtt_sample (description, rtt_us);
+         _server_monitor_heartbeat_succeeded (
+            server_monitor, hello_response, duration_us, awaited);
+      }
+   } else if (cancelled) {
+      MONITOR_LOG (server_monitor, "server monitor cancelled");
+      if (server_monitor->stream) {
+         mongoc_stream_destroy (server_monitor->stream);
+      }
+      server_monitor->stream = NULL;
+      server_monitor->more_to_come = false;
+      _server_monitor_heartbeat_failed (
+         server_monitor, &description->error, duration_us, awaited);
+   } else {
+      /* The hello reply had "ok":0 or a network error occurred. */
+      MONITOR_LOG_ERROR (server_monitor,
+                         "command or network error occurred: %s",
+                         error->message);
+      command_or_network_error = true;
+      mongoc_server_description_handle_hello (
+         description, NULL, MONGOC_RTT_UNSET, error);
+      _server_monitor_heartbeat_failed (
+         server_monitor, &description->error, duration_us, awaited);
+   }
+
+   if (command_or_network_error) {
+      if (server_monitor->stream) {
+         mongoc_stream_failed (server_monitor->stream);
+      }
+      server_monitor->stream = NULL;
+      server_monitor->more_to_come = false;
+      tdmod = mc_tpld_modify_begin (server_monitor->topology);
+      /* clear_connection_pool() is a no-op if 'description->id' was already
+       * removed. */
+      _mongoc_topology_description_clear_connection_pool (
+         tdmod.new_td,
+         server_monitor->description->id,
+         &server_monitor->description->service_id);
+      mc_tpld_modify_commit (tdmod);
+   }
+
+   bson_destroy (hello_response);
+   return description;
+}
+
 /**
  * @brief Perform a hello check on a server
  *
@@ -787,7 +1075,8 @@ fail:
  * server.
  * @param cancelled Output parameter: Whether the monitor check is cancelled.
  * @return mongoc_server_description_t* The newly created updated server
- * description.
+ * description, or NULL if the server's state is unchanged and
+ * previous_description was updated in place.
  *
  * @note May update the topology description associated with the server monitor.
  *
@@ -797,28 +1086,19 @@ fail:
 static mongoc_server_description_t *
 _server_monitor_check_server (
    mongoc_server_monitor_t *server_monitor,
-   const mongoc_server_description_t *previous_description,
+   mongoc_server_description_t *previous_description,
    bool *cancelled)
 {
    bool ret = false;
    bson_error_t error;
    bson_t hello_response;
-   int64_t duration_us;
    int64_t start_us;
-   bool command_or_network_error = false;
    bool awaited = false;
-   mongoc_server_description_t *description;
-   mc_tpld_modification tdmod;
 
    ENTRY;
 
    *cancelled = false;
    memset (&error, 0, sizeof (bson_error_t));
-   description = bson_malloc0 (sizeof (mongoc_server_description_t));
-   mongoc_server_description_init (
-      description,
-      server_monitor->description->connection_address,
-      server_monitor->description->id);
    start_us = _now_us ();
 
    if (!server_monitor->stream) {
@@ -859,74 +1139,31 @@ _server_monitor_check_server (
       server_monitor, previous_description->hello_ok, &hello_response, &error);
 
 exit:
-   duration_us = _now_us () - start_us;
-   MONITOR_LOG (
-      server_monitor, "server check duration (us): %" PRId64, duration_us);
-
-   /* If ret is true, we have a reply. Check if "ok": 1. */
-   if (ret && _mongoc_cmd_check_ok (
-                 &hello_response, MONGOC_ERROR_API_VERSION_2, &error)) {
-      int64_t rtt_ms = MONGOC_RTT_UNSET;
-
-      /* rtt remains MONGOC_RTT_UNSET if awaited. */
-      if (!awaited) {
-         rtt_ms = duration_us / 1000;
-      }
-
-      mongoc_server_description_handle_hello (
-         description, &hello_response, rtt_ms, NULL);
-      /* If the hello reply could not be parsed, consider this a command
-       * error. */
-      if (description->error.code) {
-         MONITOR_LOG_ERROR (server_monitor,
-                            "error parsing server reply: %s",
-                            description->error.message);
-         command_or_network_error = true;
-         _server_monitor_heartbeat_failed (
-            server_monitor, &description->error, duration_us, awaited);
-      } else {
-         _server_monitor_heartbeat_succeeded (
-            server_monitor, &hello_response, duration_us, awaited);
-      }
-   } else if (*cancelled) {
-      MONITOR_LOG (server_monitor, "server monitor cancelled");
-      if (server_monitor->stream) {
-         mongoc_stream_destroy (server_monitor->stream);
-      }
-      server_monitor->stream = NULL;
-      server_monitor->more_to_come = false;
-      _server_monitor_heartbeat_failed (
-         server_monitor, &description->error, duration_us, awaited);
-   } else {
-      /* The hello reply had "ok":0 or a network error occurred. */
-      MONITOR_LOG_ERROR (server_monitor,
-                         "command or network error occurred: %s",
-                         error.message);
-      command_or_network_error = true;
-      mongoc_server_description_handle_hello (
-         description, NULL, MONGOC_RTT_UNSET, &error);
-      _server_monitor_heartbeat_failed (
-         server_monitor, &description->error, duration_us, awaited);
-   }
+   RETURN (_server_monitor_check_finish (server_monitor,
+                                         previous_description,
+                                         ret,
+                                         &hello_response,
+                                         start_us,
+                                         awaited,
+                                         *cancelled,
+                                         &error));
+}
 
-   if (command_or_network_error) {
-      if (server_monitor->stream) {
-         mongoc_stream_failed (server_monitor->stream);
-      }
-      server_monitor->stream = NULL;
-      server_monitor->more_to_come = false;
-      tdmod = mc_tpld_modify_begin (server_monitor->topology);
-      /* clear_connection_pool() is a no-op if 'description->id' was already
-       * removed. */
-      _mongoc_topology_description_clear_connection_pool (
-         tdmod.new_td,
-         server_monitor->description->id,
-         &server_monitor->description->service_id);
-      mc_tpld_modify_commit (tdmod);
+/* Wake the event loop thread if it is waiting for a check to become due.
+ *
+ * Locks the event loop mutex. Caller must not hold the server monitor mutex.
+ */
+static void
+_server_monitor_loop_wakeup (mongoc_server_monitor_loop_t *loop)
+{
+   if (!loop) {
+      return;
    }
 
-   bson_destroy (&hello_response);
-   return description;
+   bson_mutex_lock (&loop->mutex);
+   loop->wakeup = true;
+   mongoc_cond_signal (&loop->cond);
+   bson_mutex_unlock (&loop->mutex);
 }
 
 /* Request scan of a single server.
@@ -941,6 +1178,7 @@ mongoc_server_monitor_request_scan (mongoc_server_monitor_t *server_monitor)
    server_monitor->shared.scan_requested = true;
    mongoc_cond_signal (&server_monitor->shared.cond);
    bson_mutex_unlock (&server_monitor->shared.mutex);
+   _server_monitor_loop_wakeup (server_monitor->loop);
 }
 
 /* Request cancellation of an in progress awaitable hello.
@@ -956,6 +1194,7 @@ mongoc_server_monitor_request_cancel (mongoc_server_monitor_t *server_monitor)
    server_monitor->shared.cancel_requested = true;
    mongoc_cond_signal (&server_monitor->shared.cond);
    bson_mutex_unlock (&server_monitor->shared.mutex);
+   _server_monitor_loop_wakeup (server_monitor->loop);
 }
 
 /* Wait for heartbeatFrequencyMS or minHeartbeatFrequencyMS if a scan is
@@ -1003,13 +1242,49 @@ mongoc_server_monitor_wait (mongoc_server_monitor_t *server_monitor)
    bson_mutex_unlock (&server_monitor->shared.mutex);
 }
 
-/* The server monitor thread function.
- *
- * Server monitor must be in state MONGOC_THREAD_OFF.
+/* Whether to start the next check without waiting after a check that was not
+ * cancelled. previous_description is NULL if the server's state was unchanged.
  */
-static BSON_THREAD_FUN (_server_monitor_thread, server_monitor_void)
-{
-   mongoc_server_monitor_t *server_monitor;
+static bool
+_server_monitor_proceed_immediately (
+   mongoc_server_monitor_t *server_monitor,
+   const mongoc_server_description_t *previous_description,
+   const mongoc_server_description_t *description)
+{
+   /* Immediately proceed to the next check if the previous response was
+    * successful and included the topologyVersion field. */
+   if (description->type != MONGOC_SERVER_UNKNOWN &&
+       !bson_empty (&description->topology_version)) {
+      MONITOR_LOG (server_monitor,
+                   "immediately proceeding due to topologyVersion");
+      return true;
+   }
+
+   /* ... or the previous response included the moreToCome flag */
+   if (server_monitor->more_to_come) {
+      MONITOR_LOG (server_monitor, "immediately proceeding due to moreToCome");
+      return true;
+   }
+
+   /* ... or the server has just transitioned to Unknown due to a network
+    * error. */
+   if (_mongoc_error_is_network (&description->error) && previous_description &&
+       previous_description->type != MONGOC_SERVER_UNKNOWN) {
+      MONITOR_LOG (server_monitor,
+                   "immediately proceeding due to network error");
+      return true;
+   }
+
+   return false;
+}
+
+/* The server monitor thread function.
+ *
+ * Server monitor must be in state MONGOC_THREAD_OFF.
+ */
+static BSON_THREAD_FUN (_server_monitor_thread, server_monitor_void)
+{
+   mongoc_server_monitor_t *server_monitor;
    mongoc_server_description_t *description;
    mongoc_server_description_t *previous_description;
 
@@ -1029,8 +1304,7 @@ static BSON_THREAD_FUN (_server_monitor_thread, server_monitor_void)
       bson_mutex_unlock (&server_monitor->shared.mutex);
 
       mongoc_server_description_destroy (previous_description);
-      previous_description = mongoc_server_description_new_copy (description);
-      mongoc_server_description_destroy (description);
+      previous_description = description;
       description = _server_monitor_check_server (
          server_monitor, previous_description, &cancelled);
 
@@ -1039,30 +1313,17 @@ static BSON_THREAD_FUN (_server_monitor_thread, server_monitor_void)
          continue;
       }
 
-      _update_topology_description (server_monitor, description);
-
-      /* Immediately proceed to the next check if the previous response was
-       * successful and included the topologyVersion field. */
-      if (description->type != MONGOC_SERVER_UNKNOWN &&
-          !bson_empty (&description->topology_version)) {
-         MONITOR_LOG (server_monitor,
-                      "immediately proceeding due to topologyVersion");
-         continue;
-      }
-
-      /* ... or the previous response included the moreToCome flag */
-      if (server_monitor->more_to_come) {
-         MONITOR_LOG (server_monitor,
-                      "immediately proceeding due to moreToCome");
-         continue;
+      if (description) {
+         _update_topology_description (server_monitor, description);
+      } else {
+         /* The server's state is unchanged, and the previous description was
+          * brought up to date. */
+         description = previous_description;
+         previous_description = NULL;
       }
 
-      /* ... or the server has just transitioned to Unknown due to a network
-       * error. */
-      if (_mongoc_error_is_network (&description->error) &&
-          previous_description->type != MONGOC_SERVER_UNKNOWN) {
-         MONITOR_LOG (server_monitor,
-                      "immediately proceeding due to network error");
+      if (_server_monitor_proceed_immediately (
+             server_monitor, previous_description, description)) {
          continue;
       }
 
@@ -1080,14 +1341,14 @@ static BSON_THREAD_FUN (_server_monitor_thread, server_monitor_void)
 static bool
 _server_monitor_ping_server (mongoc_server_monitor_t *server_monitor,
                              bool hello_ok,
-                             int64_t *rtt_ms)
+                             int64_t *rtt_us)
 {
    bool ret = false;
    int64_t start_us = _now_us ();
    bson_t hello_response;
    bson_error_t error;
 
-   *rtt_ms = MONGOC_RTT_UNSET;
+   *rtt_us = -1;
 
    if (!server_monitor->stream) {
       MONITOR_LOG (server_monitor, "rtt setting up connection");
@@ -1101,13 +1362,68 @@ _server_monitor_ping_server (mongoc_server_monitor_t *server_monitor,
       ret = _server_monitor_polling_hello (
          server_monitor, hello_ok, &hello_response, &error);
       if (ret) {
-         *rtt_ms = (_now_us () - start_us) / 1000;
+         *rtt_us = _now_us () - start_us;
       }
       bson_destroy (&hello_response);
    }
    return ret;
 }
 
+/* Whether the server's last reply in the topology description had
+ * helloOk: true, so the RTT monitor pings with "hello".
+ */
+static bool
+_server_monitor_hello_ok (mongoc_server_monitor_t *server_monitor)
+{
+   mc_shared_tpld td = mc_tpld_take_ref (server_monitor->topology);
+   const mongoc_server_description_t *sd =
+      mongoc_topology_description_server_by_id_const (
+         td.ptr, server_monitor->description->id, NULL);
+   bool hello_ok = sd ? sd->hello_ok : false;
+
+   mc_tpld_drop_ref (&td);
+   return hello_ok;
+}
+
+/* Record a round trip time sample in the topology description.
+ */
+static void
+_server_monitor_record_rtt (mongoc_server_monitor_t *server_monitor,
+                            int64_t rtt_us)
+{
+   bson_error_t error;
+   mc_tpld_modification tdmod = mc_tpld_modify_begin (server_monitor->topology);
+   mongoc_server_description_t *const mut_sd =
+      mongoc_topology_description_server_by_id (
+         tdmod.new_td, server_monitor->description->id, &error);
+
+   if (mut_sd) {
+      mongoc_server_description_update_rtt (mut_sd, rtt_us / 1000);
+      mongoc_server_description_set_rtt_sample (mut_sd, rtt_us);
+      mc_tpld_modify_commit (tdmod);
+   } else {
+      /* If the server description has been removed, the RTT thread will
+       * be terminated by background monitoring soon, so we have nothing
+       * to do but wait until we are about to be stopped. */
+      mc_tpld_modify_drop (tdmod);
+   }
+}
+
+/* Measure the round trip time to a server and record it in the topology
+ * description.
+ */
+static void
+_server_monitor_rtt_check (mongoc_server_monitor_t *server_monitor)
+{
+   int64_t rtt_us;
+
+   _server_monitor_ping_server (
+      server_monitor, _server_monitor_hello_ok (server_monitor), &rtt_us);
+   if (rtt_us >= 0) {
+      _server_monitor_record_rtt (server_monitor, rtt_us);
+   }
+}
+
 /* The RTT monitor thread function.
  *
  * Server monitor must be in state MONGOC_THREAD_OFF.
@@ -1117,10 +1433,6 @@ static BSON_THREAD_FUN (_server_monitor_rtt_thread, server_monitor_void)
    mongoc_server_monitor_t *server_monitor = server_monitor_void;
 
    while (true) {
-      int64_t rtt_ms;
-      bson_error_t error;
-      bool hello_ok;
-
       bson_mutex_lock (&server_monitor->shared.mutex);
       if (server_monitor->shared.state != MONGOC_THREAD_RUNNING) {
          bson_mutex_unlock (&server_monitor->shared.mutex);
@@ -1128,50 +1440,811 @@ static BSON_THREAD_FUN (_server_monitor_rtt_thread, server_monitor_void)
       }
       bson_mutex_unlock (&server_monitor->shared.mutex);
 
-      {
-         mc_shared_tpld td = mc_tpld_take_ref (server_monitor->topology);
-         const mongoc_server_description_t *sd =
-            mongoc_topology_description_server_by_id_const (
-               td.ptr, server_monitor->description->id, &error);
-         hello_ok = sd ? sd->hello_ok : false;
-         mc_tpld_drop_ref (&td);
+      _server_monitor_rtt_check (server_monitor);
+      mongoc_server_monitor_wait (server_monitor);
+   }
+
+   bson_mutex_lock (&server_monitor->shared.mutex);
+   server_monitor->shared.state = MONGOC_THREAD_JOINABLE;
+   bson_mutex_unlock (&server_monitor->shared.mutex);
+   BSON_THREAD_RETURN;
+}
+
+/* Schedule the next check of a monitor serviced by the event loop, as
+ * mongoc_server_monitor_wait does for a monitor thread.
+ *
+ * Called only from the event loop thread.
+ */
+static void
+_server_monitor_loop_schedule (mongoc_server_monitor_t *server_monitor,
+                               bool immediately)
+{
+   server_monitor->looped.wait_start_ms = _now_ms ();
+   server_monitor->looped.due_ms = server_monitor->looped.wait_start_ms;
+   if (!immediately) {
+      server_monitor->looped.due_ms += server_monitor->heartbeat_frequency_ms;
+   }
+}
+
+/* Complete a check started by the event loop, like the body of
+ * _server_monitor_thread does after _server_monitor_check_server returns.
+ *
+ * Called only from the event loop thread.
+ */
+static void
+_server_monitor_loop_check_done (mongoc_server_monitor_t *server_monitor,
+                                 bool cancelled)
+{
+   server_monitor->looped.awaiting = false;
+
+   if (cancelled) {
+      _server_monitor_loop_schedule (server_monitor, false);
+      return;
+   }
+
+   if (server_monitor->looped.description) {
+      _update_topology_description (server_monitor,
+                                    server_monitor->looped.description);
+   } else {
+      /* The server's state is unchanged, and the previous description was
+       * brought up to date. */
+      server_monitor->looped.description =
+         server_monitor->looped.previous_description;
+      server_monitor->looped.previous_description = NULL;
+   }
+
+   _server_monitor_loop_schedule (
+      server_monitor,
+      _server_monitor_proceed_immediately (
+         server_monitor,
+         server_monitor->looped.previous_description,
+         server_monitor->looped.description));
+}
+
+static void
+_server_monitor_loop_hello_done (mongoc_async_cmd_t *acmd,
+                                 mongoc_async_cmd_result_t result,
+                                 const bson_t *reply,
+                                 int64_t duration_usec);
+
+static void
+_server_monitor_loop_free_dns (mongoc_server_monitor_t *server_monitor)
+{
+   if (server_monitor->looped.dns_results) {
+      freeaddrinfo (server_monitor->looped.dns_results);
+   }
+
+   server_monitor->looped.dns_results = NULL;
+   server_monitor->looped.dns_next = NULL;
+}
+
+/* Create a stream that starts connecting to res without waiting for the
+ * connection. The TLS handshake, if any, is left to the async command.
+ */
+static mongoc_stream_t *
+_server_monitor_loop_stream_new (mongoc_server_monitor_t *server_monitor,
+                                 const struct addrinfo *res)
+{
+   mongoc_socket_t *sock;
+   mongoc_stream_t *stream;
+#ifdef MONGOC_ENABLE_SSL
+   mongoc_stream_t *tls_stream;
+#endif
+
+   sock =
+      mongoc_socket_new (res->ai_family, res->ai_socktype, res->ai_protocol);
+   if (!sock) {
+      return NULL;
+   }
+
+   (void) mongoc_socket_connect (
+      sock, res->ai_addr, (mongoc_socklen_t) res->ai_addrlen, 0);
+   stream = mongoc_stream_socket_new (sock);
+
+#ifdef MONGOC_ENABLE_SSL
+   if (server_monitor->ssl_opts) {
+      tls_stream = mongoc_stream_tls_new_with_hostname (
+         stream,
+         server_monitor->description->host.host,
+         server_monitor->ssl_opts,
+         1);
+      if (!tls_stream) {
+         mongoc_stream_destroy (stream);
       }
+      stream = tls_stream;
+   }
+#endif
 
-      _server_monitor_ping_server (server_monitor, hello_ok, &rtt_ms);
-      if (rtt_ms != MONGOC_RTT_UNSET) {
-         mc_tpld_modification tdmod =
-            mc_tpld_modify_begin (server_monitor->topology);
-         mongoc_server_description_t *const mut_sd =
-            mongoc_topology_description_server_by_id (
-               tdmod.new_td, server_monitor->description->id, &error);
-         if (mut_sd) {
-            mongoc_server_description_update_rtt (mut_sd, rtt_ms);
-            mc_tpld_modify_commit (tdmod);
-         } else {
-            /* If the server description has been removed, the RTT thread will
-             * be terminated by background monitoring soon, so we have nothing
-             * to do but wait until we are about to be stopped. */
-            mc_tpld_modify_drop (tdmod);
-         }
+   return stream;
+}
+
+/* Send a hello on stream with an async command of the event loop: the
+ * handshake if the monitor is connecting, otherwise a polling hello. The
+ * command owns the stream until _server_monitor_loop_hello_done.
+ */
+static void
+_server_monitor_loop_run_hello (mongoc_server_monitor_t *server_monitor,
+                                mongoc_stream_t *stream,
+                                bool is_setup_done,
+                                bool hello_ok)
+{
+   bson_t cmd;
+   mongoc_async_cmd_setup_t setup = NULL;
+   void *setup_ctx = NULL;
+
+   if (server_monitor->looped.connecting) {
+      _mongoc_topology_dup_handshake_cmd (server_monitor->topology, &cmd);
+   } else {
+      bson_copy_to (_mongoc_topology_scanner_get_monitoring_cmd (
+                       server_monitor->topology->scanner, hello_ok),
+                    &cmd);
+   }
+   _server_monitor_append_cluster_time (server_monitor, &cmd);
+
+#ifdef MONGOC_ENABLE_SSL
+   if (!is_setup_done && server_monitor->ssl_opts) {
+      setup = mongoc_async_cmd_tls_setup;
+      setup_ctx = server_monitor->description->host.host;
+   }
+#endif
+
+   server_monitor->looped.acmd =
+      mongoc_async_cmd_new (server_monitor->loop->async,
+                            stream,
+                            is_setup_done,
+                            NULL /* dns result */,
+                            NULL /* initiator */,
+                            0 /* delay */,
+                            setup,
+                            setup_ctx,
+                            "admin",
+                            &cmd,
+                            _server_monitor_loop_hello_done,
+                            server_monitor,
+                            server_monitor->connect_timeout_ms);
+   bson_destroy (&cmd);
+}
+
+/* Start the handshake on a connection to the next resolved address.
+ *
+ * Returns false and sets error if no address is left.
+ */
+static bool
+_server_monitor_loop_connect_next (mongoc_server_monitor_t *server_monitor,
+                                   bson_error_t *error)
+{
+   struct addrinfo *res;
+   mongoc_stream_t *stream;
+
+   while ((res = server_monitor->looped.dns_next)) {
+      server_monitor->looped.dns_next = res->ai_next;
+      stream = _server_monitor_loop_stream_new (server_monitor, res);
+      if (stream) {
+         _server_monitor_loop_run_hello (server_monitor, stream, false, false);
+         return true;
+      }
+   }
+
+   _server_monitor_loop_free_dns (server_monitor);
+   bson_set_error (error,
+                   MONGOC_ERROR_STREAM,
+                   MONGOC_ERROR_STREAM_CONNECT,
+                   "Failed to connect to target host: %s",
+                   server_monitor->description->host.host_and_port);
+   return false;
+}
+
+/* Start a hello from the event loop without waiting for the network: a
+ * polling hello on the monitor's connection, or the handshake on a new one.
+ *
+ * Completes in _server_monitor_loop_hello_done. Returns false and sets error
+ * if the hello could not be started.
+ * Called only from the event loop thread.
+ */
+static bool
+_server_monitor_loop_hello_begin (mongoc_server_monitor_t *server_monitor,
+                                  bool hello_ok,
+                                  bson_error_t *error)
+{
+   const mongoc_host_list_t *host = &server_monitor->description->host;
+   mongoc_stream_t *stream;
+   struct addrinfo hints;
+   char portstr[8];
+
+   server_monitor->looped.start_us = _now_us ();
+
+   if (server_monitor->stream) {
+      MONITOR_LOG (server_monitor, "polling hello");
+      server_monitor->looped.connecting = false;
+      stream = server_monitor->stream;
+      server_monitor->stream = NULL;
+      _server_monitor_loop_run_hello (server_monitor, stream, true, hello_ok);
+      return true;
+   }
+
+   MONITOR_LOG (server_monitor, "setting up connection");
+   server_monitor->looped.connecting = true;
+   server_monitor->more_to_come = false;
+
+   /* Custom streams and UNIX domain sockets are connected directly. */
+   if (server_monitor->initiator || host->family == AF_UNIX) {
+      stream = _server_monitor_connect (server_monitor, error);
+      if (!stream) {
+         return false;
+      }
+
+      _server_monitor_loop_run_hello (server_monitor, stream, true, hello_ok);
+      return true;
+   }
+
+   bson_snprintf (portstr, sizeof portstr, "%hu", host->port);
+
+   memset (&hints, 0, sizeof hints);
+   hints.ai_family = host->family;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = 0;
+   hints.ai_protocol = 0;
+
+   /* Name resolution still blocks. */
+   if (getaddrinfo (host->host,
+                    portstr,
+                    &hints,
+                    &server_monitor->looped.dns_results) != 0) {
+      mongoc_counter_dns_failure_inc ();
+      server_monitor->looped.dns_results = NULL;
+      bson_set_error (error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_NAME_RESOLUTION,
+                      "Failed to resolve %s",
+                      host->host);
+      return false;
+   }
+
+   mongoc_counter_dns_success_inc ();
+   server_monitor->looped.dns_next = server_monitor->looped.dns_results;
+   return _server_monitor_loop_connect_next (server_monitor, error);
+}
+
+/* Complete a hello started by _server_monitor_loop_hello_begin.
+ *
+ * Called by the event loop's async commands, only from the event loop thread.
+ */
+static void
+_server_monitor_loop_hello_done (mongoc_async_cmd_t *acmd,
+                                 mongoc_async_cmd_result_t result,
+                                 const bson_t *reply,
+                                 int64_t duration_usec)
+{
+   mongoc_server_monitor_t *server_monitor =
+      (mongoc_server_monitor_t *) acmd->data;
+   bool connecting = server_monitor->looped.connecting;
+   bson_t hello_response;
+   bson_error_t error;
+   bool ret = false;
+
+   if (result == MONGOC_ASYNC_CMD_CONNECTED) {
+      /* Update the start time just before the hello is sent. */
+      if (acmd->bytes_written == 0) {
+         server_monitor->looped.start_us = _now_us ();
+      }
+      return;
+   }
+
+   server_monitor->looped.acmd = NULL;
+   memset (&error, 0, sizeof (bson_error_t));
+
+   if (result == MONGOC_ASYNC_CMD_SUCCESS) {
+      server_monitor->stream = acmd->stream;
+      bson_copy_to (reply, &hello_response);
+      ret = true;
+   } else {
+      if (acmd->stream) {
+         mongoc_stream_failed (acmd->stream);
+      }
+
+      if (connecting && server_monitor->looped.dns_next &&
+          _server_monitor_loop_connect_next (server_monitor, &error)) {
+         return;
+      }
+
+      if (acmd->error.code) {
+         memcpy (&error, &acmd->error, sizeof (bson_error_t));
+      } else {
+         bson_set_error (&error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "%s",
+                         result == MONGOC_ASYNC_CMD_TIMEOUT
+                            ? "connection timeout"
+                            : "connection error");
+      }
+      bson_init (&hello_response);
+   }
+
+   _server_monitor_loop_free_dns (server_monitor);
+
+   if (server_monitor->is_rtt) {
+      /* A new connection is pinged right away, so the handshake is not
+       * counted in the round trip time. */
+      if (ret && !connecting) {
+         _server_monitor_record_rtt (
+            server_monitor, _now_us () - server_monitor->looped.start_us);
+      }
+      bson_destroy (&hello_response);
+      _server_monitor_loop_schedule (server_monitor, ret && connecting);
+      return;
+   }
+
+   server_monitor->looped.description =
+      _server_monitor_check_finish (server_monitor,
+                                    server_monitor->looped.previous_description,
+                                    ret,
+                                    &hello_response,
+                                    server_monitor->looped.start_us,
+                                    false,
+                                    false,
+                                    &error);
+   _server_monitor_loop_check_done (server_monitor, false);
+}
+
+/* Stop a hello in flight, when the monitor shuts down.
+ *
+ * Called only from the event loop thread.
+ */
+static void
+_server_monitor_loop_hello_abandon (mongoc_server_monitor_t *server_monitor)
+{
+   mongoc_async_cmd_t *acmd = server_monitor->looped.acmd;
+   mongoc_stream_t *stream;
+
+   if (!acmd) {
+      return;
+   }
+
+   stream = acmd->stream;
+   mongoc_async_cmd_destroy (acmd);
+   if (stream) {
+      mongoc_stream_failed (stream);
+   }
+
+   server_monitor->looped.acmd = NULL;
+   _server_monitor_loop_free_dns (server_monitor);
+}
+
+/* Start a check from the event loop.
+ *
+ * An awaitable hello is sent, and the reply is awaited by polling the stream
+ * along with those of other monitors. Other checks run as async commands of
+ * the event loop.
+ * Called only from the event loop thread.
+ */
+static void
+_server_monitor_loop_check_begin (mongoc_server_monitor_t *server_monitor)
+{
+   mongoc_server_description_t *previous_description;
+   bson_t hello_response;
+   bson_error_t error;
+
+   memset (&error, 0, sizeof (bson_error_t));
+
+   if (server_monitor->is_rtt) {
+      if (!_server_monitor_loop_hello_begin (
+             server_monitor,
+             _server_monitor_hello_ok (server_monitor),
+             &error)) {
+         _server_monitor_loop_schedule (server_monitor, false);
+      }
+      return;
+   }
+
+   mongoc_server_description_destroy (
+      server_monitor->looped.previous_description);
+   previous_description = server_monitor->looped.description;
+   server_monitor->looped.previous_description = previous_description;
+   server_monitor->looped.description = NULL;
+
+   if (!server_monitor->stream ||
+       (!server_monitor->more_to_come &&
+        bson_empty (&previous_description->topology_version))) {
+      _server_monitor_heartbeat_started (server_monitor, false);
+      if (!_server_monitor_loop_hello_begin (
+             server_monitor, previous_description->hello_ok, &error)) {
+         bson_init (&hello_response);
+         server_monitor->looped.description =
+            _server_monitor_check_finish (server_monitor,
+                                          previous_description,
+                                          false,
+                                          &hello_response,
+                                          server_monitor->looped.start_us,
+                                          false,
+                                          false,
+                                          &error);
+         _server_monitor_loop_check_done (server_monitor, false);
+      }
+      return;
+   }
+
+   server_monitor->looped.start_us = _now_us ();
+   _server_monitor_heartbeat_started (server_monitor, true);
+
+   if (server_monitor->more_to_come) {
+      MONITOR_LOG (server_monitor, "more to come");
+   } else {
+      MONITOR_LOG (server_monitor, "awaitable hello");
+      if (!_server_monitor_awaitable_hello_begin (
+             server_monitor, previous_description, &error)) {
+         bson_init (&hello_response);
+         server_monitor->looped.description =
+            _server_monitor_check_finish (server_monitor,
+                                          previous_description,
+                                          false,
+                                          &hello_response,
+                                          server_monitor->looped.start_us,
+                                          true,
+                                          false,
+                                          &error);
+         _server_monitor_loop_check_done (server_monitor, false);
+         return;
+      }
+   }
+
+   server_monitor->looped.awaiting = true;
+   server_monitor->looped.expire_at_ms =
+      _now_ms () + server_monitor->heartbeat_frequency_ms +
+      server_monitor->connect_timeout_ms;
+}
+
+/* Complete a check whose reply was awaited by the event loop.
+ *
+ * If the stream is not readable, the check fails with error_message unless it
+ * was cancelled.
+ * Called only from the event loop thread.
+ */
+static void
+_server_monitor_loop_check_end (mongoc_server_monitor_t *server_monitor,
+                                bool readable,
+                                bool cancelled,
+                                const char *error_message)
+{
+   bson_t hello_response;
+   bson_error_t error;
+   bool ret = false;
+
+   memset (&error, 0, sizeof (bson_error_t));
+   if (readable) {
+      /* Reads without blocking for long, since the reply is arriving. */
+      ret = _server_monitor_awaitable_hello_recv (
+         server_monitor, &hello_response, &cancelled, &error);
+   } else {
+      bson_init (&hello_response);
+      if (!cancelled) {
+         bson_set_error (&error,
+                         MONGOC_ERROR_STREAM,
+                         MONGOC_ERROR_STREAM_SOCKET,
+                         "%s",
+                         error_message);
       }
-      mongoc_server_monitor_wait (server_monitor);
    }
 
+   server_monitor->looped.description =
+      _server_monitor_check_finish (server_monitor,
+                                    server_monitor->looped.previous_description,
+                                    ret,
+                                    &hello_response,
+                                    server_monitor->looped.start_us,
+                                    true,
+                                    cancelled,
+                                    &error);
+   _server_monitor_loop_check_done (server_monitor, cancelled);
+}
+
+/* Deliver requests to a monitor serviced by the event loop, and start a check
+ * if one is due.
+ *
+ * Returns false if the monitor was asked to shut down. It is then removed from
+ * the event loop and must no longer be accessed.
+ * Called only from the event loop thread.
+ * Locks server monitor mutex and event loop mutex.
+ */
+static bool
+_server_monitor_loop_service (mongoc_server_monitor_loop_t *loop,
+                              mongoc_server_monitor_t *server_monitor)
+{
+   mongoc_server_monitor_t **monitors;
+   thread_state_t state;
+   bool cancelled = false;
+   bool scan_requested = false;
+   size_t i;
+
    bson_mutex_lock (&server_monitor->shared.mutex);
-   server_monitor->shared.state = MONGOC_THREAD_JOINABLE;
+   state = server_monitor->shared.state;
+   if (server_monitor->looped.acmd) {
+      /* Requests are delivered once the hello in flight completes. */
+   } else if (server_monitor->looped.awaiting) {
+      cancelled = server_monitor->shared.cancel_requested;
+      server_monitor->shared.cancel_requested = false;
+   } else {
+      scan_requested = server_monitor->shared.scan_requested;
+      server_monitor->shared.scan_requested = false;
+   }
    bson_mutex_unlock (&server_monitor->shared.mutex);
+
+   if (state != MONGOC_THREAD_RUNNING) {
+      bson_mutex_lock (&loop->mutex);
+      monitors = (mongoc_server_monitor_t **) loop->monitors.data;
+      for (i = 0; i < loop->monitors.len; i++) {
+         if (monitors[i] == server_monitor) {
+            monitors[i] = monitors[loop->monitors.len - 1];
+            loop->monitors.len--;
+            break;
+         }
+      }
+      bson_mutex_unlock (&loop->mutex);
+
+      _server_monitor_loop_hello_abandon (server_monitor);
+
+      bson_mutex_lock (&server_monitor->shared.mutex);
+      server_monitor->shared.state = MONGOC_THREAD_JOINABLE;
+      mongoc_cond_broadcast (&server_monitor->shared.cond);
+      bson_mutex_unlock (&server_monitor->shared.mutex);
+      return false;
+   }
+
+   if (server_monitor->looped.acmd) {
+      return true;
+   }
+
+   if (server_monitor->looped.awaiting) {
+      if (cancelled) {
+         MONITOR_LOG (server_monitor, "polling cancelled");
+         _server_monitor_loop_check_end (server_monitor, false, true, NULL);
+      } else if (_now_ms () >= server_monitor->looped.expire_at_ms) {
+         _server_monitor_loop_check_end (
+            server_monitor, false, false, "connection timeout while polling");
+      }
+      return true;
+   }
+
+   if (scan_requested) {
+      server_monitor->looped.due_ms =
+         BSON_MIN (server_monitor->looped.due_ms,
+                   server_monitor->looped.wait_start_ms +
+                      (int64_t) server_monitor->min_heartbeat_frequency_ms);
+   }
+
+   if (_now_ms () >= server_monitor->looped.due_ms) {
+      _server_monitor_loop_check_begin (server_monitor);
+   }
+
+   return true;
+}
+
+/* The event loop thread function.
+ *
+ * Each iteration services every monitor, then polls the streams of those
+ * awaiting a reply, and those of the async commands running other checks,
+ * until one is ready or the next check is due. The wait is bounded by the same
+ * tick used by monitor threads, to notice cancellation.
+ */
+static BSON_THREAD_FUN (_server_monitor_loop_thread, loop_void)
+{
+   mongoc_server_monitor_loop_t *loop = loop_void;
+   mongoc_server_monitor_t **monitors = NULL;
+   mongoc_server_monitor_t **polled = NULL;
+   mongoc_stream_poll_t *pollers = NULL;
+   bool *pending = NULL;
+   size_t n_allocated = 0;
+
+   while (true) {
+      mongoc_server_monitor_t *server_monitor;
+      size_t n_monitors;
+      size_t n_polled = 0;
+      size_t n_cmds;
+      size_t i;
+      int64_t now_ms;
+      int64_t cmds_expire_at;
+      int64_t timeout_ms = MONGOC_TOPOLOGY_MIN_HEARTBEAT_FREQUENCY_MS;
+      ssize_t ret;
+
+      bson_mutex_lock (&loop->mutex);
+      if (!loop->running) {
+         bson_mutex_unlock (&loop->mutex);
+         break;
+      }
+      loop->wakeup = false;
+      n_monitors = loop->monitors.len;
+      if (n_monitors > n_allocated) {
+         n_allocated = n_monitors;
+         monitors = bson_realloc (monitors, n_allocated * sizeof *monitors);
+         polled = bson_realloc (polled, n_allocated * sizeof *polled);
+         /* Each monitor has at most one async command in flight. */
+         pollers = bson_realloc (pollers, 2 * n_allocated * sizeof *pollers);
+         pending = bson_realloc (pending, 2 * n_allocated * sizeof *pending);
+      }
+      if (n_monitors) {
+         memcpy (monitors, loop->monitors.data, n_monitors * sizeof *monitors);
+      }
+      bson_mutex_unlock (&loop->mutex);
+
+      for (i = 0; i < n_monitors; i++) {
+         if (!_server_monitor_loop_service (loop, monitors[i])) {
+            monitors[i] = NULL;
+         }
+      }
+
+      now_ms = _now_ms ();
+      for (i = 0; i < n_monitors; i++) {
+         server_monitor = monitors[i];
+         if (!server_monitor || server_monitor->looped.acmd) {
+            continue;
+         }
+
+         if (server_monitor->looped.awaiting) {
+            timeout_ms = BSON_MIN (
+               timeout_ms, server_monitor->looped.expire_at_ms - now_ms);
+            polled[n_polled] = server_monitor;
+            pollers[n_polled].stream = server_monitor->stream;
+            /* POLLERR and POLLHUP are added in mongoc_socket_poll. */
+            pollers[n_polled].events = POLLIN;
+            pollers[n_polled].revents = 0;
+            n_polled++;
+         } else {
+            timeout_ms =
+               BSON_MIN (timeout_ms, server_monitor->looped.due_ms - now_ms);
+         }
+      }
+
+      n_cmds = mongoc_async_get_pollers (loop->async,
+                                         pollers + n_polled,
+                                         2 * n_allocated - n_polled,
+                                         &cmds_expire_at);
+      BSON_ASSERT (n_polled + n_cmds <= 2 * n_allocated);
+      if (n_cmds) {
+         timeout_ms = BSON_MIN (timeout_ms, cmds_expire_at / 1000 - now_ms);
+      }
+
+      /* A reply already read into a TLS or buffered stream does not make the
+       * socket beneath readable. */
+      for (i = 0; i < n_polled + n_cmds; i++) {
+         pending[i] = (pollers[i].events & POLLIN) &&
+                      _mongoc_stream_has_pending_data (pollers[i].stream);
+         if (pending[i]) {
+            timeout_ms = 0;
+         }
+      }
+
+      timeout_ms = BSON_MAX (timeout_ms, 0);
+
+      if (!n_polled && !n_cmds) {
+         bson_mutex_lock (&loop->mutex);
+         if (timeout_ms > 0 && loop->running && !loop->wakeup) {
+            mongoc_cond_timedwait (&loop->cond, &loop->mutex, timeout_ms);
+         }
+         bson_mutex_unlock (&loop->mutex);
+         continue;
+      }
+
+      ret = mongoc_stream_poll (
+         pollers, n_polled + n_cmds, (int32_t) timeout_ms);
+      if (ret == -1 && errno == EINTR) {
+         /* Interrupted by a signal. Service the monitors and poll again. */
+         continue;
+      }
+
+      if (ret == -1) {
+         /* Fail every awaited check, as a monitor thread fails its own. */
+         for (i = 0; i < n_polled; i++) {
+            _server_monitor_loop_check_end (
+               polled[i], false, false, "poll error");
+         }
+      } else {
+         for (i = 0; i < n_polled; i++) {
+            if (pollers[i].revents || pending[i]) {
+               _server_monitor_loop_check_end (polled[i], true, false, NULL);
+            }
+         }
+      }
+
+      for (i = n_polled; i < n_polled + n_cmds; i++) {
+         if (pending[i]) {
+            pollers[i].revents |= POLLIN;
+         }
+      }
+
+      mongoc_async_step_pollers (loop->async, pollers + n_polled, n_cmds);
+   }
+
+   bson_free (monitors);
+   bson_free (polled);
+   bson_free (pollers);
+   bson_free (pending);
    BSON_THREAD_RETURN;
 }
 
+/* Create an event loop and start its thread.
+ *
+ * Called when background monitoring starts.
+ */
+mongoc_server_monitor_loop_t *
+mongoc_server_monitor_loop_new (void)
+{
+   mongoc_server_monitor_loop_t *loop = bson_malloc0 (sizeof (*loop));
+
+   bson_mutex_init (&loop->mutex);
+   mongoc_cond_init (&loop->cond);
+   _mongoc_array_init (&loop->monitors, sizeof (mongoc_server_monitor_t *));
+   loop->async = mongoc_async_new ();
+   loop->running = true;
+   COMMON_PREFIX (thread_create)
+   (&loop->thread, _server_monitor_loop_thread, loop);
+   return loop;
+}
+
+/* Stop the event loop thread and destroy the event loop.
+ *
+ * Called when background monitoring stops, after all server monitors serviced
+ * by the event loop have been shut down.
+ */
+void
+mongoc_server_monitor_loop_destroy (mongoc_server_monitor_loop_t *loop)
+{
+   if (!loop) {
+      return;
+   }
+
+   bson_mutex_lock (&loop->mutex);
+   BSON_ASSERT (loop->monitors.len == 0);
+   loop->running = false;
+   mongoc_cond_signal (&loop->cond);
+   bson_mutex_unlock (&loop->mutex);
+   COMMON_PREFIX (thread_join) (loop->thread);
+
+   /* Monitors abandon their async commands when they shut down. */
+   BSON_ASSERT (loop->async->ncmds == 0);
+   mongoc_async_destroy (loop->async);
+   _mongoc_array_destroy (&loop->monitors);
+   mongoc_cond_destroy (&loop->cond);
+   bson_mutex_destroy (&loop->mutex);
+   bson_free (loop);
+}
+
+/* Start servicing a monitor, from its own thread or from the event loop.
+ *
+ * Caller must hold the server monitor mutex.
+ */
+static void
+_server_monitor_start (mongoc_server_monitor_t *server_monitor, bool is_rtt)
+{
+   mongoc_server_monitor_loop_t *loop = server_monitor->loop;
+
+   server_monitor->is_rtt = is_rtt;
+   server_monitor->shared.state = MONGOC_THREAD_RUNNING;
+
+   if (!loop) {
+      COMMON_PREFIX (thread_create)
+      (&server_monitor->thread,
+       is_rtt ? _server_monitor_rtt_thread : _server_monitor_thread,
+       server_monitor);
+      return;
+   }
+
+   server_monitor->looped.description =
+      mongoc_server_description_new_copy (server_monitor->description);
+   server_monitor->looped.due_ms = _now_ms ();
+
+   bson_mutex_lock (&loop->mutex);
+   _mongoc_array_append_val (&loop->monitors, server_monitor);
+   loop->wakeup = true;
+   mongoc_cond_signal (&loop->cond);
+   bson_mutex_unlock (&loop->mutex);
+}
+
 void
 mongoc_server_monitor_run (mongoc_server_monitor_t *server_monitor)
 {
    bson_mutex_lock (&server_monitor->shared.mutex);
    if (server_monitor->shared.state == MONGOC_THREAD_OFF) {
-      server_monitor->is_rtt = false;
-      server_monitor->shared.state = MONGOC_THREAD_RUNNING;
-      COMMON_PREFIX (thread_create)
-      (&server_monitor->thread, _server_monitor_thread, server_monitor);
+      _server_monitor_start (server_monitor, false);
    }
    bson_mutex_unlock (&server_monitor->shared.mutex);
 }
@@ -1181,10 +2254,7 @@ mongoc_server_monitor_run_as_rtt (mongoc_server_monitor_t *server_monitor)
 {
    bson_mutex_lock (&server_monitor->shared.mutex);
    if (server_monitor->shared.state == MONGOC_THREAD_OFF) {
-      server_monitor->is_rtt = true;
-      server_monitor->shared.state = MONGOC_THREAD_RUNNING;
-      COMMON_PREFIX (thread_create)
-      (&server_monitor->thread, _server_monitor_rtt_thread, server_monitor);
+      _server_monitor_start (server_monitor, true);
    }
    bson_mutex_unlock (&server_monitor->shared.mutex);
 }
@@ -1206,7 +2276,9 @@ mongoc_server_monitor_request_shutdown (mongoc_server_monitor_t *server_monitor)
       server_monitor->shared.state = MONGOC_THREAD_SHUTTING_DOWN;
    }
    if (server_monitor->shared.state == MONGOC_THREAD_JOINABLE) {
-      COMMON_PREFIX (thread_join) (server_monitor->thread);
+      if (!server_monitor->loop) {
+         COMMON_PREFIX (thread_join) (server_monitor->thread);
+      }
       server_monitor->shared.state = MONGOC_THREAD_OFF;
    }
    if (server_monitor->shared.state == MONGOC_THREAD_OFF) {
@@ -1235,8 +2307,15 @@ mongoc_server_monitor_wait_for_shutdown (
    }
 
    /* Shutdown requested, but thread is not yet off. Wait. */
-   COMMON_PREFIX (thread_join) (server_monitor->thread);
+   if (!server_monitor->loop) {
+      COMMON_PREFIX (thread_join) (server_monitor->thread);
+   }
    bson_mutex_lock (&server_monitor->shared.mutex);
+   /* The event loop signals once it no longer services the monitor. */
+   while (server_monitor->shared.state != MONGOC_THREAD_JOINABLE) {
+      mongoc_cond_wait (&server_monitor->shared.cond,
+                        &server_monitor->shared.mutex);
+   }
    server_monitor->shared.state = MONGOC_THREAD_OFF;
    bson_mutex_unlock (&server_monitor->shared.mutex);
 }
@@ -1259,6 +2338,9 @@ mongoc_server_monitor_destroy (mongoc_server_monitor_t *server_monitor)
    BSON_ASSERT (server_monitor->shared.state == MONGOC_THREAD_OFF);
 
    mongoc_server_description_destroy (server_monitor->description);
+   mongoc_server_description_destroy (server_monitor->looped.description);
+   mongoc_server_description_destroy (
+      server_monitor->looped.previous_description);
    mongoc_stream_destroy (server_monitor->stream);
    mongoc_uri_destroy (server_monitor->uri);
    mongoc_cond_destroy (&server_monitor->shared.cond);
@@ -34,6 +34,8 @@ typedef struct _mongoc_server_stream_t {
    mongoc_server_description_t *sd; /* owned */
    bson_t cluster_time;             /* owned */
    mongoc_stream_t *stream;         /* borrowed */
+   /* counts this server stream as an operation in progress on the server */
+   mongoc_server_load_t *load;
 } mongoc_server_stream_t;
 
 
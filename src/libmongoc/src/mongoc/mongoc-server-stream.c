@@ -28,6 +28,7 @@ mongoc_server_stream_new (const mongoc_topology_description_t *td,
                           mongoc_stream_t *stream)
 {
    mongoc_server_stream_t *server_stream;
+   const mongoc_server_description_t *td_sd;
 
    BSON_ASSERT (sd);
    BSON_ASSERT (stream);
@@ -38,6 +39,13 @@ mongoc_server_stream_new (const mongoc_topology_description_t *td,
    server_stream->sd = sd;         /* becomes owned */
    server_stream->stream = stream; /* merely borrowed */
 
+   /* @sd may be a copy of the connection's handshake description; count the
+    * operation on the server description in the topology, which server
+    * selection consults */
+   td_sd = mongoc_topology_description_server_by_id_const (td, sd->id, NULL);
+   server_stream->load =
+      td_sd ? mongoc_server_description_begin_op (td_sd) : NULL;
+
    return server_stream;
 }
 
@@ -45,6 +53,7 @@ void
 mongoc_server_stream_cleanup (mongoc_server_stream_t *server_stream)
 {
    if (server_stream) {
+      mongoc_server_load_end_op (server_stream->load);
       mongoc_server_description_destroy (server_stream->sd);
       bson_destroy (&server_stream->cluster_time);
       bson_free (server_stream);
@@ -57,6 +57,11 @@ mongoc_set_rm (mongoc_set_t *set, uint32_t id);
 void *
 mongoc_set_get (mongoc_set_t *set, uint32_t id);
 
+/* replaces the item with the given id, destroying the old item. returns false
+ * if there is no such item. */
+bool
+mongoc_set_replace (mongoc_set_t *set, uint32_t id, void *item);
+
 static BSON_INLINE const void *
 mongoc_set_get_const (const mongoc_set_t *set, uint32_t id)
 {
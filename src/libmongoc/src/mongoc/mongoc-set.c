@@ -114,6 +114,30 @@ mongoc_set_get (mongoc_set_t *set, uint32_t id)
    return ptr ? ptr->item : NULL;
 }
 
+bool
+mongoc_set_replace (mongoc_set_t *set, uint32_t id, void *item)
+{
+   mongoc_set_item_t *ptr;
+   mongoc_set_item_t key;
+
+   key.id = id;
+
+   ptr = (mongoc_set_item_t *) bsearch (
+      &key, set->items, set->items_len, sizeof (key), mongoc_set_id_cmp);
+
+   if (!ptr) {
+      return false;
+   }
+
+   if (set->dtor) {
+      set->dtor (ptr->item, set->dtor_ctx);
+   }
+
+   ptr->item = item;
+
+   return true;
+}
+
 void *
 mongoc_set_get_item (mongoc_set_t *set, int idx)
 {
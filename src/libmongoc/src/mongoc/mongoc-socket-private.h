@@ -32,6 +32,14 @@ struct _mongoc_socket_t {
    int errno_;
    int domain;
    int pid;
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   /* 0 until a large send tries SO_ZEROCOPY, then 1 if it is on, or -1 if
+    * the kernel refused it or copied the data anyway */
+   int zerocopy;
+   /* sends made with MSG_ZEROCOPY, and those the kernel is done with */
+   uint32_t zerocopy_sent;
+   uint32_t zerocopy_done;
+#endif
 };
 
 mongoc_socket_t *
@@ -39,6 +47,17 @@ mongoc_socket_accept_ex (mongoc_socket_t *sock,
                          int64_t expire_at,
                          uint16_t *port);
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+bool
+_mongoc_socket_use_zerocopy (mongoc_socket_t *sock,
+                             const mongoc_iovec_t *iov,
+                             size_t iovcnt,
+                             int64_t expire_at);
+
+void
+_mongoc_socket_disable_zerocopy (mongoc_socket_t *sock);
+#endif
+
 BSON_END_DECLS
 
 #endif /* MONGOC_SOCKET_PRIVATE_H */
@@ -28,6 +28,9 @@
 #include <Mstcpip.h>
 #include <process.h>
 #endif
+#ifdef MONGOC_ENABLE_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "socket"
@@ -36,6 +39,14 @@
 #define OPERATION_EXPIRED(expire_at) \
    ((expire_at >= 0) && (expire_at < (bson_get_monotonic_time ())))
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+/* messages from this size on are sent with MSG_ZEROCOPY, smaller ones are
+ * cheaper to copy than to pin and wait for */
+#ifndef MONGOC_ZEROCOPY_THRESHOLD
+#define MONGOC_ZEROCOPY_THRESHOLD (1024 * 1024)
+#endif
+#endif
+
 
 /* either struct sockaddr or void, depending on platform */
 typedef MONGOC_SOCKET_ARG2 mongoc_sockaddr_t;
@@ -1190,6 +1201,190 @@ mongoc_socket_send (mongoc_socket_t *sock, /* IN */
 }
 
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_socket_use_zerocopy --
+ *
+ *       Decide whether to send @iov with MSG_ZEROCOPY: it must be a
+ *       blocking send of at least MONGOC_ZEROCOPY_THRESHOLD bytes on a
+ *       TCP socket. SO_ZEROCOPY is turned on the first time.
+ *
+ * Returns:
+ *       true if the socket accepts zero-copy sends.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_socket_use_zerocopy (mongoc_socket_t *sock,
+                             const mongoc_iovec_t *iov,
+                             size_t iovcnt,
+                             int64_t expire_at)
+{
+   size_t total = 0;
+   size_t i;
+   int on = 1;
+
+   /* the pages must stay untouched until the kernel is done with them, which
+    * only a blocking send can wait for */
+   if (expire_at == 0 || sock->zerocopy < 0 || sock->domain == AF_UNIX) {
+      return false;
+   }
+
+   for (i = 0; i < iovcnt; i++) {
+      total += iov[i].iov_len;
+   }
+
+   if (total < MONGOC_ZEROCOPY_THRESHOLD) {
+      return false;
+   }
+
+   if (sock->zerocopy == 0) {
+      if (setsockopt (sock->sd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof on)) {
+         TRACE ("SO_ZEROCOPY failed: %d, copying", errno);
+         sock->zerocopy = -1;
+         return false;
+      }
+
+      sock->zerocopy = 1;
+   }
+
+   return true;
+}
+
+
+/* never send with MSG_ZEROCOPY, e.g. because another thread polls the socket
+ * and would take the completions' POLLERR for a failure */
+void
+_mongoc_socket_disable_zerocopy (mongoc_socket_t *sock)
+{
+   sock->zerocopy = -1;
+}
+
+
+/* read the completions queued on the socket's error queue for sends made
+ * with MSG_ZEROCOPY. Returns false if the socket failed. */
+static bool
+_mongoc_socket_zerocopy_reap (mongoc_socket_t *sock)
+{
+   char control[128];
+   struct msghdr msg;
+   struct cmsghdr *cm;
+   struct sock_extended_err *serr;
+   ssize_t r;
+
+   for (;;) {
+      memset (&msg, 0, sizeof msg);
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof control;
+
+      r = recvmsg (sock->sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+      if (r == -1) {
+         if (errno == EINTR) {
+            continue;
+         }
+
+         if (MONGOC_ERRNO_IS_AGAIN (errno)) {
+            return true;
+         }
+
+         _mongoc_socket_capture_errno (sock);
+         return false;
+      }
+
+      for (cm = CMSG_FIRSTHDR (&msg); cm; cm = CMSG_NXTHDR (&msg, cm)) {
+         if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+             !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+            continue;
+         }
+
+         serr = (struct sock_extended_err *) CMSG_DATA (cm);
+         if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+         }
+
+         /* the range of sends completed, counted from the socket's first */
+         sock->zerocopy_done += serr->ee_data - serr->ee_info + 1;
+
+         if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+            /* e.g. over loopback, or a device without scatter-gather */
+            TRACE ("%s", "kernel copied a zero-copy send, copying from now on");
+            sock->zerocopy = -1;
+         }
+      }
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_socket_zerocopy_wait --
+ *
+ *       Wait until the kernel has released every page passed to it with
+ *       MSG_ZEROCOPY, that is once the peer acknowledged the data, so
+ *       that the caller may reuse or free its buffers.
+ *
+ * Returns:
+ *       true if all sends completed, false if the socket failed or
+ *       @expire_at passed.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+static bool
+_mongoc_socket_zerocopy_wait (mongoc_socket_t *sock, int64_t expire_at)
+{
+   uint32_t done;
+   bool polled = false;
+   int err = 0;
+   mongoc_socklen_t len = sizeof err;
+
+   for (;;) {
+      done = sock->zerocopy_done;
+      if (!_mongoc_socket_zerocopy_reap (sock)) {
+         return false;
+      }
+
+      if (sock->zerocopy_done == sock->zerocopy_sent) {
+         return true;
+      }
+
+      if (polled && sock->zerocopy_done == done &&
+          (getsockopt (sock->sd, SOL_SOCKET, SO_ERROR, &err, &len) || err)) {
+         /* POLLERR was for a socket error, not a completion */
+         sock->errno_ = err ? err : errno;
+         return false;
+      }
+
+      /* a completion in the error queue raises POLLERR */
+      if (!_mongoc_socket_wait (sock, POLLERR, expire_at)) {
+         return false;
+      }
+
+      polled = true;
+   }
+}
+
+
+/* a send failed or timed out while the kernel may still read the caller's
+ * buffers, which the caller is free to change once we return. Reset the
+ * connection when it is closed, instead of sending or retransmitting data
+ * that may have changed meanwhile */
+static void
+_mongoc_socket_zerocopy_abort (mongoc_socket_t *sock)
+{
+   struct linger l = {1, 0};
+
+   if (setsockopt (sock->sd, SOL_SOCKET, SO_LINGER, &l, sizeof l)) {
+      TRACE ("SO_LINGER failed: %d", errno);
+   }
+}
+#endif /* MONGOC_ENABLE_ZEROCOPY */
+
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -1257,6 +1452,7 @@ _mongoc_socket_try_sendv_slow (mongoc_socket_t *sock, /* IN */
  *
  *       Helper used by mongoc_socket_sendv() to try to write as many
  *       bytes to the underlying socket until the socket buffer is full.
+ *       @flags are added to those of sendmsg(), and ignored on Windows.
  *
  *       This is performed in a non-blocking fashion.
  *
@@ -1272,7 +1468,8 @@ _mongoc_socket_try_sendv_slow (mongoc_socket_t *sock, /* IN */
 static ssize_t
 _mongoc_socket_try_sendv (mongoc_socket_t *sock, /* IN */
                           mongoc_iovec_t *iov,   /* IN */
-                          size_t iovcnt)         /* IN */
+                          size_t iovcnt,         /* IN */
+                          int flags)             /* IN */
 {
 #ifdef _WIN32
    DWORD dwNumberofBytesSent = 0;
@@ -1304,9 +1501,9 @@ _mongoc_socket_try_sendv (mongoc_socket_t *sock, /* IN */
    ret = sendmsg (sock->sd,
                   &msg,
 #ifdef MSG_NOSIGNAL
-                  MSG_NOSIGNAL);
+                  MSG_NOSIGNAL | flags);
 #else
-                  0);
+                  flags);
 #endif
    TRACE ("Send %ld out of %ld bytes", ret, iov->iov_len);
 #endif
@@ -1376,6 +1573,7 @@ mongoc_socket_sendv (mongoc_socket_t *sock,  /* IN */
    ssize_t sent;
    size_t cur = 0;
    mongoc_iovec_t *iov;
+   int flags = 0;
 
    ENTRY;
 
@@ -1386,11 +1584,27 @@ mongoc_socket_sendv (mongoc_socket_t *sock,  /* IN */
    iov = bson_malloc (sizeof (*iov) * iovcnt);
    memcpy (iov, in_iov, sizeof (*iov) * iovcnt);
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   if (_mongoc_socket_use_zerocopy (sock, in_iov, iovcnt, expire_at)) {
+      flags = MSG_ZEROCOPY;
+   }
+#endif
+
    for (;;) {
-      sent = _mongoc_socket_try_sendv (sock, &iov[cur], iovcnt - cur);
+      sent = _mongoc_socket_try_sendv (sock, &iov[cur], iovcnt - cur, flags);
       TRACE (
          "Sent %ld (of %ld) out of iovcnt=%ld", sent, iov[cur].iov_len, iovcnt);
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+      if (flags && sent > 0) {
+         sock->zerocopy_sent++;
+      } else if (flags && sent == -1 && mongoc_socket_errno (sock) == ENOBUFS) {
+         /* out of option memory to track the pages, copy the rest */
+         flags = 0;
+         continue;
+      }
+#endif
+
       /*
        * If we failed with anything other than EAGAIN or EWOULDBLOCK,
        * we should fail immediately as there is another issue with the
@@ -1426,6 +1640,12 @@ mongoc_socket_sendv (mongoc_socket_t *sock,  /* IN */
           */
          if (cur == iovcnt) {
             TRACE ("%s", "Finished the iovecs");
+#ifdef MONGOC_ENABLE_ZEROCOPY
+            if (sock->zerocopy_done != sock->zerocopy_sent &&
+                !_mongoc_socket_zerocopy_wait (sock, expire_at)) {
+               ret = -1;
+            }
+#endif
             break;
          }
 
@@ -1458,6 +1678,11 @@ mongoc_socket_sendv (mongoc_socket_t *sock,  /* IN */
    }
 
 CLEANUP:
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   if (sock->zerocopy_done != sock->zerocopy_sent) {
+      _mongoc_socket_zerocopy_abort (sock);
+   }
+#endif
    bson_free (iov);
 
    RETURN (ret);
@@ -261,6 +261,18 @@ mongoc_stream_buffered_readv (mongoc_stream_t *stream, /* IN */
 }
 
 
+/* whether bytes read ahead from the base stream are waiting in the buffer */
+bool
+_mongoc_stream_buffered_has_pending_data (mongoc_stream_t *stream)
+{
+   mongoc_stream_buffered_t *buffered = (mongoc_stream_buffered_t *) stream;
+
+   BSON_ASSERT (stream->type == MONGOC_STREAM_BUFFERED);
+
+   return buffered->buffer.len > 0;
+}
+
+
 static mongoc_stream_t *
 _mongoc_stream_buffered_get_base_stream (mongoc_stream_t *stream) /* IN */
 {
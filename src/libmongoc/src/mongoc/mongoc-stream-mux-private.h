@@ -0,0 +1,91 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_STREAM_MUX_PRIVATE_H
+#define MONGOC_STREAM_MUX_PRIVATE_H
+
+#include <bson/bson.h>
+
+#include "mongoc-buffer-private.h"
+#include "mongoc-cluster-private.h"
+#include "mongoc-set-private.h"
+#include "mongoc-thread-private.h"
+#include "mongoc-topology-description-private.h"
+
+BSON_BEGIN_DECLS
+
+/* A connection shared by the clients of a pool. Each client sees it through
+ * its own mux stream: requests are renumbered with ids unique to the
+ * connection, and replies are routed back to the stream that sent the request
+ * by their responseTo field. */
+typedef struct _mongoc_mux_conn_t {
+   uint32_t server_id;
+   /* the real connection, already handshaked and authenticated */
+   mongoc_cluster_node_t *node;
+   /* guards every field below but "in" */
+   bson_mutex_t mutex;
+   /* signaled when a reply is routed, the reader gives up, or on failure */
+   mongoc_cond_t cond;
+   /* keeps concurrent requests whole on the wire. TLS and custom streams
+    * may not read and write at once, so for them the reader also holds it
+    * while reading */
+   bson_mutex_t io_mutex;
+   bool serialize_io;
+   /* one for the mux, plus one per mux stream */
+   int refcount;
+   int32_t request_id;
+   /* requests awaiting a reply, by the id sent on the wire */
+   mongoc_set_t *pending;
+   /* true while a thread reads from the connection for everyone */
+   bool reading;
+   bool failed;
+   /* the reply being read, only touched by the reading thread. It survives a
+    * reader that times out, the next reader continues it */
+   mongoc_buffer_t in;
+   struct _mongoc_mux_conn_t *next;
+   struct _mongoc_mux_conn_t *prev;
+} mongoc_mux_conn_t;
+
+/* Shared connections to each server, owned by a client pool. */
+typedef struct _mongoc_mux_t {
+   bson_mutex_t mutex;
+   /* signaled when a connection attempt ends */
+   mongoc_cond_t cond;
+   uint32_t conns_per_server;
+   mongoc_mux_conn_t *conns;
+   /* connections being opened without the mutex, a count by server id */
+   mongoc_set_t *connecting;
+} mongoc_mux_t;
+
+
+mongoc_mux_t *
+_mongoc_mux_new (uint32_t conns_per_server);
+
+void
+_mongoc_mux_destroy (mongoc_mux_t *mux);
+
+mongoc_cluster_node_t *
+_mongoc_mux_connect_node (mongoc_mux_t *mux,
+                          mongoc_cluster_t *cluster,
+                          const mongoc_topology_description_t *td,
+                          uint32_t server_id,
+                          bson_error_t *error);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_STREAM_MUX_PRIVATE_H */
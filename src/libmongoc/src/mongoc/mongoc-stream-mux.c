@@ -0,0 +1,996 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+
+#include "mongoc-socket-private.h"
+#include "mongoc-stream-mux-private.h"
+#include "mongoc-stream-private.h"
+#include "mongoc-stream-socket.h"
+#include "mongoc-topology-private.h"
+#include "mongoc-trace-private.h"
+#include "utlist.h"
+
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "stream-mux"
+
+#define MUX_HEADER_LEN 16
+#define MUX_OP_REPLY 1
+#define MUX_OP_UPDATE 2001
+#define MUX_OP_INSERT 2002
+#define MUX_OP_QUERY 2004
+#define MUX_OP_DELETE 2006
+#define MUX_OP_KILL_CURSORS 2007
+#define MUX_OP_MSG 2013
+#define MUX_MSG_MORE_TO_COME 2u
+#define MUX_QUERY_EXHAUST 64u
+/* while the reader of a TLS connection waits it locks out writers, so it
+ * waits in slices this long to let them in */
+#define MUX_READ_SLICE_MSEC 10
+
+
+/* a whole reply routed to a stream */
+typedef struct _mongoc_mux_msg_t {
+   uint8_t *data;
+   size_t len;
+   struct _mongoc_mux_msg_t *next;
+   struct _mongoc_mux_msg_t *prev;
+} mongoc_mux_msg_t;
+
+typedef struct {
+   mongoc_stream_t vtable;
+   mongoc_mux_conn_t *conn;
+   /* replies routed to this stream but not yet read, guarded by conn->mutex */
+   mongoc_mux_msg_t *inbox;
+   /* the reply being read by the stream's owner, and how far it has read */
+   mongoc_mux_msg_t *current;
+   size_t pos;
+   bool timed_out;
+} mongoc_stream_mux_t;
+
+typedef struct {
+   mongoc_stream_mux_t *stream;
+   /* the request id the stream's owner chose */
+   int32_t request_id;
+   /* a legacy exhaust query, answered with replies until the cursor ends */
+   bool exhaust;
+} mongoc_mux_pending_t;
+
+/* a request written by a mux stream */
+typedef struct {
+   size_t len;
+   /* the request id the stream's owner chose */
+   int32_t request_id;
+   /* the request id sent on the wire, little-endian */
+   int32_t wire_id;
+   bool expects_reply;
+   bool exhaust;
+} mongoc_mux_request_t;
+
+/* a position in the data described by an array of iovecs */
+typedef struct {
+   const mongoc_iovec_t *iov;
+   size_t iovcnt;
+   size_t i;
+   size_t pos;
+} mongoc_mux_cursor_t;
+
+
+static int32_t
+_get_int32 (const uint8_t *data, size_t offset)
+{
+   int32_t v;
+
+   memcpy (&v, data + offset, sizeof v);
+
+   return BSON_UINT32_FROM_LE (v);
+}
+
+
+static void
+_set_int32 (uint8_t *data, size_t offset, int32_t v)
+{
+   v = BSON_UINT32_TO_LE (v);
+   memcpy (data + offset, &v, sizeof v);
+}
+
+
+static bool
+_expects_reply (const uint8_t *msg, size_t len)
+{
+   int32_t opcode = _get_int32 (msg, 12);
+
+   switch (opcode) {
+   case MUX_OP_UPDATE:
+   case MUX_OP_INSERT:
+   case MUX_OP_DELETE:
+   case MUX_OP_KILL_CURSORS:
+      return false;
+   case MUX_OP_MSG:
+      return len < MUX_HEADER_LEN + 4 ||
+             !((uint32_t) _get_int32 (msg, MUX_HEADER_LEN) &
+               MUX_MSG_MORE_TO_COME);
+   default:
+      return true;
+   }
+}
+
+
+/* whether another reply follows this one without a request */
+static bool
+_more_to_come (const mongoc_mux_pending_t *pending,
+               const uint8_t *msg,
+               size_t len)
+{
+   int32_t opcode = _get_int32 (msg, 12);
+   int64_t cursor_id;
+
+   if (opcode == MUX_OP_MSG) {
+      return !_expects_reply (msg, len);
+   }
+
+   if (opcode == MUX_OP_REPLY && pending->exhaust &&
+       len >= MUX_HEADER_LEN + 12) {
+      memcpy (&cursor_id, msg + MUX_HEADER_LEN + 4, sizeof cursor_id);
+      return cursor_id != 0;
+   }
+
+   return false;
+}
+
+
+/* Consume n bytes at the cursor. Copy them to dst, and append iovecs that
+ * point to them to out, if set. */
+static void
+_cursor_take (mongoc_mux_cursor_t *cursor,
+              size_t n,
+              uint8_t *dst,
+              mongoc_array_t *out)
+{
+   mongoc_iovec_t slice;
+   size_t chunk;
+
+   while (n > 0) {
+      BSON_ASSERT (cursor->i < cursor->iovcnt);
+      chunk = BSON_MIN (n, cursor->iov[cursor->i].iov_len - cursor->pos);
+
+      if (chunk > 0) {
+         slice.iov_base =
+            (char *) cursor->iov[cursor->i].iov_base + cursor->pos;
+         slice.iov_len = chunk;
+
+         if (dst) {
+            memcpy (dst, slice.iov_base, chunk);
+            dst += chunk;
+         }
+
+         if (out) {
+            _mongoc_array_append_val (out, slice);
+         }
+
+         cursor->pos += chunk;
+         n -= chunk;
+      }
+
+      if (cursor->pos == cursor->iov[cursor->i].iov_len) {
+         cursor->i++;
+         cursor->pos = 0;
+      }
+   }
+}
+
+
+static void
+_msg_destroy (mongoc_mux_msg_t *msg)
+{
+   if (msg) {
+      bson_free (msg->data);
+      bson_free (msg);
+   }
+}
+
+
+static void
+_pending_dtor (void *item, void *ctx)
+{
+   bson_free (item);
+}
+
+
+/* whether stream may be read on one thread while written on another, like a
+ * socket, possibly buffered. Not TLS, and not unknown custom streams */
+static bool
+_is_full_duplex (mongoc_stream_t *stream)
+{
+   mongoc_stream_t *base;
+
+   for (;;) {
+      if (stream->type != MONGOC_STREAM_SOCKET &&
+          stream->type != MONGOC_STREAM_BUFFERED) {
+         return false;
+      }
+
+      base = mongoc_stream_get_base_stream (stream);
+      if (!base || base == stream) {
+         return true;
+      }
+
+      stream = base;
+   }
+}
+
+
+static mongoc_mux_conn_t *
+_mongoc_mux_conn_new (mongoc_cluster_node_t *node, uint32_t server_id)
+{
+   mongoc_mux_conn_t *conn;
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   mongoc_stream_t *root;
+
+   /* a zero-copy completion raises POLLERR on the socket, which a reader on
+    * another thread would take for a failed connection */
+   root = mongoc_stream_get_root_stream (node->stream);
+   if (root->type == MONGOC_STREAM_SOCKET) {
+      _mongoc_socket_disable_zerocopy (mongoc_stream_socket_get_socket (
+         (mongoc_stream_socket_t *) root));
+   }
+#endif
+
+   conn = (mongoc_mux_conn_t *) bson_malloc0 (sizeof *conn);
+   conn->server_id = server_id;
+   conn->node = node;
+   conn->serialize_io = !_is_full_duplex (node->stream);
+   conn->refcount = 1;
+   conn->pending = mongoc_set_new (8, _pending_dtor, NULL);
+   _mongoc_buffer_init (&conn->in, NULL, 0, NULL, NULL);
+   bson_mutex_init (&conn->mutex);
+   bson_mutex_init (&conn->io_mutex);
+   mongoc_cond_init (&conn->cond);
+
+   return conn;
+}
+
+
+static void
+_mongoc_mux_conn_release (mongoc_mux_conn_t *conn)
+{
+   bool last;
+
+   bson_mutex_lock (&conn->mutex);
+   last = --conn->refcount == 0;
+   bson_mutex_unlock (&conn->mutex);
+
+   if (!last) {
+      return;
+   }
+
+   _mongoc_cluster_node_destroy (conn->node);
+   mongoc_set_destroy (conn->pending);
+   _mongoc_buffer_destroy (&conn->in);
+   bson_mutex_destroy (&conn->mutex);
+   bson_mutex_destroy (&conn->io_mutex);
+   mongoc_cond_destroy (&conn->cond);
+   bson_free (conn);
+}
+
+
+/* call with conn->mutex locked */
+static void
+_mongoc_mux_conn_fail (mongoc_mux_conn_t *conn)
+{
+   conn->failed = true;
+   mongoc_cond_broadcast (&conn->cond);
+}
+
+
+/* Hand the complete message in conn->in to the stream awaiting it. Call with
+ * conn->mutex locked. */
+static void
+_mongoc_mux_conn_route (mongoc_mux_conn_t *conn, size_t msg_len)
+{
+   mongoc_mux_pending_t *pending;
+   mongoc_mux_pending_t *next_pending;
+   mongoc_stream_mux_t *stream;
+   mongoc_mux_msg_t *msg;
+   uint8_t *data = conn->in.data;
+   int32_t response_to = _get_int32 (data, 8);
+
+   pending = (mongoc_mux_pending_t *) mongoc_set_get (conn->pending,
+                                                      (uint32_t) response_to);
+
+   if (!pending) {
+      /* the stream that sent the request is gone */
+      _mongoc_buffer_clear (&conn->in, false);
+      return;
+   }
+
+   stream = pending->stream;
+   _set_int32 (data, 8, pending->request_id);
+
+   /* an exhaust reply: the next one responds to this one, and must not be
+    * mistaken for the reply to a request */
+   if (_more_to_come (pending, data, msg_len)) {
+      if (mongoc_set_get (conn->pending, (uint32_t) _get_int32 (data, 4))) {
+         MONGOC_WARNING ("Ambiguous reply id from %s",
+                         conn->node->connection_address);
+         _mongoc_buffer_clear (&conn->in, false);
+         _mongoc_mux_conn_fail (conn);
+         return;
+      }
+
+      next_pending = bson_malloc (sizeof *next_pending);
+      next_pending->stream = stream;
+      next_pending->request_id = _get_int32 (data, 4);
+      next_pending->exhaust = pending->exhaust;
+      mongoc_set_add (
+         conn->pending, (uint32_t) next_pending->request_id, next_pending);
+   }
+
+   mongoc_set_rm (conn->pending, (uint32_t) response_to);
+
+   msg = bson_malloc0 (sizeof *msg);
+   msg->data = data;
+   msg->len = msg_len;
+   DL_APPEND (stream->inbox, msg);
+
+   /* the stream owns the message now */
+   _mongoc_buffer_init (&conn->in, NULL, 0, NULL, NULL);
+   mongoc_cond_broadcast (&conn->cond);
+}
+
+
+/* Read one message from the connection and route it, unless expire_at passes
+ * first. Call without conn->mutex, as the only reader. */
+static void
+_mongoc_mux_conn_read (mongoc_mux_conn_t *conn, int64_t expire_at)
+{
+   mongoc_stream_t *stream = conn->node->stream;
+   size_t msg_len = 0;
+   size_t need;
+   int64_t now;
+   int64_t read_expire_at;
+   int32_t timeout_msec;
+   ssize_t ret;
+
+   for (;;) {
+      if (conn->in.len < 4) {
+         need = 4 - conn->in.len;
+      } else {
+         msg_len = (size_t) _get_int32 (conn->in.data, 0);
+         if (msg_len < MUX_HEADER_LEN ||
+             msg_len > (size_t) conn->node->handshake_sd->max_msg_size) {
+            MONGOC_WARNING ("Invalid reply length from %s",
+                            conn->node->connection_address);
+            break;
+         }
+
+         need = msg_len - conn->in.len;
+      }
+
+      if (msg_len && !need) {
+         bson_mutex_lock (&conn->mutex);
+         _mongoc_mux_conn_route (conn, msg_len);
+         bson_mutex_unlock (&conn->mutex);
+         return;
+      }
+
+      timeout_msec = -1;
+      if (expire_at >= 0) {
+         now = bson_get_monotonic_time ();
+         timeout_msec = (int32_t) BSON_MAX (0, (expire_at - now) / 1000);
+      }
+
+      if (conn->serialize_io) {
+         if (timeout_msec < 0 || timeout_msec > MUX_READ_SLICE_MSEC) {
+            timeout_msec = MUX_READ_SLICE_MSEC;
+         }
+
+         bson_mutex_lock (&conn->io_mutex);
+      }
+
+      read_expire_at =
+         timeout_msec < 0
+            ? -1
+            : bson_get_monotonic_time () + 1000 * (int64_t) timeout_msec;
+
+      ret = _mongoc_buffer_try_append_from_stream (
+         &conn->in, stream, need, timeout_msec);
+
+      if (conn->serialize_io) {
+         bson_mutex_unlock (&conn->io_mutex);
+      }
+
+      if (ret > 0) {
+         continue;
+      }
+
+      /* a writer on another thread may reset the socket's error, so a read
+       * that fails past its deadline counts as timed out */
+      now = bson_get_monotonic_time ();
+      if (ret < 0 && (mongoc_stream_timed_out (stream) ||
+                      (read_expire_at >= 0 && now >= read_expire_at))) {
+         if (expire_at < 0 || now < expire_at) {
+            /* only a slice passed */
+            continue;
+         }
+
+         /* a partial message stays in conn->in for the next reader */
+         return;
+      }
+
+      break;
+   }
+
+   bson_mutex_lock (&conn->mutex);
+   _mongoc_mux_conn_fail (conn);
+   bson_mutex_unlock (&conn->mutex);
+}
+
+
+/* Wait for the next reply routed to this stream, reading from the connection
+ * on behalf of all its streams while no other thread does. */
+static mongoc_mux_msg_t *
+_mongoc_stream_mux_next (mongoc_stream_mux_t *mux, int64_t expire_at)
+{
+   mongoc_mux_conn_t *conn = mux->conn;
+   mongoc_mux_msg_t *msg = NULL;
+   bool tried = false;
+   int64_t now;
+   int64_t wait_msec;
+
+   bson_mutex_lock (&conn->mutex);
+
+   for (;;) {
+      if (mux->inbox) {
+         msg = mux->inbox;
+         DL_DELETE (mux->inbox, msg);
+         break;
+      }
+
+      if (conn->failed) {
+         errno = ECONNRESET;
+         break;
+      }
+
+      now = bson_get_monotonic_time ();
+      if (tried && expire_at >= 0 && now >= expire_at) {
+         mux->timed_out = true;
+         errno = ETIMEDOUT;
+         break;
+      }
+
+      tried = true;
+
+      if (!conn->reading) {
+         conn->reading = true;
+         bson_mutex_unlock (&conn->mutex);
+         _mongoc_mux_conn_read (conn, expire_at);
+         bson_mutex_lock (&conn->mutex);
+         conn->reading = false;
+         /* let a waiting stream take over */
+         mongoc_cond_broadcast (&conn->cond);
+      } else if (expire_at >= 0) {
+         wait_msec = (expire_at - now + 999) / 1000;
+         mongoc_cond_timedwait (&conn->cond, &conn->mutex, wait_msec);
+      } else {
+         mongoc_cond_wait (&conn->cond, &conn->mutex);
+      }
+   }
+
+   bson_mutex_unlock (&conn->mutex);
+
+   return msg;
+}
+
+
+static ssize_t
+_mongoc_stream_mux_readv (mongoc_stream_t *stream,
+                          mongoc_iovec_t *iov,
+                          size_t iovcnt,
+                          size_t min_bytes,
+                          int32_t timeout_msec)
+{
+   mongoc_stream_mux_t *mux = (mongoc_stream_mux_t *) stream;
+   int64_t expire_at = -1;
+   ssize_t total = 0;
+   size_t iov_pos = 0;
+   size_t n;
+   size_t i = 0;
+
+   ENTRY;
+
+   mux->timed_out = false;
+
+   if (timeout_msec >= 0) {
+      expire_at = bson_get_monotonic_time () + 1000 * (int64_t) timeout_msec;
+   }
+
+   while (i < iovcnt) {
+      if (iov_pos == iov[i].iov_len) {
+         i++;
+         iov_pos = 0;
+         continue;
+      }
+
+      if (!mux->current || mux->pos == mux->current->len) {
+         if (total > 0 && (size_t) total >= min_bytes) {
+            break;
+         }
+
+         _msg_destroy (mux->current);
+         mux->pos = 0;
+         mux->current = _mongoc_stream_mux_next (mux, expire_at);
+
+         if (!mux->current) {
+            RETURN (total > 0 ? total : -1);
+         }
+      }
+
+      n = BSON_MIN (iov[i].iov_len - iov_pos, mux->current->len - mux->pos);
+      memcpy ((uint8_t *) iov[i].iov_base + iov_pos,
+              mux->current->data + mux->pos,
+              n);
+      iov_pos += n;
+      mux->pos += n;
+      total += (ssize_t) n;
+   }
+
+   RETURN (total);
+}
+
+
+static ssize_t
+_mongoc_stream_mux_writev (mongoc_stream_t *stream,
+                           mongoc_iovec_t *iov,
+                           size_t iovcnt,
+                           int32_t timeout_msec)
+{
+   mongoc_stream_mux_t *mux = (mongoc_stream_mux_t *) stream;
+   mongoc_mux_conn_t *conn = mux->conn;
+   mongoc_mux_pending_t *pending;
+   mongoc_mux_request_t request;
+   mongoc_mux_request_t *requests;
+   mongoc_mux_cursor_t cursor = {iov, iovcnt, 0, 0};
+   mongoc_mux_cursor_t peek;
+   mongoc_array_t requests_array;
+   mongoc_array_t out;
+   mongoc_iovec_t wire_id;
+   bson_error_t error;
+   uint8_t header[MUX_HEADER_LEN + 4];
+   ssize_t ret = -1;
+   size_t len = 0;
+   size_t off;
+   size_t i;
+   bool ok;
+
+   ENTRY;
+
+   mux->timed_out = false;
+   _mongoc_array_init (&requests_array, sizeof (mongoc_mux_request_t));
+   _mongoc_array_init (&out, sizeof (mongoc_iovec_t));
+
+   for (i = 0; i < iovcnt; i++) {
+      len += iov[i].iov_len;
+   }
+
+   /* only whole messages can be renumbered */
+   for (off = 0; off < len; off += request.len) {
+      if (len - off < 4) {
+         errno = EINVAL;
+         GOTO (done);
+      }
+
+      memset (header, 0, sizeof header);
+      peek = cursor;
+      _cursor_take (&peek, BSON_MIN (len - off, sizeof header), header, NULL);
+
+      request.len = (size_t) _get_int32 (header, 0);
+      if (request.len < MUX_HEADER_LEN || request.len > len - off) {
+         errno = EINVAL;
+         GOTO (done);
+      }
+
+      request.request_id = _get_int32 (header, 4);
+      request.wire_id = 0;
+      request.expects_reply = _expects_reply (header, request.len);
+      request.exhaust =
+         _get_int32 (header, 12) == MUX_OP_QUERY &&
+         request.len >= MUX_HEADER_LEN + 4 &&
+         ((uint32_t) _get_int32 (header, MUX_HEADER_LEN) & MUX_QUERY_EXHAUST);
+      _mongoc_array_append_val (&requests_array, request);
+
+      _cursor_take (&cursor, request.len, NULL, NULL);
+   }
+
+   requests = (mongoc_mux_request_t *) requests_array.data;
+
+   bson_mutex_lock (&conn->mutex);
+
+   if (conn->failed) {
+      bson_mutex_unlock (&conn->mutex);
+      errno = ECONNRESET;
+      GOTO (done);
+   }
+
+   for (i = 0; i < requests_array.len; i++) {
+      /* skip ids that exhaust replies will respond to */
+      do {
+         conn->request_id = (int32_t) ((uint32_t) conn->request_id + 1u);
+      } while (mongoc_set_get (conn->pending, (uint32_t) conn->request_id));
+
+      if (requests[i].expects_reply) {
+         pending = bson_malloc (sizeof *pending);
+         pending->stream = mux;
+         pending->request_id = requests[i].request_id;
+         pending->exhaust = requests[i].exhaust;
+         mongoc_set_add (conn->pending, (uint32_t) conn->request_id, pending);
+      }
+
+      _set_int32 ((uint8_t *) &requests[i].wire_id, 0, conn->request_id);
+   }
+
+   bson_mutex_unlock (&conn->mutex);
+
+   /* write the caller's buffers, only the request ids are replaced */
+   cursor.i = 0;
+   cursor.pos = 0;
+   for (i = 0; i < requests_array.len; i++) {
+      _cursor_take (&cursor, 4, NULL, &out);
+      _cursor_take (&cursor, 4, NULL, NULL);
+      wire_id.iov_base = (void *) &requests[i].wire_id;
+      wire_id.iov_len = 4;
+      _mongoc_array_append_val (&out, wire_id);
+      _cursor_take (&cursor, requests[i].len - 8, NULL, &out);
+   }
+
+   bson_mutex_lock (&conn->io_mutex);
+   ok = _mongoc_stream_writev_full (conn->node->stream,
+                                    (mongoc_iovec_t *) out.data,
+                                    out.len,
+                                    timeout_msec,
+                                    &error);
+   bson_mutex_unlock (&conn->io_mutex);
+
+   if (!ok) {
+      /* a partial request can't be taken back */
+      mux->timed_out = mongoc_stream_timed_out (conn->node->stream);
+      bson_mutex_lock (&conn->mutex);
+      _mongoc_mux_conn_fail (conn);
+      bson_mutex_unlock (&conn->mutex);
+      errno = mux->timed_out ? ETIMEDOUT : ECONNRESET;
+      GOTO (done);
+   }
+
+   ret = (ssize_t) len;
+
+done:
+   _mongoc_array_destroy (&requests_array);
+   _mongoc_array_destroy (&out);
+
+   RETURN (ret);
+}
+
+
+static void
+_mongoc_stream_mux_destroy (mongoc_stream_t *stream)
+{
+   mongoc_stream_mux_t *mux = (mongoc_stream_mux_t *) stream;
+   mongoc_mux_conn_t *conn = mux->conn;
+   mongoc_mux_pending_t *pending;
+   mongoc_mux_msg_t *msg;
+   mongoc_mux_msg_t *tmp;
+   uint32_t id;
+   int i;
+
+   ENTRY;
+
+   bson_mutex_lock (&conn->mutex);
+
+   /* replies still to come for this stream are dropped when they arrive */
+   for (i = (int) conn->pending->items_len - 1; i >= 0; i--) {
+      pending = mongoc_set_get_item_and_id (conn->pending, i, &id);
+      if (pending->stream == mux) {
+         mongoc_set_rm (conn->pending, id);
+      }
+   }
+
+   DL_FOREACH_SAFE (mux->inbox, msg, tmp)
+   {
+      DL_DELETE (mux->inbox, msg);
+      _msg_destroy (msg);
+   }
+
+   bson_mutex_unlock (&conn->mutex);
+
+   _msg_destroy (mux->current);
+   _mongoc_mux_conn_release (conn);
+   bson_free (mux);
+
+   EXIT;
+}
+
+
+static int
+_mongoc_stream_mux_close (mongoc_stream_t *stream)
+{
+   /* the shared connection outlives the stream */
+   return 0;
+}
+
+
+static int
+_mongoc_stream_mux_flush (mongoc_stream_t *stream)
+{
+   return 0;
+}
+
+
+static bool
+_mongoc_stream_mux_check_closed (mongoc_stream_t *stream)
+{
+   mongoc_stream_mux_t *mux = (mongoc_stream_mux_t *) stream;
+   bool failed;
+
+   bson_mutex_lock (&mux->conn->mutex);
+   failed = mux->conn->failed;
+   bson_mutex_unlock (&mux->conn->mutex);
+
+   return failed;
+}
+
+
+static bool
+_mongoc_stream_mux_timed_out (mongoc_stream_t *stream)
+{
+   return ((mongoc_stream_mux_t *) stream)->timed_out;
+}
+
+
+static bool
+_mongoc_stream_mux_should_retry (mongoc_stream_t *stream)
+{
+   return false;
+}
+
+
+static mongoc_stream_t *
+_mongoc_stream_mux_new (mongoc_mux_conn_t *conn)
+{
+   mongoc_stream_mux_t *mux;
+
+   mux = (mongoc_stream_mux_t *) bson_malloc0 (sizeof *mux);
+   mux->vtable.type = MONGOC_STREAM_MUX;
+   mux->vtable.destroy = _mongoc_stream_mux_destroy;
+   mux->vtable.failed = _mongoc_stream_mux_destroy;
+   mux->vtable.close = _mongoc_stream_mux_close;
+   mux->vtable.flush = _mongoc_stream_mux_flush;
+   mux->vtable.writev = _mongoc_stream_mux_writev;
+   mux->vtable.readv = _mongoc_stream_mux_readv;
+   mux->vtable.check_closed = _mongoc_stream_mux_check_closed;
+   mux->vtable.timed_out = _mongoc_stream_mux_timed_out;
+   mux->vtable.should_retry = _mongoc_stream_mux_should_retry;
+   mux->conn = conn;
+
+   bson_mutex_lock (&conn->mutex);
+   conn->refcount++;
+   bson_mutex_unlock (&conn->mutex);
+
+   return (mongoc_stream_t *) mux;
+}
+
+
+static void
+_connecting_dtor (void *item, void *ctx)
+{
+   bson_free (item);
+}
+
+
+/* Open a new shared connection to the server, reserving its place among the
+ * server's connections while connecting without the mutex. Call with
+ * mux->mutex locked, it is locked again on return. */
+static mongoc_mux_conn_t *
+_mongoc_mux_open_conn (mongoc_mux_t *mux,
+                       mongoc_cluster_t *cluster,
+                       const mongoc_topology_description_t *td,
+                       uint32_t server_id,
+                       bson_error_t *error)
+{
+   mongoc_mux_conn_t *conn = NULL;
+   mongoc_cluster_node_t *node;
+   uint32_t *n_connecting;
+
+   n_connecting = mongoc_set_get (mux->connecting, server_id);
+   if (!n_connecting) {
+      n_connecting = bson_malloc0 (sizeof *n_connecting);
+      mongoc_set_add (mux->connecting, server_id, n_connecting);
+   }
+
+   (*n_connecting)++;
+   bson_mutex_unlock (&mux->mutex);
+
+   node = _mongoc_cluster_connect_node (cluster, td, server_id, error);
+
+   bson_mutex_lock (&mux->mutex);
+
+   n_connecting = mongoc_set_get (mux->connecting, server_id);
+   if (--(*n_connecting) == 0) {
+      mongoc_set_rm (mux->connecting, server_id);
+   }
+
+   if (node) {
+      conn = _mongoc_mux_conn_new (node, server_id);
+      DL_APPEND (mux->conns, conn);
+   }
+
+   /* let threads waiting for a connection share this one, or try again */
+   mongoc_cond_broadcast (&mux->cond);
+
+   return conn;
+}
+
+
+mongoc_mux_t *
+_mongoc_mux_new (uint32_t conns_per_server)
+{
+   mongoc_mux_t *mux;
+
+   BSON_ASSERT (conns_per_server > 0);
+
+   mux = (mongoc_mux_t *) bson_malloc0 (sizeof *mux);
+   mux->conns_per_server = conns_per_server;
+   mux->connecting = mongoc_set_new (8, _connecting_dtor, NULL);
+   bson_mutex_init (&mux->mutex);
+   mongoc_cond_init (&mux->cond);
+
+   return mux;
+}
+
+
+void
+_mongoc_mux_destroy (mongoc_mux_t *mux)
+{
+   mongoc_mux_conn_t *conn;
+   mongoc_mux_conn_t *tmp;
+
+   if (!mux) {
+      return;
+   }
+
+   DL_FOREACH_SAFE (mux->conns, conn, tmp)
+   {
+      DL_DELETE (mux->conns, conn);
+      _mongoc_mux_conn_release (conn);
+   }
+
+   BSON_ASSERT (mux->connecting->items_len == 0);
+   mongoc_set_destroy (mux->connecting);
+   bson_mutex_destroy (&mux->mutex);
+   mongoc_cond_destroy (&mux->cond);
+   bson_free (mux);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_mux_connect_node --
+ *
+ *       Get a node for the cluster whose stream shares a connection to the
+ *       given server with the other clients of the pool. Opens a connection
+ *       if there are fewer than conns_per_server, otherwise shares the
+ *       least used one. Connecting doesn't block the other clients of the
+ *       pool, but when every connection is still being opened, waits for
+ *       one.
+ *
+ * Returns:
+ *       A new node that must be destroyed with _mongoc_cluster_node_destroy,
+ *       or NULL on failure.
+ *
+ * Side effects:
+ *       Drops failed connections and those from an older generation. Sets
+ *       error on failure.
+ *
+ *--------------------------------------------------------------------------
+ */
+mongoc_cluster_node_t *
+_mongoc_mux_connect_node (mongoc_mux_t *mux,
+                          mongoc_cluster_t *cluster,
+                          const mongoc_topology_description_t *td,
+                          uint32_t server_id,
+                          bson_error_t *error)
+{
+   mongoc_mux_conn_t *conn;
+   mongoc_mux_conn_t *tmp;
+   mongoc_mux_conn_t *best;
+   mongoc_cluster_node_t *node;
+   mongoc_server_description_t *sd;
+   uint32_t *n_connecting;
+   uint32_t n_conns;
+   int best_refcount = 0;
+   int refcount;
+   bool stale;
+
+   ENTRY;
+
+   bson_mutex_lock (&mux->mutex);
+
+   for (;;) {
+      best = NULL;
+      n_conns = 0;
+
+      DL_FOREACH_SAFE (mux->conns, conn, tmp)
+      {
+         if (conn->server_id != server_id) {
+            continue;
+         }
+
+         sd = conn->node->handshake_sd;
+         bson_mutex_lock (&conn->mutex);
+         stale =
+            conn->failed ||
+            sd->generation < _mongoc_topology_get_connection_pool_generation (
+                                td, server_id, &sd->service_id);
+         refcount = conn->refcount;
+         bson_mutex_unlock (&conn->mutex);
+
+         if (stale) {
+            DL_DELETE (mux->conns, conn);
+            _mongoc_mux_conn_release (conn);
+            continue;
+         }
+
+         n_conns++;
+         if (!best || refcount < best_refcount) {
+            best = conn;
+            best_refcount = refcount;
+         }
+      }
+
+      /* count the connections other threads are opening */
+      n_connecting = mongoc_set_get (mux->connecting, server_id);
+      if (n_connecting) {
+         n_conns += *n_connecting;
+      }
+
+      if (n_conns < mux->conns_per_server) {
+         best = _mongoc_mux_open_conn (mux, cluster, td, server_id, error);
+         if (!best) {
+            bson_mutex_unlock (&mux->mutex);
+            RETURN (NULL);
+         }
+
+         break;
+      }
+
+      if (best) {
+         break;
+      }
+
+      /* every connection to the server is still being opened */
+      mongoc_cond_wait (&mux->cond, &mux->mutex);
+   }
+
+   node = _mongoc_cluster_node_new (_mongoc_stream_mux_new (best),
+                                    best->node->connection_address);
+   node->handshake_sd =
+      mongoc_server_description_new_copy (best->node->handshake_sd);
+
+   bson_mutex_unlock (&mux->mutex);
+
+   RETURN (node);
+}
@@ -19,6 +19,7 @@
 #ifndef MONGOC_STREAM_PRIVATE_H
 #define MONGOC_STREAM_PRIVATE_H
 
+#include "mongoc-config.h"
 #include "mongoc-iovec.h"
 #include "mongoc-stream.h"
 
@@ -33,6 +34,7 @@ BSON_BEGIN_DECLS
 #define MONGOC_STREAM_TLS 5
 #define MONGOC_STREAM_GRIDFS_UPLOAD 6
 #define MONGOC_STREAM_GRIDFS_DOWNLOAD 7
+#define MONGOC_STREAM_MUX 8
 
 bool
 mongoc_stream_wait (mongoc_stream_t *stream, int64_t expire_at);
@@ -47,6 +49,18 @@ _mongoc_stream_writev_full (mongoc_stream_t *stream,
 mongoc_stream_t *
 mongoc_stream_get_root_stream (mongoc_stream_t *stream);
 
+bool
+_mongoc_stream_has_pending_data (mongoc_stream_t *stream);
+
+bool
+_mongoc_stream_buffered_has_pending_data (mongoc_stream_t *stream);
+
+#ifdef MONGOC_ENABLE_IO_URING
+/* how many reads and writes a socket stream ran on io_uring */
+uint64_t
+_mongoc_stream_socket_uring_ops (mongoc_stream_t *stream);
+#endif
+
 BSON_END_DECLS
 
 
@@ -21,14 +21,28 @@
 #include "mongoc-socket-private.h"
 #include "mongoc-errno-private.h"
 #include "mongoc-counters-private.h"
+#include "mongoc-uring-private.h"
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "stream"
 
+#define URING_READ 0
+#define URING_WRITE 1
+
 
 struct _mongoc_stream_socket_t {
    mongoc_stream_t vtable;
    mongoc_socket_t *sock;
+#ifdef MONGOC_ENABLE_IO_URING
+   /* created on the first blocking read or write. Reads and writes have
+    * their own, since like send and recv they may run on two threads. Each
+    * ring is a file descriptor, so a connection may use three instead of
+    * one: raise RLIMIT_NOFILE for large pools */
+   mongoc_uring_t *rings[2];
+   bool rings_tried[2];
+   /* operations run on each ring, only touched by the ring's user */
+   uint64_t uring_ops[2];
+#endif
 };
 
 
@@ -78,6 +92,11 @@ _mongoc_stream_socket_destroy (mongoc_stream_t *stream)
       ss->sock = NULL;
    }
 
+#ifdef MONGOC_ENABLE_IO_URING
+   _mongoc_uring_destroy (ss->rings[URING_READ]);
+   _mongoc_uring_destroy (ss->rings[URING_WRITE]);
+#endif
+
    bson_free (ss);
 
    mongoc_counter_streams_active_dec ();
@@ -128,25 +147,18 @@ _mongoc_stream_socket_flush (mongoc_stream_t *stream)
 
 
 static ssize_t
-_mongoc_stream_socket_readv (mongoc_stream_t *stream,
-                             mongoc_iovec_t *iov,
-                             size_t iovcnt,
-                             size_t min_bytes,
-                             int32_t timeout_msec)
+_mongoc_stream_socket_readv_poll (mongoc_stream_socket_t *ss,
+                                  mongoc_iovec_t *iov,
+                                  size_t iovcnt,
+                                  size_t min_bytes,
+                                  int64_t expire_at)
 {
-   mongoc_stream_socket_t *ss = (mongoc_stream_socket_t *) stream;
-   int64_t expire_at;
    ssize_t ret = 0;
    ssize_t nread;
    size_t cur = 0;
 
    ENTRY;
 
-   BSON_ASSERT (ss);
-   BSON_ASSERT (ss->sock);
-
-   expire_at = get_expiration (timeout_msec);
-
    /*
     * This isn't ideal, we should plumb through to recvmsg(), but we
     * don't actually use this in any way but to a single buffer
@@ -190,6 +202,235 @@ _mongoc_stream_socket_readv (mongoc_stream_t *stream,
 }
 
 
+#ifdef MONGOC_ENABLE_IO_URING
+/* the stream's ring for a read or write that may block, or NULL to use poll */
+static mongoc_uring_t *
+_mongoc_stream_socket_get_ring (mongoc_stream_socket_t *ss,
+                                int which,
+                                int64_t expire_at)
+{
+   /* a non-blocking call is one send or recv either way */
+   if (expire_at == 0) {
+      return NULL;
+   }
+
+   if (!ss->rings_tried[which]) {
+      ss->rings_tried[which] = true;
+      ss->rings[which] = _mongoc_uring_new ();
+   }
+
+   if (ss->rings[which] && _mongoc_uring_failed (ss->rings[which])) {
+      _mongoc_uring_destroy (ss->rings[which]);
+      ss->rings[which] = NULL;
+   }
+
+   return ss->rings[which];
+}
+
+
+/* move past n bytes of the iovecs from *cur, returns true when all are done */
+static bool
+_mongoc_stream_socket_advance (mongoc_iovec_t *iov,
+                               size_t iovcnt,
+                               size_t *cur,
+                               size_t n)
+{
+   while (*cur < iovcnt && n >= iov[*cur].iov_len) {
+      n -= iov[(*cur)++].iov_len;
+   }
+
+   if (*cur == iovcnt) {
+      return true;
+   }
+
+   iov[*cur].iov_base = ((char *) iov[*cur].iov_base) + n;
+   iov[*cur].iov_len -= n;
+
+   return false;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_stream_socket_readv_uring --
+ *
+ *       Read as _mongoc_stream_socket_readv_poll does, but wait for the
+ *       data and the timeout with one io_uring_enter call instead of a
+ *       recv, a poll, and another recv.
+ *
+ *       If the kernel refuses the operation, finishes the read with poll.
+ *
+ *--------------------------------------------------------------------------
+ */
+static ssize_t
+_mongoc_stream_socket_readv_uring (mongoc_stream_socket_t *ss,
+                                   mongoc_uring_t *ring,
+                                   mongoc_iovec_t *iov,
+                                   size_t iovcnt,
+                                   size_t min_bytes,
+                                   int64_t expire_at)
+{
+   struct msghdr msg = {0};
+   ssize_t ret = 0;
+   ssize_t nread;
+   size_t cur = 0;
+
+   ENTRY;
+
+   for (;;) {
+      msg.msg_iov = iov + cur;
+      msg.msg_iovlen = iovcnt - cur;
+      ss->sock->errno_ = 0;
+      nread =
+         _mongoc_uring_recvmsg (ring, ss->sock->sd, &msg, 0, expire_at);
+
+      if (nread == -EAGAIN || (nread < 0 && _mongoc_uring_failed (ring))) {
+         nread = _mongoc_stream_socket_readv_poll (
+            ss,
+            iov + cur,
+            iovcnt - cur,
+            (size_t) ret < min_bytes ? min_bytes - (size_t) ret : 0,
+            expire_at);
+         RETURN (nread < 0 ? (ret >= (ssize_t) min_bytes ? ret : -1)
+                           : ret + nread);
+      }
+
+      ss->uring_ops[URING_READ]++;
+
+      if (nread <= 0) {
+         if (nread == -ETIMEDOUT) {
+            mongoc_counter_streams_timeout_inc ();
+         }
+
+         /* not read back from the socket, a writer may have reset it */
+         ss->sock->errno_ = (int) -nread;
+         if (ret >= (ssize_t) min_bytes) {
+            RETURN (ret);
+         }
+         errno = (int) -nread;
+         RETURN (-1);
+      }
+
+      mongoc_counter_streams_ingress_add (nread);
+      ret += nread;
+
+      if (_mongoc_stream_socket_advance (iov, iovcnt, &cur, (size_t) nread) ||
+          ret >= (ssize_t) min_bytes) {
+         RETURN (ret);
+      }
+   }
+}
+
+
+/* write all of the iovecs, as mongoc_socket_sendv does, with io_uring */
+static ssize_t
+_mongoc_stream_socket_writev_uring (mongoc_stream_socket_t *ss,
+                                    mongoc_uring_t *ring,
+                                    mongoc_iovec_t *in_iov,
+                                    size_t iovcnt,
+                                    int64_t expire_at)
+{
+   struct msghdr msg = {0};
+   mongoc_iovec_t *iov;
+   ssize_t ret = 0;
+   ssize_t sent;
+   size_t cur = 0;
+
+   ENTRY;
+
+   /* the caller's iovecs are left untouched, as with mongoc_socket_sendv */
+   iov = bson_malloc (sizeof (*iov) * iovcnt);
+   memcpy (iov, in_iov, sizeof (*iov) * iovcnt);
+
+   for (;;) {
+      msg.msg_iov = iov + cur;
+      msg.msg_iovlen = iovcnt - cur;
+      ss->sock->errno_ = 0;
+      sent = _mongoc_uring_sendmsg (
+         ring, ss->sock->sd, &msg, MSG_NOSIGNAL, expire_at);
+
+      if (sent == -EAGAIN || (sent < 0 && _mongoc_uring_failed (ring))) {
+         sent = mongoc_socket_sendv (
+            ss->sock, iov + cur, iovcnt - cur, expire_at);
+         errno = mongoc_socket_errno (ss->sock);
+         if (sent > 0) {
+            ret += sent;
+         }
+         break;
+      }
+
+      ss->uring_ops[URING_WRITE]++;
+
+      if (sent < 0) {
+         if (sent == -ETIMEDOUT) {
+            mongoc_counter_streams_timeout_inc ();
+         }
+
+         ss->sock->errno_ = (int) -sent;
+         errno = (int) -sent;
+         break;
+      }
+
+      mongoc_counter_streams_egress_add (sent);
+      ret += sent;
+
+      if (_mongoc_stream_socket_advance (iov, iovcnt, &cur, (size_t) sent)) {
+         break;
+      }
+   }
+
+   bson_free (iov);
+
+   RETURN (ret > 0 ? ret : -1);
+}
+
+
+uint64_t
+_mongoc_stream_socket_uring_ops (mongoc_stream_t *stream)
+{
+   mongoc_stream_socket_t *ss = (mongoc_stream_socket_t *) stream;
+
+   BSON_ASSERT (stream->type == MONGOC_STREAM_SOCKET);
+
+   return ss->uring_ops[URING_READ] + ss->uring_ops[URING_WRITE];
+}
+#endif /* MONGOC_ENABLE_IO_URING */
+
+
+static ssize_t
+_mongoc_stream_socket_readv (mongoc_stream_t *stream,
+                             mongoc_iovec_t *iov,
+                             size_t iovcnt,
+                             size_t min_bytes,
+                             int32_t timeout_msec)
+{
+   mongoc_stream_socket_t *ss = (mongoc_stream_socket_t *) stream;
+   int64_t expire_at;
+#ifdef MONGOC_ENABLE_IO_URING
+   mongoc_uring_t *ring;
+#endif
+
+   ENTRY;
+
+   BSON_ASSERT (ss);
+   BSON_ASSERT (ss->sock);
+
+   expire_at = get_expiration (timeout_msec);
+
+#ifdef MONGOC_ENABLE_IO_URING
+   ring = _mongoc_stream_socket_get_ring (ss, URING_READ, expire_at);
+   if (ring) {
+      RETURN (_mongoc_stream_socket_readv_uring (
+         ss, ring, iov, iovcnt, min_bytes, expire_at));
+   }
+#endif
+
+   RETURN (_mongoc_stream_socket_readv_poll (
+      ss, iov, iovcnt, min_bytes, expire_at));
+}
+
+
 static ssize_t
 _mongoc_stream_socket_writev (mongoc_stream_t *stream,
                               mongoc_iovec_t *iov,
@@ -199,11 +440,27 @@ _mongoc_stream_socket_writev (mongoc_stream_t *stream,
    mongoc_stream_socket_t *ss = (mongoc_stream_socket_t *) stream;
    int64_t expire_at;
    ssize_t ret;
+#ifdef MONGOC_ENABLE_IO_URING
+   mongoc_uring_t *ring;
+#endif
 
    ENTRY;
 
    if (ss->sock) {
       expire_at = get_expiration (timeout_msec);
+#ifdef MONGOC_ENABLE_IO_URING
+      ring = _mongoc_stream_socket_get_ring (ss, URING_WRITE, expire_at);
+#ifdef MONGOC_ENABLE_ZEROCOPY
+      /* mongoc_socket_sendv waits for the zero-copy completions */
+      if (_mongoc_socket_use_zerocopy (ss->sock, iov, iovcnt, expire_at)) {
+         ring = NULL;
+      }
+#endif
+      if (ring) {
+         RETURN (_mongoc_stream_socket_writev_uring (
+            ss, ring, iov, iovcnt, expire_at));
+      }
+#endif
       ret = mongoc_socket_sendv (ss->sock, iov, iovcnt, expire_at);
       errno = mongoc_socket_errno (ss->sock);
       RETURN (ret);
@@ -22,6 +22,8 @@
 #ifdef MONGOC_ENABLE_SSL_OPENSSL
 #include <bson/bson.h>
 
+#include "mongoc-stream.h"
+
 BSON_BEGIN_DECLS
 
 typedef struct {
@@ -49,6 +51,9 @@ typedef struct {
    mongoc_openssl_ocsp_opt_t *ocsp_opts;
 } mongoc_stream_tls_openssl_t;
 
+bool
+_mongoc_stream_tls_openssl_has_pending_data (mongoc_stream_t *stream);
+
 
 BSON_END_DECLS
 
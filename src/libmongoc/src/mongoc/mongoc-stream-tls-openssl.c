@@ -534,6 +534,21 @@ _mongoc_stream_tls_openssl_get_base_stream (mongoc_stream_t *stream)
 }
 
 
+/* whether OpenSSL holds decrypted bytes that have not been read */
+bool
+_mongoc_stream_tls_openssl_has_pending_data (mongoc_stream_t *stream)
+{
+   mongoc_stream_tls_t *tls = (mongoc_stream_tls_t *) stream;
+   mongoc_stream_tls_openssl_t *openssl =
+      (mongoc_stream_tls_openssl_t *) tls->ctx;
+   SSL *ssl;
+
+   BIO_get_ssl (openssl->bio, &ssl);
+
+   return ssl && SSL_pending (ssl) > 0;
+}
+
+
 static bool
 _mongoc_stream_tls_openssl_check_closed (mongoc_stream_t *stream) /* IN */
 {
@@ -30,6 +30,11 @@
 #include "mongoc-trace-private.h"
 #include "mongoc-util-private.h"
 
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+#include <openssl/ssl.h>
+#include "mongoc-stream-tls-openssl-private.h"
+#include "mongoc-stream-tls-private.h"
+#endif
 
 #undef MONGOC_LOG_DOMAIN
 #define MONGOC_LOG_DOMAIN "stream"
@@ -326,6 +331,39 @@ mongoc_stream_get_root_stream (mongoc_stream_t *stream)
    return stream;
 }
 
+/* Returns true if @stream, or a stream it wraps, holds received bytes that
+ * polling the socket beneath would not report. */
+bool
+_mongoc_stream_has_pending_data (mongoc_stream_t *stream)
+{
+   BSON_ASSERT_PARAM (stream);
+
+   while (true) {
+      switch (stream->type) {
+      case MONGOC_STREAM_BUFFERED:
+         if (_mongoc_stream_buffered_has_pending_data (stream)) {
+            return true;
+         }
+         break;
+#ifdef MONGOC_ENABLE_SSL_OPENSSL
+      case MONGOC_STREAM_TLS:
+         if (_mongoc_stream_tls_openssl_has_pending_data (stream)) {
+            return true;
+         }
+         break;
+#endif
+      default:
+         break;
+      }
+
+      if (!stream->get_base_stream) {
+         return false;
+      }
+
+      stream = stream->get_base_stream (stream);
+   }
+}
+
 mongoc_stream_t *
 mongoc_stream_get_tls_stream (mongoc_stream_t *stream) /* IN */
 {
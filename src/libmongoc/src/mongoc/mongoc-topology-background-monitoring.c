@@ -83,6 +83,66 @@ static BSON_THREAD_FUN (srv_polling_run, topology_void)
    BSON_THREAD_RETURN;
 }
 
+static BSON_THREAD_FUN (maintenance_run, topology_void)
+{
+   mongoc_topology_t *topology;
+   mc_shared_tpld td;
+   int64_t interval_msec;
+
+   topology = topology_void;
+   bson_mutex_lock (&topology->maintenance_mtx);
+   while (bson_atomic_int_fetch (&topology->scanner_state,
+                                 bson_memory_order_relaxed) ==
+          MONGOC_TOPOLOGY_SCANNER_BG_RUNNING) {
+      topology->maintenance_requested = false;
+      bson_mutex_unlock (&topology->maintenance_mtx);
+
+      topology->maintenance_cb (topology->maintenance_ctx);
+
+      td = mc_tpld_take_ref (topology);
+      interval_msec = td.ptr->heartbeat_msec;
+      mc_tpld_drop_ref (&td);
+
+      /* Sleep until the topology description changes, or until the next
+       * interval in case a connection was closed or has expired. Check for
+       * shutdown again, since it may have been signalled while unlocked. */
+      bson_mutex_lock (&topology->maintenance_mtx);
+      if (topology->maintenance_interval_msec > 0) {
+         interval_msec =
+            BSON_MIN (interval_msec, topology->maintenance_interval_msec);
+      }
+      if (!topology->maintenance_requested &&
+          bson_atomic_int_fetch (&topology->scanner_state,
+                                 bson_memory_order_relaxed) ==
+             MONGOC_TOPOLOGY_SCANNER_BG_RUNNING) {
+         mongoc_cond_timedwait (&topology->maintenance_cond,
+                                &topology->maintenance_mtx,
+                                interval_msec);
+      }
+   }
+   bson_mutex_unlock (&topology->maintenance_mtx);
+   BSON_THREAD_RETURN;
+}
+
+/* Wake the maintenance thread, if there is one.
+ *
+ * Called when reconciling the topology description, so that connections are
+ * established to newly discovered servers, and re-established to servers
+ * whose connection pools were cleared once they are available again.
+ */
+static void
+_background_monitor_request_maintenance (mongoc_topology_t *topology)
+{
+   if (!topology->is_maintaining) {
+      return;
+   }
+
+   bson_mutex_lock (&topology->maintenance_mtx);
+   topology->maintenance_requested = true;
+   mongoc_cond_signal (&topology->maintenance_cond);
+   bson_mutex_unlock (&topology->maintenance_mtx);
+}
+
 /* Create a server monitor if necessary.
  *
  * Called by monitor threads and application threads when reconciling the
@@ -158,6 +218,9 @@ _mongoc_topology_background_monitoring_start (mongoc_topology_t *topology)
       /* Do not proceed to start monitoring threads. */
       TRACE ("%s", "disabling monitoring for load balanced topology");
    } else {
+      if (topology->use_monitor_loop) {
+         topology->monitor_loop = mongoc_server_monitor_loop_new ();
+      }
       /* Reconcile to create the first server monitors. */
       _mongoc_topology_background_monitoring_reconcile (topology, tdmod.new_td);
       /* Start SRV polling thread. */
@@ -168,6 +231,14 @@ _mongoc_topology_background_monitoring_start (mongoc_topology_t *topology)
       }
    }
 
+   /* Start the maintenance thread. Load balancers are not monitored, but
+    * connections to them are still maintained. */
+   if (topology->maintenance_cb) {
+      topology->is_maintaining = true;
+      COMMON_PREFIX (thread_create)
+      (&topology->maintenance_thread, maintenance_run, topology);
+   }
+
    mc_tpld_modify_commit (tdmod);
 }
 
@@ -245,6 +316,8 @@ _mongoc_topology_background_monitoring_reconcile (
                                      server_descriptions);
    _remove_orphaned_server_monitors (topology->rtt_monitors,
                                      server_descriptions);
+
+   _background_monitor_request_maintenance (topology);
 }
 
 /* Request all server monitors to scan.
@@ -315,6 +388,13 @@ _mongoc_topology_background_monitoring_stop (mongoc_topology_t *topology)
    }
    bson_mutex_unlock (&topology->srv_polling_mtx);
 
+   if (topology->is_maintaining) {
+      /* Signal the maintenance thread to break out of waiting */
+      bson_mutex_lock (&topology->maintenance_mtx);
+      mongoc_cond_signal (&topology->maintenance_cond);
+      bson_mutex_unlock (&topology->maintenance_mtx);
+   }
+
    bson_mutex_lock (&topology->tpld_modification_mtx);
    n_srv_monitors = topology->server_monitors->items_len;
    n_rtt_monitors = topology->rtt_monitors->items_len;
@@ -346,11 +426,22 @@ _mongoc_topology_background_monitoring_stop (mongoc_topology_t *topology)
       mongoc_server_monitor_destroy (server_monitor);
    }
 
+   /* All monitors are off, stop the event loop servicing them. */
+   mongoc_server_monitor_loop_destroy (topology->monitor_loop);
+   topology->monitor_loop = NULL;
+
    /* Wait for SRV polling thread. */
    if (topology->is_srv_polling) {
       COMMON_PREFIX (thread_join) (topology->srv_polling_thread);
    }
 
+   /* Wait for the maintenance thread, which may be establishing
+    * connections. */
+   if (topology->is_maintaining) {
+      COMMON_PREFIX (thread_join) (topology->maintenance_thread);
+      topology->is_maintaining = false;
+   }
+
    /* Signal clients that are waiting on server selection to stop immediately,
     * as there will be no servers available.
     * This uses the tpld_modification_mtx as that is the mutex used with the
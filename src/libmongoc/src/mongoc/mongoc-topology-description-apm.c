@@ -112,7 +112,10 @@ _mongoc_topology_description_monitor_opening (mongoc_topology_description_t *td)
    }
 
    for (i = 0; i < mc_tpld_servers (td)->items_len; i++) {
-      sd = mongoc_set_get_item (mc_tpld_servers (td), (int) i);
+      uint32_t id;
+
+      mongoc_set_get_item_and_id (mc_tpld_servers (td), (int) i, &id);
+      sd = mongoc_topology_description_server_by_id (td, id, NULL);
       _mongoc_topology_description_monitor_server_opening (td, sd);
    }
 
@@ -134,6 +137,8 @@ _mongoc_topology_description_monitor_opening (mongoc_topology_description_t *td)
          mongoc_topology_description_cleanup (prev_td);
          _mongoc_topology_description_copy_to (td, prev_td);
       }
+      /* After copying, so that prev_td keeps the unmodified description. */
+      sd = mongoc_topology_description_server_by_id (td, sd->id, NULL);
       sd->type = MONGOC_SERVER_LOAD_BALANCER;
       _mongoc_topology_description_monitor_server_changed (td, prev_sd, sd);
       mongoc_server_description_destroy (prev_sd);
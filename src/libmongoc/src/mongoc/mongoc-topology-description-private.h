@@ -36,6 +36,8 @@ typedef enum {
    MONGOC_TOPOLOGY_DESCRIPTION_TYPES
 } mongoc_topology_description_type_t;
 
+typedef struct _mongoc_ss_cache_t mongoc_ss_cache_t;
+
 struct _mongoc_topology_description_t {
    bson_oid_t topology_id;
    bool opened;
@@ -50,6 +52,9 @@ struct _mongoc_topology_description_t {
    int32_t max_hosts; /* srvMaxHosts */
    bool stale;
    unsigned int rand_seed;
+   /* if nonzero, servers' round trip times are compared by this percentile
+    * rather than the average. see MONGOC_URI_LOCALTHRESHOLDPERCENTILE */
+   int32_t local_threshold_percentile;
 
    /* the greatest seen cluster time, for a MongoDB 3.6+ sharded cluster.
     * see Driver Sessions Spec. */
@@ -61,6 +66,11 @@ struct _mongoc_topology_description_t {
 
    mongoc_apm_callbacks_t apm_callbacks;
    void *apm_context;
+
+   /* memoised server selection results, NULL unless the description has been
+    * published as an immutable snapshot. see
+    * mongoc_topology_description_enable_selection_cache */
+   mongoc_ss_cache_t *_ss_cache_;
 };
 
 typedef enum { MONGOC_SS_READ, MONGOC_SS_WRITE } mongoc_ss_optype_t;
@@ -111,6 +121,10 @@ mongoc_topology_description_select (
    const mongoc_read_prefs_t *read_pref,
    int64_t local_threshold_ms);
 
+void
+mongoc_topology_description_enable_selection_cache (
+   mongoc_topology_description_t *td);
+
 mongoc_server_description_t *
 mongoc_topology_description_server_by_id (
    mongoc_topology_description_t *description,
@@ -25,6 +25,7 @@
 #include "mongoc-client-private.h"
 #include "mongoc-thread-private.h"
 #include "mongoc-host-list-private.h"
+#include "mongoc-counters-private.h"
 #include "utlist.h"
 
 
@@ -50,12 +51,57 @@ _is_data_node (const mongoc_server_description_t *sd)
 }
 
 
+/* Release a topology description's share of a server description. */
 static void
 _mongoc_topology_server_dtor (void *server_, void *ctx_)
 {
-   mongoc_server_description_destroy ((mongoc_server_description_t *) server_);
+   mongoc_server_description_t *sd = (mongoc_server_description_t *) server_;
+
+   if (bson_atomic_int32_fetch_add (
+          &sd->_shared_, -1, bson_memory_order_acq_rel) > 0) {
+      return;
+   }
+
+   mongoc_server_description_destroy (sd);
+}
+
+#define MONGOC_SS_CACHE_SIZE 8
+
+typedef struct {
+   mongoc_ss_optype_t optype;
+   mongoc_read_mode_t read_mode;
+   int64_t max_staleness_seconds;
+   int64_t local_threshold_ms;
+   uint32_t tags_hash;
+   bson_t tags;
+   /* array of const mongoc_server_description_t * */
+   mongoc_array_t servers;
+} mongoc_ss_cache_entry_t;
+
+struct _mongoc_ss_cache_t {
+   bson_shared_mutex_t mtx;
+   int n_entries;
+   /* the entry to overwrite next once all are in use */
+   int next;
+   mongoc_ss_cache_entry_t entries[MONGOC_SS_CACHE_SIZE];
+};
+
+
+static void
+_mongoc_ss_cache_destroy (mongoc_ss_cache_t *cache)
+{
+   int i;
+
+   for (i = 0; i < cache->n_entries; i++) {
+      bson_destroy (&cache->entries[i].tags);
+      _mongoc_array_destroy (&cache->entries[i].servers);
+   }
+
+   bson_shared_mutex_destroy (&cache->mtx);
+   bson_free (cache);
 }
 
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -134,14 +180,22 @@ _mongoc_topology_description_copy_to (const mongoc_topology_description_t *src,
    dst->type = src->type;
    dst->heartbeat_msec = src->heartbeat_msec;
    dst->rand_seed = src->rand_seed;
+   dst->local_threshold_percentile = src->local_threshold_percentile;
 
+   /* The server descriptions are shared rather than copied. The first
+    * topology description to modify one replaces it with a copy of its own,
+    * so an update only allocates the server descriptions it changes. */
    nitems = bson_next_power_of_two (mc_tpld_servers_const (src)->items_len);
    dst->_servers_ = mongoc_set_new (nitems, _mongoc_topology_server_dtor, NULL);
    for (i = 0; i < mc_tpld_servers_const (src)->items_len; i++) {
       sd = mongoc_set_get_item_and_id_const (
          mc_tpld_servers_const (src), (int) i, &id);
+      bson_atomic_int32_fetch_add (
+         &((mongoc_server_description_t *) sd)->_shared_,
+         1,
+         bson_memory_order_relaxed);
       mongoc_set_add (
-         mc_tpld_servers (dst), id, mongoc_server_description_new_copy (sd));
+         mc_tpld_servers (dst), id, (mongoc_server_description_t *) sd);
    }
 
    dst->set_name = bson_strdup (src->set_name);
@@ -162,6 +216,9 @@ _mongoc_topology_description_copy_to (const mongoc_topology_description_t *src,
 
    dst->session_timeout_minutes = src->session_timeout_minutes;
 
+   /* the copy may be modified, it starts without a selection cache */
+   dst->_ss_cache_ = NULL;
+
    EXIT;
 }
 
@@ -231,6 +288,11 @@ mongoc_topology_description_cleanup (mongoc_topology_description_t *description)
 
    bson_destroy (&description->cluster_time);
 
+   if (description->_ss_cache_) {
+      _mongoc_ss_cache_destroy (description->_ss_cache_);
+      description->_ss_cache_ = NULL;
+   }
+
    EXIT;
 }
 
@@ -650,6 +712,25 @@ _mongoc_topology_description_validate_max_staleness (
 }
 
 
+/* The round trip time by which to compare @sd with other servers */
+static int64_t
+_mongoc_topology_description_rtt (const mongoc_topology_description_t *td,
+                                  const mongoc_server_description_t *sd)
+{
+   double rtt;
+
+   if (td->local_threshold_percentile) {
+      rtt = mongoc_server_description_round_trip_time_percentile (
+         sd, td->local_threshold_percentile);
+      if (rtt >= 0) {
+         return (int64_t) rtt;
+      }
+   }
+
+   return sd->round_trip_time_msec;
+}
+
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -674,6 +755,7 @@ mongoc_topology_description_suitable_servers (
 {
    mongoc_suitable_data_t data;
    const mongoc_server_description_t **candidates;
+   int64_t *rtts;
 
    const mongoc_set_t *td_servers = mc_tpld_servers_const (topology);
    int64_t nearest = -1;
@@ -801,20 +883,25 @@ mongoc_topology_description_suitable_servers (
     *   - sharded anything
     * Find the nearest, then select within the window */
 
+   rtts = bson_malloc0 (sizeof (*rtts) * td_servers->items_len);
+
    for (i = 0; i < data.candidates_len; i++) {
-      if (candidates[i] &&
-          (nearest == -1 || nearest > candidates[i]->round_trip_time_msec)) {
-         nearest = candidates[i]->round_trip_time_msec;
+      if (candidates[i]) {
+         rtts[i] = _mongoc_topology_description_rtt (topology, candidates[i]);
+         if (nearest == -1 || nearest > rtts[i]) {
+            nearest = rtts[i];
+         }
       }
    }
 
    for (i = 0; i < data.candidates_len; i++) {
-      if (candidates[i] && (candidates[i]->round_trip_time_msec <=
-                            nearest + local_threshold_ms)) {
+      if (candidates[i] && (rtts[i] <= nearest + local_threshold_ms)) {
          _mongoc_array_append_val (set, candidates[i]);
       }
    }
 
+   bson_free (rtts);
+
 DONE:
 
    bson_free ((mongoc_server_description_t *) candidates);
@@ -849,6 +936,154 @@ mongoc_topology_description_has_data_node (
    return false;
 }
 
+static bool
+_mongoc_ss_cache_entry_matches (const mongoc_ss_cache_entry_t *entry,
+                                mongoc_ss_optype_t optype,
+                                const mongoc_read_prefs_t *read_pref,
+                                int64_t local_threshold_ms)
+{
+   if (entry->optype != optype ||
+       entry->local_threshold_ms != local_threshold_ms ||
+       entry->read_mode != mongoc_read_prefs_get_mode (read_pref)) {
+      return false;
+   }
+
+   if (!read_pref) {
+      return entry->max_staleness_seconds == MONGOC_NO_MAX_STALENESS &&
+             bson_empty (&entry->tags);
+   }
+
+   return entry->max_staleness_seconds == read_pref->max_staleness_seconds &&
+          entry->tags_hash == read_pref->tags_hash &&
+          bson_equal (&entry->tags, &read_pref->tags);
+}
+
+
+/* Store @servers for the given selection criteria, taking ownership of the
+ * array. */
+static void
+_mongoc_ss_cache_store (mongoc_ss_cache_t *cache,
+                        mongoc_ss_optype_t optype,
+                        const mongoc_read_prefs_t *read_pref,
+                        int64_t local_threshold_ms,
+                        mongoc_array_t *servers)
+{
+   mongoc_ss_cache_entry_t *entry;
+   int i;
+
+   bson_shared_mutex_lock (&cache->mtx);
+
+   /* another thread may have stored the same result meanwhile */
+   for (i = 0; i < cache->n_entries; i++) {
+      if (_mongoc_ss_cache_entry_matches (
+             &cache->entries[i], optype, read_pref, local_threshold_ms)) {
+         goto DONE;
+      }
+   }
+
+   if (cache->n_entries < MONGOC_SS_CACHE_SIZE) {
+      entry = &cache->entries[cache->n_entries++];
+   } else {
+      entry = &cache->entries[cache->next];
+      cache->next = (cache->next + 1) % MONGOC_SS_CACHE_SIZE;
+      bson_destroy (&entry->tags);
+      _mongoc_array_destroy (&entry->servers);
+   }
+
+   entry->optype = optype;
+   entry->read_mode = mongoc_read_prefs_get_mode (read_pref);
+   entry->local_threshold_ms = local_threshold_ms;
+   if (read_pref) {
+      entry->max_staleness_seconds = read_pref->max_staleness_seconds;
+      entry->tags_hash = read_pref->tags_hash;
+      bson_copy_to (&read_pref->tags, &entry->tags);
+   } else {
+      entry->max_staleness_seconds = MONGOC_NO_MAX_STALENESS;
+      entry->tags_hash = 0;
+      bson_init (&entry->tags);
+   }
+
+   entry->servers = *servers;
+   servers = NULL;
+
+DONE:
+   bson_shared_mutex_unlock (&cache->mtx);
+
+   if (servers) {
+      _mongoc_array_destroy (servers);
+   }
+}
+
+
+/* Choose among the suitable servers with "power of two choices": of two
+ * servers picked at random, take the one with fewer operations in progress, so
+ * load shifts away from a server that is slow to respond. */
+static const mongoc_server_description_t *
+_mongoc_topology_description_pick (const mongoc_topology_description_t *td,
+                                   const mongoc_array_t *servers)
+{
+   const mongoc_server_description_t *a;
+   const mongoc_server_description_t *b;
+   size_t i;
+   size_t j;
+
+   if (servers->len == 0) {
+      return NULL;
+   }
+
+   i = (size_t) _mongoc_rand_simple ((unsigned *) &td->rand_seed) %
+       servers->len;
+   a = _mongoc_array_index (servers, mongoc_server_description_t *, i);
+   if (servers->len == 1) {
+      return a;
+   }
+
+   /* a second server, distinct from the first */
+   j = (size_t) _mongoc_rand_simple ((unsigned *) &td->rand_seed) %
+       (servers->len - 1);
+   if (j >= i) {
+      j++;
+   }
+
+   b = _mongoc_array_index (servers, mongoc_server_description_t *, j);
+   if (mongoc_server_description_ops_in_flight (b) <
+       mongoc_server_description_ops_in_flight (a)) {
+      mongoc_counter_server_load_picks_inc ();
+      return b;
+   }
+
+   return a;
+}
+
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * mongoc_topology_description_enable_selection_cache --
+ *
+ *      Memoise the suitable servers found by
+ *      mongoc_topology_description_select, keyed by operation type, read
+ *      preference and localThresholdMS. Call this once @td is published;
+ *      a published description and its servers are never modified, so
+ *      the entries stay valid until @td is destroyed.
+ *
+ *-------------------------------------------------------------------------
+ */
+void
+mongoc_topology_description_enable_selection_cache (
+   mongoc_topology_description_t *td)
+{
+   BSON_ASSERT_PARAM (td);
+
+   if (td->_ss_cache_) {
+      return;
+   }
+
+   td->_ss_cache_ = bson_malloc0 (sizeof (mongoc_ss_cache_t));
+   bson_shared_mutex_init (&td->_ss_cache_->mtx);
+}
+
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -864,7 +1099,8 @@ mongoc_topology_description_has_data_node (
  *      Selected server description, or NULL upon failure.
  *
  * Side effects:
- *      None.
+ *      If the selection cache is enabled, the suitable servers are stored
+ *      in it.
  *
  *-------------------------------------------------------------------------
  */
@@ -877,7 +1113,9 @@ mongoc_topology_description_select (
 {
    mongoc_array_t suitable_servers;
    mongoc_server_description_t const *sd = NULL;
-   int rand_n;
+   mongoc_ss_cache_t *cache = topology->_ss_cache_;
+   const mongoc_ss_cache_entry_t *entry;
+   int i;
 
    ENTRY;
 
@@ -892,20 +1130,39 @@ mongoc_topology_description_select (
       }
    }
 
+   if (cache) {
+      bson_shared_mutex_lock_shared (&cache->mtx);
+      for (i = 0; i < cache->n_entries; i++) {
+         entry = &cache->entries[i];
+         if (_mongoc_ss_cache_entry_matches (
+                entry, optype, read_pref, local_threshold_ms)) {
+            sd = _mongoc_topology_description_pick (topology, &entry->servers);
+            bson_shared_mutex_unlock_shared (&cache->mtx);
+            GOTO (done);
+         }
+      }
+
+      bson_shared_mutex_unlock_shared (&cache->mtx);
+   }
+
    _mongoc_array_init (&suitable_servers,
                        sizeof (mongoc_server_description_t *));
 
    mongoc_topology_description_suitable_servers (
       &suitable_servers, optype, topology, read_pref, local_threshold_ms);
-   if (suitable_servers.len != 0) {
-      rand_n = _mongoc_rand_simple ((unsigned *) &topology->rand_seed);
-      sd = _mongoc_array_index (&suitable_servers,
-                                mongoc_server_description_t *,
-                                rand_n % suitable_servers.len);
+   sd = _mongoc_topology_description_pick (topology, &suitable_servers);
+
+   if (cache) {
+      _mongoc_ss_cache_store (cache,
+                              optype,
+                              read_pref,
+                              local_threshold_ms,
+                              &suitable_servers);
+   } else {
+      _mongoc_array_destroy (&suitable_servers);
    }
 
-   _mongoc_array_destroy (&suitable_servers);
-
+done:
    if (sd) {
       TRACE ("Topology type [%s], selected [%s] [%s]",
              mongoc_topology_description_type (topology),
@@ -925,6 +1182,11 @@ mongoc_topology_description_select (
  *       in @description. Otherwise, return NULL and fill out optional
  *       @error.
  *
+ *       The server description may be modified: if it was shared with
+ *       other topology descriptions, it is first replaced with a copy
+ *       owned by @description. Use
+ *       mongoc_topology_description_server_by_id_const to only read it.
+ *
  *       NOTE: In most cases, caller should create a duplicate of the
  *       returned server description.
  *
@@ -941,8 +1203,22 @@ mongoc_server_description_t *
 mongoc_topology_description_server_by_id (
    mongoc_topology_description_t *description, uint32_t id, bson_error_t *error)
 {
-   return (mongoc_server_description_t *)
+   mongoc_server_description_t *sd;
+   mongoc_server_description_t *copy;
+
+   sd = (mongoc_server_description_t *)
       mongoc_topology_description_server_by_id_const (description, id, error);
+
+   if (sd && bson_atomic_int32_fetch (&sd->_shared_,
+                                      bson_memory_order_acquire) > 0) {
+      copy = mongoc_server_description_new_copy (sd);
+      /* releases this topology description's share of sd */
+      BSON_ASSERT (
+         mongoc_set_replace (mc_tpld_servers (description), id, copy));
+      sd = copy;
+   }
+
+   return sd;
 }
 
 const mongoc_server_description_t *
@@ -1081,19 +1357,23 @@ _mongoc_topology_description_has_server (
 }
 
 typedef struct _mongoc_address_and_type_t {
+   mongoc_topology_description_t *topology;
    const char *address;
    mongoc_server_description_type_t type;
 } mongoc_address_and_type_t;
 
 static bool
-_mongoc_label_unknown_member_cb (void *item, void *ctx)
+_mongoc_label_unknown_member_cb (const void *item, void *ctx)
 {
-   mongoc_server_description_t *server = (mongoc_server_description_t *) item;
+   const mongoc_server_description_t *server = item;
    mongoc_address_and_type_t *data = (mongoc_address_and_type_t *) ctx;
 
    if (strcasecmp (server->connection_address, data->address) == 0 &&
        server->type == MONGOC_SERVER_UNKNOWN) {
-      mongoc_server_description_set_state (server, data->type);
+      mongoc_server_description_set_state (
+         mongoc_topology_description_server_by_id (
+            data->topology, server->id, NULL),
+         data->type);
       return false;
    }
    return true;
@@ -1126,11 +1406,13 @@ _mongoc_topology_description_label_unknown_member (
    BSON_ASSERT (description);
    BSON_ASSERT (address);
 
+   data.topology = description;
    data.type = type;
    data.address = address;
 
-   mongoc_set_for_each (
-      mc_tpld_servers (description), _mongoc_label_unknown_member_cb, &data);
+   mongoc_set_for_each_const (mc_tpld_servers_const (description),
+                              _mongoc_label_unknown_member_cb,
+                              &data);
 }
 
 /*
@@ -1266,6 +1548,7 @@ mongoc_topology_description_add_server (mongoc_topology_description_t *topology,
       description =
          (mongoc_server_description_t *) bson_malloc0 (sizeof *description);
       mongoc_server_description_init (description, server, server_id);
+      mongoc_server_description_init_load (description);
 
       mongoc_set_add (mc_tpld_servers (topology), server_id, description);
 
@@ -1376,13 +1659,16 @@ typedef struct _mongoc_primary_and_topology_t {
 
 /* invalidate old primaries */
 static bool
-_mongoc_topology_description_invalidate_primaries_cb (void *item, void *ctx)
+_mongoc_topology_description_invalidate_primaries_cb (const void *item,
+                                                      void *ctx)
 {
-   mongoc_server_description_t *server = (mongoc_server_description_t *) item;
+   const mongoc_server_description_t *sd = item;
+   mongoc_server_description_t *server;
    mongoc_primary_and_topology_t *data = (mongoc_primary_and_topology_t *) ctx;
 
-   if (server->id != data->primary->id &&
-       server->type == MONGOC_SERVER_RS_PRIMARY) {
+   if (sd->id != data->primary->id && sd->type == MONGOC_SERVER_RS_PRIMARY) {
+      server = mongoc_topology_description_server_by_id (
+         data->topology, sd->id, NULL);
       mongoc_server_description_set_state (server, MONGOC_SERVER_UNKNOWN);
       mongoc_server_description_set_set_version (server, MONGOC_NO_SET_VERSION);
       mongoc_server_description_set_election_id (server, NULL);
@@ -1552,9 +1838,10 @@ _mongoc_topology_description_update_rs_from_primary (
    /* 'Server' is the primary! Invalidate other primaries if found */
    data.primary = server;
    data.topology = topology;
-   mongoc_set_for_each (mc_tpld_servers (topology),
-                        _mongoc_topology_description_invalidate_primaries_cb,
-                        &data);
+   mongoc_set_for_each_const (
+      mc_tpld_servers_const (topology),
+      _mongoc_topology_description_invalidate_primaries_cb,
+      &data);
 
    /* Add to topology description any new servers primary knows about */
    _mongoc_topology_description_add_new_servers (topology, server);
@@ -2029,8 +2316,8 @@ mongoc_topology_description_handle_hello (
    BSON_ASSERT (topology);
    BSON_ASSERT (server_id != 0);
 
-   sd = mongoc_topology_description_server_by_id (topology, server_id, NULL);
-   if (!sd) {
+   if (!mongoc_topology_description_server_by_id_const (
+          topology, server_id, NULL)) {
       return; /* server already removed from topology */
    }
 
@@ -2039,6 +2326,9 @@ mongoc_topology_description_handle_hello (
       _mongoc_topology_description_copy_to (topology, prev_td);
    }
 
+   /* After copying, so that prev_td keeps the unmodified description. */
+   sd = mongoc_topology_description_server_by_id (topology, server_id, NULL);
+
    if (hello_response &&
        bson_iter_init_find (&iter, hello_response, "topologyVersion") &&
        BSON_ITER_HOLDS_DOCUMENT (&iter)) {
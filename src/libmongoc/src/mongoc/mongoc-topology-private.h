@@ -38,6 +38,7 @@
 #define MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_MULTI_THREADED 10000
 #define MONGOC_TOPOLOGY_HEARTBEAT_FREQUENCY_MS_SINGLE_THREADED 60000
 #define MONGOC_TOPOLOGY_MIN_RESCAN_SRV_INTERVAL_MS 60000
+#define MONGOC_TOPOLOGY_MAX_CONNECTING 2
 
 typedef enum {
    MONGOC_TOPOLOGY_SCANNER_OFF,
@@ -52,6 +53,7 @@ typedef enum mongoc_topology_cse_state_t {
 } mongoc_topology_cse_state_t;
 
 struct _mongoc_background_monitor_t;
+struct _mongoc_server_monitor_loop_t;
 struct _mongoc_client_pool_t;
 
 typedef enum { MONGOC_RR_SRV, MONGOC_RR_TXT } mongoc_rr_type_t;
@@ -191,6 +193,36 @@ typedef struct _mongoc_topology_t {
    mongoc_set_t *server_monitors;
    mongoc_set_t *rtt_monitors;
    bson_mutex_t apm_mutex;
+   /* If use_monitor_loop is set, server and RTT monitors are serviced by one
+    * event loop thread, created when background monitoring starts, instead of
+    * by a thread each. */
+   bool use_monitor_loop;
+   struct _mongoc_server_monitor_loop_t *monitor_loop;
+
+   /* For multi-threaded, limits how many connections application threads
+    * establish to each server at once. Maps server ids to
+    * mongoc_topology_connecting_t, protected by connecting_mtx. */
+   int32_t max_connecting;
+   mongoc_set_t *connecting;
+   bson_mutex_t connecting_mtx;
+   mongoc_cond_t connecting_cond;
+
+   /* For multi-threaded, a client pool may set a callback to maintain the
+    * connections of its idle clients: establishing them before the
+    * application needs them, and closing those that expired. Background
+    * monitoring runs it in a separate thread whenever the topology
+    * description is updated, and at least once per heartbeat or per
+    * maintenance_interval_msec, if that is set and shorter. Pools sharing
+    * the topology may lower maintenance_interval_msec while it runs, under
+    * maintenance_mtx. */
+   void (*maintenance_cb) (void *ctx);
+   void *maintenance_ctx;
+   int64_t maintenance_interval_msec;
+   bool is_maintaining;
+   bool maintenance_requested;
+   bson_thread_t maintenance_thread;
+   bson_mutex_t maintenance_mtx;
+   mongoc_cond_t maintenance_cond;
 
    /* This is overridable for SRV polling tests to mock DNS records. */
    _mongoc_rr_resolver_fn rr_resolver;
@@ -588,6 +620,31 @@ _mongoc_topology_invalidate_server (mongoc_topology_t *td, uint32_t server_id)
    mc_tpld_modify_commit (tdmod);
 }
 
+/**
+ * @brief Wait until fewer than maxConnecting connections to a server are
+ * being established, then count the caller's connection among them.
+ *
+ * Waiters are served in the order they arrive. Each successful call must be
+ * paired with a call to _mongoc_topology_connecting_end once the connection
+ * is established, or has failed. Does nothing for single-threaded
+ * topologies.
+ *
+ * @param topology The topology.
+ * @param server_id The ID of the server to connect to.
+ * @param expire_at The monotonic time in microseconds to stop waiting at.
+ * @param error Set if the wait timed out.
+ * @return false if the wait timed out.
+ */
+bool
+_mongoc_topology_connecting_begin (mongoc_topology_t *topology,
+                                   uint32_t server_id,
+                                   int64_t expire_at,
+                                   bson_error_t *error);
+
+void
+_mongoc_topology_connecting_end (mongoc_topology_t *topology,
+                                 uint32_t server_id);
+
 /* Return an array view to `max_hosts` or fewer elements of `hl`, or NULL if
  * `hl` is empty. The size of the returned array is written to `hl_array_size`
  * even if `hl` is empty.
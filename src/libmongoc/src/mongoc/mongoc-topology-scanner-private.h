@@ -24,6 +24,7 @@
 #include <bson/bson.h>
 #include "mongoc-async-private.h"
 #include "mongoc-async-cmd-private.h"
+#include "mongoc-buffer-private.h"
 #include "mongoc-handshake-private.h"
 #include "mongoc-host-list.h"
 #include "mongoc-apm-private.h"
@@ -41,7 +42,7 @@ typedef void (*mongoc_topology_scanner_setup_err_cb_t) (
 typedef void (*mongoc_topology_scanner_cb_t) (
    uint32_t id,
    const bson_t *bson,
-   int64_t rtt,
+   int64_t rtt_usec,
    void *data,
    const bson_error_t *error /* IN */);
 
@@ -52,6 +53,9 @@ typedef struct mongoc_topology_scanner_node {
    uint32_t id;
    /* after scanning, this is set to the successful stream if one exists. */
    mongoc_stream_t *stream;
+   /* bytes read from stream past the reply being read, e.g. the start of the
+    * next exhaust reply. It is bound to the lifetime of stream. */
+   mongoc_buffer_t read_ahead;
 
    int64_t last_used;
    int64_t last_failed;
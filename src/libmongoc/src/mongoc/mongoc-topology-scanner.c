@@ -530,6 +530,7 @@ mongoc_topology_scanner_add (mongoc_topology_scanner_t *ts,
    node->last_used = -1;
    node->hello_ok = hello_ok;
    bson_init (&node->speculative_auth_response);
+   _mongoc_buffer_init (&node->read_ahead, NULL, 0, NULL, NULL);
 
    DL_APPEND (ts->nodes, node);
 }
@@ -585,6 +586,7 @@ mongoc_topology_scanner_node_disconnect (mongoc_topology_scanner_node_t *node,
       }
 
       node->stream = NULL;
+      _mongoc_buffer_clear (&node->read_ahead, false);
       memset (
          &node->sasl_supported_mechs, 0, sizeof (node->sasl_supported_mechs));
       node->negotiated_sasl_supported_mechs = false;
@@ -605,6 +607,7 @@ mongoc_topology_scanner_node_destroy (mongoc_topology_scanner_node_t *node,
    }
 
    bson_destroy (&node->speculative_auth_response);
+   _mongoc_buffer_destroy (&node->read_ahead);
 
 #ifdef MONGOC_ENABLE_CRYPTO
    _mongoc_scram_destroy (&node->scram);
@@ -703,6 +706,7 @@ _async_success (mongoc_async_cmd_t *acmd,
    /* set our successful stream. */
    BSON_ASSERT (!node->stream);
    node->stream = stream;
+   _mongoc_buffer_clear (&node->read_ahead, false);
 
    if (!node->handshake_sd) {
       mongoc_server_description_t sd;
@@ -726,12 +730,8 @@ _async_success (mongoc_async_cmd_t *acmd,
          hello_response, &node->speculative_auth_response);
    }
 
-   /* mongoc_topology_scanner_cb_t takes rtt_msec, not usec */
-   ts->cb (node->id,
-           hello_response,
-           duration_usec / 1000,
-           ts->cb_data,
-           &acmd->error);
+   ts->cb (
+      node->id, hello_response, duration_usec, ts->cb_data, &acmd->error);
 }
 
 static void
@@ -785,9 +785,8 @@ _async_error_or_timeout (mongoc_async_cmd_t *acmd,
       _mongoc_topology_scanner_monitor_heartbeat_failed (
          ts, &node->host, &node->last_error, duration_usec);
 
-      /* call the topology scanner callback. cannot connect to this node.
-       * callback takes rtt_msec, not usec. */
-      ts->cb (node->id, NULL, duration_usec / 1000, ts->cb_data, error);
+      /* call the topology scanner callback. cannot connect to this node. */
+      ts->cb (node->id, NULL, duration_usec, ts->cb_data, error);
 
       mongoc_server_description_destroy (node->handshake_sd);
       node->handshake_sd = NULL;
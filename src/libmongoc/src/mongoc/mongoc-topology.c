@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include "mongoc-array-private.h"
 #include "mongoc-config.h"
+#include "mongoc-counters-private.h"
 
 #include "mongoc-handshake.h"
 #include "mongoc-handshake-private.h"
@@ -84,7 +86,8 @@ mongoc_topology_reconcile (const mongoc_topology_t *topology,
    /* Remove removed nodes */
    DL_FOREACH_SAFE (topology->scanner->nodes, ele, tmp)
    {
-      if (!mongoc_topology_description_server_by_id (td, ele->id, NULL)) {
+      if (!mongoc_topology_description_server_by_id_const (
+             td, ele->id, NULL)) {
          mongoc_topology_scanner_node_retire (ele);
       }
    }
@@ -103,7 +106,8 @@ _mongoc_topology_update_no_lock (uint32_t id,
       td, id, hello_response, rtt_msec, error);
 
    /* return false if server removed from topology */
-   return mongoc_topology_description_server_by_id (td, id, NULL) != NULL;
+   return mongoc_topology_description_server_by_id_const (td, id, NULL) !=
+          NULL;
 }
 
 
@@ -154,13 +158,14 @@ _mongoc_topology_scanner_setup_err_cb (uint32_t id,
 void
 _mongoc_topology_scanner_cb (uint32_t id,
                              const bson_t *hello_response,
-                             int64_t rtt_msec,
+                             int64_t rtt_usec,
                              void *data,
                              const bson_error_t *error /* IN */)
 {
    mongoc_topology_t *const topology = BSON_ASSERT_PTR_INLINE (data);
    mongoc_server_description_t *sd;
    mc_tpld_modification tdmod;
+   int64_t rtt_msec = rtt_usec / 1000;
 
    if (_mongoc_topology_get_type (topology) == MONGOC_TOPOLOGY_LOAD_BALANCED) {
       /* In load balanced mode, scanning is only for connection establishment.
@@ -194,6 +199,14 @@ _mongoc_topology_scanner_cb (uint32_t id,
       _mongoc_topology_update_no_lock (
          id, hello_response, rtt_msec, tdmod.new_td, error);
 
+      if (hello_response) {
+         sd = mongoc_topology_description_server_by_id (
+            tdmod.new_td, id, NULL);
+         if (sd && !sd->error.code) {
+            mongoc_server_description_set_rtt_sample (sd, rtt_usec);
+         }
+      }
+
       /* The processing of the hello results above may have added, changed, or
        * removed server descriptions. We need to reconcile that with our
        * monitoring agents
@@ -318,6 +331,29 @@ _mongoc_apply_srv_max_hosts (const mongoc_host_list_t *hl,
    return hl_array;
 }
 
+/* connection establishment to one server, for maxConnecting */
+typedef struct {
+   int32_t n_connecting;
+   /* tickets are granted in the order they are taken, so that threads are
+    * allowed to connect in the order they arrived */
+   uint64_t next_ticket;
+   uint64_t next_granted;
+   /* tickets of threads that timed out before their turn, skipped when
+    * their turn comes */
+   mongoc_array_t abandoned;
+} mongoc_topology_connecting_t;
+
+
+static void
+_connecting_dtor (void *item, void *ctx_unused)
+{
+   mongoc_topology_connecting_t *connecting = item;
+
+   _mongoc_array_destroy (&connecting->abandoned);
+   bson_free (connecting);
+}
+
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -381,6 +417,8 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
    mongoc_topology_description_init (td, heartbeat);
 
    td->set_name = bson_strdup (mongoc_uri_get_replica_set (uri));
+   td->local_threshold_percentile = mongoc_uri_get_option_as_int32 (
+      uri, MONGOC_URI_LOCALTHRESHOLDPERCENTILE, 0);
 
    topology->uri = mongoc_uri_copy (uri);
    topology->cse_state = MONGOC_CSE_DISABLED;
@@ -425,6 +463,14 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
                                       MONGOC_URI_CONNECTTIMEOUTMS,
                                       MONGOC_DEFAULT_CONNECTTIMEOUTMS);
 
+   topology->max_connecting =
+      mongoc_uri_get_option_as_int32 (topology->uri,
+                                      MONGOC_URI_MAXCONNECTING,
+                                      MONGOC_TOPOLOGY_MAX_CONNECTING);
+   if (topology->max_connecting <= 0) {
+      topology->max_connecting = MONGOC_TOPOLOGY_MAX_CONNECTING;
+   }
+
    topology->scanner_state = MONGOC_TOPOLOGY_SCANNER_OFF;
    topology->scanner =
       mongoc_topology_scanner_new (topology->uri,
@@ -586,6 +632,11 @@ mongoc_topology_new (const mongoc_uri_t *uri, bool single_threaded)
       bson_mutex_init (&topology->apm_mutex);
       bson_mutex_init (&topology->srv_polling_mtx);
       mongoc_cond_init (&topology->srv_polling_cond);
+      bson_mutex_init (&topology->maintenance_mtx);
+      mongoc_cond_init (&topology->maintenance_cond);
+      topology->connecting = mongoc_set_new (1, _connecting_dtor, NULL);
+      bson_mutex_init (&topology->connecting_mtx);
+      mongoc_cond_init (&topology->connecting_cond);
    }
 
    if (!topology->valid) {
@@ -685,6 +736,11 @@ mongoc_topology_destroy (mongoc_topology_t *topology)
       bson_mutex_destroy (&topology->apm_mutex);
       bson_mutex_destroy (&topology->srv_polling_mtx);
       mongoc_cond_destroy (&topology->srv_polling_cond);
+      bson_mutex_destroy (&topology->maintenance_mtx);
+      mongoc_cond_destroy (&topology->maintenance_cond);
+      mongoc_set_destroy (topology->connecting);
+      bson_mutex_destroy (&topology->connecting_mtx);
+      mongoc_cond_destroy (&topology->connecting_cond);
    }
 
    if (topology->valid) {
@@ -1425,7 +1481,6 @@ _mongoc_topology_update_from_handshake (mongoc_topology_t *topology,
 
    BSON_ASSERT (topology);
    BSON_ASSERT (sd);
-   BSON_ASSERT (!topology->single_threaded);
 
    if (_mongoc_topology_get_type (topology) == MONGOC_TOPOLOGY_LOAD_BALANCED) {
       /* In load balanced mode, scanning is only for connection establishment.
@@ -1444,8 +1499,14 @@ _mongoc_topology_update_from_handshake (mongoc_topology_t *topology,
 
    /* if pooled, wake threads waiting in mongoc_topology_server_by_id */
    mongoc_cond_broadcast (&topology->cond_client);
-   /* Update background monitoring. */
-   _mongoc_topology_background_monitoring_reconcile (topology, tdmod.new_td);
+   if (topology->single_threaded) {
+      /* Update the scanner's nodes, as its own scans do. */
+      mongoc_topology_reconcile (topology, tdmod.new_td);
+   } else {
+      /* Update background monitoring. */
+      _mongoc_topology_background_monitoring_reconcile (topology,
+                                                        tdmod.new_td);
+   }
    mc_tpld_modify_commit (tdmod);
 
    return has_server;
@@ -2042,8 +2103,17 @@ mc_tpld_modify_commit (mc_tpld_modification mod)
 {
    mongoc_shared_ptr old_sptr =
       mongoc_shared_ptr_copy (mod.topology->_shared_descr_._sptr_);
-   mongoc_shared_ptr new_sptr =
-      mongoc_shared_ptr_create (mod.new_td, _tpld_destroy_and_free);
+   mongoc_shared_ptr new_sptr;
+   mongoc_set_t *servers = mc_tpld_servers (mod.new_td);
+   size_t i;
+
+   for (i = 0; i < servers->items_len; i++) {
+      mongoc_server_description_publish (servers->items[i].item);
+   }
+
+   /* the published description is not modified again */
+   mongoc_topology_description_enable_selection_cache (mod.new_td);
+   new_sptr = mongoc_shared_ptr_create (mod.new_td, _tpld_destroy_and_free);
    mongoc_atomic_shared_ptr_store (&mod.topology->_shared_descr_._sptr_,
                                    new_sptr);
    bson_mutex_unlock (&mod.topology->tpld_modification_mtx);
@@ -2057,3 +2127,144 @@ mc_tpld_modify_drop (mc_tpld_modification mod)
    bson_mutex_unlock (&mod.topology->tpld_modification_mtx);
    mongoc_topology_description_destroy (mod.new_td);
 }
+
+
+/* grant the turns of threads that gave up waiting for them */
+static void
+_connecting_skip_abandoned (mongoc_topology_connecting_t *connecting)
+{
+   uint64_t *tickets;
+   size_t i = 0;
+
+   tickets = (uint64_t *) connecting->abandoned.data;
+   while (i < connecting->abandoned.len) {
+      if (tickets[i] == connecting->next_granted) {
+         tickets[i] = tickets[--connecting->abandoned.len];
+         connecting->next_granted++;
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+}
+
+
+bool
+_mongoc_topology_connecting_begin (mongoc_topology_t *topology,
+                                   uint32_t server_id,
+                                   int64_t expire_at,
+                                   bson_error_t *error)
+{
+   mongoc_topology_connecting_t *connecting;
+   uint64_t ticket;
+   int64_t start;
+   int64_t now;
+   bool timed_out = false;
+
+   BSON_ASSERT_PARAM (topology);
+
+   if (topology->single_threaded) {
+      return true;
+   }
+
+   bson_mutex_lock (&topology->connecting_mtx);
+   connecting = mongoc_set_get (topology->connecting, server_id);
+   if (!connecting) {
+      connecting = bson_malloc0 (sizeof *connecting);
+      _mongoc_array_init (&connecting->abandoned, sizeof (uint64_t));
+      mongoc_set_add (topology->connecting, server_id, connecting);
+   }
+
+   ticket = connecting->next_ticket++;
+   if (ticket != connecting->next_granted ||
+       connecting->n_connecting >= topology->max_connecting) {
+      start = bson_get_monotonic_time ();
+      mongoc_counter_connect_waits_inc ();
+
+      while (ticket != connecting->next_granted ||
+             connecting->n_connecting >= topology->max_connecting) {
+         now = bson_get_monotonic_time ();
+         if (now >= expire_at) {
+            timed_out = true;
+            break;
+         }
+
+         mongoc_cond_timedwait (&topology->connecting_cond,
+                                &topology->connecting_mtx,
+                                BSON_MAX ((expire_at - now) / 1000, 1));
+      }
+
+      mongoc_counter_connect_wait_usec_add (
+         bson_get_monotonic_time () - start);
+   }
+
+   if (timed_out) {
+      if (ticket == connecting->next_granted) {
+         connecting->next_granted++;
+         _connecting_skip_abandoned (connecting);
+      } else {
+         _mongoc_array_append_val (&connecting->abandoned, ticket);
+      }
+
+      if (connecting->next_granted != connecting->next_ticket) {
+         /* the next thread in line may be first now */
+         mongoc_cond_broadcast (&topology->connecting_cond);
+      } else if (!connecting->n_connecting) {
+         mongoc_set_rm (topology->connecting, server_id);
+      }
+
+      bson_mutex_unlock (&topology->connecting_mtx);
+
+      bson_set_error (error,
+                      MONGOC_ERROR_STREAM,
+                      MONGOC_ERROR_STREAM_CONNECT,
+                      "Timed out waiting for other connections to server "
+                      "%" PRIu32 " to be established (maxConnecting: %" PRId32
+                      ")",
+                      server_id,
+                      topology->max_connecting);
+      return false;
+   }
+
+   connecting->next_granted++;
+   connecting->n_connecting++;
+   _connecting_skip_abandoned (connecting);
+
+   if (connecting->next_granted != connecting->next_ticket) {
+      /* the next thread in line may be able to connect too */
+      mongoc_cond_broadcast (&topology->connecting_cond);
+   }
+
+   bson_mutex_unlock (&topology->connecting_mtx);
+
+   return true;
+}
+
+
+void
+_mongoc_topology_connecting_end (mongoc_topology_t *topology,
+                                 uint32_t server_id)
+{
+   mongoc_topology_connecting_t *connecting;
+
+   BSON_ASSERT_PARAM (topology);
+
+   if (topology->single_threaded) {
+      return;
+   }
+
+   bson_mutex_lock (&topology->connecting_mtx);
+   connecting = mongoc_set_get (topology->connecting, server_id);
+   BSON_ASSERT (connecting);
+   BSON_ASSERT (connecting->n_connecting > 0);
+   connecting->n_connecting--;
+
+   if (connecting->next_granted != connecting->next_ticket) {
+      mongoc_cond_broadcast (&topology->connecting_cond);
+   } else if (!connecting->n_connecting) {
+      /* no thread is connecting or waiting */
+      mongoc_set_rm (topology->connecting, server_id);
+   }
+
+   bson_mutex_unlock (&topology->connecting_mtx);
+}
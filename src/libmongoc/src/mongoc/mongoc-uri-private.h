@@ -98,6 +98,18 @@ mongoc_uri_finalize_loadbalanced (const mongoc_uri_t *uri, bson_error_t *error);
 bool
 mongoc_uri_finalize_srv (const mongoc_uri_t *uri, bson_error_t *error);
 
+/* _mongoc_uri_canonical_string describes @uri in a string that is equal for
+ * URIs that only differ in the order of hosts and options, or in the case of
+ * host names and option names. The password and the authentication mechanism
+ * properties are left out; compare them with _mongoc_uri_secrets_equal.
+ * Returns a string that must be freed with bson_free.
+ */
+char *
+_mongoc_uri_canonical_string (const mongoc_uri_t *uri);
+
+bool
+_mongoc_uri_secrets_equal (const mongoc_uri_t *a, const mongoc_uri_t *b);
+
 BSON_END_DECLS
 
 
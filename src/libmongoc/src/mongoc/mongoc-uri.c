@@ -729,6 +729,9 @@ mongoc_uri_option_is_int32 (const char *key)
           !strcasecmp (key, MONGOC_URI_SOCKETCHECKINTERVALMS) ||
           !strcasecmp (key, MONGOC_URI_SOCKETTIMEOUTMS) ||
           !strcasecmp (key, MONGOC_URI_LOCALTHRESHOLDMS) ||
+          !strcasecmp (key, MONGOC_URI_LOCALTHRESHOLDPERCENTILE) ||
+          !strcasecmp (key, MONGOC_URI_MAXCONNECTING) ||
+          !strcasecmp (key, MONGOC_URI_MAXCONNECTIONLIFETIMEMS) ||
           !strcasecmp (key, MONGOC_URI_MAXPOOLSIZE) ||
           !strcasecmp (key, MONGOC_URI_MAXSTALENESSSECONDS) ||
           !strcasecmp (key, MONGOC_URI_MINPOOLSIZE) ||
@@ -2617,6 +2620,15 @@ _mongoc_uri_set_option_as_int32_with_error (mongoc_uri_t *uri,
       return false;
    }
 
+   if (!bson_strcasecmp (option, MONGOC_URI_LOCALTHRESHOLDPERCENTILE) &&
+       (value < 0 || value > 100)) {
+      MONGOC_URI_ERROR (error,
+                        "Invalid \"%s\" of %d: must be between 0 and 100",
+                        option_orig,
+                        value);
+      return false;
+   }
+
    if ((options = mongoc_uri_get_options (uri)) &&
        bson_iter_init_find_case (&iter, options, option)) {
       if (BSON_ITER_HOLDS_INT32 (&iter)) {
@@ -3214,3 +3226,201 @@ mongoc_uri_finalize_srv (const mongoc_uri_t *uri, bson_error_t *error)
 
    return true;
 }
+
+
+static int
+_mongoc_uri_cmp_strings (const void *a, const void *b)
+{
+   return strcmp (*(const char *const *) a, *(const char *const *) b);
+}
+
+
+/* Append the fields of @src to @dst in the order of their keys, except
+ * @skip if it is not NULL. */
+static void
+_mongoc_uri_append_sorted (bson_t *dst,
+                           const char *key,
+                           const bson_t *src,
+                           const char *skip)
+{
+   bson_t child;
+   bson_iter_t iter;
+   const char **keys;
+   uint32_t n_keys = 0;
+   uint32_t i;
+
+   keys = bson_malloc0 ((bson_count_keys (src) + 1) * sizeof (char *));
+   BSON_ASSERT (bson_iter_init (&iter, src));
+   while (bson_iter_next (&iter)) {
+      if (!skip || strcmp (bson_iter_key (&iter), skip)) {
+         keys[n_keys++] = bson_iter_key (&iter);
+      }
+   }
+
+   qsort (keys, n_keys, sizeof (char *), _mongoc_uri_cmp_strings);
+
+   BSON_APPEND_DOCUMENT_BEGIN (dst, key, &child);
+   for (i = 0; i < n_keys; i++) {
+      BSON_ASSERT (bson_iter_init_find (&iter, src, keys[i]));
+      BSON_ASSERT (bson_append_iter (&child, NULL, 0, &iter));
+   }
+   bson_append_document_end (dst, &child);
+
+   bson_free (keys);
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_uri_canonical_string --
+ *
+ *       Describe everything @uri specifies in a string that does not depend
+ *       on how the URI was spelled: the order of hosts and options and the
+ *       case of host names and option names do not matter. Secrets are
+ *       left out, so that the string can be kept or logged; two URIs with
+ *       equal canonical strings configure clients identically if
+ *       _mongoc_uri_secrets_equal also returns true for them.
+ *
+ * Returns:
+ *       A string that must be freed with bson_free().
+ *
+ *--------------------------------------------------------------------------
+ */
+
+char *
+_mongoc_uri_canonical_string (const mongoc_uri_t *uri)
+{
+   bson_t doc = BSON_INITIALIZER;
+   bson_t child;
+   const mongoc_host_list_t *host;
+   const mongoc_write_concern_t *write_concern;
+   const mongoc_read_prefs_t *read_prefs;
+   const char *read_concern_level;
+   char **hosts;
+   uint32_t n_hosts = 0;
+   uint32_t i;
+   char *ret;
+
+   BSON_ASSERT_PARAM (uri);
+
+   if (uri->is_srv) {
+      BSON_APPEND_UTF8 (&doc, "srv", uri->srv);
+   }
+
+   LL_FOREACH (uri->hosts, host)
+   {
+      n_hosts++;
+   }
+
+   hosts = bson_malloc0 ((n_hosts + 1) * sizeof (char *));
+   i = 0;
+   LL_FOREACH (uri->hosts, host)
+   {
+      hosts[i] = bson_strdup (host->host_and_port);
+      mongoc_lowercase (hosts[i], hosts[i]);
+      i++;
+   }
+
+   qsort (hosts, n_hosts, sizeof (char *), _mongoc_uri_cmp_strings);
+
+   BSON_APPEND_ARRAY_BEGIN (&doc, "hosts", &child);
+   for (i = 0; i < n_hosts; i++) {
+      bson_append_utf8 (&child, "", 0, hosts[i], -1);
+      bson_free (hosts[i]);
+   }
+   bson_append_array_end (&doc, &child);
+   bson_free (hosts);
+
+   if (uri->username) {
+      BSON_APPEND_UTF8 (&doc, "username", uri->username);
+   }
+
+   if (uri->database) {
+      BSON_APPEND_UTF8 (&doc, "database", uri->database);
+   }
+
+   _mongoc_uri_append_sorted (&doc, "options", &uri->options, NULL);
+   /* the mechanism properties may hold a session token */
+   _mongoc_uri_append_sorted (&doc,
+                              "credentials",
+                              &uri->credentials,
+                              MONGOC_URI_AUTHMECHANISMPROPERTIES);
+   _mongoc_uri_append_sorted (&doc, "compressors", &uri->compressors, NULL);
+
+   /* read and write settings may be changed after parsing */
+   read_prefs = uri->read_prefs;
+   BSON_APPEND_DOCUMENT_BEGIN (&doc, "readPreference", &child);
+   BSON_APPEND_INT32 (&child, "mode", mongoc_read_prefs_get_mode (read_prefs));
+   BSON_APPEND_ARRAY (&child, "tags", mongoc_read_prefs_get_tags (read_prefs));
+   BSON_APPEND_INT64 (&child,
+                      "maxStalenessSeconds",
+                      mongoc_read_prefs_get_max_staleness_seconds (read_prefs));
+   BSON_APPEND_DOCUMENT (
+      &child, "hedge", mongoc_read_prefs_get_hedge (read_prefs));
+   bson_append_document_end (&doc, &child);
+
+   read_concern_level = mongoc_read_concern_get_level (uri->read_concern);
+   if (read_concern_level) {
+      BSON_APPEND_UTF8 (&doc, "readConcernLevel", read_concern_level);
+   }
+
+   write_concern = uri->write_concern;
+   BSON_APPEND_DOCUMENT_BEGIN (&doc, "writeConcern", &child);
+   BSON_APPEND_INT32 (&child, "w", mongoc_write_concern_get_w (write_concern));
+   if (mongoc_write_concern_get_wtag (write_concern)) {
+      BSON_APPEND_UTF8 (
+         &child, "wtag", mongoc_write_concern_get_wtag (write_concern));
+   }
+   BSON_APPEND_INT64 (&child,
+                      "wtimeout",
+                      mongoc_write_concern_get_wtimeout_int64 (write_concern));
+   if (mongoc_write_concern_journal_is_set (write_concern)) {
+      BSON_APPEND_BOOL (&child,
+                        "journal",
+                        mongoc_write_concern_get_journal (write_concern));
+   }
+   bson_append_document_end (&doc, &child);
+
+   ret = bson_as_canonical_extended_json (&doc, NULL);
+   bson_destroy (&doc);
+
+   return ret;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_uri_secrets_equal --
+ *
+ *       Compare the secrets _mongoc_uri_canonical_string leaves out: the
+ *       password and the authentication mechanism properties.
+ *
+ * Returns:
+ *       true if @a and @b have the same secrets, or neither has any.
+ *
+ *--------------------------------------------------------------------------
+ */
+
+bool
+_mongoc_uri_secrets_equal (const mongoc_uri_t *a, const mongoc_uri_t *b)
+{
+   bson_t props_a;
+   bson_t props_b;
+   bool has_a;
+   bool has_b;
+
+   BSON_ASSERT_PARAM (a);
+   BSON_ASSERT_PARAM (b);
+
+   if (!a->password != !b->password ||
+       (a->password && strcmp (a->password, b->password))) {
+      return false;
+   }
+
+   has_a = mongoc_uri_get_mechanism_properties (a, &props_a);
+   has_b = mongoc_uri_get_mechanism_properties (b, &props_b);
+
+   return has_a == has_b && (!has_a || bson_equal (&props_a, &props_b));
+}
@@ -46,6 +46,9 @@
 #define MONGOC_URI_JOURNAL "journal"
 #define MONGOC_URI_LOADBALANCED "loadbalanced"
 #define MONGOC_URI_LOCALTHRESHOLDMS "localthresholdms"
+#define MONGOC_URI_LOCALTHRESHOLDPERCENTILE "localthresholdpercentile"
+#define MONGOC_URI_MAXCONNECTING "maxconnecting"
+#define MONGOC_URI_MAXCONNECTIONLIFETIMEMS "maxconnectionlifetimems"
 #define MONGOC_URI_MAXIDLETIMEMS "maxidletimems"
 #define MONGOC_URI_MAXPOOLSIZE "maxpoolsize"
 #define MONGOC_URI_MAXSTALENESSSECONDS "maxstalenessseconds"
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-prelude.h"
+
+#ifndef MONGOC_URING_PRIVATE_H
+#define MONGOC_URING_PRIVATE_H
+
+#include "mongoc-config.h"
+
+#ifdef MONGOC_ENABLE_IO_URING
+#include <bson/bson.h>
+
+#include <sys/socket.h>
+
+BSON_BEGIN_DECLS
+
+/* A small io_uring, used by one thread at a time to run one socket operation
+ * and its timeout with a single system call. */
+typedef struct _mongoc_uring_t mongoc_uring_t;
+
+
+mongoc_uring_t *
+_mongoc_uring_new (void);
+
+/* whether the kernel refused io_uring, so streams use poll */
+bool
+_mongoc_uring_unavailable (void);
+
+void
+_mongoc_uring_destroy (mongoc_uring_t *ring);
+
+/* whether the ring can't be used anymore, and a failed operation should be
+ * retried without it */
+bool
+_mongoc_uring_failed (const mongoc_uring_t *ring);
+
+ssize_t
+_mongoc_uring_sendmsg (mongoc_uring_t *ring,
+                       int fd,
+                       struct msghdr *msg,
+                       int flags,
+                       int64_t expire_at);
+
+ssize_t
+_mongoc_uring_recvmsg (mongoc_uring_t *ring,
+                       int fd,
+                       struct msghdr *msg,
+                       int flags,
+                       int64_t expire_at);
+
+BSON_END_DECLS
+
+#endif /* MONGOC_ENABLE_IO_URING */
+
+#endif /* MONGOC_URING_PRIVATE_H */
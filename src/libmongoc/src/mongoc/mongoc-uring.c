@@ -0,0 +1,358 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-config.h"
+
+#ifdef MONGOC_ENABLE_IO_URING
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mongoc-uring-private.h"
+#include "mongoc-trace-private.h"
+
+#undef MONGOC_LOG_DOMAIN
+#define MONGOC_LOG_DOMAIN "uring"
+
+/* an operation and its linked timeout */
+#define URING_ENTRIES 2
+#define URING_OP_DATA 1
+#define URING_TIMEOUT_DATA 2
+
+
+struct _mongoc_uring_t {
+   int fd;
+   unsigned *sq_head;
+   unsigned *sq_tail;
+   unsigned *sq_mask;
+   unsigned *sq_array;
+   struct io_uring_sqe *sqes;
+   unsigned *cq_head;
+   unsigned *cq_tail;
+   unsigned *cq_mask;
+   struct io_uring_cqe *cqes;
+   void *sq_ptr;
+   size_t sq_len;
+   void *cq_ptr;
+   size_t cq_len;
+   size_t sqes_len;
+   /* set if the kernel refused the ring or an operation */
+   bool failed;
+};
+
+
+/* set once io_uring_setup fails, e.g. when the kernel lacks io_uring or it is
+ * disabled, or once it refuses an operation, so later streams don't retry */
+static int gUringUnavailable;
+
+
+static void
+_mongoc_uring_unmap (mongoc_uring_t *ring)
+{
+   if (ring->sqes) {
+      munmap (ring->sqes, ring->sqes_len);
+   }
+
+   if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) {
+      munmap (ring->cq_ptr, ring->cq_len);
+   }
+
+   if (ring->sq_ptr) {
+      munmap (ring->sq_ptr, ring->sq_len);
+   }
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_uring_new --
+ *
+ *       Create a ring with room for one operation and its timeout.
+ *
+ * Returns:
+ *       A new ring to destroy with _mongoc_uring_destroy, or NULL if
+ *       io_uring is not available.
+ *
+ *--------------------------------------------------------------------------
+ */
+mongoc_uring_t *
+_mongoc_uring_new (void)
+{
+   struct io_uring_params params = {0};
+   mongoc_uring_t *ring;
+   void *ptr;
+   int fd;
+
+   ENTRY;
+
+   if (bson_atomic_int_fetch (&gUringUnavailable, bson_memory_order_relaxed)) {
+      RETURN (NULL);
+   }
+
+   fd = (int) syscall (__NR_io_uring_setup, URING_ENTRIES, &params);
+   if (fd < 0) {
+      TRACE ("io_uring_setup failed: %d, using poll", errno);
+      bson_atomic_int_exchange (
+         &gUringUnavailable, 1, bson_memory_order_relaxed);
+      RETURN (NULL);
+   }
+
+   ring = (mongoc_uring_t *) bson_malloc0 (sizeof *ring);
+   ring->fd = fd;
+   ring->sq_len = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+   ring->cq_len =
+      params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->sq_len = ring->cq_len = BSON_MAX (ring->sq_len, ring->cq_len);
+   }
+
+   ptr = mmap (NULL,
+               ring->sq_len,
+               PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE,
+               fd,
+               IORING_OFF_SQ_RING);
+   if (ptr == MAP_FAILED) {
+      GOTO (fail);
+   }
+
+   ring->sq_ptr = ptr;
+
+   if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      ring->cq_ptr = ring->sq_ptr;
+   } else {
+      ptr = mmap (NULL,
+                  ring->cq_len,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE,
+                  fd,
+                  IORING_OFF_CQ_RING);
+      if (ptr == MAP_FAILED) {
+         GOTO (fail);
+      }
+
+      ring->cq_ptr = ptr;
+   }
+
+   ring->sqes_len = params.sq_entries * sizeof (struct io_uring_sqe);
+   ptr = mmap (NULL,
+               ring->sqes_len,
+               PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE,
+               fd,
+               IORING_OFF_SQES);
+   if (ptr == MAP_FAILED) {
+      GOTO (fail);
+   }
+
+   ring->sqes = (struct io_uring_sqe *) ptr;
+   ring->sq_head = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.head);
+   ring->sq_tail = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.tail);
+   ring->sq_mask =
+      (unsigned *) ((char *) ring->sq_ptr + params.sq_off.ring_mask);
+   ring->sq_array = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.array);
+   ring->cq_head = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.head);
+   ring->cq_tail = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.tail);
+   ring->cq_mask =
+      (unsigned *) ((char *) ring->cq_ptr + params.cq_off.ring_mask);
+   ring->cqes =
+      (struct io_uring_cqe *) ((char *) ring->cq_ptr + params.cq_off.cqes);
+
+   RETURN (ring);
+
+fail:
+   _mongoc_uring_unmap (ring);
+   close (fd);
+   bson_free (ring);
+   RETURN (NULL);
+}
+
+
+bool
+_mongoc_uring_unavailable (void)
+{
+   return bson_atomic_int_fetch (&gUringUnavailable,
+                                 bson_memory_order_relaxed) != 0;
+}
+
+
+void
+_mongoc_uring_destroy (mongoc_uring_t *ring)
+{
+   if (!ring) {
+      return;
+   }
+
+   _mongoc_uring_unmap (ring);
+   close (ring->fd);
+   bson_free (ring);
+}
+
+
+/* claim the next submission entry, the ring is empty between operations */
+static struct io_uring_sqe *
+_mongoc_uring_get_sqe (mongoc_uring_t *ring, unsigned *tail)
+{
+   unsigned idx = *tail & *ring->sq_mask;
+   struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+   memset (sqe, 0, sizeof *sqe);
+   ring->sq_array[idx] = idx;
+   (*tail)++;
+
+   return sqe;
+}
+
+
+/*
+ *--------------------------------------------------------------------------
+ *
+ * _mongoc_uring_run --
+ *
+ *       Submit a socket operation, linked to a timeout unless expire_at is
+ *       negative, and wait for it with a single io_uring_enter call.
+ *
+ * Returns:
+ *       The operation's result: a byte count, or a negative errno. A
+ *       timeout is -ETIMEDOUT.
+ *
+ *--------------------------------------------------------------------------
+ */
+static ssize_t
+_mongoc_uring_run (mongoc_uring_t *ring,
+                   uint8_t opcode,
+                   int fd,
+                   struct msghdr *msg,
+                   int flags,
+                   int64_t expire_at)
+{
+   struct __kernel_timespec ts;
+   struct io_uring_sqe *sqe;
+   struct io_uring_cqe *cqe;
+   unsigned tail = *ring->sq_tail;
+   unsigned head;
+   unsigned n_sqes = 1;
+   unsigned n_done = 0;
+   int64_t remaining;
+   ssize_t res = -EIO;
+   bool timed_out = false;
+   int ret;
+
+   sqe = _mongoc_uring_get_sqe (ring, &tail);
+   sqe->opcode = opcode;
+   sqe->fd = fd;
+   sqe->addr = (uint64_t) (uintptr_t) msg;
+   sqe->len = 1;
+   sqe->msg_flags = (uint32_t) flags;
+   sqe->user_data = URING_OP_DATA;
+
+   if (expire_at >= 0) {
+      remaining = BSON_MAX (0, expire_at - bson_get_monotonic_time ());
+      ts.tv_sec = remaining / (1000 * 1000);
+      ts.tv_nsec = (remaining % (1000 * 1000)) * 1000;
+
+      sqe->flags |= IOSQE_IO_LINK;
+      sqe = _mongoc_uring_get_sqe (ring, &tail);
+      sqe->opcode = IORING_OP_LINK_TIMEOUT;
+      sqe->fd = -1;
+      sqe->addr = (uint64_t) (uintptr_t) &ts;
+      sqe->len = 1;
+      sqe->user_data = URING_TIMEOUT_DATA;
+      n_sqes++;
+   }
+
+   __atomic_store_n (ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+   while (n_done < n_sqes) {
+      ret = (int) syscall (__NR_io_uring_enter,
+                           ring->fd,
+                           tail - __atomic_load_n (ring->sq_head,
+                                                   __ATOMIC_ACQUIRE),
+                           n_sqes - n_done,
+                           IORING_ENTER_GETEVENTS,
+                           NULL,
+                           0);
+      if (ret < 0 && errno != EINTR) {
+         /* the entries may still be pending, the ring can't be reused */
+         ring->failed = true;
+         return -errno;
+      }
+
+      head = *ring->cq_head;
+      while (head != __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE)) {
+         cqe = &ring->cqes[head & *ring->cq_mask];
+         if (cqe->user_data == URING_OP_DATA) {
+            res = cqe->res;
+         } else if (cqe->res == -ETIME) {
+            timed_out = true;
+         }
+
+         head++;
+         n_done++;
+      }
+
+      __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+   }
+
+   if (res == -ECANCELED && timed_out) {
+      res = -ETIMEDOUT;
+   } else if (res == -EINVAL || res == -EOPNOTSUPP) {
+      /* an older kernel without the operation */
+      ring->failed = true;
+      bson_atomic_int_exchange (
+         &gUringUnavailable, 1, bson_memory_order_relaxed);
+   }
+
+   return res;
+}
+
+
+bool
+_mongoc_uring_failed (const mongoc_uring_t *ring)
+{
+   return ring->failed;
+}
+
+
+ssize_t
+_mongoc_uring_sendmsg (mongoc_uring_t *ring,
+                       int fd,
+                       struct msghdr *msg,
+                       int flags,
+                       int64_t expire_at)
+{
+   return _mongoc_uring_run (
+      ring, IORING_OP_SENDMSG, fd, msg, flags, expire_at);
+}
+
+
+ssize_t
+_mongoc_uring_recvmsg (mongoc_uring_t *ring,
+                       int fd,
+                       struct msghdr *msg,
+                       int flags,
+                       int64_t expire_at)
+{
+   return _mongoc_uring_run (
+      ring, IORING_OP_RECVMSG, fd, msg, flags, expire_at);
+}
+
+#endif /* MONGOC_ENABLE_IO_URING */
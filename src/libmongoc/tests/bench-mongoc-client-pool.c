@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021 MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <mongoc/mongoc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common-thread-private.h"
+
+/*
+ * Measures the throughput of mongoc_client_pool_pop and
+ * mongoc_client_pool_push when many threads check clients in and out as
+ * fast as they can, as a request handler would. No server is contacted.
+ *
+ * usage: mongoc-client-pool-bench [THREADS [MAX_POOL_SIZE [SECONDS]]]
+ */
+
+
+typedef struct {
+   mongoc_client_pool_t *pool;
+   int64_t stop_at;
+   int64_t ops;
+} bench_thread_t;
+
+
+static BSON_THREAD_FUN (bench_worker, arg)
+{
+   bench_thread_t *thread = arg;
+   mongoc_client_t *client;
+   int64_t ops = 0;
+   int i;
+
+   while (bson_get_monotonic_time () < thread->stop_at) {
+      /* check the clock every so often, not on every operation */
+      for (i = 0; i < 1000; i++) {
+         client = mongoc_client_pool_pop (thread->pool);
+         mongoc_client_pool_push (thread->pool, client);
+      }
+
+      ops += 1000;
+   }
+
+   thread->ops = ops;
+
+   BSON_THREAD_RETURN;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_uri_t *uri;
+   bench_thread_t *threads;
+   bson_thread_t *ids;
+   char *uri_str;
+   int n_threads = 8;
+   int max_pool_size = 4;
+   int seconds = 5;
+   int64_t start;
+   int64_t elapsed;
+   int64_t total = 0;
+   int i;
+
+   if (argc > 4) {
+      fprintf (stderr,
+               "usage: mongoc-client-pool-bench"
+               " [THREADS [MAX_POOL_SIZE [SECONDS]]]\n");
+      return EXIT_FAILURE;
+   }
+
+   if (argc > 1) {
+      n_threads = atoi (argv[1]);
+   }
+
+   if (argc > 2) {
+      max_pool_size = atoi (argv[2]);
+   }
+
+   if (argc > 3) {
+      seconds = atoi (argv[3]);
+   }
+
+   if (n_threads < 1 || max_pool_size < 1 || seconds < 1) {
+      fprintf (stderr, "arguments must be positive integers\n");
+      return EXIT_FAILURE;
+   }
+
+   mongoc_init ();
+
+   uri_str = bson_strdup_printf ("mongodb://localhost/?maxPoolSize=%d",
+                                 max_pool_size);
+   uri = mongoc_uri_new (uri_str);
+   BSON_ASSERT (uri);
+   pool = mongoc_client_pool_new (uri);
+
+   /* create the clients up front so only checkouts are measured */
+   for (i = 0; i < max_pool_size; i++) {
+      client = mongoc_client_pool_pop (pool);
+      mongoc_client_pool_push (pool, client);
+   }
+
+   threads = bson_malloc0 (n_threads * sizeof (bench_thread_t));
+   ids = bson_malloc0 (n_threads * sizeof (bson_thread_t));
+   start = bson_get_monotonic_time ();
+
+   for (i = 0; i < n_threads; i++) {
+      threads[i].pool = pool;
+      threads[i].stop_at = start + (int64_t) seconds * 1000 * 1000;
+      BSON_ASSERT (!COMMON_PREFIX (thread_create) (
+         &ids[i], bench_worker, &threads[i]));
+   }
+
+   for (i = 0; i < n_threads; i++) {
+      COMMON_PREFIX (thread_join) (ids[i]);
+      total += threads[i].ops;
+   }
+
+   elapsed = bson_get_monotonic_time () - start;
+
+   printf ("threads=%d maxPoolSize=%d: %" PRId64 " pop/push pairs in %.2fs, "
+           "%.0f ops/s, %.1f ns/op\n",
+           n_threads,
+           max_pool_size,
+           total,
+           (double) elapsed / 1e6,
+           (double) total * 1e6 / (double) elapsed,
+           (double) elapsed * 1000.0 * n_threads / (double) total);
+
+   bson_free (ids);
+   bson_free (threads);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   bson_free (uri_str);
+   mongoc_cleanup ();
+
+   return EXIT_SUCCESS;
+}
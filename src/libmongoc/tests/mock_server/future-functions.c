@@ -158,6 +158,31 @@ BSON_THREAD_FUN (background_mongoc_client_command_simple, data)
    BSON_THREAD_RETURN;
 }
 
+static
+BSON_THREAD_FUN (background_mongoc_client_command_simple_pipelined, data)
+{
+   future_t *future = (future_t *) data;
+   future_value_t return_value;
+
+   return_value.type = future_value_bool_type;
+
+   future_value_set_bool (
+      &return_value,
+      mongoc_client_command_simple_pipelined (
+         future_value_get_mongoc_client_ptr (future_get_param (future, 0)),
+         future_value_get_const_char_ptr (future_get_param (future, 1)),
+         future_value_get_const_bson_ptr_ptr (future_get_param (future, 2)),
+         future_value_get_size_t (future_get_param (future, 3)),
+         future_value_get_const_mongoc_read_prefs_ptr (future_get_param (future, 4)),
+         future_value_get_bson_ptr (future_get_param (future, 5)),
+         future_value_get_bson_error_ptr (future_get_param (future, 6))
+      ));
+
+   future_resolve (future, return_value);
+
+   BSON_THREAD_RETURN;
+}
+
 static
 BSON_THREAD_FUN (background_mongoc_client_command_with_opts, data)
 {
@@ -1479,6 +1504,44 @@ future_client_command_simple (
    return future;
 }
 
+future_t *
+future_client_command_simple_pipelined (
+   mongoc_client_ptr client,
+   const_char_ptr db_name,
+   const_bson_ptr_ptr commands,
+   size_t n_commands,
+   const_mongoc_read_prefs_ptr read_prefs,
+   bson_ptr replies,
+   bson_error_ptr error)
+{
+   future_t *future = future_new (future_value_bool_type,
+                                  7);
+   
+   future_value_set_mongoc_client_ptr (
+      future_get_param (future, 0), client);
+   
+   future_value_set_const_char_ptr (
+      future_get_param (future, 1), db_name);
+   
+   future_value_set_const_bson_ptr_ptr (
+      future_get_param (future, 2), commands);
+   
+   future_value_set_size_t (
+      future_get_param (future, 3), n_commands);
+   
+   future_value_set_const_mongoc_read_prefs_ptr (
+      future_get_param (future, 4), read_prefs);
+   
+   future_value_set_bson_ptr (
+      future_get_param (future, 5), replies);
+   
+   future_value_set_bson_error_ptr (
+      future_get_param (future, 6), error);
+   
+   future_start (future, background_mongoc_client_command_simple_pipelined);
+   return future;
+}
+
 future_t *
 future_client_command_with_opts (
    mongoc_client_ptr client,
@@ -78,6 +78,19 @@ future_client_command_simple (
 );
 
 
+future_t *
+future_client_command_simple_pipelined (
+
+   mongoc_client_ptr client,
+   const_char_ptr db_name,
+   const_bson_ptr_ptr commands,
+   size_t n_commands,
+   const_mongoc_read_prefs_ptr read_prefs,
+   bson_ptr replies,
+   bson_error_ptr error
+);
+
+
 future_t *
 future_client_command_with_opts (
 
@@ -158,7 +158,7 @@ _mock_initiator (mongoc_async_cmd_t *acmd)
 static void
 _test_scanner_callback (uint32_t id,
                         const bson_t *bson,
-                        int64_t rtt_msec,
+                        int64_t rtt_usec,
                         void *data,
                         const bson_error_t *error /* IN */)
 {
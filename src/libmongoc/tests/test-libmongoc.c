@@ -62,8 +62,12 @@ test_clock_install (TestSuite *suite);
 extern void
 test_decimal128_install (TestSuite *suite);
 extern void
+test_diff_install (TestSuite *suite);
+extern void
 test_endian_install (TestSuite *suite);
 extern void
+test_filter_install (TestSuite *suite);
+extern void
 test_bson_error_install (TestSuite *suite);
 extern void
 test_iso8601_install (TestSuite *suite);
@@ -281,6 +285,10 @@ test_server_stream_install (TestSuite *suite);
 extern void
 test_generation_map_install (TestSuite *suite);
 extern void
+test_histogram_install (TestSuite *suite);
+extern void
+test_client_async_install (TestSuite *suite);
+extern void
 test_shared_install (TestSuite *suite);
 extern void
 test_ssl_install (TestSuite *suite);
@@ -2860,7 +2868,9 @@ main (int argc, char *argv[])
    test_bson_version_install (&suite);
    test_clock_install (&suite);
    test_decimal128_install (&suite);
+   test_diff_install (&suite);
    test_endian_install (&suite);
+   test_filter_install (&suite);
    test_iso8601_install (&suite);
    test_iter_install (&suite);
    test_json_install (&suite);
@@ -2973,6 +2983,8 @@ main (int argc, char *argv[])
    test_loadbalanced_install (&suite);
    test_server_stream_install (&suite);
    test_generation_map_install (&suite);
+   test_histogram_install (&suite);
+   test_client_async_install (&suite);
    test_shared_install (&suite);
    test_ssl_install (&suite);
 
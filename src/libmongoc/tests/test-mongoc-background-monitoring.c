@@ -41,7 +41,8 @@ typedef struct {
 typedef enum {
    TF_FAST_HEARTBEAT = 1 << 0,
    TF_FAST_MIN_HEARTBEAT = 1 << 1,
-   TF_AUTO_RESPOND_POLLING_HELLO = 1 << 2
+   TF_AUTO_RESPOND_POLLING_HELLO = 1 << 2,
+   TF_MONITOR_LOOP = 1 << 3
 } tf_flags_t;
 
 typedef struct {
@@ -249,6 +250,10 @@ tf_new (tf_flags_t flags)
       mock_server_autoresponds (
          tf->server, auto_respond_polling_hello, NULL, NULL);
    }
+   if (flags & TF_MONITOR_LOOP) {
+      BSON_ASSERT (
+         mongoc_client_pool_set_monitoring_event_loop (tf->pool, true));
+   }
    tf->flags = flags;
    tf->logs = bson_string_new ("");
    tf->client = mongoc_client_pool_pop (tf->pool);
@@ -358,13 +363,13 @@ _request_cancel (test_fixture_t *tf)
    bson_mutex_unlock (&tf->client->topology->tpld_modification_mtx);
 }
 
-void
-test_connect_succeeds (void)
+static void
+_test_connect_succeeds (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (0);
+   tf = tf_new (flags);
    request = mock_server_receives_legacy_hello (tf->server, NULL);
    OBSERVE (tf, request);
    OBSERVE (tf, tf->observations->n_heartbeat_started == 1);
@@ -379,13 +384,25 @@ test_connect_succeeds (void)
    tf_destroy (tf);
 }
 
-void
-test_connect_hangup (void)
+static void
+test_connect_succeeds (void)
+{
+   _test_connect_succeeds (0);
+}
+
+static void
+test_connect_succeeds_loop (void)
+{
+   _test_connect_succeeds (TF_MONITOR_LOOP);
+}
+
+static void
+_test_connect_hangup (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (0);
+   tf = tf_new (flags);
    request = mock_server_receives_legacy_hello (tf->server, NULL);
    OBSERVE (tf, request);
    OBSERVE (tf, tf->observations->n_heartbeat_started == 1);
@@ -405,6 +422,18 @@ test_connect_hangup (void)
    tf_destroy (tf);
 }
 
+void
+test_connect_hangup (void)
+{
+   _test_connect_hangup (0);
+}
+
+static void
+test_connect_hangup_loop (void)
+{
+   _test_connect_hangup (TF_MONITOR_LOOP);
+}
+
 void
 test_connect_badreply (void)
 {
@@ -481,13 +510,13 @@ test_connect_requestscan (void)
    tf_destroy (tf);
 }
 
-void
-test_retry_succeeds (void)
+static void
+_test_retry_succeeds (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (TF_FAST_MIN_HEARTBEAT);
+   tf = tf_new (TF_FAST_MIN_HEARTBEAT | flags);
 
    /* Initial discovery occurs. */
    request = mock_server_receives_legacy_hello (tf->server, NULL);
@@ -527,6 +556,18 @@ test_retry_succeeds (void)
    tf_destroy (tf);
 }
 
+void
+test_retry_succeeds (void)
+{
+   _test_retry_succeeds (0);
+}
+
+static void
+test_retry_succeeds_loop (void)
+{
+   _test_retry_succeeds (TF_MONITOR_LOOP);
+}
+
 void
 test_retry_hangup (void)
 {
@@ -727,12 +768,12 @@ test_sleep_after_scan (void)
 }
 
 static void
-test_streaming_succeeds (void)
+_test_streaming_succeeds (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO);
+   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO | flags);
    request = mock_server_receives_msg (
       tf->server,
       MONGOC_MSG_EXHAUST_ALLOWED,
@@ -752,12 +793,24 @@ test_streaming_succeeds (void)
 }
 
 static void
-test_streaming_hangup (void)
+test_streaming_succeeds (void)
+{
+   _test_streaming_succeeds (0);
+}
+
+static void
+test_streaming_succeeds_loop (void)
+{
+   _test_streaming_succeeds (TF_MONITOR_LOOP);
+}
+
+static void
+_test_streaming_hangup (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO);
+   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO | flags);
    request = mock_server_receives_msg (
       tf->server,
       MONGOC_MSG_EXHAUST_ALLOWED,
@@ -779,6 +832,18 @@ test_streaming_hangup (void)
    tf_destroy (tf);
 }
 
+static void
+test_streaming_hangup (void)
+{
+   _test_streaming_hangup (0);
+}
+
+static void
+test_streaming_hangup_loop (void)
+{
+   _test_streaming_hangup (TF_MONITOR_LOOP);
+}
+
 static void
 test_streaming_badreply (void)
 {
@@ -834,12 +899,12 @@ test_streaming_shutdown (void)
 }
 
 static void
-test_streaming_cancel (void)
+_test_streaming_cancel (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO);
+   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO | flags);
    request = mock_server_receives_msg (
       tf->server,
       MONGOC_MSG_EXHAUST_ALLOWED,
@@ -874,12 +939,24 @@ test_streaming_cancel (void)
 }
 
 static void
-test_moretocome_succeeds (void)
+test_streaming_cancel (void)
+{
+   _test_streaming_cancel (0);
+}
+
+static void
+test_streaming_cancel_loop (void)
+{
+   _test_streaming_cancel (TF_MONITOR_LOOP);
+}
+
+static void
+_test_moretocome_succeeds (tf_flags_t flags)
 {
    test_fixture_t *tf;
    request_t *request;
 
-   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO);
+   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO | flags);
    request = mock_server_receives_msg (
       tf->server,
       MONGOC_MSG_EXHAUST_ALLOWED,
@@ -929,6 +1006,103 @@ test_moretocome_succeeds (void)
    tf_destroy (tf);
 }
 
+static void
+test_moretocome_succeeds (void)
+{
+   _test_moretocome_succeeds (0);
+}
+
+static void
+test_moretocome_succeeds_loop (void)
+{
+   _test_moretocome_succeeds (TF_MONITOR_LOOP);
+}
+
+/* Returns the last write date of the server in the current topology
+ * description, and the localTime of the hello reply it was built from. */
+static int64_t
+_last_write_date (test_fixture_t *tf, int64_t *local_time_ms)
+{
+   mongoc_topology_t *topology;
+   mc_shared_tpld td;
+   const mongoc_server_description_t *sd;
+   bson_error_t error;
+   bson_iter_t iter;
+   int64_t last_write_date_ms;
+
+   topology = _mongoc_client_pool_get_topology (tf->pool);
+   td = mc_tpld_take_ref (topology);
+   sd = mongoc_topology_description_server_by_id_const (td.ptr, 1, &error);
+   ASSERT_OR_PRINT (sd, error);
+   last_write_date_ms = sd->last_write_date_ms;
+   *local_time_ms = -1;
+   if (bson_iter_init_find (&iter, &sd->last_hello_response, "localTime")) {
+      *local_time_ms = bson_iter_date_time (&iter);
+   }
+   mc_tpld_drop_ref (&td);
+
+   return last_write_date_ms;
+}
+
+static void
+_test_moretocome_unchanged (tf_flags_t flags)
+{
+   test_fixture_t *tf;
+   request_t *request;
+   int64_t local_time_ms;
+
+   tf = tf_new (TF_AUTO_RESPOND_POLLING_HELLO | flags);
+   request = mock_server_receives_msg (
+      tf->server,
+      MONGOC_MSG_EXHAUST_ALLOWED,
+      tmp_bson ("{'topologyVersion': { '$exists': true}}"));
+   OBSERVE (tf, request);
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'ok': 1, 'topologyVersion': " TV ", 'localTime': "
+                "{'$date': 1}, 'lastWrite': {'lastWriteDate': {'$date': 1}}}"));
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 2);
+   OBSERVE_SOON (tf, _last_write_date (tf, &local_time_ms) == 1);
+   OBSERVE (tf, local_time_ms == 1);
+
+   /* A reply that only differs in its timestamps updates the server
+    * description in place, which keeps the reply it was built from. */
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_MORE_TO_COME,
+      tmp_bson ("{'ok': 1, 'topologyVersion': " TV ", 'localTime': "
+                "{'$date': 2}, 'lastWrite': {'lastWriteDate': {'$date': 2}}}"));
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 3);
+   OBSERVE_SOON (tf, _last_write_date (tf, &local_time_ms) == 2);
+   OBSERVE (tf, local_time_ms == 1);
+
+   /* Any other change rebuilds the server description. */
+   mock_server_replies_opmsg (
+      request,
+      MONGOC_MSG_NONE,
+      tmp_bson ("{'ok': 1, 'topologyVersion': {'processId': {'$oid': "
+                "'AABBAABBAABBAABBAABBAABB'}, 'counter': 2}, 'localTime': "
+                "{'$date': 3}, 'lastWrite': {'lastWriteDate': {'$date': 3}}}"));
+   OBSERVE_SOON (tf, tf->observations->n_heartbeat_succeeded == 4);
+   OBSERVE_SOON (tf, _last_write_date (tf, &local_time_ms) == 3);
+   OBSERVE (tf, local_time_ms == 3);
+   request_destroy (request);
+   tf_destroy (tf);
+}
+
+static void
+test_moretocome_unchanged (void)
+{
+   _test_moretocome_unchanged (0);
+}
+
+static void
+test_moretocome_unchanged_loop (void)
+{
+   _test_moretocome_unchanged (TF_MONITOR_LOOP);
+}
+
 static void
 test_moretocome_hangup (void)
 {
@@ -1171,6 +1345,9 @@ test_monitoring_install (TestSuite *suite)
    TestSuite_AddMockServerTest (suite,
                                 "/server_monitor_thread/moretocome/succeeds",
                                 test_moretocome_succeeds);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_thread/moretocome/unchanged",
+                                test_moretocome_unchanged);
    TestSuite_AddMockServerTest (suite,
                                 "/server_monitor_thread/moretocome/hangup",
                                 test_moretocome_hangup);
@@ -1195,4 +1372,29 @@ test_monitoring_install (TestSuite *suite)
 
    TestSuite_AddMockServerTest (
       suite, "/server_monitor_thread/sleep_after_scan", test_sleep_after_scan);
+
+   /* Tests for monitoring from an event loop. */
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/connect/succeeds",
+                                test_connect_succeeds_loop);
+   TestSuite_AddMockServerTest (
+      suite, "/server_monitor_loop/connect/hangup", test_connect_hangup_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/retry/succeeds",
+                                test_retry_succeeds_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/streaming/succeeds",
+                                test_streaming_succeeds_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/streaming/hangup",
+                                test_streaming_hangup_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/streaming/cancel",
+                                test_streaming_cancel_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/moretocome/succeeds",
+                                test_moretocome_succeeds_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/server_monitor_loop/moretocome/unchanged",
+                                test_moretocome_unchanged_loop);
 }
@@ -35,8 +35,73 @@ test_mongoc_buffer_basic (void)
 }
 
 
+static void
+test_mongoc_buffer_read_ahead (void)
+{
+   mongoc_stream_t *stream;
+   mongoc_buffer_t buf;
+   mongoc_buffer_t read_ahead;
+   bson_error_t error;
+   uint8_t expected[536];
+   int32_t msg_len;
+   ssize_t r;
+
+   stream =
+      mongoc_stream_file_new_for_path (BINARY_DIR "/reply1.dat", O_RDONLY, 0);
+   ASSERT (stream);
+   r = mongoc_stream_read (stream, expected, sizeof expected, 0, 0);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) sizeof expected);
+   mongoc_stream_destroy (stream);
+
+   stream =
+      mongoc_stream_file_new_for_path (BINARY_DIR "/reply1.dat", O_RDONLY, 0);
+   ASSERT (stream);
+
+   _mongoc_buffer_init (&buf, NULL, 0, NULL, NULL);
+   _mongoc_buffer_init (&read_ahead, NULL, 0, NULL, NULL);
+
+   /* reading the length reads the whole message ahead */
+   ASSERT_OR_PRINT (_mongoc_buffer_append_from_read_ahead (
+                       &buf, &read_ahead, stream, 4, 0, &error),
+                    error);
+   ASSERT_CMPSIZE_T (buf.len, ==, (size_t) 4);
+   ASSERT_CMPSIZE_T (read_ahead.len, ==, sizeof expected - 4);
+
+   memcpy (&msg_len, buf.data, 4);
+   msg_len = BSON_UINT32_FROM_LE (msg_len);
+   ASSERT_CMPINT32 (msg_len, ==, (int32_t) sizeof expected);
+
+   /* the rest is served from memory, the surplus is kept */
+   ASSERT_OR_PRINT (_mongoc_buffer_append_from_read_ahead (
+                       &buf, &read_ahead, stream, 100, 0, &error),
+                    error);
+   ASSERT_CMPSIZE_T (read_ahead.len, ==, sizeof expected - 104);
+
+   ASSERT_OR_PRINT (
+      _mongoc_buffer_append_from_read_ahead (
+         &buf, &read_ahead, stream, (size_t) msg_len - 104, 0, &error),
+      error);
+   ASSERT_CMPSIZE_T (read_ahead.len, ==, (size_t) 0);
+   ASSERT_CMPSIZE_T (buf.len, ==, sizeof expected);
+   ASSERT (memcmp (buf.data, expected, sizeof expected) == 0);
+
+   /* end of stream */
+   ASSERT (!_mongoc_buffer_append_from_read_ahead (
+      &buf, &read_ahead, stream, 4, 0, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_SOCKET,
+                          "Failed to read 4 bytes");
+
+   _mongoc_buffer_destroy (&read_ahead);
+   _mongoc_buffer_destroy (&buf);
+   mongoc_stream_destroy (stream);
+}
+
+
 void
 test_buffer_install (TestSuite *suite)
 {
    TestSuite_Add (suite, "/Buffer/Basic", test_mongoc_buffer_basic);
+   TestSuite_Add (suite, "/Buffer/read_ahead", test_mongoc_buffer_read_ahead);
 }
@@ -0,0 +1,561 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <mongoc/mongoc.h>
+
+#include "mock_server/mock-server.h"
+#include "test-conveniences.h"
+#include "test-libmongoc.h"
+#include "TestSuite.h"
+
+
+typedef struct {
+   int n_ok;
+   int n_failed;
+   /* the data of each completed command, in order */
+   int order[8];
+   int n_done;
+   bson_error_t last_error;
+} async_results_t;
+
+
+typedef struct {
+   async_results_t *results;
+   int id;
+} async_ctx_t;
+
+
+static void
+_async_cb (mongoc_client_t *client,
+           const bson_t *reply,
+           const bson_error_t *error,
+           void *data)
+{
+   async_ctx_t *ctx = (async_ctx_t *) data;
+   async_results_t *results = ctx->results;
+
+   BSON_ASSERT (client);
+   BSON_ASSERT (results->n_done < 8);
+   results->order[results->n_done++] = ctx->id;
+
+   if (error) {
+      results->n_failed++;
+      memcpy (&results->last_error, error, sizeof *error);
+   } else {
+      BSON_ASSERT (reply);
+      results->n_ok++;
+   }
+}
+
+
+/* run the client's async commands until none are pending */
+static void
+_run_until_done (mongoc_client_t *client)
+{
+   int i;
+
+   for (i = 0; i < 100; i++) {
+      if (mongoc_client_run_async (client, 100) == 0) {
+         return;
+      }
+   }
+
+   test_error ("asynchronous commands did not complete");
+}
+
+
+static void
+test_client_async_command (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx[2];
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   /* both commands are in flight at once, each on its own connection */
+   for (i = 0; i < 2; i++) {
+      ctx[i].results = &results;
+      ctx[i].id = i;
+      ASSERT_OR_PRINT (
+         mongoc_client_command_simple_async (client,
+                                             "db",
+                                             tmp_bson ("{'ping': 1}"),
+                                             NULL,
+                                             _async_cb,
+                                             &ctx[i],
+                                             &error),
+         error);
+   }
+
+   ASSERT_CMPSIZE_T (mongoc_client_run_async (client, 0), ==, (size_t) 2);
+
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1, '$db': 'db'}"));
+   mock_server_replies_ok_and_destroys (request);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1, '$db': 'db'}"));
+   mock_server_replies_simple (request,
+                               "{'ok': 0, 'code': 2, 'errmsg': 'bad value'}");
+   request_destroy (request);
+
+   _run_until_done (client);
+
+   ASSERT_CMPINT (results.n_ok, ==, 1);
+   ASSERT_CMPINT (results.n_failed, ==, 1);
+   ASSERT_ERROR_CONTAINS (
+      results.last_error, MONGOC_ERROR_QUERY, 2, "bad value");
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_async_queue (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx[2];
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 1);
+   client = test_framework_client_new_from_uri (uri, NULL);
+
+   for (i = 0; i < 2; i++) {
+      ctx[i].results = &results;
+      ctx[i].id = i;
+      ASSERT_OR_PRINT (mongoc_client_command_simple_async (
+                          client,
+                          "db",
+                          tmp_bson ("{'ping': %d}", i),
+                          NULL,
+                          _async_cb,
+                          &ctx[i],
+                          &error),
+                       error);
+   }
+
+   /* with one connection the second command waits for the first */
+   ASSERT_CMPSIZE_T (mongoc_client_run_async (client, 0), ==, (size_t) 2);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 0}"));
+   mock_server_replies_ok_and_destroys (request);
+
+   while (results.n_done < 1) {
+      mongoc_client_run_async (client, 100);
+   }
+
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   _run_until_done (client);
+
+   ASSERT_CMPINT (results.n_ok, ==, 2);
+   ASSERT_CMPINT (results.order[0], ==, 0);
+   ASSERT_CMPINT (results.order[1], ==, 1);
+
+   mongoc_client_destroy (client);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_async_pooled (void)
+{
+   mock_server_t *server;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx = {&results, 0};
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   pool = test_framework_client_pool_new_from_uri (mock_server_get_uri (server),
+                                                   NULL);
+   client = mongoc_client_pool_pop (pool);
+
+   ASSERT_OR_PRINT (
+      mongoc_client_command_simple_async (client,
+                                          "db",
+                                          tmp_bson ("{'ping': 1}"),
+                                          NULL,
+                                          _async_cb,
+                                          &ctx,
+                                          &error),
+      error);
+   ASSERT_CMPSIZE_T (mongoc_client_run_async (client, 0), ==, (size_t) 1);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+
+   _run_until_done (client);
+
+   ASSERT_CMPINT (results.n_ok, ==, 1);
+
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_async_network_error (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx = {&results, 0};
+   request_t *request;
+   bson_error_t error;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   ASSERT_OR_PRINT (
+      mongoc_client_command_simple_async (client,
+                                          "db",
+                                          tmp_bson ("{'ping': 1}"),
+                                          NULL,
+                                          _async_cb,
+                                          &ctx,
+                                          &error),
+      error);
+   ASSERT_CMPSIZE_T (mongoc_client_run_async (client, 0), ==, (size_t) 1);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_hangs_up (request);
+   request_destroy (request);
+
+   _run_until_done (client);
+
+   ASSERT_CMPINT (results.n_failed, ==, 1);
+   ASSERT_CMPUINT32 (results.last_error.domain, ==, MONGOC_ERROR_STREAM);
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+typedef struct {
+   int n_started;
+   int n_succeeded;
+   int n_failed;
+   int64_t started_request_id;
+   int64_t finished_request_id;
+} async_apm_t;
+
+
+static void
+_async_apm_started (const mongoc_apm_command_started_t *event)
+{
+   async_apm_t *apm = mongoc_apm_command_started_get_context (event);
+
+   ASSERT_CMPSTR (mongoc_apm_command_started_get_command_name (event), "ping");
+   apm->n_started++;
+   apm->started_request_id = mongoc_apm_command_started_get_request_id (event);
+}
+
+
+static void
+_async_apm_succeeded (const mongoc_apm_command_succeeded_t *event)
+{
+   async_apm_t *apm = mongoc_apm_command_succeeded_get_context (event);
+
+   apm->n_succeeded++;
+   apm->finished_request_id =
+      mongoc_apm_command_succeeded_get_request_id (event);
+}
+
+
+static void
+_async_apm_failed (const mongoc_apm_command_failed_t *event)
+{
+   async_apm_t *apm = mongoc_apm_command_failed_get_context (event);
+
+   apm->n_failed++;
+   apm->finished_request_id = mongoc_apm_command_failed_get_request_id (event);
+}
+
+
+static void
+test_client_async_apm (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   mongoc_apm_callbacks_t *callbacks;
+   async_results_t results = {0};
+   async_ctx_t ctx = {&results, 0};
+   async_apm_t apm = {0};
+   request_t *request;
+   bson_error_t error;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+   callbacks = mongoc_apm_callbacks_new ();
+   mongoc_apm_set_command_started_cb (callbacks, _async_apm_started);
+   mongoc_apm_set_command_succeeded_cb (callbacks, _async_apm_succeeded);
+   mongoc_apm_set_command_failed_cb (callbacks, _async_apm_failed);
+   mongoc_client_set_apm_callbacks (client, callbacks, &apm);
+
+   /* one command succeeds, the next fails */
+   for (i = 0; i < 2; i++) {
+      ASSERT_OR_PRINT (
+         mongoc_client_command_simple_async (client,
+                                             "db",
+                                             tmp_bson ("{'ping': 1}"),
+                                             NULL,
+                                             _async_cb,
+                                             &ctx,
+                                             &error),
+         error);
+      ASSERT_CMPINT (apm.n_started, ==, i + 1);
+      ASSERT_CMPSIZE_T (mongoc_client_run_async (client, 0), ==, (size_t) 1);
+
+      request = mock_server_receives_msg (
+         server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+      ASSERT_CMPINT64 (apm.started_request_id,
+                       ==,
+                       (int64_t) request->request_rpc.header.request_id);
+      if (i == 0) {
+         mock_server_replies_ok_and_destroys (request);
+      } else {
+         mock_server_replies_simple (request, "{'ok': 0, 'code': 2}");
+         request_destroy (request);
+      }
+
+      _run_until_done (client);
+      ASSERT_CMPINT64 (apm.finished_request_id, ==, apm.started_request_id);
+   }
+
+   ASSERT_CMPINT (apm.n_succeeded, ==, 1);
+   ASSERT_CMPINT (apm.n_failed, ==, 1);
+   ASSERT_CMPINT (results.n_ok, ==, 1);
+   ASSERT_CMPINT (results.n_failed, ==, 1);
+
+   mongoc_client_destroy (client);
+   mongoc_apm_callbacks_destroy (callbacks);
+   mock_server_destroy (server);
+}
+
+
+#ifndef _WIN32
+/* wait for the client's sockets with poll (), as an application's event loop
+ * would, and step the client's async commands until none are pending */
+static void
+_step_until_done (mongoc_client_t *client)
+{
+   mongoc_client_async_fd_t fds[8];
+   struct pollfd pfds[8];
+   int32_t timeout_msec;
+   size_t n;
+   size_t i;
+   int j;
+
+   for (j = 0; j < 100; j++) {
+      n = mongoc_client_async_get_fds (client, fds, 8, &timeout_msec);
+      ASSERT_CMPSIZE_T (n, <=, (size_t) 8);
+
+      for (i = 0; i < n; i++) {
+         pfds[i].fd = fds[i].fd;
+         pfds[i].events = (short) fds[i].events;
+         pfds[i].revents = 0;
+      }
+
+      ASSERT_CMPINT (poll (pfds, n, BSON_MIN (timeout_msec, 100)), >=, 0);
+
+      for (i = 0; i < n; i++) {
+         fds[i].revents = pfds[i].revents;
+      }
+
+      if (mongoc_client_async_step (client, fds, n) == 0) {
+         return;
+      }
+   }
+
+   test_error ("asynchronous commands did not complete");
+}
+
+
+static void
+test_client_async_external_loop (void)
+{
+   mock_server_t *server;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx[2];
+   mongoc_client_async_fd_t fds[2];
+   request_t *request;
+   bson_error_t error;
+   int32_t timeout_msec;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_get_fds (client, fds, 2, &timeout_msec),
+      ==,
+      (size_t) 0);
+   ASSERT_CMPINT (timeout_msec, ==, -1);
+
+   for (i = 0; i < 2; i++) {
+      ctx[i].results = &results;
+      ctx[i].id = i;
+      ASSERT_OR_PRINT (
+         mongoc_client_command_simple_async (client,
+                                             "db",
+                                             tmp_bson ("{'ping': 1}"),
+                                             NULL,
+                                             _async_cb,
+                                             &ctx[i],
+                                             &error),
+         error);
+   }
+
+   /* each command waits to send on its own socket */
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_get_fds (client, fds, 2, &timeout_msec),
+      ==,
+      (size_t) 2);
+   ASSERT_CMPINT (fds[0].fd, !=, fds[1].fd);
+   ASSERT_CMPINT (fds[0].events, ==, POLLOUT);
+   ASSERT_CMPINT (timeout_msec, >, 0);
+
+   /* a step with nothing ready does nothing */
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_step (client, NULL, 0), ==, (size_t) 2);
+
+   fds[0].revents = fds[1].revents = POLLOUT;
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_step (client, fds, 2), ==, (size_t) 2);
+
+   for (i = 0; i < 2; i++) {
+      request = mock_server_receives_msg (
+         server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+      mock_server_replies_ok_and_destroys (request);
+   }
+
+   _step_until_done (client);
+   ASSERT_CMPINT (results.n_ok, ==, 2);
+
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_async_external_loop_timeout (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_t *client;
+   async_results_t results = {0};
+   async_ctx_t ctx = {&results, 0};
+   mongoc_client_async_fd_t fd;
+   request_t *request;
+   bson_error_t error;
+   int32_t timeout_msec;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_SOCKETTIMEOUTMS, 100);
+   client = test_framework_client_new_from_uri (uri, NULL);
+
+   ASSERT_OR_PRINT (
+      mongoc_client_command_simple_async (client,
+                                          "db",
+                                          tmp_bson ("{'ping': 1}"),
+                                          NULL,
+                                          _async_cb,
+                                          &ctx,
+                                          &error),
+      error);
+
+   ASSERT_CMPSIZE_T (
+      mongoc_client_async_get_fds (client, &fd, 1, &timeout_msec),
+      ==,
+      (size_t) 1);
+   ASSERT_CMPINT (timeout_msec, <=, 101);
+   fd.revents = POLLOUT;
+   mongoc_client_async_step (client, &fd, 1);
+
+   /* the server never replies; the command fails once its deadline passes */
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   _step_until_done (client);
+
+   ASSERT_CMPINT (results.n_failed, ==, 1);
+   ASSERT_ERROR_CONTAINS (results.last_error,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_CONNECT,
+                          "socket timeout");
+
+   request_destroy (request);
+   mongoc_client_destroy (client);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+#endif
+
+
+void
+test_client_async_install (TestSuite *suite)
+{
+   TestSuite_AddMockServerTest (
+      suite, "/ClientAsync/command", test_client_async_command);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientAsync/queue", test_client_async_queue);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientAsync/pooled", test_client_async_pooled);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientAsync/network_error", test_client_async_network_error);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientAsync/apm", test_client_async_apm);
+#ifndef _WIN32
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientAsync/external_loop",
+                                test_client_async_external_loop);
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientAsync/external_loop/timeout",
+                                test_client_async_external_loop_timeout);
+#endif
+}
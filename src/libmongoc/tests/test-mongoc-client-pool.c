@@ -1,10 +1,15 @@
 #include <mongoc/mongoc.h>
 #include "mongoc/mongoc-client-pool-private.h"
+#include "mongoc/mongoc-client-private.h"
+#include "mongoc/mongoc-topology-private.h"
 #include "mongoc/mongoc-util-private.h"
 
 
 #include "TestSuite.h"
+#include "test-conveniences.h"
 #include "test-libmongoc.h"
+#include "mock_server/future-functions.h"
+#include "mock_server/mock-server.h"
 
 
 static void
@@ -467,6 +472,836 @@ test_client_pool_max_pool_size_exceeded (void)
    bson_free (args);
 }
 
+
+/* Many threads popping and pushing a small pool concurrently must never
+ * share a client, and must never grow the pool past its maximum. */
+#define POP_PUSH_THREADS 8
+#define POP_PUSH_ITERATIONS 2000
+
+typedef struct {
+   mongoc_client_pool_t *pool;
+   bson_mutex_t mutex;
+   mongoc_client_t *in_use[POP_PUSH_THREADS];
+} pop_push_args_t;
+
+typedef struct {
+   pop_push_args_t *shared;
+   int id;
+} pop_push_thread_t;
+
+static BSON_THREAD_FUN (pop_push_worker, arg)
+{
+   pop_push_thread_t *thread = arg;
+   pop_push_args_t *shared = thread->shared;
+   mongoc_client_t *client;
+   int i;
+   int j;
+
+   for (i = 0; i < POP_PUSH_ITERATIONS; i++) {
+      client = i % 2 ? mongoc_client_pool_pop (shared->pool)
+                     : mongoc_client_pool_try_pop (shared->pool);
+      if (!client) {
+         continue;
+      }
+
+      bson_mutex_lock (&shared->mutex);
+      for (j = 0; j < POP_PUSH_THREADS; j++) {
+         BSON_ASSERT (shared->in_use[j] != client);
+      }
+      shared->in_use[thread->id] = client;
+      bson_mutex_unlock (&shared->mutex);
+
+      /* give other threads a chance to pop while this one holds a client */
+      bson_thrd_yield ();
+
+      bson_mutex_lock (&shared->mutex);
+      shared->in_use[thread->id] = NULL;
+      bson_mutex_unlock (&shared->mutex);
+
+      mongoc_client_pool_push (shared->pool, client);
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+static void
+_test_client_pool_pop_push_threaded (bool thread_affinity)
+{
+   mongoc_uri_t *uri;
+   pop_push_args_t shared = {0};
+   pop_push_thread_t threads[POP_PUSH_THREADS];
+   bson_thread_t ids[POP_PUSH_THREADS];
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=3");
+   shared.pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   mongoc_client_pool_set_thread_affinity (shared.pool, thread_affinity);
+   bson_mutex_init (&shared.mutex);
+
+   for (i = 0; i < POP_PUSH_THREADS; i++) {
+      threads[i].shared = &shared;
+      threads[i].id = i;
+      COMMON_PREFIX (thread_create) (&ids[i], pop_push_worker, &threads[i]);
+   }
+
+   for (i = 0; i < POP_PUSH_THREADS; i++) {
+      COMMON_PREFIX (thread_join) (ids[i]);
+   }
+
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (shared.pool), <=, (size_t) 3);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (shared.pool),
+                     ==,
+                     mongoc_client_pool_get_size (shared.pool));
+
+   bson_mutex_destroy (&shared.mutex);
+   mongoc_client_pool_destroy (shared.pool);
+   mongoc_uri_destroy (uri);
+}
+
+static void
+test_client_pool_pop_push_threaded (void)
+{
+   _test_client_pool_pop_push_threaded (false);
+}
+
+static void
+test_client_pool_pop_push_threaded_affinity (void)
+{
+   _test_client_pool_pop_push_threaded (true);
+}
+
+static BSON_THREAD_FUN (pop_other_thread, arg)
+{
+   mongoc_client_pool_t *pool = arg;
+   mongoc_client_t *client;
+
+   /* the pool is exhausted, so this takes the client kept for the main
+    * thread instead of waiting for it */
+   client = mongoc_client_pool_try_pop (pool);
+   BSON_ASSERT (client);
+   mongoc_client_pool_push (pool, client);
+
+   BSON_THREAD_RETURN;
+}
+
+static void
+test_client_pool_thread_affinity (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_client_t *other;
+   bson_thread_t id;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=1");
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   mongoc_client_pool_set_thread_affinity (pool, true);
+
+   /* a thread gets back the client it pushed */
+   client = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool), ==, (size_t) 1);
+   other = mongoc_client_pool_pop (pool);
+   ASSERT (other == client);
+   mongoc_client_pool_push (pool, other);
+
+   /* another thread reclaims it when the pool is exhausted */
+   COMMON_PREFIX (thread_create) (&id, pop_other_thread, pool);
+   COMMON_PREFIX (thread_join) (id);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), ==, (size_t) 1);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool), ==, (size_t) 1);
+
+   /* disabling thread affinity returns kept clients to the shared pool */
+   mongoc_client_pool_set_thread_affinity (pool, false);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_num_pushed (pool), ==, (size_t) 1);
+   client = mongoc_client_pool_try_pop (pool);
+   ASSERT (client);
+   mongoc_client_pool_push (pool, client);
+
+   /* the pool destroys clients kept for threads */
+   mongoc_client_pool_set_thread_affinity (pool, true);
+   client = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+/* try_pop takes the thread's own client first, as pop does */
+static void
+test_client_pool_thread_affinity_try_pop (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_client_t *other;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=2");
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   mongoc_client_pool_set_thread_affinity (pool, true);
+
+   /* rather than creating a client */
+   client = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+   ASSERT (mongoc_client_pool_try_pop (pool) == client);
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), ==, (size_t) 1);
+
+   /* rather than taking an idle client from the shared pool */
+   other = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+   mongoc_client_pool_push (pool, other);
+   ASSERT (mongoc_client_pool_try_pop (pool) == client);
+   mongoc_client_pool_push (pool, client);
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+static BSON_THREAD_FUN (pop_push_own_thread, arg)
+{
+   mongoc_client_pool_t *pool = arg;
+   mongoc_client_t *client;
+   mongoc_client_t *other;
+   int i;
+
+   client = mongoc_client_pool_pop (pool);
+   mongoc_client_pool_push (pool, client);
+
+   for (i = 0; i < 100; i++) {
+      other = mongoc_client_pool_pop (pool);
+      ASSERT (other == client);
+      mongoc_client_pool_push (pool, other);
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+/* threads get slots of their own while there are fewer threads than slots */
+static void
+test_client_pool_thread_affinity_slots (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   bson_thread_t ids[4];
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://127.0.0.1/?maxpoolsize=4");
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   mongoc_client_pool_set_thread_affinity (pool, true);
+
+   for (i = 0; i < 4; i++) {
+      COMMON_PREFIX (thread_create) (&ids[i], pop_push_own_thread, pool);
+   }
+
+   for (i = 0; i < 4; i++) {
+      COMMON_PREFIX (thread_join) (ids[i]);
+   }
+
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), ==, (size_t) 4);
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+}
+
+/* check out all @n clients, and check that each is connected to the server
+ * with a connection from at least pool generation @generation */
+static bool
+_pool_is_warm (mongoc_client_pool_t *pool, int n, uint32_t generation)
+{
+   mongoc_client_t *clients[2];
+   mongoc_cluster_node_t *node;
+   bool warm = true;
+   int i;
+
+   BSON_ASSERT (n <= 2);
+
+   for (i = 0; i < n; i++) {
+      clients[i] = mongoc_client_pool_pop (pool);
+   }
+
+   for (i = 0; i < n; i++) {
+      node = mongoc_set_get (clients[i]->cluster.nodes, 1);
+      if (!node || node->handshake_sd->generation < generation) {
+         warm = false;
+      }
+
+      mongoc_client_pool_push (pool, clients[i]);
+   }
+
+   return warm;
+}
+
+static void
+test_client_pool_warm (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mc_tpld_modification tdmod;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 2);
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_HEARTBEATFREQUENCYMS, 500);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   ASSERT (mongoc_client_pool_set_warm_size (pool, 2));
+
+   /* the first pop starts background monitoring */
+   client = mongoc_client_pool_pop (pool);
+   ASSERT (!mongoc_client_pool_set_warm_size (pool, 1));
+   mongoc_client_pool_push (pool, client);
+
+   /* both clients are connected without running an operation */
+   WAIT_UNTIL (_pool_is_warm (pool, 2, 0));
+   ASSERT_CMPSIZE_T (mongoc_client_pool_get_size (pool), ==, (size_t) 2);
+
+   /* connections closed by a pool clear are re-established */
+   tdmod = mc_tpld_modify_begin (_mongoc_client_pool_get_topology (pool));
+   _mongoc_topology_description_clear_connection_pool (
+      tdmod.new_td, 1, &kZeroServiceId);
+   mc_tpld_modify_commit (tdmod);
+   WAIT_UNTIL (_pool_is_warm (pool, 2, 1));
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+/* connect the popped @client to the mock server, as an operation would */
+static void
+_connect_client (mongoc_client_t *client)
+{
+   mongoc_server_stream_t *server_stream;
+   bson_error_t error;
+
+   server_stream = mongoc_cluster_stream_for_server (
+      &client->cluster, 1, true, NULL, NULL, &error);
+   ASSERT_OR_PRINT (server_stream, error);
+   mongoc_server_stream_cleanup (server_stream);
+}
+
+static bool
+_client_is_connected (mongoc_client_pool_t *pool)
+{
+   mongoc_client_t *client;
+   bool connected;
+
+   client = mongoc_client_pool_pop (pool);
+   connected = mongoc_set_get (client->cluster.nodes, 1) != NULL;
+   mongoc_client_pool_push (pool, client);
+
+   return connected;
+}
+
+static void
+test_client_pool_prune (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client;
+   mongoc_cluster_node_t *node;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 1);
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXIDLETIMEMS, 100);
+   mongoc_uri_set_option_as_int32 (
+      uri, MONGOC_URI_MAXCONNECTIONLIFETIMEMS, 60 * 60 * 1000);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+
+   /* connections in use are not pruned, however long they are idle */
+   client = mongoc_client_pool_pop (pool);
+   _connect_client (client);
+   node = mongoc_set_get (client->cluster.nodes, 1);
+   node->last_used -= 1000 * 1000;
+   _mongoc_usleep (300 * 1000);
+   ASSERT (mongoc_set_get (client->cluster.nodes, 1));
+
+   /* used connections are kept */
+   node->n_uses++;
+   mongoc_cluster_prune_nodes (&client->cluster);
+   ASSERT (mongoc_set_get (client->cluster.nodes, 1));
+   /* and the next pruning is due once the connection could be idle */
+   ASSERT_CMPINT64 (
+      client->cluster.prune_at, ==, node->last_used + 100 * 1000);
+   ASSERT (!client->cluster.idle_pruned);
+
+   /* connections past their lifetime are closed, even if used */
+   node->n_uses++;
+   node->created -= 2 * 60 * 60 * 1000 * (int64_t) 1000;
+   mongoc_cluster_prune_nodes (&client->cluster);
+   ASSERT (!mongoc_set_get (client->cluster.nodes, 1));
+
+   /* the idle connections of idle clients are closed in the background */
+   _connect_client (client);
+   mongoc_client_pool_push (pool, client);
+   WAIT_UNTIL (!_client_is_connected (pool));
+   client = mongoc_client_pool_pop (pool);
+   ASSERT (client->cluster.idle_pruned);
+   mongoc_client_pool_push (pool, client);
+
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+static void
+test_client_pool_share_topology (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_uri_t *other_uri;
+   mongoc_client_pool_t *pool_a;
+   mongoc_client_pool_t *pool_b;
+   mongoc_client_pool_t *pool_c;
+   mongoc_client_t *client;
+   mongoc_server_description_t *sd;
+   bson_error_t error;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   other_uri = mongoc_uri_copy (uri);
+   mongoc_uri_set_option_as_int32 (
+      other_uri, MONGOC_URI_HEARTBEATFREQUENCYMS, 1000);
+
+   pool_a = mongoc_client_pool_new (uri);
+   pool_b = mongoc_client_pool_new (uri);
+   pool_c = mongoc_client_pool_new (other_uri);
+   ASSERT (mongoc_client_pool_share_topology (pool_a));
+   ASSERT (mongoc_client_pool_share_topology (pool_a));
+   ASSERT (mongoc_client_pool_share_topology (pool_b));
+   ASSERT (mongoc_client_pool_share_topology (pool_c));
+
+   /* only pools configured the same way share a topology */
+   ASSERT (_mongoc_client_pool_get_topology (pool_a) ==
+           _mongoc_client_pool_get_topology (pool_b));
+   ASSERT (_mongoc_client_pool_get_topology (pool_a) !=
+           _mongoc_client_pool_get_topology (pool_c));
+
+   /* a shared topology can no longer be configured per pool */
+   capture_logs (true);
+   ASSERT (!mongoc_client_pool_set_appname (pool_a, "app"));
+   capture_logs (false);
+
+   client = mongoc_client_pool_pop (pool_a);
+   sd = mongoc_client_select_server (client, false, NULL, &error);
+   ASSERT_OR_PRINT (sd, error);
+   mongoc_server_description_destroy (sd);
+   mongoc_client_pool_push (pool_a, client);
+
+   /* the topology outlives the pool that created it */
+   mongoc_client_pool_destroy (pool_a);
+   client = mongoc_client_pool_pop (pool_b);
+   sd = mongoc_client_select_server (client, false, NULL, &error);
+   ASSERT_OR_PRINT (sd, error);
+   mongoc_server_description_destroy (sd);
+   mongoc_client_pool_push (pool_b, client);
+
+   /* sharing must be requested before the first client is popped */
+   client = mongoc_client_pool_pop (pool_c);
+   mongoc_client_pool_push (pool_c, client);
+   pool_a = mongoc_client_pool_new (other_uri);
+   client = mongoc_client_pool_pop (pool_a);
+   capture_logs (true);
+   ASSERT (!mongoc_client_pool_share_topology (pool_a));
+   capture_logs (false);
+   mongoc_client_pool_push (pool_a, client);
+
+   mongoc_client_pool_destroy (pool_a);
+   mongoc_client_pool_destroy (pool_c);
+   mongoc_client_pool_destroy (pool_b);
+   mongoc_uri_destroy (other_uri);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+#if defined(MONGOC_ENABLE_SSL_OPENSSL) || \
+   defined(MONGOC_ENABLE_SSL_SECURE_TRANSPORT)
+static void
+test_client_pool_share_topology_tls (void)
+{
+   mock_server_t *server;
+   mongoc_ssl_opt_t server_opts = {0};
+   mongoc_ssl_opt_t client_opts = {0};
+   mongoc_ssl_opt_t other_opts = {0};
+   mongoc_client_pool_t *pool_a;
+   mongoc_client_pool_t *pool_b;
+   mongoc_client_pool_t *pool_c;
+   mongoc_client_t *client;
+   mongoc_topology_t *topology;
+   mongoc_server_description_t *sd;
+   bson_error_t error;
+
+   server_opts.weak_cert_validation = true;
+   server_opts.ca_file = CERT_CA;
+   server_opts.pem_file = CERT_SERVER;
+   client_opts.ca_file = CERT_CA;
+   other_opts.ca_file = CERT_CA;
+   other_opts.pem_pwd = "password";
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_set_ssl_opts (server, &server_opts);
+   mock_server_run (server);
+
+   pool_a = test_framework_client_pool_new_from_uri (
+      mock_server_get_uri (server), NULL);
+   pool_b = test_framework_client_pool_new_from_uri (
+      mock_server_get_uri (server), NULL);
+   pool_c = test_framework_client_pool_new_from_uri (
+      mock_server_get_uri (server), NULL);
+   mongoc_client_pool_set_ssl_opts (pool_a, &client_opts);
+   mongoc_client_pool_set_ssl_opts (pool_b, &client_opts);
+   mongoc_client_pool_set_ssl_opts (pool_c, &other_opts);
+   ASSERT (mongoc_client_pool_share_topology (pool_a));
+   ASSERT (mongoc_client_pool_share_topology (pool_b));
+   ASSERT (mongoc_client_pool_share_topology (pool_c));
+
+   /* a different key password keeps the pools apart */
+   topology = _mongoc_client_pool_get_topology (pool_b);
+   ASSERT (_mongoc_client_pool_get_topology (pool_a) == topology);
+   ASSERT (_mongoc_client_pool_get_topology (pool_c) != topology);
+
+   /* the scanner's TLS options outlive the pool that created the topology,
+    * and the server monitors started afterward copy them */
+   mongoc_client_pool_destroy (pool_a);
+   ASSERT_CMPSTR (topology->scanner->ssl_opts->ca_file, CERT_CA);
+
+   client = mongoc_client_pool_pop (pool_b);
+   sd = mongoc_client_select_server (client, false, NULL, &error);
+   ASSERT_OR_PRINT (sd, error);
+   mongoc_server_description_destroy (sd);
+   _connect_client (client);
+   mongoc_client_pool_push (pool_b, client);
+
+   mongoc_client_pool_destroy (pool_c);
+   mongoc_client_pool_destroy (pool_b);
+   mock_server_destroy (server);
+}
+#endif
+
+static void
+test_client_pool_shared_connections (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client_a;
+   mongoc_client_t *client_b;
+   bson_t reply_a;
+   bson_t reply_b;
+   bson_error_t error_a;
+   bson_error_t error_b;
+   future_t *future_a;
+   future_t *future_b;
+   request_t *request_a;
+   request_t *request_b;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 2);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   ASSERT (mongoc_client_pool_set_shared_connections (pool, 1));
+
+   client_a = mongoc_client_pool_pop (pool);
+   client_b = mongoc_client_pool_pop (pool);
+   capture_logs (true);
+   ASSERT (!mongoc_client_pool_set_shared_connections (pool, 2));
+   capture_logs (false);
+
+   /* b's request is sent while a waits for its reply */
+   future_a = future_client_command_simple (
+      client_a, "db", tmp_bson ("{'ping': 'a'}"), NULL, &reply_a, &error_a);
+   request_a =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   future_b = future_client_command_simple (
+      client_b, "db", tmp_bson ("{'ping': 'b'}"), NULL, &reply_b, &error_b);
+   request_b =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   ASSERT_MATCH (request_get_doc (request_a, 0), "{'ping': 'a'}");
+   ASSERT_MATCH (request_get_doc (request_b, 0), "{'ping': 'b'}");
+
+   /* on one connection, with ids unique to it */
+   ASSERT_CMPINT (request_get_client_port (request_a),
+                  ==,
+                  request_get_client_port (request_b));
+   ASSERT_CMPINT (request_a->request_rpc.header.request_id,
+                  !=,
+                  request_b->request_rpc.header.request_id);
+
+   /* replies are routed by the request they respond to, in any order */
+   mock_server_replies_simple (request_b, "{'ok': 1, 'from': 'b'}");
+   mock_server_replies_simple (request_a, "{'ok': 1, 'from': 'a'}");
+   ASSERT_OR_PRINT (future_get_bool (future_b), error_b);
+   ASSERT_OR_PRINT (future_get_bool (future_a), error_a);
+   ASSERT_MATCH (&reply_a, "{'from': 'a'}");
+   ASSERT_MATCH (&reply_b, "{'from': 'b'}");
+
+   bson_destroy (&reply_a);
+   bson_destroy (&reply_b);
+   future_destroy (future_a);
+   future_destroy (future_b);
+   request_destroy (request_a);
+   request_destroy (request_b);
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_push (pool, client_b);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+/* answers hellos, except new connections' handshakes while held */
+static bool
+_hold_handshakes_responder (request_t *request, void *data)
+{
+   int32_t *hold = (int32_t *) data;
+   const bson_t *doc;
+
+   if (!request->is_command ||
+       (strcasecmp (request->command_name, "hello") != 0 &&
+        strcasecmp (request->command_name, HANDSHAKE_CMD_LEGACY_HELLO) != 0)) {
+      return false;
+   }
+
+   doc = request_get_doc (request, 0);
+   if (bson_atomic_int32_fetch (hold, bson_memory_order_seq_cst) &&
+       bson_has_field (doc, "client")) {
+      return false;
+   }
+
+   mock_server_replies_simple (request,
+                               tmp_str ("{'ok': 1,"
+                                        " 'isWritablePrimary': true,"
+                                        " 'minWireVersion': 0,"
+                                        " 'maxWireVersion': %d}",
+                                        WIRE_VERSION_MAX));
+   request_destroy (request);
+   return true;
+}
+
+static void
+test_client_pool_shared_connections_connecting (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client_a;
+   mongoc_client_t *client_b;
+   mongoc_client_t *client_c;
+   bson_error_t error_a;
+   bson_error_t error_b;
+   bson_error_t error_c;
+   future_t *future_a;
+   future_t *future_b;
+   future_t *future_c;
+   request_t *request;
+   request_t *hello;
+   uint16_t port;
+   int32_t hold = 0;
+
+   server = mock_server_new ();
+   mock_server_autoresponds (server, _hold_handshakes_responder, &hold, NULL);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 3);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   ASSERT (mongoc_client_pool_set_shared_connections (pool, 2));
+   client_a = mongoc_client_pool_pop (pool);
+   client_b = mongoc_client_pool_pop (pool);
+   client_c = mongoc_client_pool_pop (pool);
+
+   /* a opens the first shared connection */
+   future_a = future_client_command_simple (
+      client_a, "db", tmp_bson ("{'ping': 'a'}"), NULL, NULL, &error_a);
+   request =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   port = request_get_client_port (request);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future_a), error_a);
+   future_destroy (future_a);
+
+   /* b opens the second, and its handshake goes unanswered */
+   bson_atomic_int32_exchange (&hold, 1, bson_memory_order_seq_cst);
+   future_b = future_client_command_simple (
+      client_b, "db", tmp_bson ("{'ping': 'b'}"), NULL, NULL, &error_b);
+   hello = mock_server_receives_request (server);
+   ASSERT (hello);
+   ASSERT (bson_has_field (request_get_doc (hello, 0), "client"));
+
+   /* meanwhile c shares the first connection */
+   future_c = future_client_command_simple (
+      client_c, "db", tmp_bson ("{'ping': 'c'}"), NULL, NULL, &error_c);
+   request =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   ASSERT_MATCH (request_get_doc (request, 0), "{'ping': 'c'}");
+   ASSERT_CMPINT (request_get_client_port (request), ==, port);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future_c), error_c);
+   future_destroy (future_c);
+
+   /* b continues once its handshake is answered */
+   bson_atomic_int32_exchange (&hold, 0, bson_memory_order_seq_cst);
+   mock_server_replies_simple (hello,
+                               tmp_str ("{'ok': 1,"
+                                        " 'isWritablePrimary': true,"
+                                        " 'minWireVersion': 0,"
+                                        " 'maxWireVersion': %d}",
+                                        WIRE_VERSION_MAX));
+   request_destroy (hello);
+   request =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   ASSERT_MATCH (request_get_doc (request, 0), "{'ping': 'b'}");
+   ASSERT_CMPINT (request_get_client_port (request), !=, port);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future_b), error_b);
+   future_destroy (future_b);
+
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_push (pool, client_b);
+   mongoc_client_pool_push (pool, client_c);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
+#ifdef MONGOC_ENABLE_ZEROCOPY
+/* a send large enough for MSG_ZEROCOPY while another client reads */
+static void
+test_client_pool_shared_connections_zerocopy (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client_a;
+   mongoc_client_t *client_b;
+   bson_t command;
+   bson_error_t error_a;
+   bson_error_t error_b;
+   future_t *future_a;
+   future_t *future_b;
+   request_t *request_a;
+   request_t *request_b;
+   char *comment;
+   size_t len = 2 * 1024 * 1024;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 2);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   ASSERT (mongoc_client_pool_set_shared_connections (pool, 1));
+   client_a = mongoc_client_pool_pop (pool);
+   client_b = mongoc_client_pool_pop (pool);
+
+   comment = bson_malloc (len + 1);
+   memset (comment, 'a', len);
+   comment[len] = '\0';
+   bson_init (&command);
+   BSON_APPEND_UTF8 (&command, "ping", "a");
+   BSON_APPEND_UTF8 (&command, "comment", comment);
+
+   /* b reads from the shared connection while a's request is sent */
+   future_b = future_client_command_simple (
+      client_b, "db", tmp_bson ("{'ping': 'b'}"), NULL, NULL, &error_b);
+   request_b =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   future_a = future_client_command_simple (
+      client_a, "db", &command, NULL, NULL, &error_a);
+   request_a =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   ASSERT_MATCH (request_get_doc (request_a, 0), "{'ping': 'a'}");
+
+   /* the connection survived the send */
+   mock_server_replies_ok_and_destroys (request_a);
+   mock_server_replies_ok_and_destroys (request_b);
+   ASSERT_OR_PRINT (future_get_bool (future_a), error_a);
+   ASSERT_OR_PRINT (future_get_bool (future_b), error_b);
+
+   future_destroy (future_a);
+   future_destroy (future_b);
+   bson_destroy (&command);
+   bson_free (comment);
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_push (pool, client_b);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+#endif
+
+static void
+test_client_pool_shared_connections_network_error (void)
+{
+   mock_server_t *server;
+   mongoc_uri_t *uri;
+   mongoc_client_pool_t *pool;
+   mongoc_client_t *client_a;
+   mongoc_client_t *client_b;
+   bson_error_t error_a;
+   bson_error_t error_b;
+   future_t *future_a;
+   future_t *future_b;
+   request_t *request_a;
+   request_t *request_b;
+   uint16_t port;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   uri = mongoc_uri_copy (mock_server_get_uri (server));
+   mongoc_uri_set_option_as_int32 (uri, MONGOC_URI_MAXPOOLSIZE, 2);
+   pool = test_framework_client_pool_new_from_uri (uri, NULL);
+   ASSERT (mongoc_client_pool_set_shared_connections (pool, 1));
+   client_a = mongoc_client_pool_pop (pool);
+   client_b = mongoc_client_pool_pop (pool);
+
+   future_a = future_client_command_simple (
+      client_a, "db", tmp_bson ("{'ping': 'a'}"), NULL, NULL, &error_a);
+   request_a =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   future_b = future_client_command_simple (
+      client_b, "db", tmp_bson ("{'ping': 'b'}"), NULL, NULL, &error_b);
+   request_b =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   port = request_get_client_port (request_a);
+
+   /* losing the connection fails every request on it */
+   mock_server_hangs_up (request_a);
+   ASSERT (!future_get_bool (future_a));
+   ASSERT (!future_get_bool (future_b));
+   ASSERT_ERROR_CONTAINS (error_a,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_SOCKET,
+                          "socket error");
+   ASSERT_ERROR_CONTAINS (error_b,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_SOCKET,
+                          "socket error");
+   future_destroy (future_a);
+   future_destroy (future_b);
+   request_destroy (request_a);
+   request_destroy (request_b);
+
+   /* the next command opens a new shared connection */
+   future_a = future_client_command_simple (
+      client_a, "db", tmp_bson ("{'ping': 'a'}"), NULL, NULL, &error_a);
+   request_a =
+      mock_server_receives_msg (server, MONGOC_MSG_NONE, tmp_bson ("{}"));
+   ASSERT_CMPINT (request_get_client_port (request_a), !=, port);
+   mock_server_replies_ok_and_destroys (request_a);
+   ASSERT_OR_PRINT (future_get_bool (future_a), error_a);
+   future_destroy (future_a);
+
+   mongoc_client_pool_push (pool, client_a);
+   mongoc_client_pool_push (pool, client_b);
+   mongoc_client_pool_destroy (pool);
+   mongoc_uri_destroy (uri);
+   mock_server_destroy (server);
+}
+
 void
 test_client_pool_install (TestSuite *suite)
 {
@@ -505,4 +1340,48 @@ test_client_pool_install (TestSuite *suite)
    TestSuite_AddLive (suite,
                       "/ClientPool/max_pool_size_exceeded",
                       test_client_pool_max_pool_size_exceeded);
+   TestSuite_Add (suite,
+                  "/ClientPool/pop_push_threaded",
+                  test_client_pool_pop_push_threaded);
+   TestSuite_Add (suite,
+                  "/ClientPool/pop_push_threaded_affinity",
+                  test_client_pool_pop_push_threaded_affinity);
+   TestSuite_Add (suite,
+                  "/ClientPool/thread_affinity",
+                  test_client_pool_thread_affinity);
+   TestSuite_Add (suite,
+                  "/ClientPool/thread_affinity/slots",
+                  test_client_pool_thread_affinity_slots);
+   TestSuite_Add (suite,
+                  "/ClientPool/thread_affinity/try_pop",
+                  test_client_pool_thread_affinity_try_pop);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/warm", test_client_pool_warm);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/prune", test_client_pool_prune);
+   TestSuite_AddMockServerTest (
+      suite, "/ClientPool/share_topology", test_client_pool_share_topology);
+#if defined(MONGOC_ENABLE_SSL_OPENSSL) || \
+   defined(MONGOC_ENABLE_SSL_SECURE_TRANSPORT)
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/share_topology/tls",
+                                test_client_pool_share_topology_tls);
+#endif
+   TestSuite_AddMockServerTest (suite,
+                                "/ClientPool/shared_connections",
+                                test_client_pool_shared_connections);
+   TestSuite_AddMockServerTest (
+      suite,
+      "/ClientPool/shared_connections/connecting",
+      test_client_pool_shared_connections_connecting);
+   TestSuite_AddMockServerTest (
+      suite,
+      "/ClientPool/shared_connections/network_error",
+      test_client_pool_shared_connections_network_error);
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   TestSuite_AddMockServerTest (
+      suite,
+      "/ClientPool/shared_connections/zerocopy",
+      test_client_pool_shared_connections_zerocopy);
+#endif
 }
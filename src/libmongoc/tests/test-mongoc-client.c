@@ -381,6 +381,204 @@ test_client_cmd_write_concern_fam (void)
 }
 
 
+static void
+test_client_command_simple_pipelined (void)
+{
+   mongoc_client_t *client;
+   const bson_t *commands[3];
+   bson_t replies[3];
+   bson_error_t error;
+   future_t *future;
+   request_t *requests[3];
+   mock_server_t *server;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   for (i = 0; i < 3; i++) {
+      commands[i] = tmp_bson ("{'find': 'coll', 'filter': {'_id': %d}}", i);
+   }
+
+   future = future_client_command_simple_pipelined (
+      client, "db", commands, 3, NULL, replies, &error);
+
+   /* every request arrives before any is answered, on one connection */
+   for (i = 0; i < 3; i++) {
+      requests[i] = mock_server_receives_msg (
+         server,
+         MONGOC_MSG_NONE,
+         tmp_bson ("{'find': 'coll', 'filter': {'_id': %d}}", i));
+      ASSERT_CMPINT (request_get_client_port (requests[i]),
+                     ==,
+                     request_get_client_port (requests[0]));
+   }
+
+   mock_server_replies_simple (requests[0], "{'ok': 1, 'n': 0}");
+   mock_server_replies_simple (requests[1],
+                               "{'ok': 0, 'code': 2, 'errmsg': 'bad value'}");
+   mock_server_replies_simple (requests[2], "{'ok': 1, 'n': 2}");
+
+   BSON_ASSERT (!future_get_bool (future));
+   ASSERT_ERROR_CONTAINS (error, MONGOC_ERROR_QUERY, 2, "bad value");
+   ASSERT_MATCH (&replies[0], "{'ok': 1, 'n': 0}");
+   ASSERT_MATCH (&replies[1], "{'ok': 0, 'code': 2}");
+   ASSERT_MATCH (&replies[2], "{'ok': 1, 'n': 2}");
+
+   for (i = 0; i < 3; i++) {
+      request_destroy (requests[i]);
+      bson_destroy (&replies[i]);
+   }
+
+   future_destroy (future);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_command_simple_pipelined_window (void)
+{
+   mongoc_client_t *client;
+   bson_t commands[3];
+   const bson_t *command_ptrs[3];
+   bson_t replies[3];
+   bson_error_t error;
+   future_t *future;
+   request_t *request;
+   mock_server_t *server;
+   char *comment;
+   int i;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   /* each command is over half the bytes allowed in flight */
+   comment = bson_malloc (40 * 1024 + 1);
+   memset (comment, 'a', 40 * 1024);
+   comment[40 * 1024] = '\0';
+
+   for (i = 0; i < 3; i++) {
+      bson_init (&commands[i]);
+      BSON_APPEND_INT32 (&commands[i], "ping", i);
+      BSON_APPEND_UTF8 (&commands[i], "comment", comment);
+      command_ptrs[i] = &commands[i];
+   }
+
+   future = future_client_command_simple_pipelined (
+      client, "db", command_ptrs, 3, NULL, replies, &error);
+
+   /* each request is only written once the one before it is answered */
+   for (i = 0; i < 3; i++) {
+      request = mock_server_receives_msg (
+         server, MONGOC_MSG_NONE, tmp_bson ("{'ping': %d}", i));
+      mock_server_set_request_timeout_msec (server, 100);
+      BSON_ASSERT (!mock_server_receives_request (server));
+      mock_server_set_request_timeout_msec (server, get_future_timeout_ms ());
+      mock_server_replies_ok_and_destroys (request);
+   }
+
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+
+   for (i = 0; i < 3; i++) {
+      ASSERT_MATCH (&replies[i], "{'ok': 1}");
+      bson_destroy (&replies[i]);
+      bson_destroy (&commands[i]);
+   }
+
+   bson_free (comment);
+   future_destroy (future);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_command_simple_pipelined_network_error (void)
+{
+   mongoc_client_t *client;
+   const bson_t *commands[2];
+   bson_t replies[2];
+   bson_error_t error;
+   future_t *future;
+   request_t *request;
+   mock_server_t *server;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   commands[0] = tmp_bson ("{'ping': 1}");
+   commands[1] = tmp_bson ("{'ping': 2}");
+   future = future_client_command_simple_pipelined (
+      client, "db", commands, 2, NULL, replies, &error);
+
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 1}"));
+   mock_server_replies_ok_and_destroys (request);
+   request = mock_server_receives_msg (
+      server, MONGOC_MSG_NONE, tmp_bson ("{'ping': 2}"));
+   mock_server_hangs_up (request);
+
+   /* the command answered before the connection closed succeeds */
+   BSON_ASSERT (!future_get_bool (future));
+   ASSERT_CMPUINT32 (error.domain, ==, MONGOC_ERROR_STREAM);
+   ASSERT_MATCH (&replies[0], "{'ok': 1}");
+   ASSERT_CMPUINT32 (bson_count_keys (&replies[1]), ==, 0);
+
+   bson_destroy (&replies[0]);
+   bson_destroy (&replies[1]);
+   request_destroy (request);
+   future_destroy (future);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
+static void
+test_client_command_simple_pipelined_op_query (void)
+{
+   mongoc_client_t *client;
+   const bson_t *commands[2];
+   bson_t replies[2];
+   bson_error_t error;
+   future_t *future;
+   request_t *request;
+   mock_server_t *server;
+
+   /* without OP_MSG the commands run one at a time */
+   server = mock_server_with_auto_hello (WIRE_VERSION_OP_MSG - 1);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+
+   commands[0] = tmp_bson ("{'ping': 1}");
+   commands[1] = tmp_bson ("{'ping': 2}");
+   future = future_client_command_simple_pipelined (
+      client, "db", commands, 2, NULL, replies, &error);
+
+   request = mock_server_receives_command (
+      server, "db", MONGOC_QUERY_SECONDARY_OK, "{'ping': 1}");
+   mock_server_replies_ok_and_destroys (request);
+   request = mock_server_receives_command (
+      server, "db", MONGOC_QUERY_SECONDARY_OK, "{'ping': 2}");
+   mock_server_replies_ok_and_destroys (request);
+
+   ASSERT_OR_PRINT (future_get_bool (future), error);
+
+   bson_destroy (&replies[0]);
+   bson_destroy (&replies[1]);
+   future_destroy (future);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
+
+
 static char *
 gen_test_user (void)
 {
@@ -4229,6 +4427,19 @@ test_client_install (TestSuite *suite)
    TestSuite_AddMockServerTest (suite,
                                 "/Client/command/write_concern_fam",
                                 test_client_cmd_write_concern_fam);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/command/pipelined",
+                                test_client_command_simple_pipelined);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/command/pipelined/window",
+                                test_client_command_simple_pipelined_window);
+   TestSuite_AddMockServerTest (
+      suite,
+      "/Client/command/pipelined/network_error",
+      test_client_command_simple_pipelined_network_error);
+   TestSuite_AddMockServerTest (suite,
+                                "/Client/command/pipelined/op_query",
+                                test_client_command_simple_pipelined_op_query);
    TestSuite_AddMockServerTest (suite,
                                 "/Client/command/read_prefs/simple/single",
                                 test_command_simple_read_prefs_single);
@@ -557,6 +557,37 @@ test_counters_streams_timeout ()
    mongoc_client_destroy (client);
    mock_server_destroy (server);
 }
+
+
+static void
+test_counters_server_ops_in_flight (void)
+{
+   mock_server_t *server;
+   bson_error_t err = {0};
+   future_t *future;
+   mongoc_client_t *client;
+   request_t *request;
+   mongoc_server_description_t *sd;
+
+   server = mock_server_with_auto_hello (WIRE_VERSION_MAX);
+   mock_server_run (server);
+   client =
+      test_framework_client_new_from_uri (mock_server_get_uri (server), NULL);
+   sd = mongoc_client_select_server (client, true, NULL, &err);
+   mongoc_server_description_destroy (sd);
+   reset_all_counters ();
+   future = future_client_command_simple (
+      client, "test", tmp_bson ("{'ping': 1}"), NULL, NULL, &err);
+   request = mock_server_receives_msg (
+      server, MONGOC_QUERY_NONE, tmp_bson ("{'ping': 1}"));
+   DIFF_AND_RESET (server_ops_in_flight, ==, 1);
+   mock_server_replies_ok_and_destroys (request);
+   ASSERT_OR_PRINT (future_get_bool (future), err);
+   future_destroy (future);
+   DIFF_AND_RESET (server_ops_in_flight, ==, -1);
+   mongoc_client_destroy (client);
+   mock_server_destroy (server);
+}
 #endif
 
 void
@@ -616,5 +647,8 @@ test_counters_install (TestSuite *suite)
    TestSuite_AddLive (suite, "/counters/dns", test_counters_dns);
    TestSuite_AddMockServerTest (
       suite, "/counters/streams_timeout", test_counters_streams_timeout);
+   TestSuite_AddMockServerTest (suite,
+                                "/counters/server_ops_in_flight",
+                                test_counters_server_ops_in_flight);
 #endif
 }
@@ -889,6 +889,18 @@ test_handshake_platform_config (void)
    BSON_ASSERT (_get_bit (config_str, MONGOC_MD_FLAG_ENABLE_MONGODB_AWS_AUTH));
 #endif
 
+#ifdef MONGOC_ENABLE_EPOLL
+   BSON_ASSERT (_get_bit (config_str, MONGOC_MD_FLAG_ENABLE_EPOLL));
+#endif
+
+#ifdef MONGOC_ENABLE_IO_URING
+   BSON_ASSERT (_get_bit (config_str, MONGOC_MD_FLAG_ENABLE_IO_URING));
+#endif
+
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   BSON_ASSERT (_get_bit (config_str, MONGOC_MD_FLAG_ENABLE_ZEROCOPY));
+#endif
+
    /* any excess bits should all be zero. */
    for (i = LAST_MONGOC_MD_FLAG; i < total_bits; i++) {
       BSON_ASSERT (!_get_bit (config_str, i));
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongoc-histogram-private.h"
+
+#include "TestSuite.h"
+
+/* assert that @estimate is within 1/16 of @expected */
+#define ASSERT_ESTIMATE(estimate, expected)                        \
+   do {                                                            \
+      int64_t _estimate = (estimate);                              \
+      int64_t _expected = (expected);                              \
+      ASSERT_CMPINT64 (_estimate, >=, _expected - _expected / 16); \
+      ASSERT_CMPINT64 (_estimate, <=, _expected + _expected / 16); \
+   } while (0)
+
+static void
+test_histogram_percentile (void)
+{
+   mongoc_histogram_t histogram = {0};
+   int64_t i;
+
+   ASSERT_CMPINT64 (mongoc_histogram_percentile (&histogram, 50), ==, -1);
+
+   /* small values are exact */
+   mongoc_histogram_record (&histogram, 3);
+   ASSERT_CMPINT64 (mongoc_histogram_percentile (&histogram, 0), ==, 3);
+   ASSERT_CMPINT64 (mongoc_histogram_percentile (&histogram, 100), ==, 3);
+
+   /* 1 to 100 milliseconds */
+   memset (&histogram, 0, sizeof histogram);
+   for (i = 1; i <= 100; i++) {
+      mongoc_histogram_record (&histogram, i * 1000);
+   }
+
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 1), 1000);
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 50), 50000);
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 90), 90000);
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 100), 100000);
+
+   /* huge values share the last bucket */
+   mongoc_histogram_record (&histogram, INT64_MAX);
+   ASSERT_CMPINT64 (mongoc_histogram_percentile (&histogram, 100), >, 0);
+}
+
+static void
+test_histogram_decay (void)
+{
+   mongoc_histogram_t histogram = {0};
+   int i;
+
+   for (i = 0; i < MONGOC_HISTOGRAM_DECAY_SAMPLES / 2; i++) {
+      mongoc_histogram_record (&histogram, 100);
+   }
+
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 50), 100);
+
+   /* newer samples take over as older ones are halved */
+   for (i = 0; i < 4 * MONGOC_HISTOGRAM_DECAY_SAMPLES; i++) {
+      mongoc_histogram_record (&histogram, 10000);
+   }
+
+   ASSERT_CMPINT32 (histogram.total, <, MONGOC_HISTOGRAM_DECAY_SAMPLES);
+   ASSERT_ESTIMATE (mongoc_histogram_percentile (&histogram, 10), 10000);
+}
+
+void
+test_histogram_install (TestSuite *suite)
+{
+   TestSuite_Add (suite, "/histogram/percentile", test_histogram_percentile);
+   TestSuite_Add (suite, "/histogram/decay", test_histogram_decay);
+}
@@ -381,6 +381,71 @@ test_server_description_legacy_hello_ok (void)
    bson_destroy (&hello_response);
 }
 
+static void
+test_server_description_hello_unchanged (void)
+{
+   mongoc_server_description_t sd;
+   mongoc_server_description_t *copy;
+   int64_t last_write_date_ms;
+   const char *hello = "{'ok': 1, 'isWritablePrimary': true, 'setName': 'rs',"
+                       " 'hosts': ['a:1', 'b:2'], 'localTime': {'$date': 1},"
+                       " 'lastWrite': {'lastWriteDate': {'$date': 1000}},"
+                       " 'topologyVersion': {'counter': 1}}";
+
+   mongoc_server_description_init (&sd, "a:1", 1);
+   /* a description without a reply is never unchanged */
+   BSON_ASSERT (!_mongoc_server_description_hello_unchanged (
+      &sd, tmp_bson (hello), &last_write_date_ms));
+   mongoc_server_description_handle_hello (&sd, tmp_bson (hello), 10, NULL);
+   BSON_ASSERT (sd.type == MONGOC_SERVER_RS_PRIMARY);
+   ASSERT_CMPINT64 (sd.last_write_date_ms, ==, (int64_t) 1000);
+
+   /* fields that change with every reply are ignored */
+   BSON_ASSERT (_mongoc_server_description_hello_unchanged (
+      &sd,
+      tmp_bson ("{'ok': 1, 'isWritablePrimary': true, 'setName': 'rs',"
+                " 'hosts': ['a:1', 'b:2'], 'localTime': {'$date': 2},"
+                " 'lastWrite': {'lastWriteDate': {'$date': 2000}},"
+                " 'topologyVersion': {'counter': 1}, 'operationTime': 1,"
+                " '$clusterTime': {'clusterTime': 1}}"),
+      &last_write_date_ms));
+   ASSERT_CMPINT64 (last_write_date_ms, ==, (int64_t) 2000);
+
+   /* any other difference is a change */
+   BSON_ASSERT (!_mongoc_server_description_hello_unchanged (
+      &sd,
+      tmp_bson ("{'ok': 1, 'isWritablePrimary': true, 'setName': 'rs',"
+                " 'hosts': ['a:1', 'b:2'], 'localTime': {'$date': 1},"
+                " 'lastWrite': {'lastWriteDate': {'$date': 1000}},"
+                " 'topologyVersion': {'counter': 2}}"),
+      &last_write_date_ms));
+   BSON_ASSERT (!_mongoc_server_description_hello_unchanged (
+      &sd,
+      tmp_bson ("{'ok': 1, 'isWritablePrimary': true, 'setName': 'rs',"
+                " 'hosts': ['a:1'], 'localTime': {'$date': 1},"
+                " 'lastWrite': {'lastWriteDate': {'$date': 1000}},"
+                " 'topologyVersion': {'counter': 1}}"),
+      &last_write_date_ms));
+   BSON_ASSERT (!_mongoc_server_description_hello_unchanged (
+      &sd,
+      tmp_bson ("{'ok': 1, 'isWritablePrimary': true, 'setName': 'rs',"
+                " 'hosts': ['a:1', 'b:2'], 'localTime': {'$date': 1},"
+                " 'topologyVersion': {'counter': 1}}"),
+      &last_write_date_ms));
+
+   /* only the volatile fields are updated, and copies keep them */
+   mongoc_server_description_handle_unchanged_hello (&sd, 20, 3000);
+   ASSERT_CMPINT64 (sd.last_write_date_ms, ==, (int64_t) 3000);
+   ASSERT_CMPINT64 (sd.round_trip_time_msec, >, (int64_t) 10);
+   BSON_ASSERT (sd.type == MONGOC_SERVER_RS_PRIMARY);
+   copy = mongoc_server_description_new_copy (&sd);
+   ASSERT_CMPINT64 (copy->last_write_date_ms, ==, (int64_t) 3000);
+   ASSERT_CMPINT64 (copy->last_update_time_usec, ==, sd.last_update_time_usec);
+
+   mongoc_server_description_destroy (copy);
+   mongoc_server_description_cleanup (&sd);
+}
+
 void
 test_server_description_install (TestSuite *suite)
 {
@@ -403,4 +468,7 @@ test_server_description_install (TestSuite *suite)
    TestSuite_Add (suite,
                   "/server_description/legacy_hello_ok",
                   test_server_description_legacy_hello_ok);
+   TestSuite_Add (suite,
+                  "/server_description/hello_unchanged",
+                  test_server_description_hello_unchanged);
 }
@@ -3,7 +3,9 @@
 #include <mongoc/mongoc-util-private.h>
 
 #include "mongoc/mongoc-socket-private.h"
+#include "mongoc/mongoc-stream-private.h"
 #include "mongoc/mongoc-thread-private.h"
+#include "mongoc/mongoc-uring-private.h"
 #include "mongoc/mongoc-errno-private.h"
 #include "TestSuite.h"
 
@@ -302,6 +304,12 @@ static BSON_THREAD_FUN (sendv_test_client, data_)
       conn_sock, (struct sockaddr *) &server_addr, sizeof (server_addr), -1);
    BSON_ASSERT (r == 0);
 
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   /* a zero-copy send fails if its completions time out, though it wrote
+    * everything, so this test couldn't count the bytes written */
+   conn_sock->zerocopy = -1;
+#endif
+
    stream = mongoc_stream_socket_new (conn_sock);
 
    for (i = 0; i < 5; i++) {
@@ -446,6 +454,199 @@ test_mongoc_socket_poll_refusal (void *ctx)
 #endif
 }
 
+/* connect two stream sockets over the loopback interface */
+static void
+_socket_pair (mongoc_stream_t **client, mongoc_stream_t **server)
+{
+   struct sockaddr_in server_addr = {0};
+   mongoc_socket_t *listen_sock;
+   mongoc_socket_t *conn_sock;
+   mongoc_socket_t *accepted;
+   mongoc_socklen_t sock_len;
+   int r;
+
+   listen_sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (listen_sock);
+
+   server_addr.sin_family = AF_INET;
+   server_addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+   server_addr.sin_port = htons (0);
+
+   r = mongoc_socket_bind (
+      listen_sock, (struct sockaddr *) &server_addr, sizeof server_addr);
+   BSON_ASSERT (r == 0);
+
+   sock_len = sizeof (server_addr);
+   r = mongoc_socket_getsockname (
+      listen_sock, (struct sockaddr *) &server_addr, &sock_len);
+   BSON_ASSERT (r == 0);
+
+   r = mongoc_socket_listen (listen_sock, 10);
+   BSON_ASSERT (r == 0);
+
+   conn_sock = mongoc_socket_new (AF_INET, SOCK_STREAM, 0);
+   BSON_ASSERT (conn_sock);
+
+   r = mongoc_socket_connect (conn_sock,
+                              (struct sockaddr *) &server_addr,
+                              sizeof (server_addr),
+                              bson_get_monotonic_time () + TIMEOUT * 1000);
+   BSON_ASSERT (r == 0);
+
+   accepted = mongoc_socket_accept (listen_sock, bson_get_monotonic_time () +
+                                                    TIMEOUT * 1000);
+   BSON_ASSERT (accepted);
+
+   *client = mongoc_stream_socket_new (conn_sock);
+   *server = mongoc_stream_socket_new (accepted);
+
+   mongoc_socket_destroy (listen_sock);
+}
+
+
+/* scatter-gather I/O and read timeouts, whichever backend the socket stream
+ * was built with */
+static void
+test_mongoc_socket_stream_iovec (void)
+{
+   mongoc_stream_t *client;
+   mongoc_stream_t *server;
+   mongoc_iovec_t out[3];
+   mongoc_iovec_t in[2];
+   char in_a[4];
+   char in_b[5];
+   int64_t start;
+   ssize_t r;
+
+   _socket_pair (&client, &server);
+
+   in[0].iov_base = in_a;
+   in[0].iov_len = sizeof (in_a);
+   in[1].iov_base = in_b;
+   in[1].iov_len = sizeof (in_b);
+
+   /* nothing to read yet */
+   start = bson_get_monotonic_time ();
+   r = mongoc_stream_readv (server, in, 2, 1, 100);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) -1);
+   BSON_ASSERT (mongoc_stream_timed_out (server));
+   ASSERT_CMPINT64 (bson_get_monotonic_time () - start, >=, (int64_t) 50000);
+
+   out[0].iov_base = "ab";
+   out[0].iov_len = 2;
+   out[1].iov_base = "cdef";
+   out[1].iov_len = 4;
+   out[2].iov_base = "ghi";
+   out[2].iov_len = 3;
+
+   r = mongoc_stream_writev (client, out, 3, TIMEOUT);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) 9);
+
+   r = mongoc_stream_readv (server, in, 2, 9, TIMEOUT);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) 9);
+   BSON_ASSERT (memcmp (in_a, "abcd", 4) == 0);
+   BSON_ASSERT (memcmp (in_b, "efghi", 5) == 0);
+   BSON_ASSERT (!mongoc_stream_timed_out (server));
+
+#ifdef MONGOC_ENABLE_IO_URING
+   /* the reads and the write ran on io_uring, unless the kernel refused it */
+   if (!_mongoc_uring_unavailable ()) {
+      ASSERT_CMPUINT64 (
+         _mongoc_stream_socket_uring_ops (server), >=, (uint64_t) 2);
+      ASSERT_CMPUINT64 (
+         _mongoc_stream_socket_uring_ops (client), >=, (uint64_t) 1);
+   }
+#endif
+
+   /* the peer closes */
+   mongoc_stream_destroy (client);
+   r = mongoc_stream_readv (server, in, 2, 1, TIMEOUT);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) -1);
+   BSON_ASSERT (!mongoc_stream_timed_out (server));
+
+   mongoc_stream_destroy (server);
+}
+
+#ifdef MONGOC_ENABLE_ZEROCOPY
+typedef struct {
+   mongoc_stream_t *stream;
+   uint8_t *data;
+   size_t len;
+   ssize_t written;
+} zerocopy_writer_t;
+
+
+static BSON_THREAD_FUN (zerocopy_writer, data_)
+{
+   zerocopy_writer_t *writer = (zerocopy_writer_t *) data_;
+   mongoc_iovec_t iov[2];
+
+   iov[0].iov_base = writer->data;
+   iov[0].iov_len = writer->len / 2;
+   iov[1].iov_base = writer->data + writer->len / 2;
+   iov[1].iov_len = writer->len - writer->len / 2;
+
+   writer->written = mongoc_stream_writev (writer->stream, iov, 2, TIMEOUT);
+
+   /* the kernel is done with the pages once writev returns */
+   memset (writer->data, 0, writer->len);
+
+   BSON_THREAD_RETURN;
+}
+
+
+/* a send over the zero-copy threshold waits for its completions. Loopback
+ * copies the data, so the socket goes back to copying afterwards */
+static void
+test_mongoc_socket_zerocopy (void)
+{
+   mongoc_stream_t *client;
+   mongoc_stream_t *server;
+   mongoc_socket_t *sock;
+   zerocopy_writer_t writer;
+   bson_thread_t thread;
+   uint8_t *received;
+   size_t i;
+   ssize_t r;
+   int ret;
+
+   _socket_pair (&client, &server);
+
+   writer.stream = client;
+   writer.len = gFourMB;
+   writer.data = bson_malloc (writer.len);
+   writer.written = 0;
+   for (i = 0; i < writer.len; i++) {
+      writer.data[i] = (uint8_t) (i % 251);
+   }
+
+   received = bson_malloc (writer.len);
+
+   ret = COMMON_PREFIX (thread_create) (&thread, &zerocopy_writer, &writer);
+   BSON_ASSERT (ret == 0);
+
+   r = mongoc_stream_read (server, received, writer.len, writer.len, TIMEOUT);
+   ASSERT_CMPSSIZE_T (r, ==, (ssize_t) writer.len);
+
+   ret = COMMON_PREFIX (thread_join) (thread);
+   BSON_ASSERT (ret == 0);
+
+   ASSERT_CMPSSIZE_T (writer.written, ==, (ssize_t) writer.len);
+   for (i = 0; i < writer.len; i++) {
+      ASSERT_CMPINT ((int) received[i], ==, (int) (i % 251));
+   }
+
+   sock = mongoc_stream_socket_get_socket ((mongoc_stream_socket_t *) client);
+   ASSERT_CMPUINT32 (sock->zerocopy_sent, >, (uint32_t) 0);
+   ASSERT_CMPUINT32 (sock->zerocopy_done, ==, sock->zerocopy_sent);
+
+   bson_free (received);
+   bson_free (writer.data);
+   mongoc_stream_destroy (client);
+   mongoc_stream_destroy (server);
+}
+#endif
+
 void
 test_socket_install (TestSuite *suite)
 {
@@ -469,4 +670,9 @@ test_socket_install (TestSuite *suite)
                       NULL,
                       NULL,
                       test_framework_skip_if_slow);
+   TestSuite_Add (
+      suite, "/Socket/stream_iovec", test_mongoc_socket_stream_iovec);
+#ifdef MONGOC_ENABLE_ZEROCOPY
+   TestSuite_Add (suite, "/Socket/zerocopy", test_mongoc_socket_zerocopy);
+#endif
 }
@@ -88,7 +88,7 @@ test_has_readable_writable_server_pooled (void)
 
 
 static const mongoc_server_description_t *
-_sd_for_host (mongoc_topology_description_t *td, const char *host)
+_sd_for_host (const mongoc_topology_description_t *td, const char *host)
 {
    int i;
    const mongoc_server_description_t *sd;
@@ -273,6 +273,250 @@ test_topology_description_new_copy (void)
    mongoc_topology_description_destroy (td_copy);
 }
 
+/* Copies share the server descriptions, and only copy those they modify. */
+static void
+test_topology_description_shared_servers (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   mongoc_topology_description_t *td;
+   mongoc_topology_description_t *td_copy;
+   const mongoc_server_description_t *sd_a;
+   const mongoc_server_description_t *sd_b;
+
+   uri = mongoc_uri_new ("mongodb://a,b");
+   topology = mongoc_topology_new (uri, true /* single-threaded */);
+   td = mc_tpld_unsafe_get_mutable (topology);
+   td_copy = mongoc_topology_description_new_copy (td);
+
+   sd_a = _sd_for_host (td, "a");
+   sd_b = _sd_for_host (td, "b");
+   BSON_ASSERT (_sd_for_host (td_copy, "a") == sd_a);
+   BSON_ASSERT (_sd_for_host (td_copy, "b") == sd_b);
+
+   mongoc_topology_description_handle_hello (
+      td_copy, sd_a->id, tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"), 100, NULL);
+
+   /* only the updated server description was copied */
+   BSON_ASSERT (_sd_for_host (td_copy, "a") != sd_a);
+   BSON_ASSERT (_sd_for_host (td_copy, "b") == sd_b);
+   BSON_ASSERT (_sd_for_host (td_copy, "a")->type == MONGOC_SERVER_MONGOS);
+   BSON_ASSERT (sd_a->type == MONGOC_SERVER_UNKNOWN);
+
+   /* the shared server description outlives the original */
+   mongoc_topology_destroy (topology);
+   BSON_ASSERT (_sd_for_host (td_copy, "b")->type == MONGOC_SERVER_UNKNOWN);
+
+   mongoc_topology_description_destroy (td_copy);
+   mongoc_uri_destroy (uri);
+}
+
+/* A published topology description memoises selection results for as long as
+ * it exists; a newly published description computes its own. */
+static void
+test_topology_description_selection_cache (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   mc_tpld_modification tdmod;
+   mc_shared_tpld td;
+   mongoc_read_prefs_t *prefs;
+   mongoc_read_prefs_t *prefs_copy;
+   mongoc_server_description_t *sd_a;
+   const mongoc_server_description_t *sd_b;
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://a,b");
+   topology = mongoc_topology_new (uri, true /* single-threaded */);
+   tdmod = mc_tpld_modify_begin (topology);
+   mongoc_topology_description_handle_hello (
+      tdmod.new_td,
+      _sd_for_host (tdmod.new_td, "a")->id,
+      tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"),
+      10,
+      NULL);
+   mongoc_topology_description_handle_hello (
+      tdmod.new_td,
+      _sd_for_host (tdmod.new_td, "b")->id,
+      tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"),
+      100,
+      NULL);
+   mc_tpld_modify_commit (tdmod);
+
+   td = mc_tpld_take_ref (topology);
+   sd_a = (mongoc_server_description_t *) _sd_for_host (td.ptr, "a");
+   sd_b = _sd_for_host (td.ptr, "b");
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY_PREFERRED);
+   mongoc_read_prefs_add_tag (prefs, tmp_bson ("{'dc': 'ny'}"));
+
+   /* only "a" is in the latency window */
+   BSON_ASSERT (sd_a == mongoc_topology_description_select (
+                           td.ptr, MONGOC_SS_WRITE, NULL, 15));
+   BSON_ASSERT (sd_a == mongoc_topology_description_select (
+                           td.ptr, MONGOC_SS_READ, prefs, 15));
+
+   /* the results are not recomputed, even for an equal read preference */
+   sd_a->round_trip_time_msec = 1000;
+   prefs_copy = mongoc_read_prefs_copy (prefs);
+   for (i = 0; i < 10; i++) {
+      BSON_ASSERT (sd_a == mongoc_topology_description_select (
+                              td.ptr, MONGOC_SS_WRITE, NULL, 15));
+      BSON_ASSERT (sd_a == mongoc_topology_description_select (
+                              td.ptr, MONGOC_SS_READ, prefs_copy, 15));
+   }
+
+   /* a different tag set is a different entry */
+   mongoc_read_prefs_add_tag (prefs_copy, tmp_bson ("{}"));
+   BSON_ASSERT (sd_b == mongoc_topology_description_select (
+                           td.ptr, MONGOC_SS_READ, prefs_copy, 15));
+
+   tdmod = mc_tpld_modify_begin (topology);
+   ((mongoc_server_description_t *) _sd_for_host (tdmod.new_td, "a"))
+      ->round_trip_time_msec = 1000;
+   mc_tpld_modify_commit (tdmod);
+   mc_tpld_renew_ref (&td, topology);
+   sd_b = _sd_for_host (td.ptr, "b");
+   BSON_ASSERT (sd_b == mongoc_topology_description_select (
+                           td.ptr, MONGOC_SS_WRITE, NULL, 15));
+   BSON_ASSERT (sd_b == mongoc_topology_description_select (
+                           td.ptr, MONGOC_SS_READ, prefs, 15));
+
+   mongoc_read_prefs_destroy (prefs_copy);
+   mongoc_read_prefs_destroy (prefs);
+   mc_tpld_drop_ref (&td);
+   mongoc_topology_destroy (topology);
+   mongoc_uri_destroy (uri);
+}
+
+/* Of two servers in the latency window, the one with fewer operations in
+ * progress is selected. */
+static void
+test_topology_description_select_least_loaded (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   mc_tpld_modification tdmod;
+   mc_shared_tpld td;
+   const mongoc_server_description_t *sd_a;
+   const mongoc_server_description_t *sd_b;
+   mongoc_server_description_t *sd_copy;
+   mongoc_server_load_t *load;
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://a,b");
+   topology = mongoc_topology_new (uri, true /* single-threaded */);
+   tdmod = mc_tpld_modify_begin (topology);
+   mongoc_topology_description_handle_hello (
+      tdmod.new_td,
+      _sd_for_host (tdmod.new_td, "a")->id,
+      tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"),
+      10,
+      NULL);
+   mongoc_topology_description_handle_hello (
+      tdmod.new_td,
+      _sd_for_host (tdmod.new_td, "b")->id,
+      tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"),
+      10,
+      NULL);
+   mc_tpld_modify_commit (tdmod);
+
+   td = mc_tpld_take_ref (topology);
+   sd_a = _sd_for_host (td.ptr, "a");
+   sd_b = _sd_for_host (td.ptr, "b");
+
+   /* the count is shared with copies of the server description */
+   sd_copy = mongoc_server_description_new_copy (sd_a);
+   load = mongoc_server_description_begin_op (sd_a);
+   ASSERT_CMPINT32 (mongoc_server_description_ops_in_flight (sd_a), ==, 1);
+   ASSERT_CMPINT32 (mongoc_server_description_ops_in_flight (sd_copy), ==, 1);
+   for (i = 0; i < 10; i++) {
+      BSON_ASSERT (sd_b == mongoc_topology_description_select (
+                              td.ptr, MONGOC_SS_WRITE, NULL, 15));
+   }
+
+   mongoc_server_load_end_op (load);
+   ASSERT_CMPINT32 (mongoc_server_description_ops_in_flight (sd_a), ==, 0);
+   ASSERT_CMPINT32 (mongoc_server_description_ops_in_flight (sd_copy), ==, 0);
+   mongoc_server_description_destroy (sd_copy);
+   load = mongoc_server_description_begin_op (sd_b);
+   for (i = 0; i < 10; i++) {
+      BSON_ASSERT (sd_a == mongoc_topology_description_select (
+                              td.ptr, MONGOC_SS_WRITE, NULL, 15));
+   }
+
+   mongoc_server_load_end_op (load);
+   mc_tpld_drop_ref (&td);
+   mongoc_topology_destroy (topology);
+   mongoc_uri_destroy (uri);
+}
+
+/* With localThresholdPercentile, a server with jittery round trip times is
+ * left out of the latency window even if its average is low. */
+static void
+test_topology_description_local_threshold_percentile (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   mongoc_topology_description_t *td;
+   mongoc_server_description_t *sd_a;
+   mongoc_server_description_t *sd_b;
+   mongoc_array_t servers;
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://a,b/?localThresholdPercentile=90");
+   topology = mongoc_topology_new (uri, true /* single-threaded */);
+   td = mc_tpld_unsafe_get_mutable (topology);
+   ASSERT_CMPINT32 (td->local_threshold_percentile, ==, 90);
+   for (i = 0; i < 2; i++) {
+      mongoc_topology_description_handle_hello (
+         td,
+         _sd_for_host (td, i ? "b" : "a")->id,
+         tmp_bson ("{'ok': 1, 'msg': 'isdbgrid'}"),
+         10,
+         NULL);
+   }
+
+   sd_a = mongoc_topology_description_server_by_id (
+      td, _sd_for_host (td, "a")->id, NULL);
+   sd_b = mongoc_topology_description_server_by_id (
+      td, _sd_for_host (td, "b")->id, NULL);
+   /* heartbeats record their round trip times as the topology description
+    * is published */
+   for (i = 0; i < 10; i++) {
+      mongoc_server_description_set_rtt_sample (sd_a, 10000);
+      mongoc_server_description_publish (sd_a);
+      mongoc_server_description_set_rtt_sample (sd_b, i < 8 ? 5000 : 200000);
+      mongoc_server_description_publish (sd_b);
+   }
+
+   ASSERT_CMPDOUBLE (
+      mongoc_server_description_round_trip_time_percentile (sd_b, 50), <, 6);
+   ASSERT_CMPDOUBLE (
+      mongoc_server_description_round_trip_time_percentile (sd_b, 90), >, 150);
+
+   /* by average both are within 15ms of the fastest */
+   sd_a->round_trip_time_msec = 10;
+   sd_b->round_trip_time_msec = 5;
+   td->local_threshold_percentile = 0;
+   _mongoc_array_init (&servers, sizeof (mongoc_server_description_t *));
+   mongoc_topology_description_suitable_servers (
+      &servers, MONGOC_SS_WRITE, td, NULL, 15);
+   ASSERT_CMPSIZE_T (servers.len, ==, (size_t) 2);
+
+   /* by 90th percentile "b" takes about 200ms */
+   td->local_threshold_percentile = 90;
+   servers.len = 0;
+   mongoc_topology_description_suitable_servers (
+      &servers, MONGOC_SS_WRITE, td, NULL, 15);
+   ASSERT_CMPSIZE_T (servers.len, ==, (size_t) 1);
+   BSON_ASSERT (_mongoc_array_index (
+                   &servers, mongoc_server_description_t *, 0) == sd_a);
+
+   _mongoc_array_destroy (&servers);
+   mongoc_topology_destroy (topology);
+   mongoc_uri_destroy (uri);
+}
+
 /* Test that _mongoc_topology_description_clear_connection_pool increments the
  * generation.
  */
@@ -366,6 +610,18 @@ test_topology_description_install (TestSuite *suite)
    TestSuite_Add (suite,
                   "/TopologyDescription/new_copy",
                   test_topology_description_new_copy);
+   TestSuite_Add (suite,
+                  "/TopologyDescription/shared_servers",
+                  test_topology_description_shared_servers);
+   TestSuite_Add (suite,
+                  "/TopologyDescription/selection_cache",
+                  test_topology_description_selection_cache);
+   TestSuite_Add (suite,
+                  "/TopologyDescription/select_least_loaded",
+                  test_topology_description_select_least_loaded);
+   TestSuite_Add (suite,
+                  "/TopologyDescription/local_threshold_percentile",
+                  test_topology_description_local_threshold_percentile);
    TestSuite_Add (
       suite, "/TopologyDescription/pool_clear", test_topology_pool_clear);
    TestSuite_Add (suite,
@@ -24,7 +24,7 @@
 static void
 test_topology_scanner_helper (uint32_t id,
                               const bson_t *bson,
-                              int64_t rtt_msec,
+                              int64_t rtt_usec,
                               void *data,
                               const bson_error_t *error /* IN */)
 {
@@ -463,7 +463,7 @@ typedef struct dns_testcase {
 static void
 _test_topology_scanner_dns_helper (uint32_t id,
                                    const bson_t *bson,
-                                   int64_t rtt_msec,
+                                   int64_t rtt_usec,
                                    void *data,
                                    const bson_error_t *error /* IN */)
 {
@@ -569,7 +569,7 @@ test_topology_scanner_dns (void)
 static void
 _retired_fails_to_initiate_cb (uint32_t id,
                                const bson_t *bson,
-                               int64_t rtt_msec,
+                               int64_t rtt_usec,
                                void *data,
                                const bson_error_t *error /* IN */)
 {
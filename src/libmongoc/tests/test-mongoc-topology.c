@@ -2441,6 +2441,129 @@ test_hello_ok_pooled (void)
    _test_hello_ok (true);
 }
 
+#define MAX_CONNECTING_THREADS 8
+
+typedef struct {
+   mongoc_topology_t *topology;
+   int32_t n_connecting;
+   int32_t max_seen;
+} max_connecting_args_t;
+
+static BSON_THREAD_FUN (max_connecting_worker, arg)
+{
+   max_connecting_args_t *args = arg;
+   int32_t n;
+   int32_t max_seen;
+   int i;
+
+   for (i = 0; i < 50; i++) {
+      BSON_ASSERT (_mongoc_topology_connecting_begin (
+         args->topology, 1, INT64_MAX, NULL));
+      n = 1 + bson_atomic_int32_fetch_add (
+                 &args->n_connecting, 1, bson_memory_order_seq_cst);
+
+      max_seen =
+         bson_atomic_int32_fetch (&args->max_seen, bson_memory_order_seq_cst);
+      while (n > max_seen) {
+         max_seen = bson_atomic_int32_compare_exchange_strong (
+            &args->max_seen, max_seen, n, bson_memory_order_seq_cst);
+      }
+
+      /* as if performing a handshake */
+      _mongoc_usleep (100);
+      bson_atomic_int32_fetch_sub (
+         &args->n_connecting, 1, bson_memory_order_seq_cst);
+      _mongoc_topology_connecting_end (args->topology, 1);
+   }
+
+   BSON_THREAD_RETURN;
+}
+
+/* at most maxConnecting threads establish connections to a server at once */
+static void
+test_topology_max_connecting (void)
+{
+   mongoc_uri_t *uri;
+   max_connecting_args_t args = {0};
+   bson_thread_t ids[MAX_CONNECTING_THREADS];
+   int i;
+
+   uri = mongoc_uri_new ("mongodb://localhost/?maxConnecting=3");
+   args.topology = mongoc_topology_new (uri, false /* single-threaded */);
+   ASSERT_CMPINT32 (args.topology->max_connecting, ==, 3);
+
+   for (i = 0; i < MAX_CONNECTING_THREADS; i++) {
+      COMMON_PREFIX (thread_create)
+      (&ids[i], max_connecting_worker, &args);
+   }
+
+   for (i = 0; i < MAX_CONNECTING_THREADS; i++) {
+      COMMON_PREFIX (thread_join) (ids[i]);
+   }
+
+   ASSERT_CMPINT32 (args.max_seen, >=, 1);
+   ASSERT_CMPINT32 (args.max_seen, <=, 3);
+   /* no thread is connecting to the server any more */
+   ASSERT_CMPUINT32 ((uint32_t) args.topology->connecting->items_len, ==, 0u);
+
+   mongoc_topology_destroy (args.topology);
+   mongoc_uri_destroy (uri);
+
+   /* the default */
+   uri = mongoc_uri_new ("mongodb://localhost");
+   args.topology = mongoc_topology_new (uri, false /* single-threaded */);
+   ASSERT_CMPINT32 (
+      args.topology->max_connecting, ==, MONGOC_TOPOLOGY_MAX_CONNECTING);
+   mongoc_topology_destroy (args.topology);
+   mongoc_uri_destroy (uri);
+}
+
+static BSON_THREAD_FUN (connecting_waiter, arg)
+{
+   mongoc_topology_t *topology = arg;
+
+   BSON_ASSERT (_mongoc_topology_connecting_begin (
+      topology, 1, bson_get_monotonic_time () + 10 * 1000 * 1000, NULL));
+   _mongoc_topology_connecting_end (topology, 1);
+
+   BSON_THREAD_RETURN;
+}
+
+/* a thread waiting to connect gives up at its deadline, without holding up
+ * the threads behind it */
+static void
+test_topology_max_connecting_timeout (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_topology_t *topology;
+   bson_error_t error;
+   bson_thread_t id;
+
+   uri = mongoc_uri_new ("mongodb://localhost/?maxConnecting=1");
+   topology = mongoc_topology_new (uri, false /* single-threaded */);
+
+   BSON_ASSERT (
+      _mongoc_topology_connecting_begin (topology, 1, INT64_MAX, &error));
+
+   /* a thread waits with a long deadline, then this thread with a short one */
+   COMMON_PREFIX (thread_create) (&id, connecting_waiter, topology);
+   _mongoc_usleep (100 * 1000);
+   BSON_ASSERT (!_mongoc_topology_connecting_begin (
+      topology, 1, bson_get_monotonic_time () + 100 * 1000, &error));
+   ASSERT_ERROR_CONTAINS (error,
+                          MONGOC_ERROR_STREAM,
+                          MONGOC_ERROR_STREAM_CONNECT,
+                          "Timed out waiting for other connections");
+
+   /* the waiter gets its turn, and the abandoned turn is skipped */
+   _mongoc_topology_connecting_end (topology, 1);
+   COMMON_PREFIX (thread_join) (id);
+   ASSERT_CMPUINT32 ((uint32_t) topology->connecting->items_len, ==, 0u);
+
+   mongoc_topology_destroy (topology);
+   mongoc_uri_destroy (uri);
+}
+
 void
 test_topology_install (TestSuite *suite)
 {
@@ -2607,4 +2730,9 @@ test_topology_install (TestSuite *suite)
       suite, "/Topology/hello_ok/single", test_hello_ok_single);
    TestSuite_AddMockServerTest (
       suite, "/Topology/hello_ok/pooled", test_hello_ok_pooled);
+   TestSuite_Add (
+      suite, "/Topology/max_connecting", test_topology_max_connecting);
+   TestSuite_Add (suite,
+                  "/Topology/max_connecting/timeout",
+                  test_topology_max_connecting_timeout);
 }
@@ -811,6 +811,15 @@ test_mongoc_uri_new_with_error (void)
       MONGOC_ERROR_COMMAND,
       MONGOC_ERROR_COMMAND_INVALID_ARG,
       "Invalid \"zlibcompressionlevel\" of 10: must be between -1 and 9");
+
+   memset (&error, 0, sizeof (bson_error_t));
+   ASSERT (!mongoc_uri_new_with_error (
+      "mongodb://localhost/db?localthresholdpercentile=101", &error));
+   ASSERT_ERROR_CONTAINS (
+      error,
+      MONGOC_ERROR_COMMAND,
+      MONGOC_ERROR_COMMAND_INVALID_ARG,
+      "Invalid \"localthresholdpercentile\" of 101: must be between 0 and 100");
 }
 
 
@@ -2698,6 +2707,81 @@ test_casing_options (void)
    mongoc_uri_destroy(uri);
 }
 
+static bool
+_uris_equivalent (const char *a, const char *b)
+{
+   mongoc_uri_t *uri_a;
+   mongoc_uri_t *uri_b;
+   char *str_a;
+   char *str_b;
+   bool ret;
+
+   uri_a = mongoc_uri_new (a);
+   uri_b = mongoc_uri_new (b);
+   BSON_ASSERT (uri_a);
+   BSON_ASSERT (uri_b);
+   str_a = _mongoc_uri_canonical_string (uri_a);
+   str_b = _mongoc_uri_canonical_string (uri_b);
+   ret = !strcmp (str_a, str_b) && _mongoc_uri_secrets_equal (uri_a, uri_b);
+
+   bson_free (str_a);
+   bson_free (str_b);
+   mongoc_uri_destroy (uri_a);
+   mongoc_uri_destroy (uri_b);
+
+   return ret;
+}
+
+
+static void
+test_mongoc_uri_canonical_string (void)
+{
+   mongoc_uri_t *uri;
+   mongoc_read_prefs_t *prefs;
+   char *before;
+   char *after;
+
+   BSON_ASSERT (_uris_equivalent ("mongodb://a:1,B:2/?replicaSet=rs&w=2",
+                                  "mongodb://b:2,a:1/?w=2&replicaset=rs"));
+   BSON_ASSERT (_uris_equivalent ("mongodb://user:pw@a/db?authSource=x",
+                                  "mongodb://user:pw@a/db?authsource=x"));
+   BSON_ASSERT (!_uris_equivalent ("mongodb://a:1,b:2/?replicaSet=rs",
+                                   "mongodb://a:1,b:2/?replicaSet=other"));
+   BSON_ASSERT (!_uris_equivalent ("mongodb://a:1,b:2/",
+                                   "mongodb://a:1,b:2,c:3/"));
+   BSON_ASSERT (
+      !_uris_equivalent ("mongodb://user:pw@a/", "mongodb://user:other@a/"));
+   BSON_ASSERT (!_uris_equivalent ("mongodb://a/db1", "mongodb://a/db2"));
+   BSON_ASSERT (!_uris_equivalent (
+      "mongodb://user:pw@a/?authMechanism=MONGODB-AWS"
+      "&authMechanismProperties=AWS_SESSION_TOKEN:token1",
+      "mongodb://user:pw@a/?authMechanism=MONGODB-AWS"
+      "&authMechanismProperties=AWS_SESSION_TOKEN:token2"));
+
+   /* secrets are not part of the string */
+   uri = mongoc_uri_new ("mongodb://user:secret@a/?authMechanism=MONGODB-AWS"
+                         "&authMechanismProperties=AWS_SESSION_TOKEN:token");
+   before = _mongoc_uri_canonical_string (uri);
+   BSON_ASSERT (!strstr (before, "secret"));
+   BSON_ASSERT (!strstr (before, "token"));
+   bson_free (before);
+   mongoc_uri_destroy (uri);
+
+   /* settings changed after parsing are taken into account */
+   uri = mongoc_uri_new ("mongodb://a/");
+   before = _mongoc_uri_canonical_string (uri);
+   prefs = mongoc_read_prefs_new (MONGOC_READ_SECONDARY);
+   mongoc_uri_set_read_prefs_t (uri, prefs);
+   after = _mongoc_uri_canonical_string (uri);
+   BSON_ASSERT (strcmp (before, after));
+
+   bson_free (before);
+   bson_free (after);
+   mongoc_read_prefs_destroy (prefs);
+   mongoc_uri_destroy (uri);
+}
+
+
 void
 test_uri_install (TestSuite *suite)
 {
@@ -2732,4 +2816,6 @@ test_uri_install (TestSuite *suite)
                   "/Uri/one_tls_option_enables_tls",
                   test_one_tls_option_enables_tls);
    TestSuite_Add(suite, "/Uri/options_casing", test_casing_options);
+   TestSuite_Add (
+      suite, "/Uri/canonical_string", test_mongoc_uri_canonical_string);
 }